@@ -306,9 +306,9 @@ int main(int Argc, char *ARGV[])
 		}
 	CRYPTO_mem_ctrl(CRYPTO_MEM_CHECK_ON);
 
-#if 0
+	/* lock_dbg_cb() only checks lock usage and cannot serialise threads,
+	 * so keep the library's locking unless asked to debug it */
 	if (getenv("OPENSSL_DEBUG_LOCKING") != NULL)
-#endif
 		{
 		CRYPTO_set_locking_callback(lock_dbg_cb);
 		}
@@ -0,0 +1,896 @@
+/* apps/s_bench.c */
+/* ====================================================================
+ * Copyright (c) 2013 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/* s_bench runs complete TLS client/server pairs inside one process,
+ * connected by BIO pairs, on any number of threads.  Nothing touches the
+ * network, so the figures are those of the SSL library itself: handshake
+ * state machines, session cache locking, allocation and record
+ * processing.
+ *
+ * For each key type and each cipher suite it reports
+ *   full/s	full handshakes per second, server session cache off
+ *   resumed/s	abbreviated handshakes per second, each thread resuming
+ *		its own session from the server cache (or a ticket)
+ *   GB/s	application data moved from client to server over one
+ *		connection per thread
+ * summed over all threads. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include "apps.h"
+#include <openssl/bio.h>
+#include <openssl/bn.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#ifndef OPENSSL_NO_RSA
+#include <openssl/rsa.h>
+#endif
+#ifndef OPENSSL_NO_EC
+#include <openssl/ec.h>
+#endif
+#ifndef OPENSSL_NO_DH
+#include <openssl/dh.h>
+#endif
+
+#if defined(OPENSSL_THREADS) && defined(OPENSSL_SYS_UNIX)
+#define BENCH_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#undef PROG
+#define PROG	s_bench_main
+
+#define BENCH_SECONDS		3
+#define BENCH_MAX_THREADS	256
+/* large enough for a whole flight and for one full record */
+#define BENCH_BIO_SIZE		(2 * SSL3_RT_MAX_PACKET_SIZE)
+
+#define BENCH_FULL		0
+#define BENCH_RESUME		1
+#define BENCH_BULK		2
+#define BENCH_NTESTS		3
+
+static const char *default_keys = "rsa:2048,ec:prime256v1";
+static const char *default_ciphers =
+	"AES128-SHA:AES128-GCM-SHA256:"
+	"ECDHE-RSA-AES128-GCM-SHA256:ECDHE-RSA-CHACHA20-POLY1305:"
+	"ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-ECDSA-CHACHA20-POLY1305";
+
+typedef struct bench_key_st
+	{
+	char name[64];
+	X509 *cert;
+	EVP_PKEY *pkey;
+	} BENCH_KEY;
+
+typedef struct bench_thread_st
+	{
+	int test;
+	SSL_CTX *s_ctx;
+	SSL_CTX *c_ctx;
+	int bytes;
+	double count;		/* handshakes, or bytes for BENCH_BULK */
+	int error;
+	} BENCH_THREAD;
+
+static volatile int bench_stop = 0;
+static time_t bench_deadline = 0;
+
+static const char *bench_usage[]={
+"usage: s_bench [args]\n",
+" -threads n    - run n client/server pairs in parallel (default 1)\n",
+" -time n       - seconds per measurement (default 3)\n",
+" -keys list    - server key types, comma separated rsa:<bits> and\n",
+"                 ec:<curve> (default rsa:2048,ec:prime256v1)\n",
+" -cert file    - use this server certificate instead of generated keys\n",
+" -key file     - private key for -cert (default: the -cert file)\n",
+" -cipher list  - cipher suites to measure one at a time, ':' separated\n",
+" -dhparam file - DH parameters for DHE cipher suites\n",
+" -tls1         - use TLSv1 only\n",
+" -tls1_1       - use TLSv1.1 only\n",
+" -tls1_2       - use TLSv1.2 only\n",
+" -tickets      - resume with session tickets instead of the session cache\n",
+" -bytes n      - size of each SSL_write() in the bulk test (default 16384)\n",
+" -full         - measure full handshakes\n",
+" -resume       - measure resumed handshakes\n",
+" -bulk         - measure bulk transfer\n",
+"                 (all three when none is given)\n",
+" -lock_stats   - print lock waits after the run\n",
+" -zero_copy    - server reads with SSL_MODE_ZERO_COPY_READ\n",
+NULL
+};
+
+#ifdef BENCH_THREADS
+/* Used only when libcrypto has no locking callback of its own */
+static pthread_mutex_t *bench_locks = NULL;
+
+static void bench_locking_cb(int mode, int type, const char *file, int line)
+	{
+	if (mode & CRYPTO_LOCK)
+		pthread_mutex_lock(&bench_locks[type]);
+	else
+		pthread_mutex_unlock(&bench_locks[type]);
+	}
+
+static void bench_setup_locks(void)
+	{
+	int i;
+
+	if (CRYPTO_get_locking_callback() != NULL)
+		return;
+	bench_locks = OPENSSL_malloc(CRYPTO_num_locks() *
+		sizeof(pthread_mutex_t));
+	for (i = 0; i < CRYPTO_num_locks(); i++)
+		pthread_mutex_init(&bench_locks[i], NULL);
+	CRYPTO_set_locking_callback(bench_locking_cb);
+	}
+
+static void bench_cleanup_locks(void)
+	{
+	int i;
+
+	if (bench_locks == NULL)
+		return;
+	CRYPTO_set_locking_callback(NULL);
+	for (i = 0; i < CRYPTO_num_locks(); i++)
+		pthread_mutex_destroy(&bench_locks[i]);
+	OPENSSL_free(bench_locks);
+	bench_locks = NULL;
+	}
+#elif defined(SIGALRM)
+static void bench_alarm(int sig)
+	{
+	signal(SIGALRM, bench_alarm);
+	bench_stop = 1;
+	}
+#endif
+
+static int bench_done(void)
+	{
+	if (bench_stop)
+		return 1;
+	if (bench_deadline != 0 && time(NULL) >= bench_deadline)
+		return 1;
+	return 0;
+	}
+
+static X509 *bench_self_signed(EVP_PKEY *pkey)
+	{
+	X509 *x;
+	X509_NAME *name;
+
+	if ((x = X509_new()) == NULL)
+		return NULL;
+	X509_set_version(x, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(x), 1);
+	X509_gmtime_adj(X509_get_notBefore(x), 0);
+	X509_gmtime_adj(X509_get_notAfter(x), 86400);
+	X509_set_pubkey(x, pkey);
+	name = X509_get_subject_name(x);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+		(unsigned char *)"s_bench", -1, -1, 0);
+	X509_set_issuer_name(x, name);
+	if (!X509_sign(x, pkey, EVP_sha256()))
+		{
+		X509_free(x);
+		return NULL;
+		}
+	return x;
+	}
+
+/* Generate the key described by |spec|, "rsa:<bits>" or "ec:<curve>" */
+static int bench_gen_key(BENCH_KEY *k, const char *spec)
+	{
+	EVP_PKEY *pkey = NULL;
+
+	if ((pkey = EVP_PKEY_new()) == NULL)
+		goto err;
+#ifndef OPENSSL_NO_RSA
+	if (strncmp(spec, "rsa:", 4) == 0)
+		{
+		RSA *rsa = RSA_new();
+		BIGNUM *e = BN_new();
+		int bits = atoi(spec + 4);
+
+		if (rsa == NULL || e == NULL || bits < 512 ||
+			!BN_set_word(e, RSA_F4) ||
+			!RSA_generate_key_ex(rsa, bits, e, NULL))
+			{
+			if (rsa) RSA_free(rsa);
+			if (e) BN_free(e);
+			goto err;
+			}
+		BN_free(e);
+		EVP_PKEY_assign_RSA(pkey, rsa);
+		}
+	else
+#endif
+#ifndef OPENSSL_NO_EC
+	if (strncmp(spec, "ec:", 3) == 0)
+		{
+		EC_KEY *ec;
+		int nid = OBJ_sn2nid(spec + 3);
+
+		if (nid == NID_undef)
+			nid = OBJ_ln2nid(spec + 3);
+		if (nid == NID_undef ||
+			(ec = EC_KEY_new_by_curve_name(nid)) == NULL)
+			goto err;
+		EC_KEY_set_asn1_flag(ec, OPENSSL_EC_NAMED_CURVE);
+		if (!EC_KEY_generate_key(ec))
+			{
+			EC_KEY_free(ec);
+			goto err;
+			}
+		EVP_PKEY_assign_EC_KEY(pkey, ec);
+		}
+	else
+#endif
+		goto err;
+
+	if ((k->cert = bench_self_signed(pkey)) == NULL)
+		goto err;
+	k->pkey = pkey;
+	BIO_snprintf(k->name, sizeof k->name, "%s", spec);
+	return 1;
+err:
+	BIO_printf(bio_err, "s_bench: cannot generate key %s\n", spec);
+	if (pkey) EVP_PKEY_free(pkey);
+	return 0;
+	}
+
+static SSL_CTX *bench_server_ctx(const SSL_METHOD *meth, BENCH_KEY *k,
+	const char *cipher, DH *dh, int tickets)
+	{
+	SSL_CTX *ctx;
+
+	if ((ctx = SSL_CTX_new(meth)) == NULL)
+		return NULL;
+	if (!SSL_CTX_use_certificate(ctx, k->cert) ||
+		!SSL_CTX_use_PrivateKey(ctx, k->pkey) ||
+		!SSL_CTX_set_cipher_list(ctx, cipher))
+		{
+		SSL_CTX_free(ctx);
+		return NULL;
+		}
+#ifndef OPENSSL_NO_ECDH
+		{
+		EC_KEY *ecdh = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+
+		if (ecdh != NULL)
+			{
+			SSL_CTX_set_tmp_ecdh(ctx, ecdh);
+			EC_KEY_free(ecdh);
+			}
+		SSL_CTX_set_options(ctx, SSL_OP_SINGLE_ECDH_USE);
+		}
+#endif
+#ifndef OPENSSL_NO_DH
+	if (dh != NULL)
+		SSL_CTX_set_tmp_dh(ctx, dh);
+#endif
+	SSL_CTX_set_session_id_context(ctx,
+		(const unsigned char *)"s_bench", 7);
+	if (!tickets)
+		SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+	SSL_CTX_set_quiet_shutdown(ctx, 1);
+	return ctx;
+	}
+
+static SSL_CTX *bench_client_ctx(const SSL_METHOD *meth, const char *cipher,
+	int tickets)
+	{
+	SSL_CTX *ctx;
+
+	if ((ctx = SSL_CTX_new(meth)) == NULL)
+		return NULL;
+	if (!SSL_CTX_set_cipher_list(ctx, cipher))
+		{
+		SSL_CTX_free(ctx);
+		return NULL;
+		}
+	if (!tickets)
+		SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+	SSL_CTX_set_quiet_shutdown(ctx, 1);
+	return ctx;
+	}
+
+static void bench_free_pair(SSL *s, SSL *c)
+	{
+	/* a quiet shutdown keeps the session resumable */
+	if (s != NULL)
+		{
+		SSL_set_shutdown(s, SSL_SENT_SHUTDOWN|SSL_RECEIVED_SHUTDOWN);
+		SSL_free(s);
+		}
+	if (c != NULL)
+		{
+		SSL_set_shutdown(c, SSL_SENT_SHUTDOWN|SSL_RECEIVED_SHUTDOWN);
+		SSL_free(c);
+		}
+	}
+
+static int bench_want(SSL *ssl, int ret)
+	{
+	int err = SSL_get_error(ssl, ret);
+
+	return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE;
+	}
+
+/* Connect a new client and server with a BIO pair and run the handshake.
+ * Returns 1 and sets *ps and *pc on success. */
+static int bench_connect(SSL_CTX *s_ctx, SSL_CTX *c_ctx, SSL_SESSION *sess,
+	SSL **ps, SSL **pc)
+	{
+	SSL *s = NULL, *c = NULL;
+	BIO *s_bio = NULL, *c_bio = NULL;
+	int i, rs = 0, rc = 0;
+
+	s = SSL_new(s_ctx);
+	c = SSL_new(c_ctx);
+	if (s == NULL || c == NULL ||
+		!BIO_new_bio_pair(&s_bio, BENCH_BIO_SIZE, &c_bio, BENCH_BIO_SIZE))
+		goto err;
+	SSL_set_bio(s, s_bio, s_bio);
+	SSL_set_bio(c, c_bio, c_bio);
+	SSL_set_accept_state(s);
+	SSL_set_connect_state(c);
+	if (sess != NULL)
+		SSL_set_session(c, sess);
+
+	/* every round moves at least one flight, so this is plenty */
+	for (i = 0; i < 32; i++)
+		{
+		if (rc != 1)
+			{
+			rc = SSL_do_handshake(c);
+			if (rc <= 0 && !bench_want(c, rc))
+				goto err;
+			}
+		if (rs != 1)
+			{
+			rs = SSL_do_handshake(s);
+			if (rs <= 0 && !bench_want(s, rs))
+				goto err;
+			}
+		if (rc == 1 && rs == 1)
+			{
+			*ps = s;
+			*pc = c;
+			return 1;
+			}
+		}
+err:
+	bench_free_pair(s, c);
+	return 0;
+	}
+
+/* Send |len| bytes from |c| to |s|, reading up to |rlen| bytes at a time
+ * into |buf| + |len| */
+static int bench_transfer(SSL *s, SSL *c, unsigned char *buf, int len,
+	int rlen)
+	{
+	int off = 0, n, got = 0;
+
+	while (got < len)
+		{
+		if (off < len)
+			{
+			n = len - off;
+			if (n > SSL3_RT_MAX_PLAIN_LENGTH)
+				n = SSL3_RT_MAX_PLAIN_LENGTH;
+			n = SSL_write(c, buf + off, n);
+			if (n > 0)
+				off += n;
+			else if (!bench_want(c, n))
+				return 0;
+			}
+		for (;;)
+			{
+			n = SSL_read(s, buf + len, rlen);
+			if (n > 0)
+				got += n;
+			else if (!bench_want(s, n))
+				return 0;
+			else
+				break;
+			}
+		}
+	return 1;
+	}
+
+static void *bench_thread_main(void *arg)
+	{
+	BENCH_THREAD *t = arg;
+	SSL *s = NULL, *c = NULL;
+	SSL_SESSION *sess = NULL;
+	unsigned char *buf = NULL;
+	int rlen;
+
+	switch (t->test)
+		{
+	case BENCH_FULL:
+		while (!bench_done())
+			{
+			if (!bench_connect(t->s_ctx, t->c_ctx, NULL, &s, &c))
+				goto err;
+			bench_free_pair(s, c);
+			t->count++;
+			}
+		break;
+
+	case BENCH_RESUME:
+		if (!bench_connect(t->s_ctx, t->c_ctx, NULL, &s, &c))
+			goto err;
+		sess = SSL_get1_session(c);
+		bench_free_pair(s, c);
+		while (!bench_done())
+			{
+			if (!bench_connect(t->s_ctx, t->c_ctx, sess, &s, &c))
+				goto err;
+			if (!SSL_session_reused(c))
+				{
+				bench_free_pair(s, c);
+				goto err;
+				}
+			bench_free_pair(s, c);
+			t->count++;
+			}
+		break;
+
+	case BENCH_BULK:
+		/* room for a whole record, so that it can be read in place */
+		rlen = t->bytes;
+		if (rlen < SSL3_RT_MAX_PACKET_SIZE)
+			rlen = SSL3_RT_MAX_PACKET_SIZE;
+		if ((buf = OPENSSL_malloc(t->bytes + rlen)) == NULL)
+			goto err;
+		memset(buf, 'x', t->bytes);
+		if (!bench_connect(t->s_ctx, t->c_ctx, NULL, &s, &c))
+			goto err;
+		while (!bench_done())
+			{
+			if (!bench_transfer(s, c, buf, t->bytes, rlen))
+				{
+				bench_free_pair(s, c);
+				goto err;
+				}
+			t->count += t->bytes;
+			}
+		bench_free_pair(s, c);
+		break;
+		}
+	goto done;
+err:
+	t->error = 1;
+done:
+	if (sess != NULL) SSL_SESSION_free(sess);
+	if (buf != NULL) OPENSSL_free(buf);
+	ERR_remove_thread_state(NULL);
+	return NULL;
+	}
+
+/* Run |test| on |nthreads| threads for |seconds|; returns the total count
+ * per second, or -1 on failure */
+static double bench_run(int test, SSL_CTX *s_ctx, SSL_CTX *c_ctx,
+	int nthreads, int seconds, int bytes)
+	{
+	BENCH_THREAD th[BENCH_MAX_THREADS];
+#ifdef BENCH_THREADS
+	pthread_t tid[BENCH_MAX_THREADS];
+#endif
+	double total = 0, elapsed;
+	int i, error = 0;
+
+	memset(th, 0, sizeof th);
+	for (i = 0; i < nthreads; i++)
+		{
+		th[i].test = test;
+		th[i].s_ctx = s_ctx;
+		th[i].c_ctx = c_ctx;
+		th[i].bytes = bytes;
+		}
+
+	bench_stop = 0;
+	app_tminterval(TM_START, 0);
+#ifdef BENCH_THREADS
+	for (i = 0; i < nthreads; i++)
+		{
+		if (pthread_create(&tid[i], NULL, bench_thread_main, &th[i]))
+			{
+			BIO_printf(bio_err, "s_bench: cannot start thread\n");
+			bench_stop = 1;
+			nthreads = i;
+			error = 1;
+			break;
+			}
+		}
+	if (!error)
+		sleep(seconds);
+	bench_stop = 1;
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tid[i], NULL);
+#else
+# ifdef SIGALRM
+	signal(SIGALRM, bench_alarm);
+	alarm(seconds);
+# else
+	bench_deadline = time(NULL) + seconds;
+# endif
+	bench_thread_main(&th[0]);
+	bench_deadline = 0;
+#endif
+	elapsed = app_tminterval(TM_STOP, 0);
+
+	for (i = 0; i < nthreads; i++)
+		{
+		error |= th[i].error;
+		total += th[i].count;
+		}
+	if (error || elapsed <= 0)
+		return -1;
+	return total / elapsed;
+	}
+
+static void bench_print_result(BIO *out, double r, int test)
+	{
+	if (r < 0)
+		BIO_printf(out, " %11s", "failed");
+	else if (test == BENCH_BULK)
+		BIO_printf(out, " %11.3f", r / 1e9);
+	else
+		BIO_printf(out, " %11.1f", r);
+	}
+
+int MAIN(int, char **);
+
+int MAIN(int argc, char **argv)
+	{
+	int ret = 1, badops = 0, i, j, t;
+	int nthreads = 1, seconds = BENCH_SECONDS, bytes = 16384;
+	int tickets = 0, lock_stats = 0, nkeys = 0, zero_copy = 0;
+	int tests[BENCH_NTESTS] = { 0, 0, 0 };
+	char *keyspec = NULL, *certfile = NULL, *keyfile = NULL;
+	char *ciphers = NULL, *dhfile = NULL;
+	char *kbuf = NULL, *cbuf = NULL, *p, *q;
+	const SSL_METHOD *s_meth = NULL, *c_meth = NULL;
+	BENCH_KEY keys[16];
+	DH *dh = NULL;
+	BIO *out = NULL;
+	const char **pp;
+
+	apps_startup();
+
+	if (bio_err == NULL)
+		if ((bio_err = BIO_new(BIO_s_file())) != NULL)
+			BIO_set_fp(bio_err, stderr, BIO_NOCLOSE|BIO_FP_TEXT);
+
+	if (!load_config(bio_err, NULL))
+		goto end;
+
+	memset(keys, 0, sizeof keys);
+
+	argc--;
+	argv++;
+	while (argc >= 1)
+		{
+		if (strcmp(*argv, "-threads") == 0)
+			{
+			if (--argc < 1) goto bad;
+			nthreads = atoi(*(++argv));
+			if (nthreads < 1 || nthreads > BENCH_MAX_THREADS)
+				goto bad;
+			}
+		else if (strcmp(*argv, "-time") == 0)
+			{
+			if (--argc < 1) goto bad;
+			seconds = atoi(*(++argv));
+			if (seconds < 1) goto bad;
+			}
+		else if (strcmp(*argv, "-keys") == 0)
+			{
+			if (--argc < 1) goto bad;
+			keyspec = *(++argv);
+			}
+		else if (strcmp(*argv, "-cert") == 0)
+			{
+			if (--argc < 1) goto bad;
+			certfile = *(++argv);
+			}
+		else if (strcmp(*argv, "-key") == 0)
+			{
+			if (--argc < 1) goto bad;
+			keyfile = *(++argv);
+			}
+		else if (strcmp(*argv, "-cipher") == 0)
+			{
+			if (--argc < 1) goto bad;
+			ciphers = *(++argv);
+			}
+		else if (strcmp(*argv, "-dhparam") == 0)
+			{
+			if (--argc < 1) goto bad;
+			dhfile = *(++argv);
+			}
+		else if (strcmp(*argv, "-bytes") == 0)
+			{
+			if (--argc < 1) goto bad;
+			bytes = atoi(*(++argv));
+			if (bytes < 1) goto bad;
+			}
+#ifndef OPENSSL_NO_TLS1
+		else if (strcmp(*argv, "-tls1") == 0)
+			{
+			s_meth = TLSv1_server_method();
+			c_meth = TLSv1_client_method();
+			}
+		else if (strcmp(*argv, "-tls1_1") == 0)
+			{
+			s_meth = TLSv1_1_server_method();
+			c_meth = TLSv1_1_client_method();
+			}
+		else if (strcmp(*argv, "-tls1_2") == 0)
+			{
+			s_meth = TLSv1_2_server_method();
+			c_meth = TLSv1_2_client_method();
+			}
+#endif
+		else if (strcmp(*argv, "-tickets") == 0)
+			tickets = 1;
+		else if (strcmp(*argv, "-full") == 0)
+			tests[BENCH_FULL] = 1;
+		else if (strcmp(*argv, "-resume") == 0)
+			tests[BENCH_RESUME] = 1;
+		else if (strcmp(*argv, "-bulk") == 0)
+			tests[BENCH_BULK] = 1;
+		else if (strcmp(*argv, "-lock_stats") == 0)
+			lock_stats = 1;
+		else if (strcmp(*argv, "-zero_copy") == 0)
+			zero_copy = 1;
+		else
+			{
+			BIO_printf(bio_err, "unknown option %s\n", *argv);
+			badops = 1;
+			break;
+			}
+		argc--;
+		argv++;
+		}
+
+	if (badops)
+		{
+bad:
+		for (pp = bench_usage; *pp != NULL; pp++)
+			BIO_printf(bio_err, "%s", *pp);
+		goto end;
+		}
+
+#ifndef BENCH_THREADS
+	if (nthreads > 1)
+		{
+		BIO_printf(bio_err, "s_bench: threads are not supported "
+			"on this platform, using one\n");
+		nthreads = 1;
+		}
+#else
+	if (nthreads > 1 && getenv("OPENSSL_DEBUG_LOCKING") != NULL)
+		{
+		BIO_printf(bio_err, "s_bench: OPENSSL_DEBUG_LOCKING does not "
+			"lock, using one thread\n");
+		nthreads = 1;
+		}
+	bench_setup_locks();
+#endif
+
+	if (!tests[BENCH_FULL] && !tests[BENCH_RESUME] && !tests[BENCH_BULK])
+		tests[BENCH_FULL] = tests[BENCH_RESUME] = tests[BENCH_BULK] = 1;
+	if (s_meth == NULL)
+		{
+		s_meth = SSLv23_server_method();
+		c_meth = SSLv23_client_method();
+		}
+
+	SSL_load_error_strings();
+	OpenSSL_add_ssl_algorithms();
+
+	if ((out = BIO_new(BIO_s_file())) == NULL)
+		goto end;
+	BIO_set_fp(out, stdout, BIO_NOCLOSE);
+
+#ifndef OPENSSL_NO_DH
+	if (dhfile != NULL)
+		{
+		BIO *in = BIO_new_file(dhfile, "r");
+
+		if (in != NULL)
+			{
+			dh = PEM_read_bio_DHparams(in, NULL, NULL, NULL);
+			BIO_free(in);
+			}
+		if (dh == NULL)
+			{
+			BIO_printf(bio_err, "s_bench: cannot load %s\n",
+				dhfile);
+			goto end;
+			}
+		}
+#endif
+
+	if (certfile != NULL)
+		{
+		keys[0].cert = load_cert(bio_err, certfile, FORMAT_PEM, NULL,
+			NULL, "server certificate");
+		keys[0].pkey = load_key(bio_err, keyfile ? keyfile : certfile,
+			FORMAT_PEM, 0, NULL, NULL, "server key");
+		if (keys[0].cert == NULL || keys[0].pkey == NULL)
+			goto end;
+		BIO_snprintf(keys[0].name, sizeof keys[0].name, "%s",
+			OBJ_nid2sn(EVP_PKEY_type(keys[0].pkey->type)));
+		nkeys = 1;
+		}
+	else
+		{
+		kbuf = BUF_strdup(keyspec ? keyspec : default_keys);
+		for (p = kbuf; p != NULL && *p != '\0'; p = q)
+			{
+			if ((q = strchr(p, ',')) != NULL)
+				*q++ = '\0';
+			if (nkeys == (int)(sizeof keys / sizeof keys[0]))
+				break;
+			if (!bench_gen_key(&keys[nkeys], p))
+				goto end;
+			nkeys++;
+			}
+		}
+
+	BIO_printf(out, "s_bench: %d thread%s, %d second%s per test\n",
+		nthreads, nthreads > 1 ? "s" : "",
+		seconds, seconds > 1 ? "s" : "");
+	BIO_printf(out, "%-16s %-32s %11s %11s %11s\n",
+		"key", "cipher", "full/s", "resumed/s", "bulk GB/s");
+
+	cbuf = BUF_strdup(ciphers ? ciphers : default_ciphers);
+	for (i = 0; i < nkeys; i++)
+		{
+		for (p = cbuf; p != NULL && *p != '\0'; p = q)
+			{
+			SSL_CTX *s_ctx = NULL, *c_ctx = NULL;
+			SSL *s, *c;
+
+			if ((q = strchr(p, ':')) != NULL)
+				*q = '\0';
+
+			s_ctx = bench_server_ctx(s_meth, &keys[i], p, dh,
+				tickets);
+			if (s_ctx != NULL && zero_copy)
+				SSL_CTX_set_mode(s_ctx, SSL_MODE_ZERO_COPY_READ);
+			c_ctx = bench_client_ctx(c_meth, p, tickets);
+			/* skip suites this key or build cannot negotiate */
+			if (s_ctx == NULL || c_ctx == NULL ||
+				!bench_connect(s_ctx, c_ctx, NULL, &s, &c))
+				{
+				if (ciphers != NULL)
+					BIO_printf(bio_err, "s_bench: %s "
+						"cannot use %s, skipped\n",
+						keys[i].name, p);
+				ERR_clear_error();
+				}
+			else
+				{
+				bench_free_pair(s, c);
+				BIO_printf(out, "%-16s %-32s", keys[i].name, p);
+				(void)BIO_flush(out);
+				for (t = 0; t < BENCH_NTESTS; t++)
+					{
+					double r;
+
+					if (!tests[t])
+						{
+						BIO_printf(out, " %11s", "-");
+						continue;
+						}
+					SSL_CTX_set_session_cache_mode(s_ctx,
+						t == BENCH_RESUME ?
+						SSL_SESS_CACHE_SERVER :
+						SSL_SESS_CACHE_OFF);
+					r = bench_run(t, s_ctx, c_ctx,
+						nthreads, seconds, bytes);
+					bench_print_result(out, r, t);
+					(void)BIO_flush(out);
+					if (r < 0)
+						ERR_print_errors(bio_err);
+					}
+				BIO_printf(out, "\n");
+				(void)BIO_flush(out);
+				}
+			if (s_ctx != NULL) SSL_CTX_free(s_ctx);
+			if (c_ctx != NULL) SSL_CTX_free(c_ctx);
+			if (q != NULL)
+				*q++ = ':';
+			}
+		}
+
+#ifndef OPENSSL_NO_FP_API
+	if (lock_stats)
+		{
+		(void)BIO_flush(out);
+		CRYPTO_lock_contention_fp(stdout);
+		}
+#endif
+	ret = 0;
+end:
+	for (j = 0; j < (int)(sizeof keys / sizeof keys[0]); j++)
+		{
+		if (keys[j].cert) X509_free(keys[j].cert);
+		if (keys[j].pkey) EVP_PKEY_free(keys[j].pkey);
+		}
+#ifndef OPENSSL_NO_DH
+	if (dh != NULL) DH_free(dh);
+#endif
+	if (kbuf != NULL) OPENSSL_free(kbuf);
+	if (cbuf != NULL) OPENSSL_free(cbuf);
+	if (out != NULL) BIO_free_all(out);
+#ifdef BENCH_THREADS
+	bench_cleanup_locks();
+#endif
+	apps_shutdown();
+	OPENSSL_EXIT(ret);
+	}
@@ -190,6 +190,12 @@
 #include <openssl/ecdh.h>
 #endif
 #include <openssl/modes.h>
+#ifndef OPENSSL_NO_CHACHA
+#include <openssl/chacha.h>
+#endif
+#ifndef OPENSSL_NO_POLY1305
+#include <openssl/poly1305.h>
+#endif
 
 #ifdef OPENSSL_FIPS
 #ifdef OPENSSL_DOING_MAKEDEPEND
@@ -238,8 +244,11 @@ static void print_result(int alg,int run_no,int count,double time_used);
 #ifndef NO_FORK
 static int do_multi(int multi);
 #endif
+#ifndef OPENSSL_NO_MULTIBLOCK
+static void multiblock_speed(const EVP_CIPHER *evp_cipher);
+#endif
 
-#define ALGOR_NUM	30
+#define ALGOR_NUM	32
 #define SIZE_NUM	5
 #define RSA_NUM		4
 #define DSA_NUM		3
@@ -254,7 +263,8 @@ static const char *names[ALGOR_NUM]={
   "aes-128 cbc","aes-192 cbc","aes-256 cbc",
   "camellia-128 cbc","camellia-192 cbc","camellia-256 cbc",
   "evp","sha256","sha512","whirlpool",
-  "aes-128 ige","aes-192 ige","aes-256 ige","ghash" };
+  "aes-128 ige","aes-192 ige","aes-256 ige","ghash",
+  "chacha20","poly1305" };
 static double results[ALGOR_NUM][SIZE_NUM];
 static int lengths[SIZE_NUM]={16,64,256,1024,8*1024};
 #ifndef OPENSSL_NO_RSA
@@ -425,16 +435,16 @@ int MAIN(int argc, char **argv)
 	static const unsigned char key16[16]=
 		{0x12,0x34,0x56,0x78,0x9a,0xbc,0xde,0xf0,
 		 0x34,0x56,0x78,0x9a,0xbc,0xde,0xf0,0x12};
-#ifndef OPENSSL_NO_AES
-	static const unsigned char key24[24]=
-		{0x12,0x34,0x56,0x78,0x9a,0xbc,0xde,0xf0,
-		 0x34,0x56,0x78,0x9a,0xbc,0xde,0xf0,0x12,
-		 0x56,0x78,0x9a,0xbc,0xde,0xf0,0x12,0x34};
 	static const unsigned char key32[32]=
 		{0x12,0x34,0x56,0x78,0x9a,0xbc,0xde,0xf0,
 		 0x34,0x56,0x78,0x9a,0xbc,0xde,0xf0,0x12,
 		 0x56,0x78,0x9a,0xbc,0xde,0xf0,0x12,0x34,
 		 0x78,0x9a,0xbc,0xde,0xf0,0x12,0x34,0x56};
+#ifndef OPENSSL_NO_AES
+	static const unsigned char key24[24]=
+		{0x12,0x34,0x56,0x78,0x9a,0xbc,0xde,0xf0,
+		 0x34,0x56,0x78,0x9a,0xbc,0xde,0xf0,0x12,
+		 0x56,0x78,0x9a,0xbc,0xde,0xf0,0x12,0x34};
 #endif
 #ifndef OPENSSL_NO_CAMELLIA
 	static const unsigned char ckey24[24]=
@@ -498,6 +508,8 @@ int MAIN(int argc, char **argv)
 #define D_IGE_192_AES   27
 #define D_IGE_256_AES   28
 #define D_GHASH		29
+#define D_CHACHA20	30
+#define D_POLY1305	31
 	double d=0.0;
 	long c[ALGOR_NUM][SIZE_NUM];
 #define	R_DSA_512	0
@@ -626,6 +638,7 @@ int MAIN(int argc, char **argv)
 	const EVP_CIPHER *evp_cipher=NULL;
 	const EVP_MD *evp_md=NULL;
 	int decrypt=0;
+	int multiblock=0;
 #ifndef NO_FORK
 	int multi=0;
 #endif
@@ -733,6 +746,14 @@ int MAIN(int argc, char **argv)
 			j--;	/* Otherwise, -elapsed gets confused with
 				   an algorithm. */
 			}
+#ifndef OPENSSL_NO_MULTIBLOCK
+		else if (argc > 0 && !strcmp(*argv,"-mb"))
+			{
+			multiblock=1;
+			j--;	/* Otherwise, -mb gets confused with
+				   an algorithm. */
+			}
+#endif
 #ifndef OPENSSL_NO_ENGINE
 		else if	((argc > 0) && (strcmp(*argv,"-engine") == 0))
 			{
@@ -818,6 +839,14 @@ int MAIN(int argc, char **argv)
 			if (strcmp(*argv,"whirlpool") == 0) doit[D_WHIRLPOOL]=1;
 		else
 #endif
+#ifndef OPENSSL_NO_CHACHA
+			if (strcmp(*argv,"chacha20") == 0) doit[D_CHACHA20]=1;
+		else
+#endif
+#ifndef OPENSSL_NO_POLY1305
+			if (strcmp(*argv,"poly1305") == 0) doit[D_POLY1305]=1;
+		else
+#endif
 #ifndef OPENSSL_NO_RIPEMD
 			if (strcmp(*argv,"ripemd") == 0) doit[D_RMD160]=1;
 		else
@@ -1080,6 +1109,15 @@ int MAIN(int argc, char **argv)
 			BIO_printf(bio_err,"rc4");
 #endif
 			BIO_printf(bio_err,"\n");
+#ifndef OPENSSL_NO_CHACHA
+			BIO_printf(bio_err,"chacha20 ");
+#endif
+#ifndef OPENSSL_NO_POLY1305
+			BIO_printf(bio_err,"poly1305");
+#endif
+#if !defined(OPENSSL_NO_CHACHA) || !defined(OPENSSL_NO_POLY1305)
+			BIO_printf(bio_err,"\n");
+#endif
 
 #ifndef OPENSSL_NO_RSA
 			BIO_printf(bio_err,"rsa512   rsa1024  rsa2048  rsa4096\n");
@@ -1142,6 +1180,9 @@ int MAIN(int argc, char **argv)
 #endif
 			BIO_printf(bio_err,"-evp e          use EVP e.\n");
 			BIO_printf(bio_err,"-decrypt        time decryption instead of encryption (only EVP).\n");
+#ifndef OPENSSL_NO_MULTIBLOCK
+			BIO_printf(bio_err,"-mb             compare multi-block and sequential TLS record encryption (only EVP).\n");
+#endif
 			BIO_printf(bio_err,"-mr             produce machine readable output.\n");
 #ifndef NO_FORK
 			BIO_printf(bio_err,"-multi n        run n benchmarks in parallel.\n");
@@ -1298,6 +1339,8 @@ int MAIN(int argc, char **argv)
 	c[D_IGE_192_AES][0]=count;
 	c[D_IGE_256_AES][0]=count;
 	c[D_GHASH][0]=count;
+	c[D_CHACHA20][0]=count;
+	c[D_POLY1305][0]=count;
 
 	for (i=1; i<SIZE_NUM; i++)
 		{
@@ -1336,6 +1379,8 @@ int MAIN(int argc, char **argv)
 		c[D_IGE_128_AES][i]=c[D_IGE_128_AES][i-1]*l0/l1;
 		c[D_IGE_192_AES][i]=c[D_IGE_192_AES][i-1]*l0/l1;
 		c[D_IGE_256_AES][i]=c[D_IGE_256_AES][i-1]*l0/l1;
+		c[D_CHACHA20][i]=c[D_CHACHA20][i-1]*l0/l1;
+		c[D_POLY1305][i]=c[D_POLY1305][i-1]*l0/l1;
 		}
 #ifndef OPENSSL_NO_RSA
 	rsa_c[R_RSA_512][0]=count/2000;
@@ -1499,6 +1544,21 @@ int MAIN(int argc, char **argv)
 #endif
 #endif /* SIGALRM */
 
+#ifndef OPENSSL_NO_MULTIBLOCK
+	if (multiblock)
+		{
+		if (evp_cipher == NULL ||
+		    !(EVP_CIPHER_flags(evp_cipher) & EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK))
+			{
+			BIO_printf(bio_err,"-mb requires a multi-block capable cipher, such as -evp aes-128-cbc-hmac-sha1\n");
+			goto end;
+			}
+		multiblock_speed(evp_cipher);
+		mret=0;
+		goto end;
+		}
+#endif
+
 #ifndef OPENSSL_NO_MD2
 	if (doit[D_MD2])
 		{
@@ -1806,6 +1866,42 @@ int MAIN(int argc, char **argv)
 		}
 
 #endif
+#ifndef OPENSSL_NO_CHACHA
+	if (doit[D_CHACHA20])
+		{
+		for (j=0; j<SIZE_NUM; j++)
+			{
+			print_message(names[D_CHACHA20],c[D_CHACHA20][j],lengths[j]);
+			Time_F(START);
+			for (count=0,run=1; COND(c[D_CHACHA20][j]); count++)
+				CRYPTO_chacha_20(buf,buf,(unsigned long)lengths[j],
+					key32,(unsigned char *)"0123456789ab",1);
+			d=Time_F(STOP);
+			print_result(D_CHACHA20,j,count,d);
+			}
+		}
+#endif
+#ifndef OPENSSL_NO_POLY1305
+	if (doit[D_POLY1305])
+		{
+		POLY1305_CTX poly;
+		unsigned char tag[POLY1305_TAG_SIZE];
+
+		for (j=0; j<SIZE_NUM; j++)
+			{
+			print_message(names[D_POLY1305],c[D_POLY1305][j],lengths[j]);
+			Time_F(START);
+			for (count=0,run=1; COND(c[D_POLY1305][j]); count++)
+				{
+				CRYPTO_poly1305_init(&poly,key32);
+				CRYPTO_poly1305_update(&poly,buf,lengths[j]);
+				CRYPTO_poly1305_finish(&poly,tag);
+				}
+			d=Time_F(STOP);
+			print_result(D_POLY1305,j,count,d);
+			}
+		}
+#endif
 #ifndef OPENSSL_NO_CAMELLIA
 	if (doit[D_CBC_128_CML])
 		{
@@ -2573,6 +2669,129 @@ end:
 	OPENSSL_EXIT(mret);
 	}
 
+#ifndef OPENSSL_NO_MULTIBLOCK
+/* TLS 1.1+ application data records as written by SSL_write(): 8 records
+ * of len/8 bytes, either encrypted at once or one after the other.
+ */
+static void multiblock_speed(const EVP_CIPHER *evp_cipher)
+	{
+	static int mblengths[]={8*1024,2*8*1024,4*8*1024,8*8*1024,8*16*1024};
+	const int num=sizeof(mblengths)/sizeof(mblengths[0]);
+	static const char *mbnames[2]={"multi-block","sequential"};
+	double mbresults[2][sizeof(mblengths)/sizeof(mblengths[0])];
+	unsigned char *inp,*out,no_key[32],no_iv[16];
+	EVP_CIPHER_CTX ctx;
+	double d=0.0;
+	long count;
+	int j,k,mode;
+
+	EVP_CIPHER_CTX_init(&ctx);
+
+	inp=OPENSSL_malloc(mblengths[num-1]);
+	out=OPENSSL_malloc(mblengths[num-1]+1024);
+	if (inp == NULL || out == NULL)
+		{
+		BIO_printf(bio_err,"out of memory\n");
+		goto end;
+		}
+	RAND_pseudo_bytes(inp,mblengths[num-1]);
+	memset(no_key,0,sizeof(no_key));
+	memset(no_iv,0,sizeof(no_iv));
+
+	EVP_EncryptInit_ex(&ctx,evp_cipher,NULL,no_key,no_iv);
+	EVP_CIPHER_CTX_ctrl(&ctx,EVP_CTRL_AEAD_SET_MAC_KEY,sizeof(no_key),no_key);
+
+	for (mode=0; mode<2; mode++)
+		{
+		for (j=0; j<num; j++)
+			{
+			print_message(mbnames[mode],0,mblengths[j]);
+			Time_F(START);
+			for (count=0,run=1; run && count<0x7fffffff; count++)
+				{
+				unsigned char aad[13];
+				EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM mb_param;
+				size_t frag=mblengths[j]/8, len;
+				int packlen,pad;
+
+				memset(aad,0,8);
+				aad[8]=23;	/* SSL3_RT_APPLICATION_DATA */
+				aad[9]=3;	/* TLS 1.1 */
+				aad[10]=2;
+
+				if (mode == 0)
+					{
+					aad[11]=0;
+					aad[12]=0;
+					mb_param.out=NULL;
+					mb_param.inp=aad;
+					mb_param.len=mblengths[j];
+					mb_param.interleave=8;
+
+					packlen=EVP_CIPHER_CTX_ctrl(&ctx,
+						EVP_CTRL_TLS1_1_MULTIBLOCK_AAD,
+						sizeof(mb_param),&mb_param);
+					if (packlen <= 0)
+						{
+						BIO_printf(bio_err,"multi-block encryption failed\n");
+						goto end;
+						}
+
+					mb_param.out=out;
+					mb_param.inp=inp;
+					EVP_CIPHER_CTX_ctrl(&ctx,
+						EVP_CTRL_TLS1_1_MULTIBLOCK_ENCRYPT,
+						sizeof(mb_param),&mb_param);
+					continue;
+					}
+
+				for (k=0; k<8; k++)
+					{
+					/* explicit IV, payload, MAC and padding */
+					len=16+frag;
+					aad[11]=(unsigned char)(len>>8);
+					aad[12]=(unsigned char)len;
+					pad=EVP_CIPHER_CTX_ctrl(&ctx,
+						EVP_CTRL_AEAD_TLS1_AAD,13,aad);
+					RAND_pseudo_bytes(out,16);
+					memcpy(out+16,inp+k*frag,frag);
+					EVP_Cipher(&ctx,out,out,len+pad);
+					}
+				}
+			d=Time_F(STOP);
+			BIO_printf(bio_err,mr ? "+R:%ld:%s:%f\n"
+				   : "%ld %s's in %.2fs\n",count,mbnames[mode],d);
+			mbresults[mode][j]=((double)count)/d*mblengths[j];
+			}
+		}
+
+	if (mr)
+		fprintf(stdout,"+H");
+	else
+		{
+		fprintf(stdout,"The 'numbers' are in 1000s of bytes per second processed.\n");
+		fprintf(stdout,"%-24s",OBJ_nid2ln(evp_cipher->nid));
+		}
+	for (j=0; j<num; j++)
+		fprintf(stdout,mr ? ":%d" : "%7d bytes",mblengths[j]);
+	fprintf(stdout,"\n");
+
+	for (mode=0; mode<2; mode++)
+		{
+		fprintf(stdout,mr ? "+F:%s" : "%-24s",mbnames[mode]);
+		for (j=0; j<num; j++)
+			fprintf(stdout,mr ? ":%.2f" : " %11.2fk",
+				mr ? mbresults[mode][j] : mbresults[mode][j]/1e3);
+		fprintf(stdout,"\n");
+		}
+
+end:
+	EVP_CIPHER_CTX_cleanup(&ctx);
+	if (inp) OPENSSL_free(inp);
+	if (out) OPENSSL_free(out);
+	}
+#endif
+
 static void print_message(const char *s, long num, int length)
 	{
 #ifdef SIGALRM
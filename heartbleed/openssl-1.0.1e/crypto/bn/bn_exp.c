@@ -112,6 +112,7 @@
 
 #include "cryptlib.h"
 #include "bn_lcl.h"
+#include "rsaz_exp.h"
 
 #include <stdlib.h>
 #ifdef _WIN32
@@ -619,6 +620,26 @@ int BN_mod_exp_mont_consttime(BIGNUM *rr, const BIGNUM *a, const BIGNUM *p,
 		if (!BN_MONT_CTX_set(mont,m,ctx)) goto err;
 		}
 
+#ifdef RSAZ_ENABLED
+	/* 1024-bit operands, i.e. the CRT halves of RSA-2048, go to the
+	 * AVX2 code in rsaz_exp.c when the processor supports it. */
+	if (a->top == 16 && p->top == 16 && BN_num_bits(m) == 1024 &&
+	    !a->neg && BN_ucmp(a,m) < 0 && rsaz_avx2_eligible())
+		{
+		BN_ULONG RR[16];
+
+		if (bn_wexpand(rr,16) == NULL) goto err;
+		memset(RR,0,sizeof(RR));
+		memcpy(RR,mont->RR.d,mont->RR.top*sizeof(BN_ULONG));
+		RSAZ_1024_mod_exp_avx2(rr->d,a->d,p->d,m->d,RR,mont->n0[0]);
+		rr->top=16;
+		rr->neg=0;
+		bn_correct_top(rr);
+		ret=1;
+		goto err;
+		}
+#endif
+
 	/* Get the window size to use with size of p. */
 	window = BN_window_bits_for_ctime_exponent_size(bits);
 #if defined(OPENSSL_BN_ASM_MONT5)
@@ -179,6 +179,57 @@ int main(int argc, char *argv[])
 			EXIT(1);
 			}
 		}
+	/* 1024-bit operands may take a dedicated code path in
+	 * BN_mod_exp_mont_consttime(), as for the RSA-2048 CRT halves */
+	for (i=0; i<100; i++)
+		{
+		BN_rand(m,1024,0,1);
+		switch (i)
+			{
+		case 0:	/* largest base and exponent */
+			BN_sub(a,m,BN_value_one());
+			BN_one(b);
+			BN_lshift(b,b,1024);
+			BN_sub(b,b,BN_value_one());
+			break;
+		case 1:	/* sparse base */
+			BN_one(a);
+			BN_lshift(a,a,1000);
+			BN_add_word(a,1);
+			BN_rand(b,1024,-1,0);
+			break;
+		default:
+			BN_rand(a,1024,-1,0);
+			BN_mod(a,a,m,ctx);
+			BN_rand(b,1024,-1,0);
+			break;
+			}
+
+		if (BN_mod_exp_mont(r_mont,a,b,m,ctx,NULL) <= 0 ||
+		    BN_mod_exp_recp(r_recp,a,b,m,ctx) <= 0 ||
+		    BN_mod_exp_mont_consttime(r_mont_const,a,b,m,ctx,NULL) <= 0)
+			{
+			printf("1024-bit modular exponentiation problems\n");
+			ERR_print_errors(out);
+			EXIT(1);
+			}
+		if (BN_cmp(r_mont,r_recp) != 0 ||
+		    BN_cmp(r_mont,r_mont_const) != 0)
+			{
+			printf("\n1024-bit results differ\n");
+			printf("a = ");	BN_print(out,a);
+			printf("\nb = "); BN_print(out,b);
+			printf("\nm = "); BN_print(out,m);
+			printf("\nrecp     ="); BN_print(out,r_recp);
+			printf("\nmont     ="); BN_print(out,r_mont);
+			printf("\nmont_ct  ="); BN_print(out,r_mont_const);
+			printf("\n");
+			EXIT(1);
+			}
+		printf(".");
+		fflush(stdout);
+		}
+
 	BN_free(r_mont);
 	BN_free(r_mont_const);
 	BN_free(r_recp);
@@ -0,0 +1,506 @@
+/* ====================================================================
+ * Copyright (c) 2013 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/*
+ * Constant-time 1024-bit modular exponentiation with AVX2, used for the
+ * two CRT halves of a 2048-bit RSA private key operation.
+ *
+ * Numbers are held in a redundant radix-2^29 representation, one digit
+ * per 64-bit vector lane, so that the 32x32->64 bit vpmuludq products of
+ * two digits can be summed many times over before a lane overflows.
+ * Multiplication forms the full product and then applies word-by-word
+ * Montgomery reduction. The reduction is inherently serial, one digit at
+ * a time, so it is done modulo m' = m*k0 rather than m, where k0 is
+ * -m^-1 mod 2^29: the lowest digit of m' is then 2^29-1, the quotient
+ * digit is just the low digit of the accumulator and the serial chain
+ * loses two multiplications. Working modulo a multiple of m is harmless
+ * since only the final result is reduced modulo m itself.
+ *
+ * With 37 digits R = 2^1073 > 4m', so the outputs of "almost Montgomery"
+ * multiplication stay below 2m' and no subtraction is needed until the
+ * end. Between multiplications the digits are only approximately
+ * normalised, with a few vector operations that move the excess bits of
+ * every lane into the next lane at once. The 5-bit window table is read in full for every window so that
+ * the memory access pattern does not depend on the exponent.
+ */
+
+#include <string.h>
+#include <openssl/crypto.h>
+#include "bn_lcl.h"
+#include "rsaz_exp.h"
+
+#ifndef RSAZ_ENABLED
+static void *dummy=&dummy;
+#else
+
+#include <immintrin.h>
+
+extern unsigned int OPENSSL_ia32cap_P[];
+
+#define DIGIT_BITS	29
+#define DIGIT_MASK	(((BN_ULONG)1<<DIGIT_BITS)-1)
+#define NUM_DIGITS	37	/* 37*29 = 1073 bits */
+#define NUM_VEC		10	/* vectors of 4 lanes covering NUM_DIGITS+3 */
+#define PAD		4	/* zero lanes in front of each number */
+#define NUM_SIZE	(PAD+4*NUM_VEC)
+
+#define WINDOW		5
+#define TABLE_SIZE	(1<<WINDOW)
+
+/* A number is NUM_SIZE lanes: PAD zero lanes, the digits and zero lanes
+ * up to a whole number of vectors. The leading zeros let the
+ * multiplication read b*2^(29*s) for s = 0..3 with plain unaligned loads
+ * at b+PAD-s. */
+typedef BN_ULONG rsaz_num[NUM_SIZE] __attribute__((aligned(32)));
+
+/* A double-length product, one column per lane */
+typedef BN_ULONG rsaz_prod[8*NUM_VEC] __attribute__((aligned(32)));
+
+#define LOAD(p)		_mm256_load_si256((const __m256i *)(p))
+#define STORE(p, v)	_mm256_store_si256((__m256i *)(p), (v))
+#define LOADU(p)	_mm256_loadu_si256((const __m256i *)(p))
+
+/* BARRIER keeps the accumulators in registers: without it the compiler
+ * hoists the products of later steps and spills them. */
+#define BARRIER()							\
+	for (k = 0; k < NUM_VEC; k++)					\
+		__asm__("" : "+x"(acc[k]));
+
+int rsaz_avx2_eligible(void)
+	{
+	return (OPENSSL_ia32cap_P[2]&(1<<5)) != 0;	/* AVX2 */
+	}
+
+/* rsaz_to_digits converts 16 words into radix-2^29 digits. */
+static void rsaz_to_digits(rsaz_num out, const BN_ULONG in[16])
+	{
+	int j, bit, w, off;
+	BN_ULONG d;
+
+	memset(out, 0, sizeof(rsaz_num));
+	for (j = 0; j*DIGIT_BITS < 16*BN_BITS2; j++)
+		{
+		bit = j*DIGIT_BITS;
+		w = bit/BN_BITS2;
+		off = bit%BN_BITS2;
+		d = in[w] >> off;
+		if (off > BN_BITS2-DIGIT_BITS && w < 15)
+			d |= in[w+1] << (BN_BITS2-off);
+		out[PAD+j] = d & DIGIT_MASK;
+		}
+	}
+
+/* rsaz_from_digits converts normalised digits of a number less than
+ * 2^1024 back into 16 words. */
+static void rsaz_from_digits(BN_ULONG out[16], const rsaz_num in)
+	{
+	int j, bit, w, off;
+
+	memset(out, 0, 16*sizeof(BN_ULONG));
+	for (j = 0; j*DIGIT_BITS < 16*BN_BITS2; j++)
+		{
+		bit = j*DIGIT_BITS;
+		w = bit/BN_BITS2;
+		off = bit%BN_BITS2;
+		out[w] |= in[PAD+j] << off;
+		if (off > BN_BITS2-DIGIT_BITS && w < 15)
+			out[w+1] |= in[PAD+j] >> (BN_BITS2-off);
+		}
+	}
+
+/*
+ * Multiplication and squaring keep a window of ten vectors, columns
+ * 4*block.. of the product, in acc[]. Digit i = 4*block+s of a is
+ * multiplied by b*2^(29*s), read with a plain unaligned load at b+PAD-s;
+ * after four digits the lowest vector is complete and the window moves
+ * on. The blocks are unrolled and the window rotates through acc[]
+ * rather than being moved, so that it stays in registers: ACC(block, k) is
+ * vector k of the window of the current block.
+ */
+#define ACC(block, k)	acc[((block)+(k))%NUM_VEC]
+
+#define MUL_ROW(block, s)						\
+	{								\
+	va = _mm256_set1_epi64x(a[PAD+4*(block)+(s)]);			\
+	for (k = 0; k < NUM_VEC; k++)					\
+		ACC(block, k) = _mm256_add_epi64(ACC(block, k),			\
+			_mm256_mul_epu32(va, LOADU(b+PAD-(s)+4*k)));	\
+	BARRIER()							\
+	}
+
+#define MUL_BLOCK(block)						\
+	MUL_ROW(block, 0)						\
+	MUL_ROW(block, 1)						\
+	MUL_ROW(block, 2)						\
+	MUL_ROW(block, 3)						\
+	STORE(t+4*(block), ACC(block, 0));					\
+	ACC(block, 0) = _mm256_setzero_si256();
+
+__attribute__((target("avx2")))
+static void rsaz_mul(rsaz_prod t, const rsaz_num a, const rsaz_num b)
+	{
+	__m256i acc[NUM_VEC], va;
+	int k;
+
+	for (k = 0; k < NUM_VEC; k++)
+		acc[k] = _mm256_setzero_si256();
+
+	MUL_BLOCK(0) MUL_BLOCK(1) MUL_BLOCK(2)
+	MUL_BLOCK(3) MUL_BLOCK(4) MUL_BLOCK(5)
+	MUL_BLOCK(6) MUL_BLOCK(7) MUL_BLOCK(8)
+	MUL_ROW(9, 0)		/* digit 36 */
+	for (k = 0; k < NUM_VEC; k++)
+		STORE(t+4*(9+k), acc[(9+k)%NUM_VEC]);
+	}
+
+/*
+ * Squaring adds a[i]*2a[j] for j > i and a[i]^2, so row i starts at the
+ * vector holding column 2i. In that vector the lanes below column 2i are
+ * cleared and the lane of column 2i is halved, both with one variable
+ * shift of the doubled digits.
+ */
+#define SQR_ROW(block, s)						\
+	{								\
+	va = _mm256_set1_epi64x(a[PAD+4*(block)+(s)]);			\
+	k = (block)+((s)>>1);						\
+	ACC(block, k) = _mm256_add_epi64(ACC(block, k), _mm256_mul_epu32(va,		\
+		_mm256_srlv_epi64(LOADU(d+PAD-(s)+4*k), diag[(s)&1])));	\
+	for (k++; k < NUM_VEC; k++)					\
+		ACC(block, k) = _mm256_add_epi64(ACC(block, k),			\
+			_mm256_mul_epu32(va, LOADU(d+PAD-(s)+4*k)));	\
+	BARRIER()							\
+	}
+
+#define SQR_BLOCK(block)						\
+	SQR_ROW(block, 0)						\
+	SQR_ROW(block, 1)						\
+	SQR_ROW(block, 2)						\
+	SQR_ROW(block, 3)						\
+	STORE(t+4*(block), ACC(block, 0));					\
+	ACC(block, 0) = _mm256_setzero_si256();
+
+__attribute__((target("avx2")))
+static void rsaz_sqr(rsaz_prod t, const rsaz_num a)
+	{
+	__m256i acc[NUM_VEC], va, diag[2];
+	rsaz_num d;
+	int k;
+
+	for (k = 0; k < NUM_VEC; k++)
+		{
+		acc[k] = _mm256_setzero_si256();
+		STORE(d+PAD+4*k, _mm256_add_epi64(LOAD(a+PAD+4*k),
+			LOAD(a+PAD+4*k)));
+		}
+	memset(d, 0, PAD*sizeof(BN_ULONG));
+	/* column 2i is lane 0 for even i and lane 2 for odd i */
+	diag[0] = _mm256_setr_epi64x(1, 0, 0, 0);
+	diag[1] = _mm256_setr_epi64x(64, 64, 1, 0);
+
+	SQR_BLOCK(0) SQR_BLOCK(1) SQR_BLOCK(2)
+	SQR_BLOCK(3) SQR_BLOCK(4) SQR_BLOCK(5)
+	SQR_BLOCK(6) SQR_BLOCK(7) SQR_BLOCK(8)
+	SQR_ROW(9, 0)		/* digit 36 */
+	for (k = 0; k < NUM_VEC; k++)
+		STORE(t+4*(9+k), acc[(9+k)%NUM_VEC]);
+	}
+
+/*
+ * One step of the Montgomery reduction modulo m', for column
+ * i = 4*block+s. lo, lo1 and lo2 are the exact values of columns i to
+ * i+2. As m'[0] = 2^29-1 the digit q that clears column i is its low
+ * digit and lo + q*m'[0] = (lo>>29 + q)*2^29. Column i+3 is read from
+ * the window three steps before it is needed, so that the serial
+ * dependency runs through scalar registers only, and q*m' is added to
+ * the nine vectors above it.
+ */
+#define REDC_STEP(block, s)						\
+	{								\
+	BN_ULONG q, next, next1, next2;					\
+	next2 = ((s) >= 1 ? _mm256_extract_epi64(ACC(block, 1), ((s)+3)&3) :	\
+		_mm256_extract_epi64(ACC(block, 0), 3));			\
+	q = lo & DIGIT_MASK;						\
+	next = lo1 + q*m[PAD+1] + (lo >> DIGIT_BITS) + q;		\
+	next1 = lo2 + q*m[PAD+2];					\
+	next2 += q*m[PAD+3];						\
+	vq = _mm256_set1_epi64x(q);					\
+	for (k = 1; k < NUM_VEC; k++)					\
+		ACC(block, k) = _mm256_add_epi64(ACC(block, k),			\
+			_mm256_mul_epu32(vq, LOADU(m+PAD-(s)+4*k)));	\
+	BARRIER()							\
+	lo = next;							\
+	lo1 = next1;							\
+	lo2 = next2;							\
+	}
+
+#define REDC_BLOCK(block)						\
+	REDC_STEP(block, 0)						\
+	REDC_STEP(block, 1)						\
+	REDC_STEP(block, 2)						\
+	REDC_STEP(block, 3)						\
+	ACC(block, 0) = LOAD(t+4*((block)+NUM_VEC));
+
+/*
+ * rsaz_fold moves the bits above the digit size of every lane of |v|
+ * into the next lane up, all lanes at once, taking in the bits carried
+ * out of the vector below from |carry| and leaving its own there. It
+ * does not fully normalise, but a lane below 2^64 is left below
+ * 2^29+2^35, and one below 2^29+2^35 below 2^29+2^7.
+ */
+__attribute__((target("avx2")))
+static inline __m256i rsaz_fold(__m256i v, __m256i *carry)
+	{
+	/* rotate the carries up by one lane, lane 0 taking the carry out
+	 * of lane 3 of the vector below */
+	__m256i hi = _mm256_permute4x64_epi64(_mm256_srli_epi64(v,
+		DIGIT_BITS), 0x93);
+
+	v = _mm256_add_epi64(_mm256_and_si256(v,
+		_mm256_set1_epi64x(DIGIT_MASK)),
+		_mm256_blend_epi32(hi, *carry, 0x03));
+	*carry = hi;
+	return v;
+	}
+
+/*
+ * rsaz_redc sets r = t/2^1073 mod m', up to a multiple of m', using t
+ * as scratch space. The product of two numbers below 2m' leaves r < 2m'.
+ *
+ * The columns of t are folded first, so that the at most 37 products
+ * below 2^58 the reduction adds to a column cannot overflow it. The
+ * digits of r are folded twice but not fully normalised: they may
+ * exceed 2^29 by a little, which the multiplication tolerates.
+ */
+__attribute__((target("avx2")))
+static void rsaz_redc(rsaz_num r, rsaz_prod t, const rsaz_num m)
+	{
+	__m256i acc[NUM_VEC], vq, v[NUM_VEC+1], carry;
+	BN_ULONG lo, lo1, lo2;
+	int k;
+
+	carry = _mm256_setzero_si256();
+	for (k = 0; k < NUM_VEC; k++)
+		acc[k] = rsaz_fold(LOAD(t+4*k), &carry);
+	for (k = NUM_VEC; k < 2*NUM_VEC; k++)
+		STORE(t+4*k, rsaz_fold(LOAD(t+4*k), &carry));
+	lo = _mm256_extract_epi64(acc[0], 0);
+	lo1 = _mm256_extract_epi64(acc[0], 1);
+	lo2 = _mm256_extract_epi64(acc[0], 2);
+
+	REDC_BLOCK(0) REDC_BLOCK(1) REDC_BLOCK(2)
+	REDC_BLOCK(3) REDC_BLOCK(4) REDC_BLOCK(5)
+	REDC_BLOCK(6) REDC_BLOCK(7) REDC_BLOCK(8)
+	REDC_STEP(9, 0)		/* column 36 */
+
+	/* The result starts at column 37, lane 1 of the window. Fold it
+	 * and move it down by a lane so that the stores are aligned. */
+	v[0] = _mm256_set_epi64x(lo2, lo1, lo, 0);
+	for (k = 1; k < NUM_VEC; k++)
+		v[k] = acc[(9+k)%NUM_VEC];
+	v[NUM_VEC] = _mm256_setzero_si256();
+	carry = _mm256_setzero_si256();
+	for (k = 0; k < NUM_VEC; k++)
+		v[k] = rsaz_fold(v[k], &carry);
+	carry = _mm256_setzero_si256();
+	for (k = 0; k < NUM_VEC; k++)
+		v[k] = rsaz_fold(v[k], &carry);
+	STORE(r, v[NUM_VEC]);
+	for (k = 0; k < NUM_VEC; k++)
+		STORE(r+PAD+4*k, _mm256_blend_epi32(
+			_mm256_permute4x64_epi64(v[k], 0x39),
+			_mm256_permute4x64_epi64(v[k+1], 0x39), 0xc0));
+	}
+
+/* rsaz_amm sets r = a*b/2^1073 mod m', up to a multiple of m'. a and b
+ * must be below 2m' with digits below 2^29+2^7; r may alias either. */
+static void rsaz_amm(rsaz_num r, const rsaz_num a, const rsaz_num b,
+		const rsaz_num m)
+	{
+	rsaz_prod t;
+
+	if (a == b)
+		rsaz_sqr(t, a);
+	else
+		rsaz_mul(t, a, b);
+	rsaz_redc(r, t, m);
+	}
+
+/* rsaz_redc_final sets r = a/2^1073 mod m, up to m itself, for a < 2m'
+ * and k0 = -m^-1 mod 2^29. It is used once, to leave the Montgomery
+ * domain, so plain scalar code is good enough. */
+static void rsaz_redc_final(rsaz_num r, const rsaz_num a, const rsaz_num m,
+		BN_ULONG k0)
+	{
+	BN_ULONG t[2*NUM_DIGITS+1], q;
+	int i, j;
+
+	memset(t, 0, sizeof(t));
+	memcpy(t, a+PAD, NUM_DIGITS*sizeof(BN_ULONG));
+	for (i = 0; i < NUM_DIGITS; i++)
+		{
+		q = (t[i]*k0) & DIGIT_MASK;
+		for (j = 0; j < NUM_DIGITS; j++)
+			t[i+j] += q*m[PAD+j];
+		t[i+1] += t[i] >> DIGIT_BITS;
+		}
+	for (j = NUM_DIGITS; j < 2*NUM_DIGITS; j++)
+		{
+		t[j+1] += t[j] >> DIGIT_BITS;
+		t[j] &= DIGIT_MASK;
+		}
+	memset(r, 0, sizeof(rsaz_num));
+	memcpy(r+PAD, t+NUM_DIGITS, NUM_DIGITS*sizeof(BN_ULONG));
+	OPENSSL_cleanse(t, sizeof(t));
+	}
+
+/* rsaz_gather copies entry |idx| of |table| to |out| reading every entry,
+ * so that the access pattern is independent of |idx|. */
+__attribute__((target("avx2")))
+static void rsaz_gather(rsaz_num out, const rsaz_num table[TABLE_SIZE],
+		int idx)
+	{
+	__m256i acc[NUM_VEC], mask, vidx = _mm256_set1_epi64x(idx);
+	int i, k;
+
+	for (k = 0; k < NUM_VEC; k++)
+		acc[k] = _mm256_setzero_si256();
+	for (i = 0; i < TABLE_SIZE; i++)
+		{
+		mask = _mm256_cmpeq_epi64(vidx, _mm256_set1_epi64x(i));
+		for (k = 0; k < NUM_VEC; k++)
+			acc[k] = _mm256_or_si256(acc[k], _mm256_and_si256(mask,
+				LOAD(table[i]+PAD+4*k)));
+		}
+	for (k = 0; k < NUM_VEC; k++)
+		STORE(out+PAD+4*k, acc[k]);
+	memset(out, 0, PAD*sizeof(BN_ULONG));
+	}
+
+/* get_window returns the WINDOW bits of |e| starting at bit |pos|. */
+static int get_window(const BN_ULONG e[16], int pos)
+	{
+	int w = pos/BN_BITS2, off = pos%BN_BITS2;
+	BN_ULONG v = e[w] >> off;
+
+	if (off > BN_BITS2-WINDOW && w < 15)
+		v |= e[w+1] << (BN_BITS2-off);
+	return (int)(v & (TABLE_SIZE-1));
+	}
+
+void RSAZ_1024_mod_exp_avx2(BN_ULONG result[16],
+	const BN_ULONG base[16], const BN_ULONG exponent[16],
+	const BN_ULONG m[16], const BN_ULONG RR[16], BN_ULONG k0)
+	{
+	rsaz_num table[TABLE_SIZE];
+	rsaz_num M, M1, A, R2, T, one;
+	BN_ULONG res[16], sub[16], mask, c;
+	int i, pos;
+
+	k0 &= DIGIT_MASK;
+	rsaz_to_digits(M, m);
+	rsaz_to_digits(A, base);
+	rsaz_to_digits(R2, RR);
+
+	/* M1 = m*k0, so that M1[0] = 2^29-1 */
+	memset(M1, 0, sizeof(M1));
+	for (c = 0, i = 0; i < NUM_DIGITS; i++)
+		{
+		c += M[PAD+i]*k0;
+		M1[PAD+i] = c & DIGIT_MASK;
+		c >>= DIGIT_BITS;
+		}
+
+	/* R2 = 2^2146 mod m, the square of our R, from RR = 2^2048:
+	 * 2^2048 * 2^2048 / 2^1073 = 2^3023, 2^3023 * 2^196 / 2^1073 = 2^2146 */
+	rsaz_amm(R2, R2, R2, M1);
+	memset(T, 0, sizeof(T));
+	T[PAD+196/DIGIT_BITS] = (BN_ULONG)1 << (196%DIGIT_BITS);
+	rsaz_amm(R2, R2, T, M1);
+
+	memset(one, 0, sizeof(one));
+	one[PAD] = 1;
+
+	/* table[i] = base^i in the Montgomery domain */
+	rsaz_amm(table[0], R2, one, M1);
+	rsaz_amm(table[1], R2, A, M1);
+	for (i = 2; i < TABLE_SIZE; i++)
+		{
+		if (i & 1)
+			rsaz_amm(table[i], table[i-1], table[1], M1);
+		else
+			rsaz_amm(table[i], table[i/2], table[i/2], M1);
+		}
+
+	/* 1024 = 4 + 204*5 */
+	pos = 1024 - 4;
+	rsaz_gather(A, table, get_window(exponent, pos) & 0xf);
+	while (pos > 0)
+		{
+		pos -= WINDOW;
+		for (i = 0; i < WINDOW; i++)
+			rsaz_amm(A, A, A, M1);
+		rsaz_gather(T, table, get_window(exponent, pos));
+		rsaz_amm(A, A, T, M1);
+		}
+
+	/* Leave the Montgomery domain modulo m itself. The result is at
+	 * most m, so one conditional subtraction fully reduces it. */
+	rsaz_redc_final(A, A, M, k0);
+	rsaz_from_digits(res, A);
+	mask = 0 - bn_sub_words(sub, res, m, 16);
+	for (i = 0; i < 16; i++)
+		result[i] = (res[i] & mask) | (sub[i] & ~mask);
+
+	OPENSSL_cleanse(table, sizeof(table));
+	OPENSSL_cleanse(A, sizeof(A));
+	OPENSSL_cleanse(T, sizeof(T));
+	OPENSSL_cleanse(res, sizeof(res));
+	OPENSSL_cleanse(sub, sizeof(sub));
+	}
+#endif
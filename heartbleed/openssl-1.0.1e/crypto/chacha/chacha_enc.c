@@ -0,0 +1,354 @@
+/* crypto/chacha/chacha_enc.c */
+/* ====================================================================
+ * Copyright (c) 2013 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/*
+ * ChaCha20 as specified in RFC 7539. The portable code below processes
+ * one 64-byte block at a time. On x86 processors long inputs are
+ * instead run through 4 (SSE2) or 8 (AVX2) blocks in parallel, one
+ * block per vector lane, chosen at run-time from OPENSSL_ia32cap_P.
+ */
+
+#include <string.h>
+#include <openssl/opensslconf.h>
+#include <openssl/crypto.h>
+
+#ifndef OPENSSL_NO_CHACHA
+
+#include <openssl/chacha.h>
+
+typedef unsigned int u32;
+
+#define U8TO32_LITTLE(p) \
+	(((u32)((p)[0])      ) | ((u32)((p)[1]) <<  8) | \
+	 ((u32)((p)[2]) << 16) | ((u32)((p)[3]) << 24)   )
+
+#define U32TO8_LITTLE(p, v) \
+	{ (p)[0] = (unsigned char)((v)      ); \
+	  (p)[1] = (unsigned char)((v) >>  8); \
+	  (p)[2] = (unsigned char)((v) >> 16); \
+	  (p)[3] = (unsigned char)((v) >> 24); }
+
+#define ROTATE(v, n)	(((v) << (n)) | ((v) >> (32 - (n))))
+
+/* QUARTERROUND updates a, b, c, d with a ChaCha "quarter" round. */
+#define QUARTERROUND(a, b, c, d) \
+	x[a] += x[b]; x[d] = ROTATE((x[d] ^ x[a]), 16); \
+	x[c] += x[d]; x[b] = ROTATE((x[b] ^ x[c]), 12); \
+	x[a] += x[b]; x[d] = ROTATE((x[d] ^ x[a]),  8); \
+	x[c] += x[d]; x[b] = ROTATE((x[b] ^ x[c]),  7);
+
+static const unsigned char sigma[16] = "expand 32-byte k";
+
+/* chacha_core performs 20 rounds of ChaCha on the input words in
+ * |input| and writes the 64 output bytes to |output|. */
+static void chacha_core(unsigned char output[64], const u32 input[16])
+	{
+	u32 x[16];
+	int i;
+
+	memcpy(x, input, sizeof(u32) * 16);
+	for (i = 20; i > 0; i -= 2)
+		{
+		QUARTERROUND( 0, 4, 8,12)
+		QUARTERROUND( 1, 5, 9,13)
+		QUARTERROUND( 2, 6,10,14)
+		QUARTERROUND( 3, 7,11,15)
+		QUARTERROUND( 0, 5,10,15)
+		QUARTERROUND( 1, 6,11,12)
+		QUARTERROUND( 2, 7, 8,13)
+		QUARTERROUND( 3, 4, 9,14)
+		}
+
+	for (i = 0; i < 16; ++i)
+		x[i] += input[i];
+	for (i = 0; i < 16; ++i)
+		U32TO8_LITTLE(output + 4 * i, x[i]);
+	}
+
+#if !defined(OPENSSL_NO_ASM) && !defined(PEDANTIC) && \
+	defined(__GNUC__) && (__GNUC__>4 || (__GNUC__==4 && __GNUC_MINOR__>=8)) && \
+	(defined(__i386) || defined(__i386__) || \
+	 defined(__x86_64) || defined(__x86_64__))
+# define CHACHA_VEC
+
+extern unsigned int OPENSSL_ia32cap_P[];
+#define SSE2_CAPABLE	(OPENSSL_ia32cap_P[0]&(1<<26))
+#define AVX2_CAPABLE	(OPENSSL_ia32cap_P[2]&(1<<5))
+
+/*
+ * In the vector code every lane computes a different block: vector
+ * x[i] holds word i of 4 or 8 consecutive blocks, so the rounds are
+ * exactly the scalar ones. The lanes are transposed back into blocks
+ * before they are XORed with the input.
+ */
+typedef unsigned int   u32x4 __attribute__((vector_size(16)));
+typedef unsigned int   u32x8 __attribute__((vector_size(32)));
+typedef unsigned short u16x8 __attribute__((vector_size(16)));
+typedef unsigned char  u8x32 __attribute__((vector_size(32)));
+
+#define VROTATE(v, n)	(((v) << (n)) | ((v) >> (32 - (n))))
+
+/* Rotations by 16 and 8 are word and byte shuffles */
+#define ROT16_4(v)	((u32x4)__builtin_shuffle((u16x8)(v), \
+				(u16x8){1,0,3,2,5,4,7,6}))
+#define ROT8_4(v)	VROTATE(v, 8)
+#define ROT16_8(v)	((u32x8)__builtin_shuffle((u8x32)(v), \
+				(u8x32){2,3,0,1,6,7,4,5,10,11,8,9,14,15,12,13, \
+				18,19,16,17,22,23,20,21,26,27,24,25,30,31,28,29}))
+#define ROT8_8(v)	((u32x8)__builtin_shuffle((u8x32)(v), \
+				(u8x32){3,0,1,2,7,4,5,6,11,8,9,10,15,12,13,14, \
+				19,16,17,18,23,20,21,22,27,24,25,26,31,28,29,30}))
+
+#define VQUARTERROUND(a, b, c, d, R16, R8) \
+	x[a] += x[b]; x[d] ^= x[a]; x[d] = R16(x[d]); \
+	x[c] += x[d]; x[b] ^= x[c]; x[b] = VROTATE(x[b], 12); \
+	x[a] += x[b]; x[d] ^= x[a]; x[d] = R8(x[d]); \
+	x[c] += x[d]; x[b] ^= x[c]; x[b] = VROTATE(x[b], 7);
+
+#define VROUNDS(R16, R8) \
+	for (i = 20; i > 0; i -= 2) \
+		{ \
+		VQUARTERROUND( 0, 4, 8,12, R16, R8) \
+		VQUARTERROUND( 1, 5, 9,13, R16, R8) \
+		VQUARTERROUND( 2, 6,10,14, R16, R8) \
+		VQUARTERROUND( 3, 7,11,15, R16, R8) \
+		VQUARTERROUND( 0, 5,10,15, R16, R8) \
+		VQUARTERROUND( 1, 6,11,12, R16, R8) \
+		VQUARTERROUND( 2, 7, 8,13, R16, R8) \
+		VQUARTERROUND( 3, 4, 9,14, R16, R8) \
+		}
+
+/* One transposition step: swap bit |s| of the row index with bit |s|
+ * of the lane index for rows |r| and |r+s|. */
+#define TRANSPOSE_STEP(v, r, s, lo, hi) \
+	{ t = v[r]; \
+	  v[r]   = __builtin_shuffle(t, v[(r)+(s)], lo); \
+	  v[(r)+(s)] = __builtin_shuffle(t, v[(r)+(s)], hi); }
+
+/* chacha_blocks_4x processes |len| bytes, a multiple of 256, four
+ * blocks at a time. */
+__attribute__((target("sse2")))
+static void chacha_blocks_4x(unsigned char *out, const unsigned char *in,
+		size_t len, u32 input[16])
+	{
+	u32x4 s[16], x[16], t, d;
+	int i, j;
+
+	for (i = 0; i < 16; ++i)
+		s[i] = (u32x4){input[i], input[i], input[i], input[i]};
+	s[12] += (u32x4){0, 1, 2, 3};
+
+	for (; len >= 256; len -= 256, in += 256, out += 256)
+		{
+		for (i = 0; i < 16; ++i)
+			x[i] = s[i];
+		VROUNDS(ROT16_4, ROT8_4)
+		for (i = 0; i < 16; ++i)
+			x[i] += s[i];
+
+		/* x[4g+k] now holds word 4g+k of all four blocks */
+		for (i = 0; i < 16; i += 4)
+			{
+			TRANSPOSE_STEP(x, i+0, 1, ((u32x4){0,4,2,6}),
+						((u32x4){1,5,3,7}))
+			TRANSPOSE_STEP(x, i+2, 1, ((u32x4){0,4,2,6}),
+						((u32x4){1,5,3,7}))
+			TRANSPOSE_STEP(x, i+0, 2, ((u32x4){0,1,4,5}),
+						((u32x4){2,3,6,7}))
+			TRANSPOSE_STEP(x, i+1, 2, ((u32x4){0,1,4,5}),
+						((u32x4){2,3,6,7}))
+			for (j = 0; j < 4; ++j)
+				{
+				memcpy(&d, in + 64*j + 4*i, 16);
+				d ^= x[i+j];
+				memcpy(out + 64*j + 4*i, &d, 16);
+				}
+			}
+
+		s[12] += (u32x4){4, 4, 4, 4};
+		}
+
+	input[12] = s[12][0];
+	}
+
+/* chacha_blocks_8x processes |len| bytes, a multiple of 512, eight
+ * blocks at a time. */
+__attribute__((target("avx2")))
+static void chacha_blocks_8x(unsigned char *out, const unsigned char *in,
+		size_t len, u32 input[16])
+	{
+	u32x8 s[16], x[16], t, d;
+	int i, j;
+
+	for (i = 0; i < 16; ++i)
+		s[i] = (u32x8){input[i], input[i], input[i], input[i],
+			       input[i], input[i], input[i], input[i]};
+	s[12] += (u32x8){0, 1, 2, 3, 4, 5, 6, 7};
+
+	for (; len >= 512; len -= 512, in += 512, out += 512)
+		{
+		for (i = 0; i < 16; ++i)
+			x[i] = s[i];
+		VROUNDS(ROT16_8, ROT8_8)
+		for (i = 0; i < 16; ++i)
+			x[i] += s[i];
+
+		/* x[8g+k] now holds word 8g+k of all eight blocks */
+		for (i = 0; i < 16; i += 8)
+			{
+#define LO1 ((u32x8){0,8,2,10,4,12,6,14})
+#define HI1 ((u32x8){1,9,3,11,5,13,7,15})
+#define LO2 ((u32x8){0,1,8,9,4,5,12,13})
+#define HI2 ((u32x8){2,3,10,11,6,7,14,15})
+#define LO4 ((u32x8){0,1,2,3,8,9,10,11})
+#define HI4 ((u32x8){4,5,6,7,12,13,14,15})
+			TRANSPOSE_STEP(x, i+0, 1, LO1, HI1)
+			TRANSPOSE_STEP(x, i+2, 1, LO1, HI1)
+			TRANSPOSE_STEP(x, i+4, 1, LO1, HI1)
+			TRANSPOSE_STEP(x, i+6, 1, LO1, HI1)
+			TRANSPOSE_STEP(x, i+0, 2, LO2, HI2)
+			TRANSPOSE_STEP(x, i+1, 2, LO2, HI2)
+			TRANSPOSE_STEP(x, i+4, 2, LO2, HI2)
+			TRANSPOSE_STEP(x, i+5, 2, LO2, HI2)
+			TRANSPOSE_STEP(x, i+0, 4, LO4, HI4)
+			TRANSPOSE_STEP(x, i+1, 4, LO4, HI4)
+			TRANSPOSE_STEP(x, i+2, 4, LO4, HI4)
+			TRANSPOSE_STEP(x, i+3, 4, LO4, HI4)
+#undef LO1
+#undef HI1
+#undef LO2
+#undef HI2
+#undef LO4
+#undef HI4
+			for (j = 0; j < 8; ++j)
+				{
+				memcpy(&d, in + 64*j + 4*i, 32);
+				d ^= x[i+j];
+				memcpy(out + 64*j + 4*i, &d, 32);
+				}
+			}
+
+		s[12] += (u32x8){8, 8, 8, 8, 8, 8, 8, 8};
+		}
+
+	input[12] = s[12][0];
+	}
+#endif
+
+void CRYPTO_chacha_20(unsigned char *out,
+		      const unsigned char *in, size_t in_len,
+		      const unsigned char key[CHACHA_KEY_SIZE],
+		      const unsigned char nonce[CHACHA_NONCE_SIZE],
+		      unsigned int counter)
+	{
+	u32 input[16];
+	unsigned char buf[64];
+	size_t todo, i;
+
+	input[0] = U8TO32_LITTLE(sigma + 0);
+	input[1] = U8TO32_LITTLE(sigma + 4);
+	input[2] = U8TO32_LITTLE(sigma + 8);
+	input[3] = U8TO32_LITTLE(sigma + 12);
+
+	input[4] = U8TO32_LITTLE(key + 0);
+	input[5] = U8TO32_LITTLE(key + 4);
+	input[6] = U8TO32_LITTLE(key + 8);
+	input[7] = U8TO32_LITTLE(key + 12);
+
+	input[8] = U8TO32_LITTLE(key + 16);
+	input[9] = U8TO32_LITTLE(key + 20);
+	input[10] = U8TO32_LITTLE(key + 24);
+	input[11] = U8TO32_LITTLE(key + 28);
+
+	input[12] = counter;
+	input[13] = U8TO32_LITTLE(nonce + 0);
+	input[14] = U8TO32_LITTLE(nonce + 4);
+	input[15] = U8TO32_LITTLE(nonce + 8);
+
+#ifdef CHACHA_VEC
+	if (in_len >= 512 && AVX2_CAPABLE)
+		{
+		todo = in_len & ~(size_t)511;
+		chacha_blocks_8x(out, in, todo, input);
+		in += todo;
+		out += todo;
+		in_len -= todo;
+		}
+	if (in_len >= 256 && SSE2_CAPABLE)
+		{
+		todo = in_len & ~(size_t)255;
+		chacha_blocks_4x(out, in, todo, input);
+		in += todo;
+		out += todo;
+		in_len -= todo;
+		}
+#endif
+
+	while (in_len > 0)
+		{
+		todo = sizeof(buf);
+		if (in_len < todo)
+			todo = in_len;
+
+		chacha_core(buf, input);
+		for (i = 0; i < todo; i++)
+			out[i] = in[i] ^ buf[i];
+
+		out += todo;
+		in += todo;
+		in_len -= todo;
+
+		input[12]++;
+		}
+
+	OPENSSL_cleanse(buf, sizeof(buf));
+	}
+
+#endif  /* !OPENSSL_NO_CHACHA */
@@ -0,0 +1,344 @@
+/* crypto/chacha/chachatest.c */
+/* ====================================================================
+ * Copyright (c) 2013 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../e_os.h"
+
+#ifdef OPENSSL_NO_CHACHA
+int main(int argc, char *argv[])
+{
+    printf("No ChaCha support\n");
+    return(0);
+}
+#else
+#include <openssl/chacha.h>
+#ifndef OPENSSL_NO_POLY1305
+#include <openssl/evp.h>
+#endif
+
+struct chacha_test {
+	const char *keyhex;
+	const char *noncehex;
+	unsigned int counter;
+	const char *plaintext;	/* hex, or NULL for all zero */
+	size_t len;
+	const char *outhex;
+};
+
+/* Test vectors from RFC 7539, sections 2.4.2 and A.2 */
+static const struct chacha_test chacha_tests[] = {
+	{
+	"000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+	"000000000000004a00000000",
+	1,
+	"4c616469657320616e642047656e746c656d656e206f662074686520636c6173"
+	"73206f66202739393a204966204920636f756c64206f6666657220796f75206f"
+	"6e6c79206f6e652074697020666f7220746865206675747572652c2073756e73"
+	"637265656e20776f756c642062652069742e",
+	114,
+	"6e2e359a2568f98041ba0728dd0d6981e97e7aec1d4360c20a27afccfd9fae0b"
+	"f91b65c5524733ab8f593dabcd62b3571639d624e65152ab8f530c359f0861d8"
+	"07ca0dbf500d6a6156a38e088a22b65e52bc514d16ccf806818ce91ab7793736"
+	"5af90bbf74a35be6b40b8eedf2785e42874d",
+	},
+	{
+	"0000000000000000000000000000000000000000000000000000000000000000",
+	"000000000000000000000000",
+	0,
+	NULL,
+	64,
+	"76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7"
+	"da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586",
+	},
+	{
+	"0000000000000000000000000000000000000000000000000000000000000001",
+	"000000000000000000000002",
+	1,
+	"416e79207375626d697373696f6e20746f20746865204945544620696e74656e"
+	"6465642062792074686520436f6e7472696275746f7220666f72207075626c69"
+	"636174696f6e20617320616c6c206f722070617274206f6620616e2049455446"
+	"20496e7465726e65742d4472616674206f722052464320616e6420616e792073"
+	"746174656d656e74206d6164652077697468696e2074686520636f6e74657874"
+	"206f6620616e204945544620616374697669747920697320636f6e7369646572"
+	"656420616e20224945544620436f6e747269627574696f6e222e205375636820"
+	"73746174656d656e747320696e636c756465206f72616c2073746174656d656e"
+	"747320696e20494554462073657373696f6e732c2061732077656c6c20617320"
+	"7772697474656e20616e6420656c656374726f6e696320636f6d6d756e696361"
+	"74696f6e73206d61646520617420616e792074696d65206f7220706c6163652c"
+	"207768696368206172652061646472657373656420746f",
+	375,
+	"a3fbf07df3fa2fde4f376ca23e82737041605d9f4f4f57bd8cff2c1d4b7955ec"
+	"2a97948bd3722915c8f3d337f7d370050e9e96d647b7c39f56e031ca5eb6250d"
+	"4042e02785ececfa4b4bb5e8ead0440e20b6e8db09d881a7c6132f420e527950"
+	"42bdfa7773d8a9051447b3291ce1411c680465552aa6c405b7764d5e87bea85a"
+	"d00f8449ed8f72d0d662ab052691ca66424bc86d2df80ea41f43abf937d3259d"
+	"c4b2d0dfb48a6c9139ddd7f76966e928e635553ba76c5c879d7b35d49eb2e62b"
+	"0871cdac638939e25e8a1e0ef9d5280fa8ca328b351c3c765989cbcf3daa8b6c"
+	"cc3aaf9f3979c92b3720fc88dc95ed84a1be059c6499b9fda236e7e818b04b0b"
+	"c39c1e876b193bfe5569753f88128cc08aaa9b63d1a16f80ef2554d7189c411f"
+	"5869ca52c5b83fa36ff216b9c1d30062bebcfd2dc5bce0911934fda79a86f6e6"
+	"98ced759c3ff9b6477338f3da4f9cd8514ea9982ccafb341b2384dd902f3d1ab"
+	"7ac61dd29c6f21ba5b862f3730e37cfdc4fd806c22f221",
+	},
+};
+
+static unsigned char *hex_decode(const char *hex, size_t *len)
+	{
+	size_t i, n = strlen(hex) / 2;
+	unsigned char *ret = malloc(n + 1);
+	unsigned int v;
+
+	for (i = 0; i < n; i++)
+		{
+		sscanf(hex + 2 * i, "%2x", &v);
+		ret[i] = (unsigned char)v;
+		}
+	if (len)
+		*len = n;
+	return ret;
+	}
+
+static int run_test_vector(int num, const struct chacha_test *test)
+	{
+	unsigned char *key, *nonce, *in, *expected, *out;
+	size_t len;
+	int ret = 0;
+
+	key = hex_decode(test->keyhex, NULL);
+	nonce = hex_decode(test->noncehex, NULL);
+	expected = hex_decode(test->outhex, &len);
+	if (len != test->len)
+		{
+		fprintf(stderr, "ChaCha20 test #%d: bad expected length\n", num);
+		return 0;
+		}
+	if (test->plaintext)
+		in = hex_decode(test->plaintext, NULL);
+	else
+		{
+		in = malloc(len + 1);
+		memset(in, 0, len);
+		}
+	out = malloc(len + 1);
+
+	CRYPTO_chacha_20(out, in, len, key, nonce, test->counter);
+	if (memcmp(out, expected, len) != 0)
+		fprintf(stderr, "ChaCha20 test #%d failed\n", num);
+	else
+		{
+		/* in-place operation */
+		CRYPTO_chacha_20(out, out, len, key, nonce, test->counter);
+		if (memcmp(out, in, len) != 0)
+			fprintf(stderr, "ChaCha20 test #%d failed in place\n", num);
+		else
+			ret = 1;
+		}
+
+	free(key);
+	free(nonce);
+	free(in);
+	free(expected);
+	free(out);
+	return ret;
+	}
+
+/* The multi-block code paths only kick in for long inputs. Check them
+ * against the block-at-a-time code, which is used for short calls. */
+static int run_length_test(void)
+	{
+	static unsigned char in[1600], out[1600], ref[1600];
+	unsigned char key[32], nonce[12];
+	size_t len, off, todo;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = (unsigned char)(i * 7 + 1);
+	for (i = 0; i < sizeof(nonce); i++)
+		nonce[i] = (unsigned char)(i * 13 + 5);
+	for (i = 0; i < sizeof(in); i++)
+		in[i] = (unsigned char)(i * 31);
+
+	for (len = 0; len <= sizeof(in); len += 1 + len / 16)
+		{
+		for (off = 0; off < len; off += todo)
+			{
+			todo = len - off < 64 ? len - off : 64;
+			CRYPTO_chacha_20(ref + off, in + off, todo, key, nonce,
+					 0xfffffff0 + off / 64);
+			}
+		CRYPTO_chacha_20(out, in, len, key, nonce, 0xfffffff0);
+		if (memcmp(out, ref, len) != 0)
+			{
+			fprintf(stderr, "ChaCha20 length %lu failed\n",
+				(unsigned long)len);
+			return 0;
+			}
+		}
+	return 1;
+	}
+
+#ifndef OPENSSL_NO_POLY1305
+/* AEAD test vector from RFC 7539, section 2.8.2 */
+static const char aead_key[] =
+	"808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f";
+static const char aead_nonce[] = "070000004041424344454647";
+static const char aead_aad[] = "50515253c0c1c2c3c4c5c6c7";
+static const char aead_pt[] =
+	"4c616469657320616e642047656e746c656d656e206f662074686520636c6173"
+	"73206f66202739393a204966204920636f756c64206f6666657220796f75206f"
+	"6e6c79206f6e652074697020666f7220746865206675747572652c2073756e73"
+	"637265656e20776f756c642062652069742e";
+static const char aead_ct[] =
+	"d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+	"3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+	"92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+	"3ff4def08e4b7a9de576d26586cec64b6116";
+static const char aead_tag[] = "1ae10b594f09e26a7e902ecbd0600691";
+
+/* Feed the payload in uneven pieces so that the EVP layer has to carry
+ * partial key stream blocks between calls. */
+static int aead_crypt(int enc, const unsigned char *key,
+		const unsigned char *nonce, const unsigned char *aad,
+		size_t aad_len, const unsigned char *in, size_t len,
+		unsigned char *out, unsigned char *tag)
+	{
+	EVP_CIPHER_CTX ctx;
+	size_t off, todo, step = 1;
+	int outl, ok = 0;
+
+	EVP_CIPHER_CTX_init(&ctx);
+	if (!EVP_CipherInit_ex(&ctx, EVP_chacha20_poly1305(), NULL, key,
+			       nonce, enc))
+		goto err;
+	if (!enc && !EVP_CIPHER_CTX_ctrl(&ctx, EVP_CTRL_AEAD_SET_TAG, 16, tag))
+		goto err;
+	if (!EVP_CipherUpdate(&ctx, NULL, &outl, aad, 5) ||
+	    !EVP_CipherUpdate(&ctx, NULL, &outl, aad + 5, aad_len - 5))
+		goto err;
+	for (off = 0; off < len; off += todo, step += 13)
+		{
+		todo = len - off < step ? len - off : step;
+		if (!EVP_CipherUpdate(&ctx, out + off, &outl, in + off, todo))
+			goto err;
+		}
+	if (!EVP_CipherFinal_ex(&ctx, out + len, &outl))
+		goto err;
+	if (enc && !EVP_CIPHER_CTX_ctrl(&ctx, EVP_CTRL_AEAD_GET_TAG, 16, tag))
+		goto err;
+	ok = 1;
+err:
+	EVP_CIPHER_CTX_cleanup(&ctx);
+	return ok;
+	}
+
+static int run_aead_test(void)
+	{
+	unsigned char *key, *nonce, *aad, *pt, *ct, *tag, out[128], mac[16];
+	size_t aad_len, len;
+	int ret = 0;
+
+	key = hex_decode(aead_key, NULL);
+	nonce = hex_decode(aead_nonce, NULL);
+	aad = hex_decode(aead_aad, &aad_len);
+	pt = hex_decode(aead_pt, &len);
+	ct = hex_decode(aead_ct, NULL);
+	tag = hex_decode(aead_tag, NULL);
+
+	if (!aead_crypt(1, key, nonce, aad, aad_len, pt, len, out, mac) ||
+	    memcmp(out, ct, len) != 0 || memcmp(mac, tag, 16) != 0)
+		fprintf(stderr, "ChaCha20-Poly1305 encryption failed\n");
+	else if (!aead_crypt(0, key, nonce, aad, aad_len, ct, len, out, tag) ||
+		 memcmp(out, pt, len) != 0)
+		fprintf(stderr, "ChaCha20-Poly1305 decryption failed\n");
+	else
+		{
+		tag[15] ^= 1;
+		if (aead_crypt(0, key, nonce, aad, aad_len, ct, len, out, tag))
+			fprintf(stderr, "ChaCha20-Poly1305 accepted a bad tag\n");
+		else
+			ret = 1;
+		}
+
+	free(key);
+	free(nonce);
+	free(aad);
+	free(pt);
+	free(ct);
+	free(tag);
+	return ret;
+	}
+#endif
+
+int main(int argc, char **argv)
+	{
+	unsigned int i;
+	int err = 0;
+
+	for (i = 0; i < sizeof(chacha_tests) / sizeof(chacha_tests[0]); i++)
+		{
+		if (!run_test_vector(i, &chacha_tests[i]))
+			err++;
+		}
+	if (!run_length_test())
+		err++;
+#ifndef OPENSSL_NO_POLY1305
+	if (!run_aead_test())
+		err++;
+#endif
+
+	if (err == 0)
+		printf("ChaCha20 tests passed\n");
+	EXIT(err);
+	return(err);
+	}
+#endif
@@ -117,6 +117,12 @@
 #include "cryptlib.h"
 #include <openssl/safestack.h>
 
+#if defined(OPENSSL_THREADS) && defined(__linux) && defined(__GNUC__) && \
+	!defined(OPENSSL_NO_DEFAULT_LOCKS)
+#define DEFAULT_PTHREAD_LOCKS
+#include <pthread.h>
+#endif
+
 #if defined(OPENSSL_SYS_WIN32) || defined(OPENSSL_SYS_WIN16)
 static double SSLeay_MSVC5_hack=0.0; /* and for VC1.5 */
 #endif
@@ -182,8 +188,55 @@ static STACK_OF(OPENSSL_STRING) *app_locks=NULL;
 static STACK_OF(CRYPTO_dynlock) *dyn_locks=NULL;
 
 
+#ifdef DEFAULT_PTHREAD_LOCKS
+/* Built-in locking callback, in place until the application installs its
+ * own. It uses one read/write lock per static lock id, so readers of
+ * read-mostly structures do not serialise. The pthread functions are weak
+ * references: a program that does not link libpthread cannot start
+ * threads and runs without locking, as it did before. */
+#pragma weak pthread_rwlock_rdlock
+#pragma weak pthread_rwlock_wrlock
+#pragma weak pthread_rwlock_tryrdlock
+#pragma weak pthread_rwlock_trywrlock
+#pragma weak pthread_rwlock_unlock
+
+static pthread_rwlock_t default_locks[CRYPTO_NUM_LOCKS] =
+	{ [0 ... CRYPTO_NUM_LOCKS-1] = PTHREAD_RWLOCK_INITIALIZER };
+/* Acquisitions that had to wait, for CRYPTO_READ and CRYPTO_WRITE */
+static unsigned long default_lock_waits[CRYPTO_NUM_LOCKS][2];
+
+static void default_locking_callback(int mode, int type, const char *file,
+	int line)
+	{
+	pthread_rwlock_t *l;
+
+	if (pthread_rwlock_unlock == NULL || type >= CRYPTO_NUM_LOCKS)
+		return;
+	l = &default_locks[type];
+
+	if (!(mode & CRYPTO_LOCK))
+		pthread_rwlock_unlock(l);
+	else if (mode & CRYPTO_READ)
+		{
+		if (pthread_rwlock_tryrdlock(l) != 0)
+			{
+			__sync_fetch_and_add(&default_lock_waits[type][0], 1);
+			pthread_rwlock_rdlock(l);
+			}
+		}
+	else if (pthread_rwlock_trywrlock(l) != 0)
+		{
+		pthread_rwlock_wrlock(l);
+		default_lock_waits[type][1]++;
+		}
+	}
+
+static void (MS_FAR *locking_callback)(int mode,int type,
+	const char *file,int line)=default_locking_callback;
+#else
 static void (MS_FAR *locking_callback)(int mode,int type,
 	const char *file,int line)=0;
+#endif
 static int (MS_FAR *add_lock_callback)(int *pointer,int amount,
 	int type,const char *file,int line)=0;
 #ifndef OPENSSL_NO_DEPRECATED
@@ -649,6 +702,34 @@ int CRYPTO_add_lock(int *pointer, int amount, int type, const char *file,
 	return(ret);
 	}
 
+int CRYPTO_get_lock_contention(int type, unsigned long *rd_waits,
+	unsigned long *wr_waits)
+	{
+#ifdef DEFAULT_PTHREAD_LOCKS
+	if (type > 0 && type < CRYPTO_NUM_LOCKS)
+		{
+		*rd_waits = default_lock_waits[type][0];
+		*wr_waits = default_lock_waits[type][1];
+		return 1;
+		}
+#endif
+	return 0;
+	}
+
+#ifndef OPENSSL_NO_FP_API
+void CRYPTO_lock_contention_fp(FILE *fp)
+	{
+	unsigned long r,w;
+	int i;
+
+	for (i=1; i<CRYPTO_NUM_LOCKS; i++)
+		{
+		if (CRYPTO_get_lock_contention(i,&r,&w) && (r || w))
+			fprintf(fp,"%8lu %8lu:%s\n",r,w,lock_names[i]);
+		}
+	}
+#endif
+
 const char *CRYPTO_get_lock_name(int type)
 	{
 	if (type < 0)
@@ -665,7 +746,7 @@ const char *CRYPTO_get_lock_name(int type)
 	defined(__INTEL__) || \
 	defined(__x86_64) || defined(__x86_64__) || defined(_M_AMD64) || defined(_M_X64)
 
-unsigned int  OPENSSL_ia32cap_P[2];
+unsigned int  OPENSSL_ia32cap_P[4];
 unsigned long *OPENSSL_ia32cap_loc(void)
 {   if (sizeof(long)==4)
 	/*
@@ -693,7 +774,7 @@ void OPENSSL_cpuid_setup(void)
     if (trigger)	return;
 
     trigger=1;
-    if ((env=getenv("OPENSSL_ia32cap"))) {
+    if ((env=getenv("OPENSSL_ia32cap")) && env[0]!=':') {
 	int off = (env[0]=='~')?1:0;
 #if defined(_WIN32)
 	if (!sscanf(env+off,"%I64i",&vec)) vec = strtoul(env+off,NULL,0);
@@ -712,6 +793,20 @@ void OPENSSL_cpuid_setup(void)
      */
     OPENSSL_ia32cap_P[0] = (unsigned int)vec|(1<<10);
     OPENSSL_ia32cap_P[1] = (unsigned int)(vec>>32);
+
+    /*
+     * OPENSSL_ia32_cpuid stores the extended feature flags (CPUID
+     * leaf 7 %ebx, e.g. AVX2) in OPENSSL_ia32cap_P[2] itself. They
+     * can be masked with a second ':'-separated value, for example
+     * OPENSSL_ia32cap=":~0x20" disables AVX2 code paths.
+     */
+    if (env && (env=strchr(env,':'))) {
+	env++;
+	if (env[0]=='~')
+	    OPENSSL_ia32cap_P[2] &= ~(unsigned int)strtoul(env+1,NULL,0);
+	else
+	    OPENSSL_ia32cap_P[2] = (unsigned int)strtoul(env,NULL,0);
+    }
 }
 #endif
 
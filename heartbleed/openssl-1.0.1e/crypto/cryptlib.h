@@ -104,6 +104,15 @@ void OPENSSL_showfatal(const char *fmta,...);
 void *OPENSSL_stderr(void);
 extern int OPENSSL_NONPIC_relocated;
 
+/* Storage class for per-thread state that must not sit behind one of the
+ * global locks. Left undefined where the compiler cannot provide it, in
+ * which case callers fall back to shared, locked state. */
+#if !defined(OPENSSL_THREADS)
+#define OPENSSL_THREAD_LOCAL
+#elif defined(__GNUC__) && defined(__ELF__) && !defined(OPENSSL_NO_THREAD_LOCAL)
+#define OPENSSL_THREAD_LOCAL	__thread
+#endif
+
 #ifdef  __cplusplus
 }
 #endif
@@ -447,6 +447,12 @@ unsigned long CRYPTO_thread_id(void);
 #endif
 
 const char *CRYPTO_get_lock_name(int type);
+/* Waits for each lock, kept by the built-in locking callback only */
+int CRYPTO_get_lock_contention(int type, unsigned long *rd_waits,
+	unsigned long *wr_waits);
+#ifndef OPENSSL_NO_FP_API
+void CRYPTO_lock_contention_fp(FILE *fp);
+#endif
 int CRYPTO_add_lock(int *pointer,int amount,int type, const char *file,
 		    int line);
 
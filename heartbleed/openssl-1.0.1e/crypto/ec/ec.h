@@ -992,6 +992,7 @@ void ERR_load_EC_strings(void);
 #define EC_F_ECPARAMETERS_PRINT_FP			 148
 #define EC_F_ECPKPARAMETERS_PRINT			 149
 #define EC_F_ECPKPARAMETERS_PRINT_FP			 150
+#define EC_F_ECP_NISTZ256_WINDOWED_MUL			 240
 #define EC_F_ECP_NIST_MOD_192				 203
 #define EC_F_ECP_NIST_MOD_224				 204
 #define EC_F_ECP_NIST_MOD_256				 205
@@ -1024,6 +1025,8 @@ void ERR_load_EC_strings(void);
 #define EC_F_EC_GFP_NISTP256_GROUP_SET_CURVE		 230
 #define EC_F_EC_GFP_NISTP256_POINTS_MUL			 231
 #define EC_F_EC_GFP_NISTP256_POINT_GET_AFFINE_COORDINATES 232
+#define EC_F_EC_GFP_NISTZ256_POINTS_MUL			 238
+#define EC_F_EC_GFP_NISTZ256_POINT_GET_AFFINE_COORDINATES 239
 #define EC_F_EC_GFP_NISTP521_GROUP_SET_CURVE		 233
 #define EC_F_EC_GFP_NISTP521_POINTS_MUL			 234
 #define EC_F_EC_GFP_NISTP521_POINT_GET_AFFINE_COORDINATES 235
@@ -444,3 +444,18 @@ void ec_GFp_nistp_points_make_affine_internal(size_t num, void *point_array,
 	void (*felem_contract)(void *out, const void *in));
 void ec_GFp_nistp_recode_scalar_bits(unsigned char *sign, unsigned char *digit, unsigned char in);
 #endif
+
+/* ecp_nistz256.c: constant-time P-256 with 64-bit limbs and a 128-bit
+ * multiply, used for prime256v1 by default where available */
+#if !defined(OPENSSL_NO_EC_NISTZ256) && defined(__GNUC__) && \
+    (defined(__x86_64) || defined(__x86_64__)) && defined(__SIZEOF_INT128__)
+# define ECP_NISTZ256_CAPABLE
+#endif
+
+#ifdef ECP_NISTZ256_CAPABLE
+const EC_METHOD *EC_GFp_nistz256_method(void);
+int ec_GFp_nistz256_point_get_affine_coordinates(const EC_GROUP *group, const EC_POINT *point, BIGNUM *x, BIGNUM *y, BN_CTX *ctx);
+int ec_GFp_nistz256_points_mul(const EC_GROUP *group, EC_POINT *r, const BIGNUM *scalar, size_t num, const EC_POINT *points[], const BIGNUM *scalars[], BN_CTX *ctx);
+int ec_GFp_nistz256_precompute_mult(EC_GROUP *group, BN_CTX *ctx);
+int ec_GFp_nistz256_have_precompute_mult(const EC_GROUP *group);
+#endif
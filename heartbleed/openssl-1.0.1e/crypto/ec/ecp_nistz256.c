@@ -0,0 +1,986 @@
+/* crypto/ec/ecp_nistz256.c */
+/* ====================================================================
+ * Copyright (c) 2013 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/*
+ * Constant-time point multiplication on NIST P-256 for 64-bit platforms
+ * with a 128-bit multiply.
+ *
+ * Field elements are kept in the Montgomery domain with R = 2^256, which
+ * is exactly how BN_MONT_CTX represents them with 64-bit limbs, so the
+ * coordinates of an EC_POINT created by the Montgomery method can be used
+ * as they are. Points are multiplied with a fixed 5-bit Booth window; the
+ * generator uses a shared table of 37 x 64 affine multiples, indexed with
+ * a 7-bit Booth window, so that neither the running time nor the memory
+ * access pattern depends on the scalar.
+ */
+
+#include <openssl/opensslconf.h>
+
+#include <string.h>
+#include <openssl/err.h>
+#include <openssl/crypto.h>
+#include "ec_lcl.h"
+
+#ifdef ECP_NISTZ256_CAPABLE
+
+typedef unsigned long long u64;
+typedef unsigned __int128 u128;
+
+#define P256_LIMBS	4
+
+typedef struct {
+	u64 X[P256_LIMBS];
+	u64 Y[P256_LIMBS];
+	u64 Z[P256_LIMBS];
+} P256_POINT;
+
+typedef struct {
+	u64 X[P256_LIMBS];
+	u64 Y[P256_LIMBS];
+} P256_POINT_AFFINE;
+
+/* (2^7i)*(j+1)*G for i in [0,37) and j in [0,64) */
+typedef P256_POINT_AFFINE PRECOMP256_ROW[64];
+#define PRECOMP256_ROWS	37
+
+/* The field prime, 2^256 - 2^224 + 2^192 + 2^96 - 1 */
+static const u64 P256[P256_LIMBS] = {
+	0xffffffffffffffffULL, 0x00000000ffffffffULL,
+	0x0000000000000000ULL, 0xffffffff00000001ULL };
+
+/* p - 2, the exponent for inversion */
+static const u64 P256_MINUS_2[P256_LIMBS] = {
+	0xfffffffffffffffdULL, 0x00000000ffffffffULL,
+	0x0000000000000000ULL, 0xffffffff00000001ULL };
+
+/* 1 in the Montgomery domain, 2^256 mod p */
+static const u64 ONE[P256_LIMBS] = {
+	0x0000000000000001ULL, 0xffffffff00000000ULL,
+	0xffffffffffffffffULL, 0x00000000fffffffeULL };
+
+/* The generator in the Montgomery domain */
+static const u64 G_X[P256_LIMBS] = {
+	0x79e730d418a9143cULL, 0x75ba95fc5fedb601ULL,
+	0x79fb732b77622510ULL, 0x18905f76a53755c6ULL };
+static const u64 G_Y[P256_LIMBS] = {
+	0xddf25357ce95560aULL, 0x8b4ab8e4ba19e45cULL,
+	0xd2e88688dd21f325ULL, 0x8571ff1825885d85ULL };
+
+/* Returns all ones if |in| is zero and zero otherwise */
+static u64 is_zero(u64 in)
+	{
+	in |= (0 - in);
+	in = ~in;
+	return 0 - (in >> 63);
+	}
+
+static u64 is_equal(const u64 a[P256_LIMBS], const u64 b[P256_LIMBS])
+	{
+	u64 res;
+
+	res = a[0] ^ b[0];
+	res |= a[1] ^ b[1];
+	res |= a[2] ^ b[2];
+	res |= a[3] ^ b[3];
+	return is_zero(res);
+	}
+
+static u64 is_zero_felem(const u64 a[P256_LIMBS])
+	{
+	return is_zero(a[0] | a[1] | a[2] | a[3]);
+	}
+
+static void copy_conditional(u64 dst[P256_LIMBS], const u64 src[P256_LIMBS],
+			u64 move)
+	{
+	u64 mask1 = 0 - move;
+	u64 mask2 = ~mask1;
+
+	dst[0] = (src[0] & mask1) ^ (dst[0] & mask2);
+	dst[1] = (src[1] & mask1) ^ (dst[1] & mask2);
+	dst[2] = (src[2] & mask1) ^ (dst[2] & mask2);
+	dst[3] = (src[3] & mask1) ^ (dst[3] & mask2);
+	}
+
+/* r = a - p if a + 2^256*carry >= p, else a */
+static void reduce_once(u64 r[P256_LIMBS], const u64 a[P256_LIMBS], u64 carry)
+	{
+	u64 t[P256_LIMBS], borrow = 0, mask;
+	u128 d;
+	int i;
+
+	for (i = 0; i < P256_LIMBS; i++)
+		{
+		d = (u128)a[i] - P256[i] - borrow;
+		t[i] = (u64)d;
+		borrow = (u64)(d >> 64) & 1;
+		}
+	mask = 0 - (carry | (borrow ^ 1));
+	for (i = 0; i < P256_LIMBS; i++)
+		r[i] = (t[i] & mask) | (a[i] & ~mask);
+	}
+
+static void felem_add(u64 r[P256_LIMBS], const u64 a[P256_LIMBS],
+			const u64 b[P256_LIMBS])
+	{
+	u64 t[P256_LIMBS], carry = 0;
+	u128 s;
+	int i;
+
+	for (i = 0; i < P256_LIMBS; i++)
+		{
+		s = (u128)a[i] + b[i] + carry;
+		t[i] = (u64)s;
+		carry = (u64)(s >> 64);
+		}
+	reduce_once(r, t, carry);
+	}
+
+static void felem_sub(u64 r[P256_LIMBS], const u64 a[P256_LIMBS],
+			const u64 b[P256_LIMBS])
+	{
+	u64 t[P256_LIMBS], borrow = 0, carry = 0, mask;
+	u128 d;
+	int i;
+
+	for (i = 0; i < P256_LIMBS; i++)
+		{
+		d = (u128)a[i] - b[i] - borrow;
+		t[i] = (u64)d;
+		borrow = (u64)(d >> 64) & 1;
+		}
+	/* add p back if we went negative */
+	mask = 0 - borrow;
+	for (i = 0; i < P256_LIMBS; i++)
+		{
+		d = (u128)t[i] + (P256[i] & mask) + carry;
+		r[i] = (u64)d;
+		carry = (u64)(d >> 64);
+		}
+	}
+
+static void felem_neg(u64 r[P256_LIMBS], const u64 a[P256_LIMBS])
+	{
+	static const u64 zero[P256_LIMBS] = { 0 };
+
+	felem_sub(r, zero, a);
+	}
+
+static void felem_mul_by_2(u64 r[P256_LIMBS], const u64 a[P256_LIMBS])
+	{
+	felem_add(r, a, a);
+	}
+
+static void felem_mul_by_3(u64 r[P256_LIMBS], const u64 a[P256_LIMBS])
+	{
+	u64 t[P256_LIMBS];
+
+	felem_add(t, a, a);
+	felem_add(r, t, a);
+	}
+
+static void felem_div_by_2(u64 r[P256_LIMBS], const u64 a[P256_LIMBS])
+	{
+	u64 t[P256_LIMBS], carry = 0, mask = 0 - (a[0] & 1);
+	u128 s;
+	int i;
+
+	for (i = 0; i < P256_LIMBS; i++)
+		{
+		s = (u128)a[i] + (P256[i] & mask) + carry;
+		t[i] = (u64)s;
+		carry = (u64)(s >> 64);
+		}
+	r[0] = (t[0] >> 1) | (t[1] << 63);
+	r[1] = (t[1] >> 1) | (t[2] << 63);
+	r[2] = (t[2] >> 1) | (t[3] << 63);
+	r[3] = (t[3] >> 1) | (carry << 63);
+	}
+
+/* Montgomery multiplication, r = a*b/2^256 mod p. Since p = -1 mod 2^64
+ * the per-word reduction factor is simply the low word of the
+ * accumulator. */
+static void felem_mul(u64 r[P256_LIMBS], const u64 a[P256_LIMBS],
+			const u64 b[P256_LIMBS])
+	{
+	u64 acc[P256_LIMBS + 2], m, carry;
+	u128 t;
+	int i, j;
+
+	memset(acc, 0, sizeof(acc));
+	for (i = 0; i < P256_LIMBS; i++)
+		{
+		carry = 0;
+		for (j = 0; j < P256_LIMBS; j++)
+			{
+			t = (u128)a[j] * b[i] + acc[j] + carry;
+			acc[j] = (u64)t;
+			carry = (u64)(t >> 64);
+			}
+		t = (u128)acc[4] + carry;
+		acc[4] = (u64)t;
+		acc[5] = (u64)(t >> 64);
+
+		m = acc[0];
+		t = (u128)m * P256[0] + acc[0];
+		carry = (u64)(t >> 64);
+		for (j = 1; j < P256_LIMBS; j++)
+			{
+			t = (u128)m * P256[j] + acc[j] + carry;
+			acc[j - 1] = (u64)t;
+			carry = (u64)(t >> 64);
+			}
+		t = (u128)acc[4] + carry;
+		acc[3] = (u64)t;
+		acc[4] = acc[5] + (u64)(t >> 64);
+		}
+	reduce_once(r, acc, acc[4]);
+	}
+
+static void felem_sqr(u64 r[P256_LIMBS], const u64 a[P256_LIMBS])
+	{
+	felem_mul(r, a, a);
+	}
+
+/* r = a^-1 by Fermat's little theorem. The exponent is public, so the
+ * branches below do not leak anything about |a|. */
+static void felem_inv(u64 r[P256_LIMBS], const u64 a[P256_LIMBS])
+	{
+	u64 t[P256_LIMBS];
+	int i;
+
+	memcpy(t, ONE, sizeof(t));
+	for (i = 255; i >= 0; i--)
+		{
+		felem_sqr(t, t);
+		if ((P256_MINUS_2[i / 64] >> (i % 64)) & 1)
+			felem_mul(t, t, a);
+		}
+	memcpy(r, t, sizeof(t));
+	}
+
+/* Point doubling in Jacobian coordinates, a = -3. The point at infinity
+ * (Z == 0) doubles to itself. */
+static void point_double(P256_POINT *r, const P256_POINT *a)
+	{
+	u64 S[P256_LIMBS], M[P256_LIMBS], Zsqr[P256_LIMBS], tmp0[P256_LIMBS];
+
+	felem_mul_by_2(S, a->Y);
+	felem_sqr(Zsqr, a->Z);
+	felem_sqr(S, S);
+	felem_mul(r->Z, a->Z, a->Y);
+	felem_mul_by_2(r->Z, r->Z);
+	felem_add(M, a->X, Zsqr);
+	felem_sub(Zsqr, a->X, Zsqr);
+	felem_sqr(r->Y, S);
+	felem_div_by_2(r->Y, r->Y);
+	felem_mul(M, M, Zsqr);
+	felem_mul_by_3(M, M);
+	felem_mul(S, S, a->X);
+	felem_mul_by_2(tmp0, S);
+	felem_sqr(r->X, M);
+	felem_sub(r->X, r->X, tmp0);
+	felem_sub(S, S, r->X);
+	felem_mul(S, S, M);
+	felem_sub(r->Y, S, r->Y);
+	}
+
+/* Point addition in Jacobian coordinates. Either input may be the point
+ * at infinity. Adding a point to itself only happens for degenerate
+ * scalars and is handled, in variable time, by doubling. */
+static void point_add(P256_POINT *r, const P256_POINT *a, const P256_POINT *b)
+	{
+	u64 U2[P256_LIMBS], S2[P256_LIMBS], U1[P256_LIMBS], S1[P256_LIMBS];
+	u64 Z1sqr[P256_LIMBS], Z2sqr[P256_LIMBS], H[P256_LIMBS], R[P256_LIMBS];
+	u64 Hsqr[P256_LIMBS], Rsqr[P256_LIMBS], Hcub[P256_LIMBS];
+	u64 res_x[P256_LIMBS], res_y[P256_LIMBS], res_z[P256_LIMBS];
+	u64 in1infty, in2infty;
+
+	in1infty = is_zero_felem(a->Z);
+	in2infty = is_zero_felem(b->Z);
+
+	felem_sqr(Z2sqr, b->Z);
+	felem_sqr(Z1sqr, a->Z);
+	felem_mul(S1, Z2sqr, b->Z);
+	felem_mul(S2, Z1sqr, a->Z);
+	felem_mul(S1, S1, a->Y);
+	felem_mul(S2, S2, b->Y);
+	felem_sub(R, S2, S1);
+	felem_mul(U1, a->X, Z2sqr);
+	felem_mul(U2, b->X, Z1sqr);
+	felem_sub(H, U2, U1);
+
+	if (is_equal(U1, U2) && !in1infty && !in2infty)
+		{
+		if (is_equal(S1, S2))
+			point_double(r, a);
+		else
+			memset(r, 0, sizeof(*r));
+		return;
+		}
+
+	felem_sqr(Rsqr, R);
+	felem_mul(res_z, H, a->Z);
+	felem_sqr(Hsqr, H);
+	felem_mul(res_z, res_z, b->Z);
+	felem_mul(Hcub, Hsqr, H);
+	felem_mul(U2, U1, Hsqr);
+	felem_mul_by_2(Hsqr, U2);
+	felem_sub(res_x, Rsqr, Hsqr);
+	felem_sub(res_x, res_x, Hcub);
+	felem_sub(res_y, U2, res_x);
+	felem_mul(S2, S1, Hcub);
+	felem_mul(res_y, R, res_y);
+	felem_sub(res_y, res_y, S2);
+
+	copy_conditional(res_x, b->X, in1infty & 1);
+	copy_conditional(res_y, b->Y, in1infty & 1);
+	copy_conditional(res_z, b->Z, in1infty & 1);
+	copy_conditional(res_x, a->X, in2infty & 1);
+	copy_conditional(res_y, a->Y, in2infty & 1);
+	copy_conditional(res_z, a->Z, in2infty & 1);
+
+	memcpy(r->X, res_x, sizeof(res_x));
+	memcpy(r->Y, res_y, sizeof(res_y));
+	memcpy(r->Z, res_z, sizeof(res_z));
+	}
+
+/* Mixed addition of an affine point, (0,0) standing for infinity. The
+ * inputs must not be equal; with the fixed-base table that would require
+ * the scalar to hit a multiple of the group order part way through. */
+static void point_add_affine(P256_POINT *r, const P256_POINT *a,
+			const P256_POINT_AFFINE *b)
+	{
+	u64 U2[P256_LIMBS], S2[P256_LIMBS], Z1sqr[P256_LIMBS];
+	u64 H[P256_LIMBS], R[P256_LIMBS], Hsqr[P256_LIMBS], Rsqr[P256_LIMBS];
+	u64 Hcub[P256_LIMBS];
+	u64 res_x[P256_LIMBS], res_y[P256_LIMBS], res_z[P256_LIMBS];
+	u64 in1infty, in2infty;
+
+	in1infty = is_zero_felem(a->Z);
+	in2infty = is_zero(b->X[0] | b->X[1] | b->X[2] | b->X[3] |
+			   b->Y[0] | b->Y[1] | b->Y[2] | b->Y[3]);
+
+	felem_sqr(Z1sqr, a->Z);
+	felem_mul(U2, b->X, Z1sqr);
+	felem_sub(H, U2, a->X);
+	felem_mul(S2, Z1sqr, a->Z);
+	felem_mul(res_z, H, a->Z);
+	felem_mul(S2, S2, b->Y);
+	felem_sub(R, S2, a->Y);
+
+	felem_sqr(Hsqr, H);
+	felem_sqr(Rsqr, R);
+	felem_mul(Hcub, Hsqr, H);
+	felem_mul(U2, a->X, Hsqr);
+	felem_mul_by_2(Hsqr, U2);
+	felem_sub(res_x, Rsqr, Hsqr);
+	felem_sub(res_x, res_x, Hcub);
+	felem_sub(H, U2, res_x);
+	felem_mul(S2, a->Y, Hcub);
+	felem_mul(res_y, H, R);
+	felem_sub(res_y, res_y, S2);
+
+	copy_conditional(res_x, b->X, in1infty & 1);
+	copy_conditional(res_y, b->Y, in1infty & 1);
+	copy_conditional(res_z, ONE, in1infty & 1);
+	copy_conditional(res_x, a->X, in2infty & 1);
+	copy_conditional(res_y, a->Y, in2infty & 1);
+	copy_conditional(res_z, a->Z, in2infty & 1);
+
+	memcpy(r->X, res_x, sizeof(res_x));
+	memcpy(r->Y, res_y, sizeof(res_y));
+	memcpy(r->Z, res_z, sizeof(res_z));
+	}
+
+/* Constant-time table lookups: every entry is read. Index 0 yields the
+ * point at infinity, index i the entry i-1. */
+static void select_w5(P256_POINT *out, const P256_POINT table[16],
+			unsigned int index)
+	{
+	u64 *o = (u64 *)out, mask;
+	const u64 *t;
+	int i, j;
+
+	memset(out, 0, sizeof(*out));
+	for (i = 0; i < 16; i++)
+		{
+		mask = is_zero((u64)(i + 1) ^ index);
+		t = (const u64 *)&table[i];
+		for (j = 0; j < 3 * P256_LIMBS; j++)
+			o[j] |= t[j] & mask;
+		}
+	}
+
+static void select_w7(P256_POINT_AFFINE *out, const P256_POINT_AFFINE table[64],
+			unsigned int index)
+	{
+	u64 *o = (u64 *)out, mask;
+	const u64 *t;
+	int i, j;
+
+	memset(out, 0, sizeof(*out));
+	for (i = 0; i < 64; i++)
+		{
+		mask = is_zero((u64)(i + 1) ^ index);
+		t = (const u64 *)&table[i];
+		for (j = 0; j < 2 * P256_LIMBS; j++)
+			o[j] |= t[j] & mask;
+		}
+	}
+
+/* Booth recoding of a (w+1)-bit window into a sign bit (lsb) and an
+ * absolute value in [0, 2^(w-1)], see "Fast and Regular Algorithms for
+ * Scalar Multiplication over Elliptic Curves" by Joye and Tunstall. */
+static unsigned int booth_recode_w5(unsigned int in)
+	{
+	unsigned int s, d;
+
+	s = ~((in >> 5) - 1);
+	d = (1 << 6) - in - 1;
+	d = (d & s) | (in & ~s);
+	d = (d >> 1) + (d & 1);
+	return (d << 1) + (s & 1);
+	}
+
+static unsigned int booth_recode_w7(unsigned int in)
+	{
+	unsigned int s, d;
+
+	s = ~((in >> 7) - 1);
+	d = (1 << 8) - in - 1;
+	d = (d & s) | (in & ~s);
+	d = (d >> 1) + (d & 1);
+	return (d << 1) + (s & 1);
+	}
+
+/* Conversions to and from BIGNUM. Coordinates of points in a group set
+ * up by the Montgomery method are already in the right domain. */
+static int bn_to_felem(u64 out[P256_LIMBS], const BIGNUM *in)
+	{
+	int i;
+
+	if (BN_is_negative(in) || in->top > P256_LIMBS)
+		return 0;
+	memset(out, 0, P256_LIMBS * sizeof(u64));
+	for (i = 0; i < in->top; i++)
+		out[i] = in->d[i];
+	return 1;
+	}
+
+static int felem_to_bn(BIGNUM *out, const u64 in[P256_LIMBS])
+	{
+	int i;
+
+	if (bn_wexpand(out, P256_LIMBS) == NULL)
+		return 0;
+	for (i = 0; i < P256_LIMBS; i++)
+		out->d[i] = (BN_ULONG)in[i];
+	out->top = P256_LIMBS;
+	out->neg = 0;
+	bn_correct_top(out);
+	return 1;
+	}
+
+/* Little-endian bytes of |scalar| mod the group order, with one spare
+ * zero byte at the top for the window arithmetic below. */
+static int scalar_to_bytes(const EC_GROUP *group, unsigned char p_str[33],
+			const BIGNUM *scalar, BN_CTX *ctx)
+	{
+	const BIGNUM *s = scalar;
+	BIGNUM *tmp = NULL;
+	int i, j, ret = 0;
+
+	if (BN_num_bits(scalar) > 256 || BN_is_negative(scalar))
+		{
+		BN_CTX_start(ctx);
+		if ((tmp = BN_CTX_get(ctx)) == NULL ||
+		    !BN_nnmod(tmp, scalar, &group->order, ctx))
+			goto err;
+		s = tmp;
+		}
+	memset(p_str, 0, 33);
+	for (i = 0; i < s->top; i++)
+		for (j = 0; j < (int)sizeof(BN_ULONG); j++)
+			p_str[i * sizeof(BN_ULONG) + j] =
+				(unsigned char)(s->d[i] >> (8 * j));
+	ret = 1;
+err:
+	if (tmp != NULL)
+		BN_CTX_end(ctx);
+	return ret;
+	}
+
+/* r = sum scalars[i]*points[i], with fixed 5-bit windows interleaved
+ * across the points so that they share the doublings. */
+static int windowed_mul(const EC_GROUP *group, P256_POINT *r,
+			const EC_POINT *points[], const BIGNUM *scalars[],
+			size_t num, BN_CTX *ctx)
+	{
+	const unsigned int window_size = 5;
+	const unsigned int mask = (1 << (window_size + 1)) - 1;
+	unsigned int wvalue, index;
+	unsigned char (*p_str)[33] = NULL;
+	P256_POINT (*table)[16] = NULL;
+	P256_POINT temp;
+	u64 negY[P256_LIMBS];
+	size_t i;
+	int j, ret = 0;
+
+	p_str = OPENSSL_malloc(num * sizeof(*p_str));
+	table = OPENSSL_malloc(num * sizeof(*table));
+	if (p_str == NULL || table == NULL)
+		{
+		ECerr(EC_F_ECP_NISTZ256_WINDOWED_MUL, ERR_R_MALLOC_FAILURE);
+		goto err;
+		}
+
+	for (i = 0; i < num; i++)
+		{
+		P256_POINT *row = table[i];
+
+		if (!scalar_to_bytes(group, p_str[i], scalars[i], ctx))
+			goto err;
+		if (!bn_to_felem(row[0].X, &points[i]->X) ||
+		    !bn_to_felem(row[0].Y, &points[i]->Y) ||
+		    !bn_to_felem(row[0].Z, &points[i]->Z))
+			{
+			ECerr(EC_F_ECP_NISTZ256_WINDOWED_MUL,
+				EC_R_COORDINATES_OUT_OF_RANGE);
+			goto err;
+			}
+
+		/* row[k-1] = k*P for k in [1,16] */
+		point_double(&row[ 2 - 1], &row[ 1 - 1]);
+		point_add   (&row[ 3 - 1], &row[ 2 - 1], &row[ 1 - 1]);
+		point_double(&row[ 4 - 1], &row[ 2 - 1]);
+		point_double(&row[ 6 - 1], &row[ 3 - 1]);
+		point_double(&row[ 8 - 1], &row[ 4 - 1]);
+		point_double(&row[12 - 1], &row[ 6 - 1]);
+		point_add   (&row[ 5 - 1], &row[ 4 - 1], &row[ 1 - 1]);
+		point_add   (&row[ 7 - 1], &row[ 6 - 1], &row[ 1 - 1]);
+		point_add   (&row[ 9 - 1], &row[ 8 - 1], &row[ 1 - 1]);
+		point_add   (&row[13 - 1], &row[12 - 1], &row[ 1 - 1]);
+		point_double(&row[14 - 1], &row[ 7 - 1]);
+		point_double(&row[10 - 1], &row[ 5 - 1]);
+		point_add   (&row[15 - 1], &row[14 - 1], &row[ 1 - 1]);
+		point_add   (&row[11 - 1], &row[10 - 1], &row[ 1 - 1]);
+		point_double(&row[16 - 1], &row[ 8 - 1]);
+		}
+
+	index = 255;
+
+	wvalue = p_str[0][(index - 1) / 8];
+	wvalue = (wvalue >> ((index - 1) % 8)) & mask;
+	select_w5(r, table[0], booth_recode_w5(wvalue) >> 1);
+
+	while (index >= 5)
+		{
+		for (i = (index == 255 ? 1 : 0); i < num; i++)
+			{
+			unsigned int off = (index - 1) / 8;
+
+			wvalue = p_str[i][off] | p_str[i][off + 1] << 8;
+			wvalue = (wvalue >> ((index - 1) % 8)) & mask;
+			wvalue = booth_recode_w5(wvalue);
+
+			select_w5(&temp, table[i], wvalue >> 1);
+			felem_neg(negY, temp.Y);
+			copy_conditional(temp.Y, negY, wvalue & 1);
+			point_add(r, r, &temp);
+			}
+
+		index -= window_size;
+		for (j = 0; j < (int)window_size; j++)
+			point_double(r, r);
+		}
+
+	/* Final window */
+	for (i = 0; i < num; i++)
+		{
+		wvalue = p_str[i][0];
+		wvalue = (wvalue << 1) & mask;
+		wvalue = booth_recode_w5(wvalue);
+
+		select_w5(&temp, table[i], wvalue >> 1);
+		felem_neg(negY, temp.Y);
+		copy_conditional(temp.Y, negY, wvalue & 1);
+		point_add(r, r, &temp);
+		}
+
+	ret = 1;
+err:
+	if (table != NULL)
+		{
+		OPENSSL_cleanse(table, num * sizeof(*table));
+		OPENSSL_free(table);
+		}
+	if (p_str != NULL)
+		{
+		OPENSSL_cleanse(p_str, num * sizeof(*p_str));
+		OPENSSL_free(p_str);
+		}
+	return ret;
+	}
+
+/* The fixed-base table is the same for every P-256 group, so it is built
+ * once per process, on first use, and shared. It lives in static storage
+ * rather than on the heap since it is never released. */
+static PRECOMP256_ROW precomputed_table[PRECOMP256_ROWS];
+static int precomputed_table_ready = 0;
+
+static void convert_row_to_affine(P256_POINT_AFFINE out[64],
+			const P256_POINT in[64])
+	{
+	u64 prod[64][P256_LIMBS], inv[P256_LIMBS], zinv[P256_LIMBS];
+	u64 zinv2[P256_LIMBS];
+	int i;
+
+	/* Montgomery's trick: one inversion for the whole row */
+	memcpy(prod[0], in[0].Z, sizeof(prod[0]));
+	for (i = 1; i < 64; i++)
+		felem_mul(prod[i], prod[i - 1], in[i].Z);
+	felem_inv(inv, prod[63]);
+	for (i = 63; i >= 0; i--)
+		{
+		if (i > 0)
+			{
+			felem_mul(zinv, inv, prod[i - 1]);
+			felem_mul(inv, inv, in[i].Z);
+			}
+		else
+			memcpy(zinv, inv, sizeof(zinv));
+		felem_sqr(zinv2, zinv);
+		felem_mul(out[i].X, in[i].X, zinv2);
+		felem_mul(zinv2, zinv2, zinv);
+		felem_mul(out[i].Y, in[i].Y, zinv2);
+		}
+	}
+
+static void build_table(PRECOMP256_ROW *tbl)
+	{
+	P256_POINT base, row[64];
+	int i, j;
+
+	memcpy(base.X, G_X, sizeof(base.X));
+	memcpy(base.Y, G_Y, sizeof(base.Y));
+	memcpy(base.Z, ONE, sizeof(base.Z));
+
+	for (i = 0; i < PRECOMP256_ROWS; i++)
+		{
+		row[0] = base;
+		point_double(&row[1], &base);
+		for (j = 2; j < 64; j++)
+			point_add(&row[j], &row[j - 1], &base);
+		convert_row_to_affine(tbl[i], row);
+
+		for (j = 0; j < 7; j++)
+			point_double(&base, &base);
+		}
+	}
+
+static const PRECOMP256_ROW *get_table(void)
+	{
+	int ready;
+
+	CRYPTO_r_lock(CRYPTO_LOCK_EC_PRE_COMP);
+	ready = precomputed_table_ready;
+	CRYPTO_r_unlock(CRYPTO_LOCK_EC_PRE_COMP);
+	if (!ready)
+		{
+		CRYPTO_w_lock(CRYPTO_LOCK_EC_PRE_COMP);
+		if (!precomputed_table_ready)
+			{
+			build_table(precomputed_table);
+			precomputed_table_ready = 1;
+			}
+		CRYPTO_w_unlock(CRYPTO_LOCK_EC_PRE_COMP);
+		}
+	return precomputed_table;
+	}
+
+/* r = scalar*G with 7-bit Booth windows over the table */
+static int base_mul(const EC_GROUP *group, P256_POINT *r,
+			const PRECOMP256_ROW *tbl, const BIGNUM *scalar,
+			BN_CTX *ctx)
+	{
+	const unsigned int window_size = 7;
+	const unsigned int mask = (1 << (window_size + 1)) - 1;
+	unsigned int wvalue, index = 0;
+	unsigned char p_str[33];
+	P256_POINT_AFFINE t;
+	u64 negY[P256_LIMBS], infty;
+	int i;
+
+	if (!scalar_to_bytes(group, p_str, scalar, ctx))
+		return 0;
+
+	/* First window */
+	wvalue = (p_str[0] << 1) & mask;
+	index += window_size;
+	wvalue = booth_recode_w7(wvalue);
+
+	select_w7(&t, tbl[0], wvalue >> 1);
+	felem_neg(negY, t.Y);
+	copy_conditional(t.Y, negY, wvalue & 1);
+
+	/* Affine infinity is (0,0), Jacobian infinity has Z = 0 */
+	infty = ~is_zero(t.X[0] | t.X[1] | t.X[2] | t.X[3] |
+			 t.Y[0] | t.Y[1] | t.Y[2] | t.Y[3]);
+	memcpy(r->X, t.X, sizeof(r->X));
+	memcpy(r->Y, t.Y, sizeof(r->Y));
+	for (i = 0; i < P256_LIMBS; i++)
+		r->Z[i] = ONE[i] & infty;
+
+	for (i = 1; i < PRECOMP256_ROWS; i++)
+		{
+		unsigned int off = (index - 1) / 8;
+
+		wvalue = p_str[off] | p_str[off + 1] << 8;
+		wvalue = (wvalue >> ((index - 1) % 8)) & mask;
+		index += window_size;
+		wvalue = booth_recode_w7(wvalue);
+
+		select_w7(&t, tbl[i], wvalue >> 1);
+		felem_neg(negY, t.Y);
+		copy_conditional(t.Y, negY, wvalue & 1);
+		point_add_affine(r, r, &t);
+		}
+
+	OPENSSL_cleanse(p_str, sizeof(p_str));
+	return 1;
+	}
+
+/* Is the group generator the standard P-256 base point? */
+static int is_standard_generator(const EC_GROUP *group)
+	{
+	u64 x[P256_LIMBS], y[P256_LIMBS], z[P256_LIMBS], p[P256_LIMBS];
+	const EC_POINT *g = group->generator;
+
+	if (g == NULL ||
+	    !bn_to_felem(p, &group->field) ||
+	    !bn_to_felem(x, &g->X) ||
+	    !bn_to_felem(y, &g->Y) ||
+	    !bn_to_felem(z, &g->Z))
+		return 0;
+	return (int)(is_equal(p, P256) & is_equal(x, G_X) &
+		     is_equal(y, G_Y) & is_equal(z, ONE) & 1);
+	}
+
+int ec_GFp_nistz256_points_mul(const EC_GROUP *group, EC_POINT *r,
+			const BIGNUM *scalar, size_t num, const EC_POINT *points[],
+			const BIGNUM *scalars[], BN_CTX *ctx)
+	{
+	const PRECOMP256_ROW *tbl = NULL;
+	P256_POINT p, q;
+	BN_CTX *new_ctx = NULL;
+	size_t i;
+	int ret = 0;
+
+	if (scalar == NULL && num == 0)
+		return EC_POINT_set_to_infinity(group, r);
+
+	for (i = 0; i < num; i++)
+		{
+		if (group->meth != points[i]->meth)
+			{
+			ECerr(EC_F_EC_GFP_NISTZ256_POINTS_MUL,
+				EC_R_INCOMPATIBLE_OBJECTS);
+			return 0;
+			}
+		}
+
+	if (scalar != NULL)
+		{
+		/* A custom generator takes the generic path */
+		if (!is_standard_generator(group))
+			return ec_wNAF_mul(group, r, scalar, num, points,
+					   scalars, ctx);
+		tbl = get_table();
+		}
+
+	if (ctx == NULL)
+		{
+		if ((ctx = new_ctx = BN_CTX_new()) == NULL)
+			goto err;
+		}
+
+	memset(&p, 0, sizeof(p));
+	if (scalar != NULL && !base_mul(group, &p, tbl, scalar, ctx))
+		goto err;
+
+	if (num != 0)
+		{
+		if (!windowed_mul(group, &q, points, scalars, num, ctx))
+			goto err;
+		point_add(&p, &p, &q);
+		}
+
+	if (!felem_to_bn(&r->X, p.X) ||
+	    !felem_to_bn(&r->Y, p.Y) ||
+	    !felem_to_bn(&r->Z, p.Z))
+		goto err;
+	r->Z_is_one = (int)(is_equal(p.Z, ONE) & 1);
+	ret = 1;
+err:
+	OPENSSL_cleanse(&p, sizeof(p));
+	OPENSSL_cleanse(&q, sizeof(q));
+	if (new_ctx != NULL)
+		BN_CTX_free(new_ctx);
+	return ret;
+	}
+
+int ec_GFp_nistz256_point_get_affine_coordinates(const EC_GROUP *group,
+			const EC_POINT *point, BIGNUM *x, BIGNUM *y, BN_CTX *ctx)
+	{
+	static const u64 plain_one[P256_LIMBS] = { 1, 0, 0, 0 };
+	u64 X[P256_LIMBS], Y[P256_LIMBS], Z[P256_LIMBS];
+	u64 z_inv2[P256_LIMBS], z_inv3[P256_LIMBS], res[P256_LIMBS];
+
+	if (EC_POINT_is_at_infinity(group, point))
+		{
+		ECerr(EC_F_EC_GFP_NISTZ256_POINT_GET_AFFINE_COORDINATES,
+			EC_R_POINT_AT_INFINITY);
+		return 0;
+		}
+
+	if (!bn_to_felem(X, &point->X) ||
+	    !bn_to_felem(Y, &point->Y) ||
+	    !bn_to_felem(Z, &point->Z))
+		{
+		ECerr(EC_F_EC_GFP_NISTZ256_POINT_GET_AFFINE_COORDINATES,
+			EC_R_COORDINATES_OUT_OF_RANGE);
+		return 0;
+		}
+
+	felem_inv(z_inv3, Z);
+	felem_sqr(z_inv2, z_inv3);
+
+	if (x != NULL)
+		{
+		felem_mul(res, X, z_inv2);
+		/* leave the Montgomery domain */
+		felem_mul(res, res, plain_one);
+		if (!felem_to_bn(x, res))
+			return 0;
+		}
+	if (y != NULL)
+		{
+		felem_mul(z_inv3, z_inv3, z_inv2);
+		felem_mul(res, Y, z_inv3);
+		felem_mul(res, res, plain_one);
+		if (!felem_to_bn(y, res))
+			return 0;
+		}
+	return 1;
+	}
+
+int ec_GFp_nistz256_precompute_mult(EC_GROUP *group, BN_CTX *ctx)
+	{
+	if (!is_standard_generator(group))
+		return ec_wNAF_precompute_mult(group, ctx);
+	get_table();
+	return 1;
+	}
+
+int ec_GFp_nistz256_have_precompute_mult(const EC_GROUP *group)
+	{
+	if (!is_standard_generator(group))
+		return ec_wNAF_have_precompute_mult(group);
+	return 1;
+	}
+
+const EC_METHOD *EC_GFp_nistz256_method(void)
+	{
+	static const EC_METHOD ret = {
+		EC_FLAGS_DEFAULT_OCT,
+		NID_X9_62_prime_field,
+		ec_GFp_mont_group_init,
+		ec_GFp_mont_group_finish,
+		ec_GFp_mont_group_clear_finish,
+		ec_GFp_mont_group_copy,
+		ec_GFp_mont_group_set_curve,
+		ec_GFp_simple_group_get_curve,
+		ec_GFp_simple_group_get_degree,
+		ec_GFp_simple_group_check_discriminant,
+		ec_GFp_simple_point_init,
+		ec_GFp_simple_point_finish,
+		ec_GFp_simple_point_clear_finish,
+		ec_GFp_simple_point_copy,
+		ec_GFp_simple_point_set_to_infinity,
+		ec_GFp_simple_set_Jprojective_coordinates_GFp,
+		ec_GFp_simple_get_Jprojective_coordinates_GFp,
+		ec_GFp_simple_point_set_affine_coordinates,
+		ec_GFp_nistz256_point_get_affine_coordinates,
+		0,0,0,
+		ec_GFp_simple_add,
+		ec_GFp_simple_dbl,
+		ec_GFp_simple_invert,
+		ec_GFp_simple_is_at_infinity,
+		ec_GFp_simple_is_on_curve,
+		ec_GFp_simple_cmp,
+		ec_GFp_simple_make_affine,
+		ec_GFp_simple_points_make_affine,
+		ec_GFp_nistz256_points_mul,
+		ec_GFp_nistz256_precompute_mult,
+		ec_GFp_nistz256_have_precompute_mult,
+		ec_GFp_mont_field_mul,
+		ec_GFp_mont_field_sqr,
+		0 /* field_div */,
+		ec_GFp_mont_field_encode,
+		ec_GFp_mont_field_decode,
+		ec_GFp_mont_field_set_to_one };
+
+	return &ret;
+	}
+
+#else
+static void *dummy=&dummy;
+#endif
@@ -1444,6 +1444,138 @@ void nistp_tests()
 	}
 #endif
 
+/* Compare or copy points of two groups on the same curve through their
+ * affine coordinates. */
+static int p256_points_equal(const EC_GROUP *g1, const EC_POINT *p1,
+	const EC_GROUP *g2, const EC_POINT *p2, BN_CTX *ctx)
+	{
+	BIGNUM *x1, *y1, *x2, *y2;
+	int ret = 0;
+
+	if (EC_POINT_is_at_infinity(g1, p1) || EC_POINT_is_at_infinity(g2, p2))
+		return EC_POINT_is_at_infinity(g1, p1) &&
+			EC_POINT_is_at_infinity(g2, p2);
+	BN_CTX_start(ctx);
+	x1 = BN_CTX_get(ctx); y1 = BN_CTX_get(ctx);
+	x2 = BN_CTX_get(ctx); y2 = BN_CTX_get(ctx);
+	if (y2 != NULL &&
+	    EC_POINT_get_affine_coordinates_GFp(g1, p1, x1, y1, ctx) &&
+	    EC_POINT_get_affine_coordinates_GFp(g2, p2, x2, y2, ctx))
+		ret = BN_cmp(x1, x2) == 0 && BN_cmp(y1, y2) == 0;
+	BN_CTX_end(ctx);
+	return ret;
+	}
+
+static int p256_copy_point(const EC_GROUP *dst_group, EC_POINT *dst,
+	const EC_GROUP *src_group, const EC_POINT *src, BN_CTX *ctx)
+	{
+	BIGNUM *x, *y;
+	int ret = 0;
+
+	BN_CTX_start(ctx);
+	x = BN_CTX_get(ctx); y = BN_CTX_get(ctx);
+	if (y != NULL &&
+	    EC_POINT_get_affine_coordinates_GFp(src_group, src, x, y, ctx) &&
+	    EC_POINT_set_affine_coordinates_GFp(dst_group, dst, x, y, ctx))
+		ret = 1;
+	BN_CTX_end(ctx);
+	return ret;
+	}
+
+/* Cross-check the default prime256v1 method, which may be an optimised
+ * one, against the generic Montgomery arithmetic on the same curve. */
+static void p256_default_method_test(void)
+	{
+	BN_CTX *ctx;
+	EC_GROUP *DEF, *REF;
+	EC_POINT *P, *Q, *R_DEF, *R_REF, *T;
+	const EC_POINT *points[2];
+	const BIGNUM *scalars[2];
+	BIGNUM *p, *a, *b, *x, *y, *order, *k, *l, *m;
+	int i;
+
+	fprintf(stdout, "\nP-256 default method against generic arithmetic ... ");
+	fflush(stdout);
+	ctx = BN_CTX_new();
+	p = BN_new(); a = BN_new(); b = BN_new();
+	x = BN_new(); y = BN_new(); order = BN_new();
+	k = BN_new(); l = BN_new(); m = BN_new();
+
+	if ((DEF = EC_GROUP_new_by_curve_name(NID_X9_62_prime256v1)) == NULL) ABORT;
+	if (!EC_GROUP_get_curve_GFp(DEF, p, a, b, ctx)) ABORT;
+	if ((REF = EC_GROUP_new(EC_GFp_mont_method())) == NULL) ABORT;
+	if (!EC_GROUP_set_curve_GFp(REF, p, a, b, ctx)) ABORT;
+	if (!EC_GROUP_get_order(DEF, order, ctx)) ABORT;
+	if (!EC_POINT_get_affine_coordinates_GFp(DEF, EC_GROUP_get0_generator(DEF), x, y, ctx)) ABORT;
+	T = EC_POINT_new(REF);
+	if (!EC_POINT_set_affine_coordinates_GFp(REF, T, x, y, ctx)) ABORT;
+	if (!EC_GROUP_set_generator(REF, T, order, BN_value_one())) ABORT;
+
+	P = EC_POINT_new(DEF); Q = EC_POINT_new(DEF);
+	R_DEF = EC_POINT_new(DEF); R_REF = EC_POINT_new(REF);
+
+	for (i = 0; i < 40; i++)
+		{
+		/* a few scalars that stress the window and reduction code */
+		switch (i)
+			{
+		case 0: BN_zero(k); break;
+		case 1: BN_one(k); break;
+		case 2: if (!BN_sub(k, order, BN_value_one())) ABORT; break;
+		case 3: if (!BN_copy(k, order)) ABORT; break;
+		case 4: if (!BN_add(k, order, BN_value_one())) ABORT; break;
+		case 5: if (!BN_rand(k, 256, -1, 0)) ABORT; BN_set_negative(k, 1); break;
+		case 6: if (!BN_rand(k, 300, -1, 0)) ABORT; break;
+		case 7: if (!BN_set_bit(k, 255)) ABORT; break;
+		default: if (!BN_rand_range(k, order)) ABORT; break;
+			}
+		if (!BN_rand_range(l, order)) ABORT;
+
+		/* k*G */
+		if (!EC_POINT_mul(DEF, R_DEF, k, NULL, NULL, ctx)) ABORT;
+		if (!EC_POINT_mul(REF, R_REF, k, NULL, NULL, ctx)) ABORT;
+		if (!p256_points_equal(DEF, R_DEF, REF, R_REF, ctx)) ABORT;
+
+		/* P = l*G, then k*P */
+		if (!EC_POINT_mul(DEF, P, l, NULL, NULL, ctx)) ABORT;
+		if (!EC_POINT_mul(DEF, R_DEF, NULL, P, k, ctx)) ABORT;
+		if (!p256_copy_point(REF, T, DEF, P, ctx)) ABORT;
+		if (!EC_POINT_mul(REF, R_REF, NULL, T, k, ctx)) ABORT;
+		if (!p256_points_equal(DEF, R_DEF, REF, R_REF, ctx)) ABORT;
+
+		/* m*G + k*P + l*Q as in ECDSA verification */
+		if (!BN_rand_range(m, order)) ABORT;
+		if (!EC_POINT_dbl(DEF, Q, P, ctx)) ABORT;
+		points[0] = P; points[1] = Q;
+		scalars[0] = k; scalars[1] = l;
+		if (!EC_POINTs_mul(DEF, R_DEF, m, 2, points, scalars, ctx)) ABORT;
+		if (!BN_mul(x, l, BN_value_one(), ctx)) ABORT;
+		if (!BN_lshift1(x, x)) ABORT;
+		if (!BN_mod_mul(x, x, l, order, ctx)) ABORT;
+		if (!BN_mod_mul(y, k, l, order, ctx)) ABORT;
+		if (!BN_mod_add(x, x, y, order, ctx)) ABORT;
+		if (!BN_mod_add(x, x, m, order, ctx)) ABORT;
+		if (!EC_POINT_mul(REF, R_REF, x, NULL, NULL, ctx)) ABORT;
+		if (!p256_points_equal(DEF, R_DEF, REF, R_REF, ctx)) ABORT;
+		}
+
+	/* the point at infinity as input */
+	if (!EC_POINT_set_to_infinity(DEF, P)) ABORT;
+	if (!EC_POINT_mul(DEF, R_DEF, k, P, l, ctx)) ABORT;
+	if (!EC_POINT_mul(DEF, Q, k, NULL, NULL, ctx)) ABORT;
+	if (0 != EC_POINT_cmp(DEF, R_DEF, Q, ctx)) ABORT;
+
+	fprintf(stdout, "ok\n");
+
+	EC_POINT_free(P); EC_POINT_free(Q); EC_POINT_free(T);
+	EC_POINT_free(R_DEF); EC_POINT_free(R_REF);
+	EC_GROUP_free(DEF); EC_GROUP_free(REF);
+	BN_free(p); BN_free(a); BN_free(b);
+	BN_free(x); BN_free(y); BN_free(order);
+	BN_free(k); BN_free(l); BN_free(m);
+	BN_CTX_free(ctx);
+	}
+
 static const char rnd_seed[] = "string to make the random number generator think it has entropy";
 
 int main(int argc, char *argv[])
@@ -1473,6 +1605,7 @@ int main(int argc, char *argv[])
 #ifndef OPENSSL_NO_EC_NISTP_64_GCC_128
 	nistp_tests();
 #endif
+	p256_default_method_test();
 	/* test the internal curves */
 	internal_curve_test();
 
@@ -286,6 +286,17 @@ static LHASH_OF(ERR_STATE) *int_thread_hash = NULL;
 static int int_thread_hash_references = 0;
 static int int_err_library_number= ERR_LIB_USER;
 
+#ifdef OPENSSL_THREAD_LOCAL
+/* The calling thread's entry in int_thread_hash, so that ERR_get_state()
+ * does not have to take CRYPTO_LOCK_ERR to find it. Any removal from the
+ * hash, possibly of this very entry by another thread, bumps
+ * int_thread_gen, and the cached pointer is only trusted while the
+ * generation it was looked up in is current. */
+static OPENSSL_THREAD_LOCAL ERR_STATE *int_thread_state;
+static OPENSSL_THREAD_LOCAL unsigned int int_thread_state_gen;
+static volatile unsigned int int_thread_gen = 1;
+#endif
+
 /* Internal function that checks whether "err_fns" is set and if not, sets it to
  * the defaults. */
 static void err_fns_check(void)
@@ -530,6 +541,10 @@ static void int_thread_del_item(const ERR_STATE *d)
 
 	CRYPTO_w_lock(CRYPTO_LOCK_ERR);
 	p = lh_ERR_STATE_delete(hash, d);
+#ifdef OPENSSL_THREAD_LOCAL
+	if (p)
+		int_thread_gen++;
+#endif
 	/* make sure we don't leak memory */
 	if (int_thread_hash_references == 1
 	    && int_thread_hash && lh_ERR_STATE_num_items(int_thread_hash) == 0)
@@ -1007,8 +1022,16 @@ ERR_STATE *ERR_get_state(void)
 	ERR_STATE *ret,tmp,*tmpp=NULL;
 	int i;
 	CRYPTO_THREADID tid;
+#ifdef OPENSSL_THREAD_LOCAL
+	unsigned int gen;
+#endif
 
 	err_fns_check();
+#ifdef OPENSSL_THREAD_LOCAL
+	gen = int_thread_gen;
+	if (int_thread_state != NULL && int_thread_state_gen == gen)
+		return int_thread_state;
+#endif
 	CRYPTO_THREADID_current(&tid);
 	CRYPTO_THREADID_cpy(&tmp.tid, &tid);
 	ret=ERRFN(thread_get_item)(&tmp);
@@ -1038,6 +1061,13 @@ ERR_STATE *ERR_get_state(void)
 		if (tmpp)
 			ERR_STATE_free(tmpp);
 		}
+#ifdef OPENSSL_THREAD_LOCAL
+	if (err_fns == &err_defaults)
+		{
+		int_thread_state = ret;
+		int_thread_state_gen = gen;
+		}
+#endif
 	return ret;
 	}
 
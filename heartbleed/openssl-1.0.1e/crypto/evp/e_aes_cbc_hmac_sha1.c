@@ -58,6 +58,7 @@
 #include <openssl/objects.h>
 #include <openssl/aes.h>
 #include <openssl/sha.h>
+#include <openssl/rand.h>
 #include "evp_locl.h"
 
 #ifndef EVP_CIPH_FLAG_AEAD_CIPHER
@@ -94,8 +95,9 @@ typedef struct
 # define BSWAP(x) ({ unsigned int r=(x); asm ("bswapl %0":"=r"(r):"0"(r)); r; })
 #endif
 
-extern unsigned int OPENSSL_ia32cap_P[2];
+extern unsigned int OPENSSL_ia32cap_P[];
 #define AESNI_CAPABLE   (1<<(57-32))
+#define AVX2_CAPABLE	(OPENSSL_ia32cap_P[2]&(1<<5))
 
 int aesni_set_encrypt_key(const unsigned char *userKey, int bits,
 			      AES_KEY *key);
@@ -108,6 +110,12 @@ void aesni_cbc_encrypt(const unsigned char *in,
 			   const AES_KEY *key,
 			   unsigned char *ivec, int enc);
 
+void aesni_ecb_encrypt(const unsigned char *in,
+			   unsigned char *out,
+			   size_t length,
+			   const AES_KEY *key,
+			   int enc);
+
 void aesni_cbc_sha1_enc (const void *inp, void *out, size_t blocks,
 		const AES_KEY *key, unsigned char iv[16],
 		SHA_CTX *ctx,const void *in0);
@@ -450,6 +458,252 @@ static int aesni_cbc_hmac_sha1_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
 	return 1;
 	}
 
+#if defined(__GNUC__) && (__GNUC__>4 || (__GNUC__==4 && __GNUC_MINOR__>=8)) && \
+	!defined(PEDANTIC) && !defined(OPENSSL_NO_MULTIBLOCK)
+# define MULTIBLOCK
+#endif
+
+#ifdef MULTIBLOCK
+/*
+ * Multi-block TLS 1.1+ record encryption. Records are independent
+ * of each other once there is an explicit IV, so 4 or 8 of them are
+ * hashed in the lanes of a vector register and their CBC chains are
+ * interleaved in a single ECB call. This hides the latency of both
+ * SHA1 and serial CBC encryption that limits the stitched code path.
+ */
+typedef struct {
+	unsigned int	A[8],B[8],C[8],D[8],E[8];
+	} SHA1_MB_CTX;
+
+typedef unsigned int u32x4 __attribute__((vector_size(16)));
+typedef unsigned int u32x8 __attribute__((vector_size(32)));
+
+static inline unsigned int mb_load(const unsigned char *p)
+	{
+	unsigned int v;
+	memcpy(&v,p,4);
+	return __builtin_bswap32(v);
+	}
+
+#define MB_ROTL(x,n)	(((x)<<(n))|((x)>>(32-(n))))
+#define MB_F_00_19(b,c,d)	((((c)^(d))&(b))^(d))
+#define MB_F_20_39(b,c,d)	((b)^(c)^(d))
+#define MB_F_40_59(b,c,d)	(((b)&(c))|(((b)|(c))&(d)))
+#define MB_F_60_79(b,c,d)	MB_F_20_39(b,c,d)
+
+/* Rounds are unrolled as in sha_locl.h, so that every W[] index is
+ * a constant and no register moves are needed between rounds.
+ */
+#define MB_X(i)		W[(i)&15]=MB_ROTL(W[((i)+13)&15]^W[((i)+8)&15]^ \
+				W[((i)+2)&15]^W[(i)&15],1)
+#define MB_R(f,k,a,b,c,d,e,i)	e+=MB_ROTL(a,5)+f(b,c,d)+(k)+W[(i)&15]; \
+				b=MB_ROTL(b,30)
+#define MB_RX(f,k,a,b,c,d,e,i)	MB_X(i); MB_R(f,k,a,b,c,d,e,i)
+#define MB_R5(R,f,k,i)	R(f,k,a,b,c,d,e,i);   R(f,k,e,a,b,c,d,(i)+1); \
+			R(f,k,d,e,a,b,c,(i)+2); R(f,k,c,d,e,a,b,(i)+3); \
+			R(f,k,b,c,d,e,a,(i)+4)
+
+#define MB_LOAD4(i)	(u32x4){ mb_load(p[0]+(i)),mb_load(p[1]+(i)), \
+				 mb_load(p[2]+(i)),mb_load(p[3]+(i)) }
+#define MB_LOAD8(i)	(u32x8){ mb_load(p[0]+(i)),mb_load(p[1]+(i)), \
+				 mb_load(p[2]+(i)),mb_load(p[3]+(i)), \
+				 mb_load(p[4]+(i)),mb_load(p[5]+(i)), \
+				 mb_load(p[6]+(i)),mb_load(p[7]+(i)) }
+
+#define SHA1_MB_BLOCKS(V,LOAD)	do {				\
+	V a,b,c,d,e,A,B,C,D,E,W[16];				\
+	int t;							\
+	memcpy(&a,&ctx->A[lane],sizeof(V));			\
+	memcpy(&b,&ctx->B[lane],sizeof(V));			\
+	memcpy(&c,&ctx->C[lane],sizeof(V));			\
+	memcpy(&d,&ctx->D[lane],sizeof(V));			\
+	memcpy(&e,&ctx->E[lane],sizeof(V));			\
+	for (;blocks;blocks--,off+=SHA_CBLOCK) {		\
+		A=a; B=b; C=c; D=d; E=e;			\
+		for (t=0;t<16;t++)				\
+			W[t]=LOAD(off+4*t);			\
+		MB_R5(MB_R, MB_F_00_19,0x5a827999U, 0);		\
+		MB_R5(MB_R, MB_F_00_19,0x5a827999U, 5);		\
+		MB_R5(MB_R, MB_F_00_19,0x5a827999U,10);		\
+		MB_R(MB_F_00_19,0x5a827999U,a,b,c,d,e,15);	\
+		MB_RX(MB_F_00_19,0x5a827999U,e,a,b,c,d,16);	\
+		MB_RX(MB_F_00_19,0x5a827999U,d,e,a,b,c,17);	\
+		MB_RX(MB_F_00_19,0x5a827999U,c,d,e,a,b,18);	\
+		MB_RX(MB_F_00_19,0x5a827999U,b,c,d,e,a,19);	\
+		MB_R5(MB_RX,MB_F_20_39,0x6ed9eba1U,20);		\
+		MB_R5(MB_RX,MB_F_20_39,0x6ed9eba1U,25);		\
+		MB_R5(MB_RX,MB_F_20_39,0x6ed9eba1U,30);		\
+		MB_R5(MB_RX,MB_F_20_39,0x6ed9eba1U,35);		\
+		MB_R5(MB_RX,MB_F_40_59,0x8f1bbcdcU,40);		\
+		MB_R5(MB_RX,MB_F_40_59,0x8f1bbcdcU,45);		\
+		MB_R5(MB_RX,MB_F_40_59,0x8f1bbcdcU,50);		\
+		MB_R5(MB_RX,MB_F_40_59,0x8f1bbcdcU,55);		\
+		MB_R5(MB_RX,MB_F_60_79,0xca62c1d6U,60);		\
+		MB_R5(MB_RX,MB_F_60_79,0xca62c1d6U,65);		\
+		MB_R5(MB_RX,MB_F_60_79,0xca62c1d6U,70);		\
+		MB_R5(MB_RX,MB_F_60_79,0xca62c1d6U,75);		\
+		a+=A; b+=B; c+=C; d+=D; e+=E;			\
+	}							\
+	memcpy(&ctx->A[lane],&a,sizeof(V));			\
+	memcpy(&ctx->B[lane],&b,sizeof(V));			\
+	memcpy(&ctx->C[lane],&c,sizeof(V));			\
+	memcpy(&ctx->D[lane],&d,sizeof(V));			\
+	memcpy(&ctx->E[lane],&e,sizeof(V));			\
+	} while (0)
+
+static void sha1_multi_block_4x(SHA1_MB_CTX *ctx,int lane,
+		const unsigned char **p,size_t blocks)
+	{
+	size_t off=0;
+
+	SHA1_MB_BLOCKS(u32x4,MB_LOAD4);
+	}
+
+__attribute__((target("avx2")))
+static void sha1_multi_block_8x(SHA1_MB_CTX *ctx,int lane,
+		const unsigned char **p,size_t blocks)
+	{
+	size_t off=0;
+
+	SHA1_MB_BLOCKS(u32x8,MB_LOAD8);
+	}
+
+static int sha1_multi_block_lanes(void)
+	{
+	return AVX2_CAPABLE?8:4;
+	}
+
+static size_t tls1_1_multi_block_bufsize(size_t frag,size_t last,int x)
+	{
+	/* header, explicit IV and payload|hmac|padding */
+	return (x-1)*(5+16+((frag+SHA_DIGEST_LENGTH+AES_BLOCK_SIZE)&-AES_BLOCK_SIZE)) +
+		     (5+16+((last+SHA_DIGEST_LENGTH+AES_BLOCK_SIZE)&-AES_BLOCK_SIZE));
+	}
+
+static size_t tls1_1_multi_block_encrypt(EVP_AES_HMAC_SHA1 *key,
+			unsigned char *out,const unsigned char *inp,
+			size_t inp_len,int x)
+	{
+	SHA1_MB_CTX	mctx;
+	SHA_CTX		sctx[8];
+	const unsigned char *hinp[8];
+	unsigned char	*rec[8],*last_block;
+	unsigned char	ivs[8*AES_BLOCK_SIZE],blk[8*AES_BLOCK_SIZE];
+	unsigned char	aad[13],mac[SHA_DIGEST_LENGTH];
+	size_t		frag,last,len[8],enc_len[8],blocks,i,j,k,ret=0;
+
+	frag = inp_len/x;
+	last = inp_len-frag*(x-1);
+	if (frag<4*SHA_CBLOCK || last>16384)
+		return 0;
+
+	if (RAND_bytes(ivs,x*AES_BLOCK_SIZE)<=0)
+		return 0;
+
+	memcpy(aad,key->aux.tls_aad,13);
+
+	/* Inner hash of the AAD and the first bytes of every record,
+	 * so that all of the lanes are aligned to a block boundary.
+	 */
+	for (i=0;i<(size_t)x;i++)
+		{
+		len[i] = (i==(size_t)x-1)?last:frag;
+		hinp[i] = inp+i*frag;
+
+		aad[11] = (unsigned char)(len[i]>>8);
+		aad[12] = (unsigned char)len[i];
+
+		sctx[i] = key->head;
+		SHA1_Update(&sctx[i],aad,13);
+		SHA1_Update(&sctx[i],hinp[i],SHA_CBLOCK-13);
+		hinp[i] += SHA_CBLOCK-13;
+
+		mctx.A[i] = sctx[i].h0;
+		mctx.B[i] = sctx[i].h1;
+		mctx.C[i] = sctx[i].h2;
+		mctx.D[i] = sctx[i].h3;
+		mctx.E[i] = sctx[i].h4;
+
+		/* next sequence number */
+		for (j=8;j-->0;)
+			if (++aad[j]) break;
+		}
+
+	/* The bulk of the payload, all of the lanes in parallel */
+	blocks = (frag-(SHA_CBLOCK-13))/SHA_CBLOCK;
+
+	if (x==8 && sha1_multi_block_lanes()==8)
+		sha1_multi_block_8x(&mctx,0,hinp,blocks);
+	else
+		for (i=0;i<(size_t)x;i+=4)
+			sha1_multi_block_4x(&mctx,i,hinp+i,blocks);
+
+	/* Finish every HMAC and lay the records out */
+	for (i=0;i<(size_t)x;i++)
+		{
+		sctx[i].h0 = mctx.A[i];
+		sctx[i].h1 = mctx.B[i];
+		sctx[i].h2 = mctx.C[i];
+		sctx[i].h3 = mctx.D[i];
+		sctx[i].h4 = mctx.E[i];
+		sctx[i].Nl += (unsigned int)(blocks*SHA_CBLOCK*8);
+
+		j = SHA_CBLOCK-13+blocks*SHA_CBLOCK;
+		SHA1_Update(&sctx[i],hinp[i]+blocks*SHA_CBLOCK,len[i]-j);
+		SHA1_Final(mac,&sctx[i]);
+		sctx[i] = key->tail;
+		SHA1_Update(&sctx[i],mac,SHA_DIGEST_LENGTH);
+		SHA1_Final(mac,&sctx[i]);
+
+		enc_len[i] = (len[i]+SHA_DIGEST_LENGTH+AES_BLOCK_SIZE)&-AES_BLOCK_SIZE;
+
+		rec[i] = out+ret;
+		rec[i][0] = key->aux.tls_aad[8];
+		rec[i][1] = key->aux.tls_aad[9];
+		rec[i][2] = key->aux.tls_aad[10];
+		rec[i][3] = (unsigned char)((AES_BLOCK_SIZE+enc_len[i])>>8);
+		rec[i][4] = (unsigned char)(AES_BLOCK_SIZE+enc_len[i]);
+		memcpy(rec[i]+5,ivs+i*AES_BLOCK_SIZE,AES_BLOCK_SIZE);
+		rec[i] += 5+AES_BLOCK_SIZE;
+
+		memcpy(rec[i],inp+i*frag,len[i]);
+		memcpy(rec[i]+len[i],mac,SHA_DIGEST_LENGTH);
+		for (j=len[i]+SHA_DIGEST_LENGTH;j<enc_len[i];j++)
+			rec[i][j] = (unsigned char)(enc_len[i]-len[i]-SHA_DIGEST_LENGTH-1);
+
+		ret += 5+AES_BLOCK_SIZE+enc_len[i];
+		}
+
+	/* Interleaved CBC: one block of every record per ECB call */
+	blocks = enc_len[0]/AES_BLOCK_SIZE;
+	for (j=0;j<blocks*AES_BLOCK_SIZE;j+=AES_BLOCK_SIZE)
+		{
+		for (i=0;i<(size_t)x;i++)
+			for (k=0;k<AES_BLOCK_SIZE;k++)
+				blk[i*AES_BLOCK_SIZE+k] = rec[i][j+k]^rec[i][j+k-AES_BLOCK_SIZE];
+
+		aesni_ecb_encrypt(blk,blk,x*AES_BLOCK_SIZE,&key->ks,1);
+
+		for (i=0;i<(size_t)x;i++)
+			memcpy(rec[i]+j,blk+i*AES_BLOCK_SIZE,AES_BLOCK_SIZE);
+		}
+
+	/* The last record might be longer than the rest */
+	if (enc_len[x-1]>j)
+		{
+		last_block = rec[x-1]+j-AES_BLOCK_SIZE;
+		memcpy(blk,last_block,AES_BLOCK_SIZE);
+		aesni_cbc_encrypt(rec[x-1]+j,rec[x-1]+j,enc_len[x-1]-j,
+				&key->ks,blk,1);
+		}
+
+	OPENSSL_cleanse(sctx,sizeof(sctx));
+	OPENSSL_cleanse(blk,sizeof(blk));
+
+	return ret;
+	}
+#endif
+
 static int aesni_cbc_hmac_sha1_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg, void *ptr)
 	{
 	EVP_AES_HMAC_SHA1 *key = data(ctx);
@@ -513,11 +767,52 @@ static int aesni_cbc_hmac_sha1_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg, void
 			return SHA_DIGEST_LENGTH;
 			}
 		}
+#ifdef MULTIBLOCK
+	case EVP_CTRL_TLS1_1_MULTIBLOCK_MAX_BUFSIZE:
+		return (int)tls1_1_multi_block_bufsize(arg,arg,1);
+
+	case EVP_CTRL_TLS1_1_MULTIBLOCK_AAD:
+		{
+		EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM *param = ptr;
+		unsigned int x = param->interleave;
+		size_t frag;
+
+		if (!ctx->encrypt || (x!=4 && x!=8) ||
+		    arg<(int)sizeof(*param) || param->len<4*x*SHA_CBLOCK)
+			return -1;
+
+		if ((param->inp[9]<<8|param->inp[10]) < TLS1_1_VERSION)
+			return -1;
+
+		/* sequence number, type and version */
+		memcpy(key->aux.tls_aad,param->inp,11);
+
+		frag = param->len/x;
+		return (int)tls1_1_multi_block_bufsize(frag,param->len-frag*(x-1),x);
+		}
+
+	case EVP_CTRL_TLS1_1_MULTIBLOCK_ENCRYPT:
+		{
+		EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM *param = ptr;
+
+		if (arg<(int)sizeof(*param))
+			return -1;
+
+		return (int)tls1_1_multi_block_encrypt(key,param->out,
+				param->inp,param->len,param->interleave);
+		}
+#endif
 	default:
 		return -1;
 		}
 	}
 
+#ifdef MULTIBLOCK
+#define MULTIBLOCK_FLAG	EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
+#else
+#define MULTIBLOCK_FLAG	0
+#endif
+
 static EVP_CIPHER aesni_128_cbc_hmac_sha1_cipher =
 	{
 #ifdef NID_aes_128_cbc_hmac_sha1
@@ -526,7 +821,8 @@ static EVP_CIPHER aesni_128_cbc_hmac_sha1_cipher =
 	NID_undef,
 #endif
 	16,16,16,
-	EVP_CIPH_CBC_MODE|EVP_CIPH_FLAG_DEFAULT_ASN1|EVP_CIPH_FLAG_AEAD_CIPHER,
+	EVP_CIPH_CBC_MODE|EVP_CIPH_FLAG_DEFAULT_ASN1|EVP_CIPH_FLAG_AEAD_CIPHER|
+	MULTIBLOCK_FLAG,
 	aesni_cbc_hmac_sha1_init_key,
 	aesni_cbc_hmac_sha1_cipher,
 	NULL,
@@ -545,7 +841,8 @@ static EVP_CIPHER aesni_256_cbc_hmac_sha1_cipher =
 	NID_undef,
 #endif
 	16,32,16,
-	EVP_CIPH_CBC_MODE|EVP_CIPH_FLAG_DEFAULT_ASN1|EVP_CIPH_FLAG_AEAD_CIPHER,
+	EVP_CIPH_CBC_MODE|EVP_CIPH_FLAG_DEFAULT_ASN1|EVP_CIPH_FLAG_AEAD_CIPHER|
+	MULTIBLOCK_FLAG,
 	aesni_cbc_hmac_sha1_init_key,
 	aesni_cbc_hmac_sha1_cipher,
 	NULL,
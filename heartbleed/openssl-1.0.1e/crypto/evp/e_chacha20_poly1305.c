@@ -0,0 +1,448 @@
+/* ====================================================================
+ * Copyright (c) 2013 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+#include <openssl/opensslconf.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/crypto.h>
+#include <openssl/chacha.h>
+#include <openssl/poly1305.h>
+#include "evp_locl.h"
+
+#define CHACHA_CTR_SIZE		16
+
+typedef struct
+    {
+    unsigned char key[CHACHA_KEY_SIZE];
+    unsigned char nonce[CHACHA_NONCE_SIZE];
+    unsigned int counter;
+    unsigned char buf[CHACHA_BLOCK_SIZE];	/* leftover keystream */
+    unsigned int num;				/* bytes used from buf */
+    } EVP_CHACHA_KEY;
+
+#define data(ctx)	((EVP_CHACHA_KEY *)(ctx)->cipher_data)
+
+/* Encrypt |len| bytes as a continuation of the key stream: leftover
+ * bytes of the previous block first, then whole blocks in one call so
+ * the vectorised code paths see long inputs, then a partial block. */
+static void chacha_stream(EVP_CHACHA_KEY *key, unsigned char *out,
+			const unsigned char *in, size_t len)
+	{
+	unsigned int n = key->num;
+	size_t blocks;
+
+	if (n)
+		{
+		while (len && n < CHACHA_BLOCK_SIZE)
+			{
+			*(out++) = *(in++) ^ key->buf[n++];
+			--len;
+			}
+		key->num = n % CHACHA_BLOCK_SIZE;
+		if (len == 0)
+			return;
+		}
+
+	blocks = len / CHACHA_BLOCK_SIZE;
+	if (blocks)
+		{
+		CRYPTO_chacha_20(out, in, blocks*CHACHA_BLOCK_SIZE,
+				key->key, key->nonce, key->counter);
+		key->counter += (unsigned int)blocks;
+		out += blocks*CHACHA_BLOCK_SIZE;
+		in  += blocks*CHACHA_BLOCK_SIZE;
+		len -= blocks*CHACHA_BLOCK_SIZE;
+		}
+
+	if (len)
+		{
+		memset(key->buf, 0, sizeof(key->buf));
+		CRYPTO_chacha_20(key->buf, key->buf, sizeof(key->buf),
+				key->key, key->nonce, key->counter++);
+		for (n = 0; n < len; n++)
+			out[n] = in[n] ^ key->buf[n];
+		key->num = n;
+		}
+	}
+
+static int chacha_init_key(EVP_CIPHER_CTX *ctx, const unsigned char *key,
+			const unsigned char *iv, int enc)
+	{
+	EVP_CHACHA_KEY *ck = data(ctx);
+
+	if (key)
+		memcpy(ck->key, key, CHACHA_KEY_SIZE);
+	if (iv)
+		{
+		/* 32-bit little-endian block counter followed by the nonce,
+		 * the same layout as the RFC 7539 initial state. */
+		ck->counter = iv[0] | iv[1]<<8 | iv[2]<<16 | (unsigned int)iv[3]<<24;
+		memcpy(ck->nonce, iv+4, CHACHA_NONCE_SIZE);
+		}
+	ck->num = 0;
+	return 1;
+	}
+
+static int chacha_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
+			const unsigned char *in, size_t len)
+	{
+	chacha_stream(data(ctx), out, in, len);
+	return 1;
+	}
+
+static int chacha_cleanup(EVP_CIPHER_CTX *ctx)
+	{
+	OPENSSL_cleanse(ctx->cipher_data, sizeof(EVP_CHACHA_KEY));
+	return 1;
+	}
+
+static const EVP_CIPHER chacha20_cipher =
+	{
+	NID_chacha20,
+	1,CHACHA_KEY_SIZE,CHACHA_CTR_SIZE,
+	EVP_CIPH_STREAM_CIPHER|EVP_CIPH_ALWAYS_CALL_INIT|EVP_CIPH_CUSTOM_IV,
+	chacha_init_key,
+	chacha_cipher,
+	chacha_cleanup,
+	sizeof(EVP_CHACHA_KEY),
+	NULL,
+	NULL,
+	NULL,
+	NULL
+	};
+
+const EVP_CIPHER *EVP_chacha20(void)
+	{
+	return(&chacha20_cipher);
+	}
+
+typedef struct
+    {
+    EVP_CHACHA_KEY ks;
+    unsigned char iv[CHACHA_NONCE_SIZE];	/* fixed/initial nonce */
+    POLY1305_CTX poly;
+    unsigned char tag[POLY1305_TAG_SIZE];
+    size_t aad_len, ct_len;
+    int mac_inited, aad_done;
+    int taglen;					/* -1 if no tag set */
+    int tls_aad_len;				/* -1 if not a TLS record */
+    unsigned char tls_aad[13];
+    } EVP_CHACHA_AEAD_CTX;
+
+#define aead_data(ctx)	((EVP_CHACHA_AEAD_CTX *)(ctx)->cipher_data)
+
+static const unsigned char zero_pad[16];
+
+static void poly1305_pad16(POLY1305_CTX *poly, size_t len)
+	{
+	if (len % 16)
+		CRYPTO_poly1305_update(poly, zero_pad, 16 - len%16);
+	}
+
+static void poly1305_lengths(POLY1305_CTX *poly, size_t aad_len,
+			size_t ct_len)
+	{
+	unsigned char l[16];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		{
+		l[i]   = (unsigned char)(aad_len >> (8*i));
+		l[8+i] = (unsigned char)(ct_len >> (8*i));
+		}
+	CRYPTO_poly1305_update(poly, l, sizeof(l));
+	}
+
+/* Derive the one-time Poly1305 key from block 0 of the key stream and
+ * leave the cipher positioned at block 1, as RFC 7539 section 2.6. */
+static void chacha_poly_start(EVP_CHACHA_AEAD_CTX *actx,
+			const unsigned char *nonce)
+	{
+	unsigned char otk[CHACHA_BLOCK_SIZE];
+
+	memset(otk, 0, sizeof(otk));
+	memcpy(actx->ks.nonce, nonce, CHACHA_NONCE_SIZE);
+	CRYPTO_chacha_20(otk, otk, sizeof(otk), actx->ks.key, nonce, 0);
+	CRYPTO_poly1305_init(&actx->poly, otk);
+	OPENSSL_cleanse(otk, sizeof(otk));
+	actx->ks.counter = 1;
+	actx->ks.num = 0;
+	actx->aad_len = actx->ct_len = 0;
+	actx->aad_done = 0;
+	actx->mac_inited = 1;
+	}
+
+static int chacha_poly_init_key(EVP_CIPHER_CTX *ctx,
+			const unsigned char *key, const unsigned char *iv, int enc)
+	{
+	EVP_CHACHA_AEAD_CTX *actx = aead_data(ctx);
+
+	if (!key && !iv)
+		return 1;
+	if (key)
+		memcpy(actx->ks.key, key, CHACHA_KEY_SIZE);
+	if (iv)
+		memcpy(actx->iv, iv, CHACHA_NONCE_SIZE);
+	actx->mac_inited = 0;
+	actx->tls_aad_len = -1;
+	return 1;
+	}
+
+/* One TLS record: |in| holds the payload followed by room for (or, when
+ * decrypting, the value of) the tag. The per-record nonce is the fixed
+ * IV from the key block XORed with the 64-bit sequence number, so no
+ * explicit nonce travels on the wire. */
+static int chacha_poly_tls_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
+			const unsigned char *in, size_t len)
+	{
+	EVP_CHACHA_AEAD_CTX *actx = aead_data(ctx);
+	unsigned char nonce[CHACHA_NONCE_SIZE], tag[POLY1305_TAG_SIZE];
+	size_t plen;
+	int i, rv = -1;
+
+	if (len < POLY1305_TAG_SIZE)
+		goto err;
+	plen = len - POLY1305_TAG_SIZE;
+
+	memcpy(nonce, actx->iv, CHACHA_NONCE_SIZE);
+	for (i = 0; i < 8; i++)
+		nonce[4+i] ^= actx->tls_aad[i];
+	chacha_poly_start(actx, nonce);
+
+	CRYPTO_poly1305_update(&actx->poly, actx->tls_aad, actx->tls_aad_len);
+	poly1305_pad16(&actx->poly, actx->tls_aad_len);
+
+	if (ctx->encrypt)
+		{
+		chacha_stream(&actx->ks, out, in, plen);
+		CRYPTO_poly1305_update(&actx->poly, out, plen);
+		poly1305_pad16(&actx->poly, plen);
+		poly1305_lengths(&actx->poly, actx->tls_aad_len, plen);
+		CRYPTO_poly1305_finish(&actx->poly, out + plen);
+		}
+	else
+		{
+		CRYPTO_poly1305_update(&actx->poly, in, plen);
+		poly1305_pad16(&actx->poly, plen);
+		poly1305_lengths(&actx->poly, actx->tls_aad_len, plen);
+		CRYPTO_poly1305_finish(&actx->poly, tag);
+		/* Authenticate before decrypting anything */
+		if (CRYPTO_memcmp(tag, in + plen, POLY1305_TAG_SIZE))
+			{
+			OPENSSL_cleanse(out, len);
+			goto err;
+			}
+		chacha_stream(&actx->ks, out, in, plen);
+		}
+	rv = (int)len;
+err:
+	actx->mac_inited = 0;
+	actx->tls_aad_len = -1;
+	return rv;
+	}
+
+static int chacha_poly_cipher(EVP_CIPHER_CTX *ctx, unsigned char *out,
+			const unsigned char *in, size_t len)
+	{
+	EVP_CHACHA_AEAD_CTX *actx = aead_data(ctx);
+
+	if (actx->tls_aad_len >= 0)
+		return chacha_poly_tls_cipher(ctx, out, in, len);
+
+	if (!actx->mac_inited)
+		chacha_poly_start(actx, actx->iv);
+
+	if (in)
+		{
+		if (out == NULL)
+			{
+			/* Additional data, must precede the payload */
+			if (actx->aad_done)
+				return -1;
+			CRYPTO_poly1305_update(&actx->poly, in, len);
+			actx->aad_len += len;
+			return (int)len;
+			}
+		if (!actx->aad_done)
+			{
+			poly1305_pad16(&actx->poly, actx->aad_len);
+			actx->aad_done = 1;
+			}
+		if (ctx->encrypt)
+			{
+			chacha_stream(&actx->ks, out, in, len);
+			CRYPTO_poly1305_update(&actx->poly, out, len);
+			}
+		else
+			{
+			CRYPTO_poly1305_update(&actx->poly, in, len);
+			chacha_stream(&actx->ks, out, in, len);
+			}
+		actx->ct_len += len;
+		return (int)len;
+		}
+
+	/* Final: compute and either keep or check the tag */
+	if (!actx->aad_done)
+		poly1305_pad16(&actx->poly, actx->aad_len);
+	poly1305_pad16(&actx->poly, actx->ct_len);
+	poly1305_lengths(&actx->poly, actx->aad_len, actx->ct_len);
+	actx->mac_inited = 0;
+	if (ctx->encrypt)
+		{
+		CRYPTO_poly1305_finish(&actx->poly, actx->tag);
+		actx->taglen = POLY1305_TAG_SIZE;
+		return 0;
+		}
+	CRYPTO_poly1305_finish(&actx->poly, ctx->buf);
+	if (actx->taglen != POLY1305_TAG_SIZE ||
+	    CRYPTO_memcmp(ctx->buf, actx->tag, POLY1305_TAG_SIZE))
+		return -1;
+	return 0;
+	}
+
+static int chacha_poly_ctrl(EVP_CIPHER_CTX *ctx, int type, int arg,
+			void *ptr)
+	{
+	EVP_CHACHA_AEAD_CTX *actx = aead_data(ctx);
+
+	switch (type)
+		{
+	case EVP_CTRL_INIT:
+		memset(actx, 0, sizeof(*actx));
+		actx->taglen = -1;
+		actx->tls_aad_len = -1;
+		return 1;
+
+	case EVP_CTRL_AEAD_SET_IVLEN:
+		return arg == CHACHA_NONCE_SIZE;
+
+	case EVP_CTRL_AEAD_SET_TAG:
+		if (arg != POLY1305_TAG_SIZE || ctx->encrypt)
+			return 0;
+		memcpy(actx->tag, ptr, arg);
+		actx->taglen = arg;
+		return 1;
+
+	case EVP_CTRL_AEAD_GET_TAG:
+		if (arg <= 0 || arg > POLY1305_TAG_SIZE || !ctx->encrypt ||
+		    actx->taglen < 0)
+			return 0;
+		memcpy(ptr, actx->tag, arg);
+		return 1;
+
+	case EVP_CTRL_AEAD_SET_IV_FIXED:
+		if (arg != CHACHA_NONCE_SIZE)
+			return 0;
+		memcpy(actx->iv, ptr, arg);
+		return 1;
+
+	case EVP_CTRL_AEAD_TLS1_AAD:
+		/* Save the AAD for later use */
+		if (arg != 13)
+			return 0;
+		memcpy(actx->tls_aad, ptr, arg);
+		actx->tls_aad_len = arg;
+		if (!ctx->encrypt)
+			{
+			unsigned int len =
+				actx->tls_aad[arg-2]<<8 | actx->tls_aad[arg-1];
+			/* Correct length for the tag */
+			if (len < POLY1305_TAG_SIZE)
+				return 0;
+			len -= POLY1305_TAG_SIZE;
+			actx->tls_aad[arg-2] = len>>8;
+			actx->tls_aad[arg-1] = len & 0xff;
+			}
+		/* Extra padding: tag appended to record */
+		return POLY1305_TAG_SIZE;
+
+	default:
+		return -1;
+		}
+	}
+
+static int chacha_poly_cleanup(EVP_CIPHER_CTX *ctx)
+	{
+	OPENSSL_cleanse(ctx->cipher_data, sizeof(EVP_CHACHA_AEAD_CTX));
+	return 1;
+	}
+
+#define CHACHA_POLY_FLAGS	(EVP_CIPH_STREAM_CIPHER|EVP_CIPH_FLAG_DEFAULT_ASN1 \
+		| EVP_CIPH_CUSTOM_IV | EVP_CIPH_FLAG_CUSTOM_CIPHER \
+		| EVP_CIPH_ALWAYS_CALL_INIT | EVP_CIPH_CTRL_INIT \
+		| EVP_CIPH_FLAG_AEAD_CIPHER)
+
+static const EVP_CIPHER chacha20_poly1305_cipher =
+	{
+	NID_chacha20_poly1305,
+	1,CHACHA_KEY_SIZE,CHACHA_NONCE_SIZE,
+	CHACHA_POLY_FLAGS,
+	chacha_poly_init_key,
+	chacha_poly_cipher,
+	chacha_poly_cleanup,
+	sizeof(EVP_CHACHA_AEAD_CTX),
+	NULL,
+	NULL,
+	chacha_poly_ctrl,
+	NULL
+	};
+
+const EVP_CIPHER *EVP_chacha20_poly1305(void)
+	{
+	return(&chacha20_poly1305_cipher);
+	}
+
+#endif
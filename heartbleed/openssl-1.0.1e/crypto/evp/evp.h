@@ -362,6 +362,8 @@ struct evp_cipher_st
  */
 #define 	EVP_CIPH_FLAG_CUSTOM_CIPHER	0x100000
 #define		EVP_CIPH_FLAG_AEAD_CIPHER	0x200000
+/* Cipher can encrypt several TLS 1.1+ records at once */
+#define		EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK	0x400000
 
 /* ctrl() values */
 
@@ -384,6 +386,10 @@ struct evp_cipher_st
 #define		EVP_CTRL_CCM_SET_TAG		EVP_CTRL_GCM_SET_TAG
 #define		EVP_CTRL_CCM_SET_L		0x14
 #define		EVP_CTRL_CCM_SET_MSGLEN		0x15
+#define		EVP_CTRL_AEAD_SET_IVLEN		EVP_CTRL_GCM_SET_IVLEN
+#define		EVP_CTRL_AEAD_GET_TAG		EVP_CTRL_GCM_GET_TAG
+#define		EVP_CTRL_AEAD_SET_TAG		EVP_CTRL_GCM_SET_TAG
+#define		EVP_CTRL_AEAD_SET_IV_FIXED	EVP_CTRL_GCM_SET_IV_FIXED
 /* AEAD cipher deduces payload length and returns number of bytes
  * required to store MAC and eventual padding. Subsequent call to
  * EVP_Cipher even appends/verifies MAC.
@@ -393,6 +399,19 @@ struct evp_cipher_st
 #define		EVP_CTRL_AEAD_SET_MAC_KEY	0x17
 /* Set the GCM invocation field, decrypt only */
 #define		EVP_CTRL_GCM_SET_IV_INV		0x18
+/* Multi-block TLS 1.1+ record encryption, see
+ * EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM below.
+ */
+#define		EVP_CTRL_TLS1_1_MULTIBLOCK_AAD	0x19
+#define		EVP_CTRL_TLS1_1_MULTIBLOCK_ENCRYPT	0x1a
+#define		EVP_CTRL_TLS1_1_MULTIBLOCK_MAX_BUFSIZE	0x1b
+
+typedef struct {
+	unsigned char *out;
+	const unsigned char *inp;
+	size_t len;
+	unsigned int interleave;
+} EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM;
 
 /* GCM TLS constants */
 /* Length of fixed part of IV derived from PRF */
@@ -848,6 +867,10 @@ const EVP_CIPHER *EVP_seed_cfb128(void);
 # define EVP_seed_cfb EVP_seed_cfb128
 const EVP_CIPHER *EVP_seed_ofb(void);
 #endif
+#if !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+const EVP_CIPHER *EVP_chacha20(void);
+const EVP_CIPHER *EVP_chacha20_poly1305(void);
+#endif
 
 void OPENSSL_add_all_algorithms_noconf(void);
 void OPENSSL_add_all_algorithms_conf(void);
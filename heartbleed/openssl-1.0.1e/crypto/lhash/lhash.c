@@ -107,6 +107,15 @@ const char lh_version[]="lhash" OPENSSL_VERSION_PTEXT;
 #define UP_LOAD		(2*LH_LOAD_MULT) /* load times 256  (default 2) */
 #define DOWN_LOAD	(LH_LOAD_MULT)   /* load times 256  (default 1) */
 
+/* lh_retrieve() is called under read locks (the session cache, the
+ * error string tables), so several threads may bump its statistics at
+ * once. */
+#if defined(__GNUC__)
+#define LH_STAT_INC(x)	((void)__sync_fetch_and_add(&(x),1))
+#else
+#define LH_STAT_INC(x)	((x)++)
+#endif
+
 static void expand(_LHASH *lh);
 static void contract(_LHASH *lh);
 static LHASH_NODE **getrn(_LHASH *lh, const void *data, unsigned long *rhash);
@@ -251,18 +260,20 @@ void *lh_retrieve(_LHASH *lh, const void *data)
 	LHASH_NODE **rn;
 	void *ret;
 
-	lh->error=0;
+	/* Only writers set it, so readers need not store to it */
+	if (lh->error)
+		lh->error=0;
 	rn=getrn(lh,data,&hash);
 
 	if (*rn == NULL)
 		{
-		lh->num_retrieve_miss++;
+		LH_STAT_INC(lh->num_retrieve_miss);
 		return(NULL);
 		}
 	else
 		{
 		ret= (*rn)->data;
-		lh->num_retrieve++;
+		LH_STAT_INC(lh->num_retrieve);
 		}
 	return(ret);
 	}
@@ -409,7 +420,7 @@ static LHASH_NODE **getrn(_LHASH *lh, const void *data, unsigned long *rhash)
 	LHASH_COMP_FN_TYPE cf;
 
 	hash=(*(lh->hash))(data);
-	lh->num_hash_calls++;
+	LH_STAT_INC(lh->num_hash_calls);
 	*rhash=hash;
 
 	nn=hash%lh->pmax;
@@ -421,14 +432,14 @@ static LHASH_NODE **getrn(_LHASH *lh, const void *data, unsigned long *rhash)
 	for (n1= *ret; n1 != NULL; n1=n1->next)
 		{
 #ifndef OPENSSL_NO_HASH_COMP
-		lh->num_hash_comps++;
+		LH_STAT_INC(lh->num_hash_comps);
 		if (n1->hash != hash)
 			{
 			ret= &(n1->next);
 			continue;
 			}
 #endif
-		lh->num_comp_calls++;
+		LH_STAT_INC(lh->num_comp_calls);
 		if(cf(n1->data,data) == 0)
 			break;
 		ret= &(n1->next);
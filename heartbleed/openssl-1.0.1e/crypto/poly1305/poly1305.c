@@ -0,0 +1,418 @@
+/* crypto/poly1305/poly1305.c */
+/* ====================================================================
+ * Copyright (c) 2013 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/*
+ * Poly1305 as specified in RFC 7539, with the 130-bit accumulator kept
+ * in five 26-bit limbs so that all products fit in 64 bits. The
+ * portable code hashes one 16-byte block at a time. On x86 processors
+ * long inputs are hashed 2 (SSE2) or 4 (AVX2) blocks at a time, lane j
+ * accumulating blocks j, j+n, j+2n... multiplied by r^n, with a final
+ * multiplication by r^(n-j) that lines the lanes up again.
+ */
+
+#include <string.h>
+#include <openssl/opensslconf.h>
+#include <openssl/crypto.h>
+
+#ifndef OPENSSL_NO_POLY1305
+
+#include <openssl/poly1305.h>
+
+typedef unsigned int u32;
+typedef unsigned long long u64;
+
+#define U8TO32_LITTLE(p) \
+	(((u32)((p)[0])      ) | ((u32)((p)[1]) <<  8) | \
+	 ((u32)((p)[2]) << 16) | ((u32)((p)[3]) << 24)   )
+
+#define U32TO8_LITTLE(p, v) \
+	{ (p)[0] = (unsigned char)((v)      ); \
+	  (p)[1] = (unsigned char)((v) >>  8); \
+	  (p)[2] = (unsigned char)((v) >> 16); \
+	  (p)[3] = (unsigned char)((v) >> 24); }
+
+#define MASK26	0x3ffffff
+
+/* poly1305_mul sets |out| to |a|*|b| mod 2^130-5, partially reduced. */
+static void poly1305_mul(u32 out[5], const u32 a[5], const u32 b[5])
+	{
+	u32 s1 = b[1] * 5, s2 = b[2] * 5, s3 = b[3] * 5, s4 = b[4] * 5;
+	u64 d0, d1, d2, d3, d4;
+	u32 c;
+
+	d0 = (u64)a[0]*b[0] + (u64)a[1]*s4 + (u64)a[2]*s3 + (u64)a[3]*s2 + (u64)a[4]*s1;
+	d1 = (u64)a[0]*b[1] + (u64)a[1]*b[0] + (u64)a[2]*s4 + (u64)a[3]*s3 + (u64)a[4]*s2;
+	d2 = (u64)a[0]*b[2] + (u64)a[1]*b[1] + (u64)a[2]*b[0] + (u64)a[3]*s4 + (u64)a[4]*s3;
+	d3 = (u64)a[0]*b[3] + (u64)a[1]*b[2] + (u64)a[2]*b[1] + (u64)a[3]*b[0] + (u64)a[4]*s4;
+	d4 = (u64)a[0]*b[4] + (u64)a[1]*b[3] + (u64)a[2]*b[2] + (u64)a[3]*b[1] + (u64)a[4]*b[0];
+
+	               c = (u32)(d0 >> 26); out[0] = (u32)d0 & MASK26;
+	d1 += c;       c = (u32)(d1 >> 26); out[1] = (u32)d1 & MASK26;
+	d2 += c;       c = (u32)(d2 >> 26); out[2] = (u32)d2 & MASK26;
+	d3 += c;       c = (u32)(d3 >> 26); out[3] = (u32)d3 & MASK26;
+	d4 += c;       c = (u32)(d4 >> 26); out[4] = (u32)d4 & MASK26;
+	out[0] += c * 5; c = out[0] >> 26;  out[0] &= MASK26;
+	out[1] += c;
+	}
+
+/* poly1305_blocks hashes |len| bytes, a multiple of 16. |hibit| is the
+ * 2^128 bit of each block, i.e. 1<<24 for all but a padded last one. */
+static void poly1305_blocks(POLY1305_CTX *ctx, const unsigned char *m,
+		size_t len, u32 hibit)
+	{
+	const u32 r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2],
+		  r3 = ctx->r[3], r4 = ctx->r[4];
+	const u32 s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	u32 h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2],
+	    h3 = ctx->h[3], h4 = ctx->h[4];
+	u64 d0, d1, d2, d3, d4;
+	u32 c;
+
+	for (; len >= 16; len -= 16, m += 16)
+		{
+		h0 += (U8TO32_LITTLE(m +  0)     ) & MASK26;
+		h1 += (U8TO32_LITTLE(m +  3) >> 2) & MASK26;
+		h2 += (U8TO32_LITTLE(m +  6) >> 4) & MASK26;
+		h3 += (U8TO32_LITTLE(m +  9) >> 6) & MASK26;
+		h4 += (U8TO32_LITTLE(m + 12) >> 8) | hibit;
+
+		d0 = (u64)h0*r0 + (u64)h1*s4 + (u64)h2*s3 + (u64)h3*s2 + (u64)h4*s1;
+		d1 = (u64)h0*r1 + (u64)h1*r0 + (u64)h2*s4 + (u64)h3*s3 + (u64)h4*s2;
+		d2 = (u64)h0*r2 + (u64)h1*r1 + (u64)h2*r0 + (u64)h3*s4 + (u64)h4*s3;
+		d3 = (u64)h0*r3 + (u64)h1*r2 + (u64)h2*r1 + (u64)h3*r0 + (u64)h4*s4;
+		d4 = (u64)h0*r4 + (u64)h1*r3 + (u64)h2*r2 + (u64)h3*r1 + (u64)h4*r0;
+
+		           c = (u32)(d0 >> 26); h0 = (u32)d0 & MASK26;
+		d1 += c;   c = (u32)(d1 >> 26); h1 = (u32)d1 & MASK26;
+		d2 += c;   c = (u32)(d2 >> 26); h2 = (u32)d2 & MASK26;
+		d3 += c;   c = (u32)(d3 >> 26); h3 = (u32)d3 & MASK26;
+		d4 += c;   c = (u32)(d4 >> 26); h4 = (u32)d4 & MASK26;
+		h0 += c * 5; c = h0 >> 26;      h0 &= MASK26;
+		h1 += c;
+		}
+
+	ctx->h[0] = h0;
+	ctx->h[1] = h1;
+	ctx->h[2] = h2;
+	ctx->h[3] = h3;
+	ctx->h[4] = h4;
+	}
+
+#if !defined(OPENSSL_NO_ASM) && !defined(PEDANTIC) && \
+	defined(__GNUC__) && (__GNUC__>4 || (__GNUC__==4 && __GNUC_MINOR__>=8)) && \
+	(defined(__i386) || defined(__i386__) || \
+	 defined(__x86_64) || defined(__x86_64__))
+# define POLY1305_VEC
+
+extern unsigned int OPENSSL_ia32cap_P[];
+#define SSE2_CAPABLE	(OPENSSL_ia32cap_P[0]&(1<<26))
+#define AVX2_CAPABLE	(OPENSSL_ia32cap_P[2]&(1<<5))
+
+typedef int       i32x4 __attribute__((vector_size(16)));
+typedef int       i32x8 __attribute__((vector_size(32)));
+typedef long long i64x2 __attribute__((vector_size(16)));
+typedef long long i64x4 __attribute__((vector_size(32)));
+typedef u64       u64x2 __attribute__((vector_size(16)));
+typedef u64       u64x4 __attribute__((vector_size(32)));
+
+/* Limbs are kept below 2^32 in 64-bit lanes, so that pmuludq, which
+ * multiplies the low halves of the lanes, yields the full products. */
+#define MUL2(a, b)	((u64x2)__builtin_ia32_pmuludq128((i32x4)(a), (i32x4)(b)))
+#define MUL4(a, b)	((u64x4)__builtin_ia32_pmuludq256((i32x8)(a), (i32x8)(b)))
+
+/*
+ * POLY1305_VEC_BLOCKS hashes |len| bytes, a multiple of 16*N, N blocks
+ * at a time with vectors of type VT. Q0 and Q1 select the low and the
+ * high 64-bit halves of N consecutive blocks from two vector loads.
+ */
+#define POLY1305_VEC_BLOCKS(VT, N, MUL, Q0, Q1) \
+	u32 (*pw[4])[5]; \
+	VT rn[9], rf[9], *R; \
+	VT h0, h1, h2, h3, h4, d0, d1, d2, d3, d4, c, p0, p1, q0, q1; \
+	const VT mask = (VT){} + MASK26, hibit = (VT){} + (1<<24); \
+	u32 t[5]; \
+	int i, j; \
+	\
+	pw[0] = &ctx->r; \
+	pw[1] = &ctx->rpow[0]; \
+	pw[2] = &ctx->rpow[1]; \
+	pw[3] = &ctx->rpow[2]; \
+	for (j = 0; j < N; j++) \
+		{ \
+		/* rn: r^N in all lanes, rf: r^(N-j) in lane j */ \
+		for (i = 0; i < 5; i++) \
+			{ \
+			rn[i][j] = (*pw[N-1])[i]; \
+			rf[i][j] = (*pw[N-1-j])[i]; \
+			} \
+		for (i = 1; i < 5; i++) \
+			{ \
+			rn[4+i][j] = rn[i][j] * 5; \
+			rf[4+i][j] = rf[i][j] * 5; \
+			} \
+		} \
+	h0 = h1 = h2 = h3 = h4 = (VT){}; \
+	h0[0] = ctx->h[0]; h1[0] = ctx->h[1]; h2[0] = ctx->h[2]; \
+	h3[0] = ctx->h[3]; h4[0] = ctx->h[4]; \
+	\
+	for (; len; len -= 16*N, m += 16*N) \
+		{ \
+		memcpy(&p0, m, sizeof(VT)); \
+		memcpy(&p1, m + sizeof(VT), sizeof(VT)); \
+		q0 = __builtin_shuffle(p0, p1, Q0); \
+		q1 = __builtin_shuffle(p0, p1, Q1); \
+		h0 += q0 & mask; \
+		h1 += (q0 >> 26) & mask; \
+		h2 += ((q0 >> 52) | (q1 << 12)) & mask; \
+		h3 += (q1 >> 14) & mask; \
+		h4 += (q1 >> 40) | hibit; \
+		\
+		R = len == 16*N ? rf : rn; \
+		d0 = MUL(h0,R[0]) + MUL(h1,R[8]) + MUL(h2,R[7]) + MUL(h3,R[6]) + MUL(h4,R[5]); \
+		d1 = MUL(h0,R[1]) + MUL(h1,R[0]) + MUL(h2,R[8]) + MUL(h3,R[7]) + MUL(h4,R[6]); \
+		d2 = MUL(h0,R[2]) + MUL(h1,R[1]) + MUL(h2,R[0]) + MUL(h3,R[8]) + MUL(h4,R[7]); \
+		d3 = MUL(h0,R[3]) + MUL(h1,R[2]) + MUL(h2,R[1]) + MUL(h3,R[0]) + MUL(h4,R[8]); \
+		d4 = MUL(h0,R[4]) + MUL(h1,R[3]) + MUL(h2,R[2]) + MUL(h3,R[1]) + MUL(h4,R[0]); \
+		\
+		           c = d0 >> 26; h0 = d0 & mask; \
+		d1 += c;   c = d1 >> 26; h1 = d1 & mask; \
+		d2 += c;   c = d2 >> 26; h2 = d2 & mask; \
+		d3 += c;   c = d3 >> 26; h3 = d3 & mask; \
+		d4 += c;   c = d4 >> 26; h4 = d4 & mask; \
+		h0 += c + (c << 2); c = h0 >> 26; h0 &= mask; \
+		h1 += c; \
+		} \
+	\
+	/* add up the lanes and reduce */ \
+	for (i = 0; i < 5; i++) \
+		t[i] = 0; \
+	for (j = 0; j < N; j++) \
+		{ \
+		t[0] += (u32)h0[j]; t[1] += (u32)h1[j]; t[2] += (u32)h2[j]; \
+		t[3] += (u32)h3[j]; t[4] += (u32)h4[j]; \
+		} \
+	for (i = 0; i < 4; i++) \
+		{ \
+		t[i+1] += t[i] >> 26; \
+		t[i] &= MASK26; \
+		} \
+	t[0] += (t[4] >> 26) * 5; \
+	t[4] &= MASK26; \
+	t[1] += t[0] >> 26; \
+	t[0] &= MASK26; \
+	for (i = 0; i < 5; i++) \
+		ctx->h[i] = t[i];
+
+__attribute__((target("sse2")))
+static void poly1305_blocks_2x(POLY1305_CTX *ctx, const unsigned char *m,
+		size_t len)
+	{
+	POLY1305_VEC_BLOCKS(u64x2, 2, MUL2,
+			((u64x2){0,2}), ((u64x2){1,3}))
+	}
+
+__attribute__((target("avx2")))
+static void poly1305_blocks_4x(POLY1305_CTX *ctx, const unsigned char *m,
+		size_t len)
+	{
+	POLY1305_VEC_BLOCKS(u64x4, 4, MUL4,
+			((u64x4){0,2,4,6}), ((u64x4){1,3,5,7}))
+	}
+#endif
+
+/* poly1305_bulk hashes |len| bytes of full blocks. */
+static void poly1305_bulk(POLY1305_CTX *ctx, const unsigned char *m,
+		size_t len)
+	{
+#ifdef POLY1305_VEC
+	size_t todo;
+
+	if (len >= 256 && AVX2_CAPABLE)
+		{
+		todo = len & ~(size_t)63;
+		poly1305_blocks_4x(ctx, m, todo);
+		m += todo;
+		len -= todo;
+		}
+	if (len >= 128 && SSE2_CAPABLE)
+		{
+		todo = len & ~(size_t)31;
+		poly1305_blocks_2x(ctx, m, todo);
+		m += todo;
+		len -= todo;
+		}
+#endif
+	poly1305_blocks(ctx, m, len, 1 << 24);
+	}
+
+void CRYPTO_poly1305_init(POLY1305_CTX *ctx,
+			  const unsigned char key[POLY1305_KEY_SIZE])
+	{
+	/* r &= 0xffffffc0ffffffc0ffffffc0fffffff */
+	ctx->r[0] = (U8TO32_LITTLE(key +  0)     ) & 0x3ffffff;
+	ctx->r[1] = (U8TO32_LITTLE(key +  3) >> 2) & 0x3ffff03;
+	ctx->r[2] = (U8TO32_LITTLE(key +  6) >> 4) & 0x3ffc0ff;
+	ctx->r[3] = (U8TO32_LITTLE(key +  9) >> 6) & 0x3f03fff;
+	ctx->r[4] = (U8TO32_LITTLE(key + 12) >> 8) & 0x00fffff;
+
+	/* powers of r for the vector code */
+	poly1305_mul(ctx->rpow[0], ctx->r, ctx->r);
+	poly1305_mul(ctx->rpow[1], ctx->rpow[0], ctx->r);
+	poly1305_mul(ctx->rpow[2], ctx->rpow[1], ctx->r);
+
+	memset(ctx->h, 0, sizeof(ctx->h));
+
+	ctx->pad[0] = U8TO32_LITTLE(key + 16);
+	ctx->pad[1] = U8TO32_LITTLE(key + 20);
+	ctx->pad[2] = U8TO32_LITTLE(key + 24);
+	ctx->pad[3] = U8TO32_LITTLE(key + 28);
+
+	ctx->num = 0;
+	}
+
+void CRYPTO_poly1305_update(POLY1305_CTX *ctx,
+			    const unsigned char *in, size_t len)
+	{
+	size_t todo;
+
+	if (ctx->num)
+		{
+		todo = 16 - ctx->num;
+		if (todo > len)
+			todo = len;
+		memcpy(ctx->data + ctx->num, in, todo);
+		ctx->num += todo;
+		in += todo;
+		len -= todo;
+		if (ctx->num < 16)
+			return;
+		poly1305_blocks(ctx, ctx->data, 16, 1 << 24);
+		ctx->num = 0;
+		}
+
+	todo = len & ~(size_t)15;
+	if (todo)
+		{
+		poly1305_bulk(ctx, in, todo);
+		in += todo;
+		len -= todo;
+		}
+
+	if (len)
+		{
+		memcpy(ctx->data, in, len);
+		ctx->num = len;
+		}
+	}
+
+void CRYPTO_poly1305_finish(POLY1305_CTX *ctx,
+			    unsigned char mac[POLY1305_TAG_SIZE])
+	{
+	u32 h0, h1, h2, h3, h4, c;
+	u32 g0, g1, g2, g3, g4, mask;
+	u64 f;
+
+	/* pad a partial block with a one and zeros, no 2^128 bit */
+	if (ctx->num)
+		{
+		ctx->data[ctx->num] = 1;
+		memset(ctx->data + ctx->num + 1, 0, 15 - ctx->num);
+		poly1305_blocks(ctx, ctx->data, 16, 0);
+		}
+
+	/* fully carry h */
+	h0 = ctx->h[0];
+	h1 = ctx->h[1];
+	h2 = ctx->h[2];
+	h3 = ctx->h[3];
+	h4 = ctx->h[4];
+
+	             c = h1 >> 26; h1 &= MASK26;
+	h2 += c;     c = h2 >> 26; h2 &= MASK26;
+	h3 += c;     c = h3 >> 26; h3 &= MASK26;
+	h4 += c;     c = h4 >> 26; h4 &= MASK26;
+	h0 += c * 5; c = h0 >> 26; h0 &= MASK26;
+	h1 += c;
+
+	/* compute h + -p */
+	g0 = h0 + 5; c = g0 >> 26; g0 &= MASK26;
+	g1 = h1 + c; c = g1 >> 26; g1 &= MASK26;
+	g2 = h2 + c; c = g2 >> 26; g2 &= MASK26;
+	g3 = h3 + c; c = g3 >> 26; g3 &= MASK26;
+	g4 = h4 + c - (1 << 26);
+
+	/* select h if h < p, or h + -p if h >= p, in constant time */
+	mask = (g4 >> 31) - 1;
+	g0 &= mask;
+	g1 &= mask;
+	g2 &= mask;
+	g3 &= mask;
+	g4 &= mask;
+	mask = ~mask;
+	h0 = (h0 & mask) | g0;
+	h1 = (h1 & mask) | g1;
+	h2 = (h2 & mask) | g2;
+	h3 = (h3 & mask) | g3;
+	h4 = (h4 & mask) | g4;
+
+	/* mac = (h + s) % 2^128, h is converted to radix 2^32 on the way */
+	f = (u64)h0 + ((u64)h1 << 26) + ctx->pad[0];
+	U32TO8_LITTLE(mac +  0, (u32)f);
+	f = (f >> 32) + ((u64)h2 << 20) + ctx->pad[1];
+	U32TO8_LITTLE(mac +  4, (u32)f);
+	f = (f >> 32) + ((u64)h3 << 14) + ctx->pad[2];
+	U32TO8_LITTLE(mac +  8, (u32)f);
+	f = (f >> 32) + ((u64)h4 <<  8) + ctx->pad[3];
+	U32TO8_LITTLE(mac + 12, (u32)f);
+
+	OPENSSL_cleanse(ctx, sizeof(*ctx));
+	}
+
+#endif  /* !OPENSSL_NO_POLY1305 */
@@ -0,0 +1,98 @@
+/* crypto/poly1305/poly1305.h */
+/* ====================================================================
+ * Copyright (c) 2013 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+#ifndef HEADER_POLY1305_H
+#define HEADER_POLY1305_H
+
+#include <openssl/opensslconf.h>
+
+#if defined(OPENSSL_NO_POLY1305)
+#error Poly1305 support is disabled.
+#endif
+
+#include <stddef.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#define POLY1305_KEY_SIZE	32
+#define POLY1305_TAG_SIZE	16
+
+typedef struct poly1305_context_st
+	{
+	unsigned int r[5];		/* key r, radix 2^26 */
+	unsigned int rpow[3][5];	/* r^2, r^3, r^4 */
+	unsigned int h[5];		/* accumulator, radix 2^26 */
+	unsigned int pad[4];		/* key s */
+	size_t num;
+	unsigned char data[16];
+	} POLY1305_CTX;
+
+/* CRYPTO_poly1305_init sets up |ctx| to compute a Poly1305 tag with the
+ * one-time key |key|: 16 bytes of r followed by 16 bytes of s. A key
+ * must never be used to authenticate more than one message. */
+void CRYPTO_poly1305_init(POLY1305_CTX *ctx,
+			  const unsigned char key[POLY1305_KEY_SIZE]);
+
+/* CRYPTO_poly1305_update feeds |len| bytes from |in| into |ctx|. */
+void CRYPTO_poly1305_update(POLY1305_CTX *ctx,
+			    const unsigned char *in, size_t len);
+
+/* CRYPTO_poly1305_finish writes the 16-byte tag to |mac| and cleanses
+ * |ctx|. */
+void CRYPTO_poly1305_finish(POLY1305_CTX *ctx,
+			    unsigned char mac[POLY1305_TAG_SIZE]);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
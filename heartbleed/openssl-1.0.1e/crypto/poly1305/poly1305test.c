@@ -0,0 +1,251 @@
+/* crypto/poly1305/poly1305test.c */
+/* ====================================================================
+ * Copyright (c) 2013 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../e_os.h"
+
+#ifdef OPENSSL_NO_POLY1305
+int main(int argc, char *argv[])
+{
+    printf("No Poly1305 support\n");
+    return(0);
+}
+#else
+#include <openssl/poly1305.h>
+
+struct poly1305_test {
+	const char *keyhex;
+	const char *msghex;
+	const char *machex;
+};
+
+/* Test vectors from RFC 7539, sections 2.5.2 and A.3 */
+static const struct poly1305_test poly1305_tests[] = {
+	{
+	"85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b",
+	"43727970746f6772617068696320466f72756d2052657365617263682047726f"
+	"7570",
+	"a8061dc1305136c6c22b8baf0c0127a9",
+	},
+	{
+	"0000000000000000000000000000000000000000000000000000000000000000",
+	"0000000000000000000000000000000000000000000000000000000000000000"
+	"0000000000000000000000000000000000000000000000000000000000000000",
+	"00000000000000000000000000000000",
+	},
+	{
+	"0000000000000000000000000000000036e5f6b5c5e06070f0efca96227a863e",
+	"416e79207375626d697373696f6e20746f20746865204945544620696e74656e"
+	"6465642062792074686520436f6e7472696275746f7220666f72207075626c69"
+	"636174696f6e20617320616c6c206f722070617274206f6620616e2049455446"
+	"20496e7465726e65742d4472616674206f722052464320616e6420616e792073"
+	"746174656d656e74206d6164652077697468696e2074686520636f6e74657874"
+	"206f6620616e204945544620616374697669747920697320636f6e7369646572"
+	"656420616e20224945544620436f6e747269627574696f6e222e205375636820"
+	"73746174656d656e747320696e636c756465206f72616c2073746174656d656e"
+	"747320696e20494554462073657373696f6e732c2061732077656c6c20617320"
+	"7772697474656e20616e6420656c656374726f6e696320636f6d6d756e696361"
+	"74696f6e73206d61646520617420616e792074696d65206f7220706c6163652c"
+	"207768696368206172652061646472657373656420746f",
+	"36e5f6b5c5e06070f0efca96227a863e",
+	},
+	{
+	"0200000000000000000000000000000000000000000000000000000000000000",
+	"ffffffffffffffffffffffffffffffff",
+	"03000000000000000000000000000000",
+	},
+	{
+	"02000000000000000000000000000000ffffffffffffffffffffffffffffffff",
+	"02000000000000000000000000000000",
+	"03000000000000000000000000000000",
+	},
+	{
+	"0100000000000000000000000000000000000000000000000000000000000000",
+	"fffffffffffffffffffffffffffffffff0ffffffffffffffffffffffffffffff"
+	"11000000000000000000000000000000",
+	"05000000000000000000000000000000",
+	},
+	{
+	"0100000000000000000000000000000000000000000000000000000000000000",
+	"fffffffffffffffffffffffffffffffffbfefefefefefefefefefefefefefefe"
+	"01010101010101010101010101010101",
+	"00000000000000000000000000000000",
+	},
+	{
+	"0200000000000000000000000000000000000000000000000000000000000000",
+	"fdffffffffffffffffffffffffffffff",
+	"faffffffffffffffffffffffffffffff",
+	},
+	{
+	"0100000000000000040000000000000000000000000000000000000000000000",
+	"e33594d7505e43b900000000000000003394d7505e4379cd0100000000000000"
+	"0000000000000000000000000000000001000000000000000000000000000000",
+	"14000000000000005500000000000000",
+	},
+	{
+	"0100000000000000040000000000000000000000000000000000000000000000",
+	"e33594d7505e43b900000000000000003394d7505e4379cd0100000000000000"
+	"00000000000000000000000000000000",
+	"13000000000000000000000000000000",
+	},
+};
+
+static unsigned char *hex_decode(const char *hex, size_t *len)
+	{
+	size_t i, n = strlen(hex) / 2;
+	unsigned char *ret = malloc(n + 1);
+	unsigned int v;
+
+	for (i = 0; i < n; i++)
+		{
+		sscanf(hex + 2 * i, "%2x", &v);
+		ret[i] = (unsigned char)v;
+		}
+	if (len)
+		*len = n;
+	return ret;
+	}
+
+static int run_test_vector(int num, const struct poly1305_test *test)
+	{
+	unsigned char *key, *msg, *expected, mac[POLY1305_TAG_SIZE];
+	POLY1305_CTX ctx;
+	size_t len, i;
+	int ret = 1;
+
+	key = hex_decode(test->keyhex, NULL);
+	msg = hex_decode(test->msghex, &len);
+	expected = hex_decode(test->machex, NULL);
+
+	CRYPTO_poly1305_init(&ctx, key);
+	CRYPTO_poly1305_update(&ctx, msg, len);
+	CRYPTO_poly1305_finish(&ctx, mac);
+	if (memcmp(mac, expected, sizeof(mac)) != 0)
+		{
+		fprintf(stderr, "Poly1305 test #%d failed\n", num);
+		ret = 0;
+		}
+
+	/* the same, a byte at a time */
+	CRYPTO_poly1305_init(&ctx, key);
+	for (i = 0; i < len; i++)
+		CRYPTO_poly1305_update(&ctx, msg + i, 1);
+	CRYPTO_poly1305_finish(&ctx, mac);
+	if (memcmp(mac, expected, sizeof(mac)) != 0)
+		{
+		fprintf(stderr, "Poly1305 test #%d failed (bytewise)\n", num);
+		ret = 0;
+		}
+
+	free(key);
+	free(msg);
+	free(expected);
+	return ret;
+	}
+
+/* The multi-block code paths only kick in for long inputs. Check them
+ * against block-at-a-time updates, with a key that has all r bits set
+ * and a message that keeps the accumulator large. */
+static int run_length_test(void)
+	{
+	static unsigned char msg[2048];
+	unsigned char key[32], mac[16], ref[16];
+	POLY1305_CTX ctx;
+	size_t len, off;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = 0xff;
+	for (i = 0; i < sizeof(msg); i++)
+		msg[i] = (unsigned char)(0xff - (i % 7));
+
+	for (len = 0; len <= sizeof(msg); len += 1 + len / 8)
+		{
+		CRYPTO_poly1305_init(&ctx, key);
+		for (off = 0; off < len; off += 16)
+			CRYPTO_poly1305_update(&ctx, msg + off,
+				len - off < 16 ? len - off : 16);
+		CRYPTO_poly1305_finish(&ctx, ref);
+
+		CRYPTO_poly1305_init(&ctx, key);
+		CRYPTO_poly1305_update(&ctx, msg, len);
+		CRYPTO_poly1305_finish(&ctx, mac);
+		if (memcmp(mac, ref, sizeof(mac)) != 0)
+			{
+			fprintf(stderr, "Poly1305 length %lu failed\n",
+				(unsigned long)len);
+			return 0;
+			}
+		}
+	return 1;
+	}
+
+int main(int argc, char **argv)
+	{
+	unsigned int i;
+	int err = 0;
+
+	for (i = 0; i < sizeof(poly1305_tests) / sizeof(poly1305_tests[0]); i++)
+		{
+		if (!run_test_vector(i, &poly1305_tests[i]))
+			err++;
+		}
+	if (!run_length_test())
+		err++;
+
+	if (err == 0)
+		printf("Poly1305 tests passed\n");
+	EXIT(err);
+	return(err);
+	}
+#endif
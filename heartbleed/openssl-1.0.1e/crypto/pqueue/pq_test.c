@@ -57,39 +57,324 @@
  *
  */
 
-#include "pqueue.h"
+#include <time.h>
+#include <openssl/crypto.h>
+#include <openssl/pqueue.h>
 
-int
-main(void)
+/* Deterministic generator so that runs are reproducible */
+static unsigned long lcg_state = 1;
+
+static unsigned long
+lcg(void)
+	{
+	lcg_state = (lcg_state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+	return lcg_state >> 8;
+	}
+
+static void
+prio_set(unsigned char *prio64be, unsigned long hi, unsigned long lo)
+	{
+	prio64be[0] = (unsigned char)(hi >> 24);
+	prio64be[1] = (unsigned char)(hi >> 16);
+	prio64be[2] = (unsigned char)(hi >> 8);
+	prio64be[3] = (unsigned char)(hi);
+	prio64be[4] = (unsigned char)(lo >> 24);
+	prio64be[5] = (unsigned char)(lo >> 16);
+	prio64be[6] = (unsigned char)(lo >> 8);
+	prio64be[7] = (unsigned char)(lo);
+	}
+
+static unsigned long
+prio_lo(const pitem *item)
+	{
+	return ((unsigned long)item->priority[4] << 24) |
+		((unsigned long)item->priority[5] << 16) |
+		((unsigned long)item->priority[6] << 8) |
+		item->priority[7];
+	}
+
+/* Shuffle |seq| in windows of |window| entries, the way a lossy path
+ * reorders DTLS fragments. */
+static void
+shuffle_windows(unsigned long *seq, int n, int window)
+	{
+	int i, j, base;
+	unsigned long t;
+
+	for (base = 0; base < n; base += window)
+		{
+		int len = n - base < window ? n - base : window;
+
+		for (i = len - 1; i > 0; i--)
+			{
+			j = (int)(lcg() % (i + 1));
+			t = seq[base + i];
+			seq[base + i] = seq[base + j];
+			seq[base + j] = t;
+			}
+		}
+	}
+
+static int
+test_basic(void)
 	{
+	unsigned char prio[8];
 	pitem *item;
 	pqueue pq;
+	int ret = 0;
 
 	pq = pqueue_new();
 
-	item = pitem_new(3, NULL);
+	prio_set(prio, 0, 3);
+	item = pitem_new(prio, NULL);
 	pqueue_insert(pq, item);
 
-	item = pitem_new(1, NULL);
+	prio_set(prio, 0, 1);
+	item = pitem_new(prio, NULL);
 	pqueue_insert(pq, item);
 
-	item = pitem_new(2, NULL);
+	prio_set(prio, 0, 2);
+	item = pitem_new(prio, NULL);
 	pqueue_insert(pq, item);
 
-	item = pqueue_find(pq, 1);
-	fprintf(stderr, "found %ld\n", item->priority);
+	/* duplicates are refused */
+	item = pitem_new(prio, NULL);
+	if (pqueue_insert(pq, item) != NULL)
+		{
+		fprintf(stderr, "duplicate priority was inserted\n");
+		goto err;
+		}
+	pitem_free(item);
 
-	item = pqueue_find(pq, 2);
-	fprintf(stderr, "found %ld\n", item->priority);
+	prio_set(prio, 0, 1);
+	item = pqueue_find(pq, prio);
+	if (item == NULL || prio_lo(item) != 1) goto err;
+	fprintf(stderr, "found %lu\n", prio_lo(item));
 
-	item = pqueue_find(pq, 3);
-	fprintf(stderr, "found %ld\n", item ? item->priority: 0);
+	prio_set(prio, 0, 2);
+	item = pqueue_find(pq, prio);
+	if (item == NULL || prio_lo(item) != 2) goto err;
+	fprintf(stderr, "found %lu\n", prio_lo(item));
 
-	pqueue_print(pq);
+	prio_set(prio, 0, 3);
+	item = pqueue_find(pq, prio);
+	if (item == NULL || prio_lo(item) != 3) goto err;
+	fprintf(stderr, "found %lu\n", prio_lo(item));
+
+	prio_set(prio, 1, 3);
+	if (pqueue_find(pq, prio) != NULL) goto err;
 
+	if (pqueue_size(pq) != 3) goto err;
+
+	pqueue_print(pq);
+	ret = 1;
+err:
+	if (!ret)
+		fprintf(stderr, "basic test failed\n");
 	for(item = pqueue_pop(pq); item != NULL; item = pqueue_pop(pq))
 		pitem_free(item);
 
 	pqueue_free(pq);
+	return ret;
+	}
+
+/* Insert |n| priorities spread over a few epochs in random order,
+ * interleave pops with inserts, and check ordering, lookups and the
+ * count after every step. */
+static int
+test_random(int n)
+	{
+	unsigned long *seq;
+	unsigned char prio[8];
+	unsigned long expect;
+	piterator iter;
+	pitem *item, *prev;
+	pqueue pq;
+	int i, popped = 0, ret = 0;
+
+	seq = OPENSSL_malloc(n * sizeof(*seq));
+	pq = pqueue_new();
+	if (seq == NULL || pq == NULL) goto err;
+
+	for (i = 0; i < n; i++)
+		seq[i] = i;
+	shuffle_windows(seq, n, n);
+
+	for (i = 0; i < n; i++)
+		{
+		prio_set(prio, seq[i] % 3, seq[i]);
+		item = pitem_new(prio, NULL);
+		if (item == NULL || pqueue_insert(pq, item) != item)
+			{
+			fprintf(stderr, "insert %lu failed\n", seq[i]);
+			goto err;
+			}
+		}
+	if (pqueue_size(pq) != n) goto err;
+
+	for (i = 0; i < n; i++)
+		{
+		prio_set(prio, seq[i] % 3, seq[i]);
+		item = pqueue_find(pq, prio);
+		if (item == NULL || prio_lo(item) != seq[i])
+			{
+			fprintf(stderr, "find %lu failed\n", seq[i]);
+			goto err;
+			}
+		prio_set(prio, seq[i] % 3 + 3, seq[i]);
+		if (pqueue_find(pq, prio) != NULL)
+			{
+			fprintf(stderr, "found absent %lu\n", seq[i]);
+			goto err;
+			}
+		}
+
+	/* iteration follows priority order */
+	iter = pqueue_iterator(pq);
+	for (i = 0, prev = NULL; (item = pqueue_next(&iter)) != NULL; i++)
+		{
+		if (prev != NULL && memcmp(prev->priority, item->priority, 8) >= 0)
+			{
+			fprintf(stderr, "iterator out of order\n");
+			goto err;
+			}
+		prev = item;
+		}
+	if (i != n) goto err;
+
+	/* pop half, then push the popped items back as a new epoch */
+	for (i = 0; i < n / 2; i++)
+		{
+		item = pqueue_pop(pq);
+		if (item == NULL) goto err;
+		prio_set(prio, 10, prio_lo(item));
+		pitem_free(item);
+		item = pitem_new(prio, NULL);
+		if (item == NULL || pqueue_insert(pq, item) != item) goto err;
+		}
+	if (pqueue_size(pq) != n) goto err;
+
+	for (prev = NULL; (item = pqueue_pop(pq)) != NULL; popped++)
+		{
+		if (prev != NULL && memcmp(prev->priority, item->priority, 8) >= 0)
+			{
+			fprintf(stderr, "pop out of order\n");
+			goto err;
+			}
+		if (prev != NULL) pitem_free(prev);
+		prev = item;
+		if (pqueue_size(pq) != n - popped - 1) goto err;
+		}
+	if (prev != NULL) pitem_free(prev);
+	if (popped != n || pqueue_peek(pq) != NULL) goto err;
+
+	/* the queue is usable again once drained */
+	expect = 7;
+	prio_set(prio, 0, expect);
+	item = pitem_new(prio, NULL);
+	if (pqueue_insert(pq, item) != item) goto err;
+	if (pqueue_find(pq, prio) != item || pqueue_pop(pq) != item) goto err;
+	pitem_free(item);
+
+	ret = 1;
+err:
+	if (!ret)
+		fprintf(stderr, "random test failed\n");
+	if (pq != NULL)
+		{
+		while ((item = pqueue_pop(pq)) != NULL)
+			pitem_free(item);
+		pqueue_free(pq);
+		}
+	if (seq != NULL) OPENSSL_free(seq);
+	return ret;
+	}
+
+/* Reassemble |n| fragments that arrive reordered within windows of
+ * |window| with one in ten retransmitted, as dtls1_process_out_of_seq_message()
+ * and dtls1_retrieve_buffered_fragment() do: look the sequence number
+ * up, buffer it if new and drain the head while it is the next one
+ * expected. */
+static void
+bench(int n, int window)
+	{
+	unsigned long *seq, next = 0;
+	unsigned char prio[8];
+	pitem *item;
+	pqueue pq;
+	clock_t t;
+	long ops = 0;
+	int i, max = 0;
+
+	seq = OPENSSL_malloc(n * sizeof(*seq));
+	pq = pqueue_new();
+	if (seq == NULL || pq == NULL)
+		{
+		fprintf(stderr, "out of memory\n");
+		return;
+		}
+
+	for (i = 0; i < n; i++)
+		seq[i] = i;
+	shuffle_windows(seq, n, window);
+
+	t = clock();
+	for (i = 0; i < n; i++)
+		{
+		prio_set(prio, 0, seq[i]);
+		ops++;
+		if (pqueue_find(pq, prio) == NULL)
+			{
+			item = pitem_new(prio, NULL);
+			pqueue_insert(pq, item);
+			ops++;
+			}
+		if (lcg() % 10 == 0)
+			{
+			/* retransmission of something already buffered */
+			ops++;
+			pqueue_find(pq, prio);
+			}
+		if (pqueue_size(pq) > max)
+			max = pqueue_size(pq);
+
+		while ((item = pqueue_peek(pq)) != NULL && prio_lo(item) == next)
+			{
+			pitem_free(pqueue_pop(pq));
+			next++;
+			ops++;
+			}
+		}
+	t = clock() - t;
+
+	fprintf(stdout, "%d fragments, window %d, peak queue %d: "
+		"%.2f ms, %.1f ns/op\n", n, window, max,
+		(double)t * 1000 / CLOCKS_PER_SEC,
+		ops ? (double)t * 1e9 / CLOCKS_PER_SEC / ops : 0.0);
+
+	while ((item = pqueue_pop(pq)) != NULL)
+		pitem_free(item);
+	pqueue_free(pq);
+	OPENSSL_free(seq);
+	}
+
+int
+main(int argc, char *argv[])
+	{
+	if (argc > 1 && strcmp(argv[1], "-bench") == 0)
+		{
+		int n = argc > 2 ? atoi(argv[2]) : 100000;
+
+		if (n < 1) n = 1;
+		bench(n, 64);
+		bench(n, 1024);
+		bench(n, n);
+		return 0;
+		}
+
+	if (!test_basic() || !test_random(5000))
+		return 1;
+
+	fprintf(stderr, "PASS\n");
 	return 0;
 	}
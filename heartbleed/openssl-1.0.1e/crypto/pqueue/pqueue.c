@@ -61,24 +61,162 @@
 #include <openssl/bn.h>
 #include "pqueue.h"
 
+/* The queue is a skip list ordered on the 64-bit priority with a hash
+ * index on the side.  Level 0 of the skip list is the public |next|
+ * chain of pitem, so pqueue_iterator()/pqueue_next() and any code that
+ * follows item->next still see the items in priority order.  The upper
+ * levels make pqueue_insert() O(log n) when DTLS fragments and records
+ * arrive out of order, appends to the tail (the common case of in-order
+ * arrival and of buffering sent messages) are O(1) through the |last|
+ * pointers, and pqueue_find() is a hash lookup.
+ *
+ * The bookkeeping lives in a PITEM_NODE that wraps every pitem handed
+ * out by pitem_new(), so items must always come from pitem_new(). */
+
+#define PQ_MAX_LEVEL		8	/* p = 1/4, good for ~64k items */
+#define PQ_MIN_BUCKETS		16
+
+typedef struct pitem_node_st
+	{
+	pitem item;			/* must be first */
+	struct pitem_node_st *hnext;	/* hash chain */
+	unsigned int hash;
+	int level;
+	struct pitem_node_st *forward[PQ_MAX_LEVEL];	/* [0] unused */
+	} PITEM_NODE;
+
 typedef struct _pqueue
 	{
-	pitem *items;
+	PITEM_NODE *head[PQ_MAX_LEVEL];
+	PITEM_NODE *last[PQ_MAX_LEVEL];
+	int level;
 	int count;
+	PITEM_NODE **buckets;
+	unsigned int nbuckets;		/* power of two */
+	unsigned int seed;		/* level generator state */
 	} pqueue_s;
 
+#define PQ_NODE(item)	((PITEM_NODE *)(item))
+
+static PITEM_NODE *
+pq_next(PITEM_NODE *node, int l)
+	{
+	return l == 0 ? PQ_NODE(node->item.next) : node->forward[l];
+	}
+
+static void
+pq_set_next(PITEM_NODE *node, int l, PITEM_NODE *next)
+	{
+	if (l == 0)
+		node->item.next = (pitem *)next;
+	else
+		node->forward[l] = next;
+	}
+
+static unsigned int
+pq_hash(const unsigned char *prio64be)
+	{
+	unsigned int hi, lo, h;
+
+	hi = ((unsigned int)prio64be[0] << 24) | (prio64be[1] << 16) |
+		(prio64be[2] << 8) | prio64be[3];
+	lo = ((unsigned int)prio64be[4] << 24) | (prio64be[5] << 16) |
+		(prio64be[6] << 8) | prio64be[7];
+
+	h = (hi * 0x9e3779b1U) ^ lo;
+	h ^= h >> 15;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	return h & 0xffffffffU;
+	}
+
+static int
+pq_random_level(pqueue_s *pq)
+	{
+	unsigned int r;
+	int level = 1;
+
+	/* xorshift32 */
+	r = pq->seed;
+	r ^= (r << 13) & 0xffffffffU;
+	r ^= r >> 17;
+	r ^= (r << 5) & 0xffffffffU;
+	pq->seed = r;
+
+	while ((r & 3) == 0 && level < PQ_MAX_LEVEL)
+		{
+		level++;
+		r >>= 2;
+		}
+	return level;
+	}
+
+static void
+pq_hash_grow(pqueue_s *pq)
+	{
+	PITEM_NODE **nb, *node, *next;
+	unsigned int i, n = pq->nbuckets * 2;
+
+	nb = OPENSSL_malloc(n * sizeof(PITEM_NODE *));
+	/* on failure keep using the smaller table */
+	if (nb == NULL) return;
+	memset(nb, 0, n * sizeof(PITEM_NODE *));
+
+	for (i = 0; i < pq->nbuckets; i++)
+		{
+		for (node = pq->buckets[i]; node != NULL; node = next)
+			{
+			next = node->hnext;
+			node->hnext = nb[node->hash & (n - 1)];
+			nb[node->hash & (n - 1)] = node;
+			}
+		}
+
+	OPENSSL_free(pq->buckets);
+	pq->buckets = nb;
+	pq->nbuckets = n;
+	}
+
+static PITEM_NODE *
+pq_hash_find(pqueue_s *pq, const unsigned char *prio64be, unsigned int hash)
+	{
+	PITEM_NODE *node;
+
+	for (node = pq->buckets[hash & (pq->nbuckets - 1)]; node != NULL;
+		node = node->hnext)
+		{
+		if (node->hash == hash &&
+			memcmp(node->item.priority, prio64be, 8) == 0)
+			return node;
+		}
+	return NULL;
+	}
+
+static void
+pq_hash_remove(pqueue_s *pq, PITEM_NODE *node)
+	{
+	PITEM_NODE **p = &pq->buckets[node->hash & (pq->nbuckets - 1)];
+
+	while (*p != NULL && *p != node)
+		p = &(*p)->hnext;
+	if (*p != NULL)
+		*p = node->hnext;
+	node->hnext = NULL;
+	}
+
 pitem *
 pitem_new(unsigned char *prio64be, void *data)
 	{
-	pitem *item = (pitem *) OPENSSL_malloc(sizeof(pitem));
-	if (item == NULL) return NULL;
+	PITEM_NODE *node = (PITEM_NODE *) OPENSSL_malloc(sizeof(PITEM_NODE));
+	if (node == NULL) return NULL;
 
-	memcpy(item->priority,prio64be,sizeof(item->priority));
+	memset(node, 0x00, sizeof(PITEM_NODE));
+	memcpy(node->item.priority,prio64be,sizeof(node->item.priority));
 
-	item->data = data;
-	item->next = NULL;
+	node->item.data = data;
+	node->item.next = NULL;
 
-	return item;
+	return &node->item;
 	}
 
 void
@@ -86,7 +224,7 @@ pitem_free(pitem *item)
 	{
 	if (item == NULL) return;
 
-	OPENSSL_free(item);
+	OPENSSL_free(PQ_NODE(item));
 	}
 
 pqueue_s *
@@ -96,6 +234,23 @@ pqueue_new()
 	if (pq == NULL) return NULL;
 
 	memset(pq, 0x00, sizeof(pqueue_s));
+
+	pq->nbuckets = PQ_MIN_BUCKETS;
+	pq->buckets = OPENSSL_malloc(pq->nbuckets * sizeof(PITEM_NODE *));
+	if (pq->buckets == NULL)
+		{
+		OPENSSL_free(pq);
+		return NULL;
+		}
+	memset(pq->buckets, 0x00, pq->nbuckets * sizeof(PITEM_NODE *));
+
+	/* The level generator only needs to be cheap and non-zero; it
+	 * does not depend on the (peer supplied) priorities. */
+	pq->seed = (unsigned int)((size_t)pq >> 4) ^ 0x2545f491U;
+	if (pq->seed == 0)
+		pq->seed = 0x2545f491U;
+	pq->level = 1;
+
 	return pq;
 	}
 
@@ -104,45 +259,78 @@ pqueue_free(pqueue_s *pq)
 	{
 	if (pq == NULL) return;
 
+	OPENSSL_free(pq->buckets);
 	OPENSSL_free(pq);
 	}
 
 pitem *
 pqueue_insert(pqueue_s *pq, pitem *item)
 	{
-	pitem *curr, *next;
+	PITEM_NODE *node = PQ_NODE(item);
+	PITEM_NODE *update[PQ_MAX_LEVEL];
+	PITEM_NODE *x, *next;
+	int l, level;
+
+	node->hash = pq_hash(item->priority);
+
+	/* duplicates not allowed */
+	if (pq_hash_find(pq, item->priority, node->hash) != NULL)
+		return NULL;
 
-	if (pq->items == NULL)
+	memset(update, 0, sizeof(update));
+
+	/* we can compare 64-bit value in big-endian encoding
+	 * with memcmp:-) */
+	if (pq->last[0] != NULL &&
+		memcmp(pq->last[0]->item.priority, item->priority, 8) < 0)
 		{
-		pq->items = item;
-		return item;
+		/* new maximum: append after the last node of every level */
+		for (l = 0; l < pq->level; l++)
+			update[l] = pq->last[l];
 		}
-
-	for(curr = NULL, next = pq->items; 
-		next != NULL;
-		curr = next, next = next->next)
+	else
 		{
-		/* we can compare 64-bit value in big-endian encoding
-		 * with memcmp:-) */
-		int cmp = memcmp(next->priority, item->priority,8);
-		if (cmp > 0)		/* next > item */
+		for (x = NULL, l = pq->level - 1; l >= 0; l--)
 			{
-			item->next = next;
+			for (;;)
+				{
+				next = x ? pq_next(x, l) : pq->head[l];
+				if (next == NULL || memcmp(next->item.priority,
+						item->priority, 8) > 0)
+					break;
+				x = next;
+				}
+			update[l] = x;
+			}
+		}
 
-			if (curr == NULL) 
-				pq->items = item;
-			else  
-				curr->next = item;
+	level = pq_random_level(pq);
+	if (level > pq->level)
+		pq->level = level;
+	node->level = level;
 
-			return item;
+	for (l = 0; l < level; l++)
+		{
+		if (update[l] != NULL)
+			{
+			next = pq_next(update[l], l);
+			pq_set_next(update[l], l, node);
 			}
-		
-		else if (cmp == 0)	/* duplicates not allowed */
-			return NULL;
+		else
+			{
+			next = pq->head[l];
+			pq->head[l] = node;
+			}
+		pq_set_next(node, l, next);
+		if (next == NULL)
+			pq->last[l] = node;
 		}
 
-	item->next = NULL;
-	curr->next = item;
+	node->hnext = pq->buckets[node->hash & (pq->nbuckets - 1)];
+	pq->buckets[node->hash & (pq->nbuckets - 1)] = node;
+
+	if ((unsigned int)++pq->count > pq->nbuckets * 2)
+		pq_hash_grow(pq);
 
 	return item;
 	}
@@ -150,59 +338,48 @@ pqueue_insert(pqueue_s *pq, pitem *item)
 pitem *
 pqueue_peek(pqueue_s *pq)
 	{
-	return pq->items;
+	return (pitem *)pq->head[0];
 	}
 
 pitem *
 pqueue_pop(pqueue_s *pq)
 	{
-	pitem *item = pq->items;
+	PITEM_NODE *node = pq->head[0];
+	int l;
 
-	if (pq->items != NULL)
-		pq->items = pq->items->next;
+	if (node == NULL)
+		return NULL;
 
-	return item;
+	/* the smallest item is first on every level it is linked into */
+	for (l = 0; l < node->level; l++)
+		{
+		pq->head[l] = pq_next(node, l);
+		if (pq->head[l] == NULL)
+			pq->last[l] = NULL;
+		pq_set_next(node, l, NULL);
+		}
+
+	pq_hash_remove(pq, node);
+	pq->count--;
+
+	return &node->item;
 	}
 
 pitem *
 pqueue_find(pqueue_s *pq, unsigned char *prio64be)
 	{
-	pitem *next;
-	pitem *found = NULL;
-
-	if ( pq->items == NULL)
-		return NULL;
-
-	for ( next = pq->items; next->next != NULL; next = next->next)
-		{
-		if ( memcmp(next->priority, prio64be,8) == 0)
-			{
-			found = next;
-			break;
-			}
-		}
-	
-	/* check the one last node */
-	if ( memcmp(next->priority, prio64be,8) ==0)
-		found = next;
-
-	if ( ! found)
-		return NULL;
+	PITEM_NODE *found;
 
-#if 0 /* find works in peek mode */
-	if ( prev == NULL)
-		pq->items = next->next;
-	else
-		prev->next = next->next;
-#endif
+	/* find works in peek mode */
+	found = pq_hash_find(pq, prio64be, pq_hash(prio64be));
 
-	return found;
+	return found ? &found->item : NULL;
 	}
 
 void
 pqueue_print(pqueue_s *pq)
 	{
-	pitem *item = pq->items;
+	pitem *item = (pitem *)pq->head[0];
 
 	while(item != NULL)
 		{
@@ -240,13 +417,5 @@ pqueue_next(pitem **item)
 int
 pqueue_size(pqueue_s *pq)
 {
-	pitem *item = pq->items;
-	int count = 0;
-	
-	while(item != NULL)
-	{
-		count++;
-		item = item->next;
-	}
-	return count;
+	return pq->count;
 }
@@ -0,0 +1,336 @@
+/* ====================================================================
+ * Copyright (c) 2013 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/*
+ * A RAND_METHOD that gives every thread its own CTR_DRBG (NIST SP 800-90A,
+ * AES-256, no derivation function), seeded with 384 bits from the
+ * md_rand pool. The pool, and so CRYPTO_LOCK_RAND, is only used to
+ * instantiate or reseed a thread's DRBG: after a fork, after
+ * RAND_add() or RAND_seed() have added entropy, and every
+ * CTR_DRBG_RESEED_INTERVAL requests. RAND_add() calls that claim no
+ * entropy, like the time stamps added at the start of every handshake,
+ * go into the calling thread's DRBG as additional input instead.
+ *
+ * A thread's state is released with the thread without being cleansed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cryptlib.h"
+#include <openssl/rand.h>
+
+#if !defined(OPENSSL_THREAD_LOCAL) || defined(OPENSSL_NO_AES)
+
+RAND_METHOD *RAND_CTR_DRBG(void)
+	{
+	return RAND_SSLeay();
+	}
+
+#else
+
+#include <openssl/aes.h>
+#include <openssl/modes.h>
+
+#define CTR_DRBG_KEYLEN		32
+#define CTR_DRBG_SEEDLEN	(CTR_DRBG_KEYLEN+AES_BLOCK_SIZE)
+/* SP 800-90A allows far more of both */
+#define CTR_DRBG_RESEED_INTERVAL	(1<<16)
+#define CTR_DRBG_MAX_REQUEST	(1<<16)
+
+#if	defined(AES_ASM) && !defined(I386_ONLY) &&	(  \
+	((defined(__i386)	|| defined(__i386__)	|| \
+	  defined(_M_IX86)) && defined(OPENSSL_IA32_SSE2))|| \
+	defined(__x86_64)	|| defined(__x86_64__)	|| \
+	defined(_M_AMD64)	|| defined(_M_X64)	|| \
+	defined(__INTEL__)				)
+#define	AESNI_CAPABLE	(OPENSSL_ia32cap_P[1]&(1<<(57-32)))
+
+int aesni_set_encrypt_key(const unsigned char *userKey, int bits,
+			AES_KEY *key);
+void aesni_ctr32_encrypt_blocks(const unsigned char *in,
+			unsigned char *out,
+			size_t blocks,
+			const void *key,
+			const unsigned char *ivec);
+#endif
+
+typedef struct ctr_drbg_st
+	{
+	AES_KEY ks;
+	/* V+1 in the notation of SP 800-90A: the next counter block */
+	unsigned char ctr[AES_BLOCK_SIZE];
+	unsigned long requests;	/* since the last (re)seed */
+	int seed_gen;		/* drbg_seed_gen when last (re)seeded */
+#ifndef GETPID_IS_MEANINGLESS
+	pid_t pid;
+#endif
+	int aesni;
+	int instantiated;
+	int seeded;		/* from a pool that had enough entropy */
+	} CTR_DRBG;
+
+static OPENSSL_THREAD_LOCAL CTR_DRBG drbg_state;
+
+/* Bumped whenever the pool gains entropy or is cleared, to tell every
+ * thread to reseed. Only ever changed through CRYPTO_add() under
+ * CRYPTO_LOCK_RAND2: RAND_poll() calls back into ctr_drbg_rand_add()
+ * while md_rand holds CRYPTO_LOCK_RAND. */
+static int drbg_seed_gen = 0;
+
+static void ctr_drbg_rand_seed(const void *buf, int num);
+static int ctr_drbg_rand_bytes(unsigned char *buf, int num);
+static void ctr_drbg_rand_cleanup(void);
+static void ctr_drbg_rand_add(const void *buf, int num, double add_entropy);
+static int ctr_drbg_rand_pseudo_bytes(unsigned char *buf, int num);
+static int ctr_drbg_rand_status(void);
+
+static RAND_METHOD rand_ctr_drbg_meth={
+	ctr_drbg_rand_seed,
+	ctr_drbg_rand_bytes,
+	ctr_drbg_rand_cleanup,
+	ctr_drbg_rand_add,
+	ctr_drbg_rand_pseudo_bytes,
+	ctr_drbg_rand_status
+	};
+
+RAND_METHOD *RAND_CTR_DRBG(void)
+	{
+	return(&rand_ctr_drbg_meth);
+	}
+
+static void ctr_drbg_inc(unsigned char *ctr)
+	{
+	int n=AES_BLOCK_SIZE;
+
+	do	{
+		--n;
+		if (++ctr[n] != 0) return;
+		} while (n);
+	}
+
+static void ctr_drbg_set_key(CTR_DRBG *d, const unsigned char *key)
+	{
+#ifdef AESNI_CAPABLE
+	if (d->aesni)
+		aesni_set_encrypt_key(key,CTR_DRBG_KEYLEN*8,&d->ks);
+	else
+#endif
+		AES_set_encrypt_key(key,CTR_DRBG_KEYLEN*8,&d->ks);
+	}
+
+/* out = E(K,V+1) || E(K,V+2) || ..., truncated to len, and V += blocks */
+static void ctr_drbg_stream(CTR_DRBG *d, unsigned char *out, size_t len)
+	{
+	unsigned char ecount[AES_BLOCK_SIZE];
+	unsigned int num=0;
+
+	memset(out,0,len);
+#ifdef AESNI_CAPABLE
+	if (d->aesni)
+		CRYPTO_ctr128_encrypt_ctr32(out,out,len,&d->ks,d->ctr,
+			ecount,&num,(ctr128_f)aesni_ctr32_encrypt_blocks);
+	else
+#endif
+		CRYPTO_ctr128_encrypt(out,out,len,&d->ks,d->ctr,
+			ecount,&num,(block128_f)AES_encrypt);
+	if (num) OPENSSL_cleanse(ecount,sizeof(ecount));
+	}
+
+/* CTR_DRBG_Update() with optional provided_data of CTR_DRBG_SEEDLEN bytes */
+static void ctr_drbg_update(CTR_DRBG *d, const unsigned char *data)
+	{
+	unsigned char temp[CTR_DRBG_SEEDLEN];
+	int i;
+
+	ctr_drbg_stream(d,temp,sizeof(temp));
+	if (data != NULL)
+		for (i=0; i<CTR_DRBG_SEEDLEN; i++)
+			temp[i]^=data[i];
+	ctr_drbg_set_key(d,temp);
+	memcpy(d->ctr,temp+CTR_DRBG_KEYLEN,AES_BLOCK_SIZE);
+	ctr_drbg_inc(d->ctr);
+	OPENSSL_cleanse(temp,sizeof(temp));
+	}
+
+/* Additional input of any length, one CTR_DRBG_Update() per block */
+static void ctr_drbg_mix(CTR_DRBG *d, const unsigned char *in, size_t len)
+	{
+	unsigned char data[CTR_DRBG_SEEDLEN];
+	size_t j;
+
+	while (len > 0)
+		{
+		j=(len > CTR_DRBG_SEEDLEN)?CTR_DRBG_SEEDLEN:len;
+		memcpy(data,in,j);
+		memset(data+j,0,CTR_DRBG_SEEDLEN-j);
+		ctr_drbg_update(d,data);
+		in+=j;
+		len-=j;
+		}
+	OPENSSL_cleanse(data,sizeof(data));
+	}
+
+/* Instantiate or reseed from the md_rand pool. The seed is still used if
+ * the pool is short of entropy, but then the state is not marked seeded
+ * and the next request tries again. */
+static void ctr_drbg_reseed(CTR_DRBG *d, int pseudo)
+	{
+	unsigned char seed[CTR_DRBG_SEEDLEN];
+	const RAND_METHOD *pool=RAND_SSLeay();
+	int gen=drbg_seed_gen;
+	int ok;
+
+	ok=pseudo?pool->pseudorand(seed,sizeof(seed))
+		:pool->bytes(seed,sizeof(seed));
+
+	if (!d->instantiated)
+		{
+		unsigned char key[CTR_DRBG_KEYLEN];
+
+#ifdef AESNI_CAPABLE
+		d->aesni=AESNI_CAPABLE?1:0;
+#endif
+		memset(key,0,sizeof(key));
+		ctr_drbg_set_key(d,key);
+		memset(d->ctr,0,sizeof(d->ctr));
+		ctr_drbg_inc(d->ctr);
+		d->instantiated=1;
+		}
+	ctr_drbg_update(d,seed);
+	OPENSSL_cleanse(seed,sizeof(seed));
+
+	d->seeded=(ok > 0);
+	d->requests=0;
+	d->seed_gen=gen;
+#ifndef GETPID_IS_MEANINGLESS
+	d->pid=getpid();
+#endif
+	}
+
+static int ctr_drbg_generate(unsigned char *buf, int num, int pseudo)
+	{
+	CTR_DRBG *d=&drbg_state;
+	size_t j;
+
+#ifdef BN_DEBUG
+	if (rand_predictable)
+		return RAND_SSLeay()->bytes(buf,num);
+#endif
+	if (num <= 0)
+		return 1;
+
+	if (!d->seeded || d->seed_gen != drbg_seed_gen
+#ifndef GETPID_IS_MEANINGLESS
+	    || d->pid != getpid()
+#endif
+	    || d->requests >= CTR_DRBG_RESEED_INTERVAL)
+		{
+		ctr_drbg_reseed(d,pseudo);
+		/* the pool has already raised RAND_R_PRNG_NOT_SEEDED */
+		if (!d->seeded && !pseudo)
+			return 0;
+		}
+
+	while (num > 0)
+		{
+		j=(num > CTR_DRBG_MAX_REQUEST)?CTR_DRBG_MAX_REQUEST:num;
+		ctr_drbg_stream(d,buf,j);
+		ctr_drbg_update(d,NULL);
+		d->requests++;
+		buf+=j;
+		num-=j;
+		}
+	return d->seeded;
+	}
+
+static int ctr_drbg_rand_bytes(unsigned char *buf, int num)
+	{
+	return ctr_drbg_generate(buf,num,0);
+	}
+
+static int ctr_drbg_rand_pseudo_bytes(unsigned char *buf, int num)
+	{
+	return ctr_drbg_generate(buf,num,1);
+	}
+
+static void ctr_drbg_rand_add(const void *buf, int num, double add)
+	{
+	CTR_DRBG *d=&drbg_state;
+
+	if (num <= 0)
+		return;
+	if (add <= 0 && d->seeded)
+		{
+		ctr_drbg_mix(d,buf,num);
+		return;
+		}
+	RAND_SSLeay()->add(buf,num,add);
+	CRYPTO_add(&drbg_seed_gen,1,CRYPTO_LOCK_RAND2);
+	}
+
+static void ctr_drbg_rand_seed(const void *buf, int num)
+	{
+	ctr_drbg_rand_add(buf,num,(double)num);
+	}
+
+static void ctr_drbg_rand_cleanup(void)
+	{
+	RAND_SSLeay()->cleanup();
+	OPENSSL_cleanse(&drbg_state,sizeof(drbg_state));
+	memset(&drbg_state,0,sizeof(drbg_state));
+	CRYPTO_add(&drbg_seed_gen,1,CRYPTO_LOCK_RAND2);
+	}
+
+static int ctr_drbg_rand_status(void)
+	{
+	return RAND_SSLeay()->status();
+	}
+
+#endif
@@ -58,10 +58,16 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <openssl/rand.h>
 
 #include "../e_os.h"
 
+#ifdef OPENSSL_SYS_UNIX
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
 /* some FIPS 140-1 random number test */
 /* some simple tests */
 
@@ -209,6 +215,37 @@ int main(int argc,char **argv)
 		err++;
 		}
 	printf("test 4 done\n");
+
+#ifdef OPENSSL_SYS_UNIX
+	/* test 5: a child process must not repeat its parent's output */
+	{
+	unsigned char pbuf[16],cbuf[16];
+	int fd[2];
+	pid_t pid;
+
+	if (pipe(fd) == 0 && (pid=fork()) >= 0)
+		{
+		if (pid == 0)
+			{
+			RAND_pseudo_bytes(cbuf,sizeof(cbuf));
+			if (write(fd[1],cbuf,sizeof(cbuf)) != sizeof(cbuf))
+				_exit(1);
+			_exit(0);
+			}
+		RAND_pseudo_bytes(pbuf,sizeof(pbuf));
+		if (read(fd[0],cbuf,sizeof(cbuf)) != sizeof(cbuf) ||
+			memcmp(pbuf,cbuf,sizeof(pbuf)) == 0)
+			{
+			printf("test 5 failed, child repeated parent output\n");
+			err++;
+			}
+		waitpid(pid,NULL,0);
+		close(fd[0]);
+		close(fd[1]);
+		}
+	printf("test 5 done\n");
+	}
+#endif
  err:
 	err=((err)?1:0);
 #ifdef OPENSSL_SYS_NETWARE
@@ -2658,6 +2658,24 @@ DECLARE_SPECIAL_STACK_OF(OPENSSL_BLOCK, void)
 #define lh_SSL_SESSION_stats_bio(lh,out) \
   LHM_lh_stats_bio(SSL_SESSION,lh,out)
 #define lh_SSL_SESSION_free(lh) LHM_lh_free(SSL_SESSION,lh)
+
+#define lh_X509_OBJECT_INDEX_new() LHM_lh_new(X509_OBJECT_INDEX,x509_object_index)
+#define lh_X509_OBJECT_INDEX_insert(lh,inst) LHM_lh_insert(X509_OBJECT_INDEX,lh,inst)
+#define lh_X509_OBJECT_INDEX_retrieve(lh,inst) LHM_lh_retrieve(X509_OBJECT_INDEX,lh,inst)
+#define lh_X509_OBJECT_INDEX_delete(lh,inst) LHM_lh_delete(X509_OBJECT_INDEX,lh,inst)
+#define lh_X509_OBJECT_INDEX_doall(lh,fn) LHM_lh_doall(X509_OBJECT_INDEX,lh,fn)
+#define lh_X509_OBJECT_INDEX_doall_arg(lh,fn,arg_type,arg) \
+  LHM_lh_doall_arg(X509_OBJECT_INDEX,lh,fn,arg_type,arg)
+#define lh_X509_OBJECT_INDEX_error(lh) LHM_lh_error(X509_OBJECT_INDEX,lh)
+#define lh_X509_OBJECT_INDEX_num_items(lh) LHM_lh_num_items(X509_OBJECT_INDEX,lh)
+#define lh_X509_OBJECT_INDEX_down_load(lh) LHM_lh_down_load(X509_OBJECT_INDEX,lh)
+#define lh_X509_OBJECT_INDEX_node_stats_bio(lh,out) \
+  LHM_lh_node_stats_bio(X509_OBJECT_INDEX,lh,out)
+#define lh_X509_OBJECT_INDEX_node_usage_stats_bio(lh,out) \
+  LHM_lh_node_usage_stats_bio(X509_OBJECT_INDEX,lh,out)
+#define lh_X509_OBJECT_INDEX_stats_bio(lh,out) \
+  LHM_lh_stats_bio(X509_OBJECT_INDEX,lh,out)
+#define lh_X509_OBJECT_INDEX_free(lh) LHM_lh_free(X509_OBJECT_INDEX,lh)
 /* End of util/mkstack.pl block, you may now edit :-) */
 
 #endif /* !defined HEADER_SAFESTACK_H */
@@ -76,6 +76,7 @@
 #endif
 #ifdef PTHREADS
 #include <pthread.h>
+#include <sys/time.h>
 #endif
 #ifdef OPENSSL_SYS_NETWARE
 #if !defined __int64
@@ -144,6 +145,14 @@ int thread_number=10;
 int number_of_loops=10;
 int reconnect=0;
 int cache_stats=0;
+long cache_size= -1;
+int no_ticket=0;
+int sharded=0;
+int err_bench=0;
+int default_locks=0;
+
+/* ERR_clear_error() calls per loop with -err */
+#define ERR_BENCH_CALLS	1000
 
 static const char rnd_seed[] = "string to make the random number generator think it has entropy";
 
@@ -178,6 +187,11 @@ static void sv_usage(void)
 	fprintf(stderr," -loops arg    - number of 'connections', per thread\n");
 	fprintf(stderr," -reconnect    - reuse session-id's\n");
 	fprintf(stderr," -stats        - server session-id cache stats\n");
+	fprintf(stderr," -cache_size n - server session-id cache size\n");
+	fprintf(stderr," -no_ticket    - resume from the session-id cache, not tickets\n");
+	fprintf(stderr," -sharded      - shard the server session-id cache\n");
+	fprintf(stderr," -err          - time ERR_clear_error() instead of connections\n");
+	fprintf(stderr," -default_locks - use the library's locking (Linux)\n");
 	fprintf(stderr," -cert arg     - server certificate/key\n");
 	fprintf(stderr," -ccert arg    - client certificate/key\n");
 	fprintf(stderr," -ssl3         - just SSLv3n\n");
@@ -188,6 +202,7 @@ int main(int argc, char *argv[])
 	char *CApath=NULL,*CAfile=NULL;
 	int badop=0;
 	int ret=1;
+	int i;
 	int client_auth=0;
 	int server_auth=0;
 	SSL_CTX *s_ctx=NULL;
@@ -215,6 +230,19 @@ int main(int argc, char *argv[])
 			reconnect=1;
 		else if	(strcmp(*argv,"-stats") == 0)
 			cache_stats=1;
+		else if	(strcmp(*argv,"-cache_size") == 0)
+			{
+			if (--argc < 1) goto bad;
+			cache_size= atol(*(++argv));
+			}
+		else if	(strcmp(*argv,"-no_ticket") == 0)
+			no_ticket=1;
+		else if	(strcmp(*argv,"-sharded") == 0)
+			sharded=1;
+		else if	(strcmp(*argv,"-err") == 0)
+			err_bench=1;
+		else if	(strcmp(*argv,"-default_locks") == 0)
+			default_locks=1;
 		else if	(strcmp(*argv,"-ssl3") == 0)
 			ssl_method=SSLv3_method();
 		else if	(strcmp(*argv,"-ssl2") == 0)
@@ -275,6 +303,10 @@ bad:
 	SSL_load_error_strings();
 	OpenSSL_add_ssl_algorithms();
 
+	/* before the session cache mode: the shards take dynamic locks */
+	if (!default_locks)
+		thread_setup();
+
 	c_ctx=SSL_CTX_new(ssl_method);
 	s_ctx=SSL_CTX_new(ssl_method);
 	if ((c_ctx == NULL) || (s_ctx == NULL))
@@ -284,9 +316,14 @@ bad:
 		}
 
 	SSL_CTX_set_session_cache_mode(s_ctx,
-		SSL_SESS_CACHE_NO_AUTO_CLEAR|SSL_SESS_CACHE_SERVER);
+		SSL_SESS_CACHE_NO_AUTO_CLEAR|SSL_SESS_CACHE_SERVER|
+		(sharded?SSL_SESS_CACHE_SHARDED:0));
 	SSL_CTX_set_session_cache_mode(c_ctx,
 		SSL_SESS_CACHE_NO_AUTO_CLEAR|SSL_SESS_CACHE_SERVER);
+	if (cache_size >= 0)
+		SSL_CTX_sess_set_cache_size(s_ctx,cache_size);
+	if (no_ticket)
+		SSL_CTX_set_options(s_ctx,SSL_OP_NO_TICKET);
 
 	if (!SSL_CTX_use_certificate_file(s_ctx,scert,SSL_FILETYPE_PEM))
 		{
@@ -330,9 +367,17 @@ bad:
 			verify_callback);
 		}
 
-	thread_setup();
-	do_threads(s_ctx,c_ctx);
-	thread_cleanup();
+	if (default_locks)
+		{
+		do_threads(s_ctx,c_ctx);
+		/* read and write waits */
+		CRYPTO_lock_contention_fp(stderr);
+		}
+	else
+		{
+		do_threads(s_ctx,c_ctx);
+		thread_cleanup();
+		}
 end:
 	
 	if (c_ctx != NULL) 
@@ -347,13 +392,19 @@ end:
 		print_stats(stderr,s_ctx);
 		if (cache_stats)
 			{
-			fprintf(stderr,"-----\n");
-			lh_stats(SSL_CTX_sessions(s_ctx),stderr);
-			fprintf(stderr,"-----\n");
-		/*	lh_node_stats(SSL_CTX_sessions(s_ctx),stderr);
-			fprintf(stderr,"-----\n"); */
-			lh_node_usage_stats(SSL_CTX_sessions(s_ctx),stderr);
-			fprintf(stderr,"-----\n");
+			LHASH_OF(SSL_SESSION) *sessions;
+
+			/* one table per shard, or just SSL_CTX_sessions() */
+			for (i=0; (sessions=SSL_CTX_sessions_shard(s_ctx,i)) != NULL; i++)
+				{
+				fprintf(stderr,"----- shard %d\n",i);
+				lh_stats(sessions,stderr);
+				fprintf(stderr,"-----\n");
+			/*	lh_node_stats(sessions,stderr);
+				fprintf(stderr,"-----\n"); */
+				lh_node_usage_stats(sessions,stderr);
+				fprintf(stderr,"-----\n");
+				}
 			}
 		SSL_CTX_free(s_ctx);
 		fprintf(stderr,"done free\n");
@@ -388,7 +439,13 @@ int ndoit(SSL_CTX *ssl_ctx[2])
 		}
 
 	fprintf(stdout,"started thread %lu\n",CRYPTO_thread_id());
-	for (i=0; i<number_of_loops; i++)
+	if (err_bench)
+		{
+		/* what SSL_read() and SSL_write() do on every call */
+		for (i=0; i<number_of_loops*ERR_BENCH_CALLS; i++)
+			ERR_clear_error();
+		}
+	for (i=0; !err_bench && i<number_of_loops; i++)
 		{
 /*		fprintf(stderr,"%4d %2d ctx->ref (%3d,%3d)\n",
 			CRYPTO_thread_id(),i,
@@ -1025,6 +1082,64 @@ unsigned long irix_thread_id(void)
 
 static pthread_mutex_t *lock_cs;
 static long *lock_count;
+static long *lock_waits;
+
+/* Dynamic locks, such as the ones of a sharded session cache. They are
+ * created and destroyed while only one thread runs. */
+struct CRYPTO_dynlock_value
+	{
+	pthread_mutex_t mutex;
+	long count;
+	long waits;
+	struct CRYPTO_dynlock_value *next;
+	};
+static struct CRYPTO_dynlock_value *dyn_locks=NULL;
+
+static struct CRYPTO_dynlock_value *pthreads_dynlock_create(const char *file,
+	int line)
+	{
+	struct CRYPTO_dynlock_value *l;
+
+	l=OPENSSL_malloc(sizeof(struct CRYPTO_dynlock_value));
+	if (l == NULL) return(NULL);
+	pthread_mutex_init(&l->mutex,NULL);
+	l->count=0;
+	l->waits=0;
+	l->next=dyn_locks;
+	dyn_locks=l;
+	return(l);
+	}
+
+static void pthreads_dynlock_lock(int mode, struct CRYPTO_dynlock_value *l,
+	const char *file, int line)
+	{
+	if (mode & CRYPTO_LOCK)
+		{
+		if (pthread_mutex_trylock(&l->mutex) != 0)
+			{
+			pthread_mutex_lock(&l->mutex);
+			l->waits++;
+			}
+		l->count++;
+		}
+	else
+		pthread_mutex_unlock(&l->mutex);
+	}
+
+static void pthreads_dynlock_destroy(struct CRYPTO_dynlock_value *l,
+	const char *file, int line)
+	{
+	struct CRYPTO_dynlock_value **p;
+
+	for (p= &dyn_locks; *p != NULL; p= &(*p)->next)
+		if (*p == l)
+			{
+			*p=l->next;
+			break;
+			}
+	pthread_mutex_destroy(&l->mutex);
+	OPENSSL_free(l);
+	}
 
 void thread_setup(void)
 	{
@@ -1032,18 +1147,24 @@ void thread_setup(void)
 
 	lock_cs=OPENSSL_malloc(CRYPTO_num_locks() * sizeof(pthread_mutex_t));
 	lock_count=OPENSSL_malloc(CRYPTO_num_locks() * sizeof(long));
+	lock_waits=OPENSSL_malloc(CRYPTO_num_locks() * sizeof(long));
 	for (i=0; i<CRYPTO_num_locks(); i++)
 		{
 		lock_count[i]=0;
+		lock_waits[i]=0;
 		pthread_mutex_init(&(lock_cs[i]),NULL);
 		}
 
 	CRYPTO_set_id_callback((unsigned long (*)())pthreads_thread_id);
 	CRYPTO_set_locking_callback((void (*)())pthreads_locking_callback);
+	CRYPTO_set_dynlock_create_callback(pthreads_dynlock_create);
+	CRYPTO_set_dynlock_lock_callback(pthreads_dynlock_lock);
+	CRYPTO_set_dynlock_destroy_callback(pthreads_dynlock_destroy);
 	}
 
 void thread_cleanup(void)
 	{
+	struct CRYPTO_dynlock_value *l;
 	int i;
 
 	CRYPTO_set_locking_callback(NULL);
@@ -1051,11 +1172,16 @@ void thread_cleanup(void)
 	for (i=0; i<CRYPTO_num_locks(); i++)
 		{
 		pthread_mutex_destroy(&(lock_cs[i]));
-		fprintf(stderr,"%8ld:%s\n",lock_count[i],
+		/* acquisitions, and how many of those had to wait */
+		fprintf(stderr,"%8ld %8ld:%s\n",lock_count[i],lock_waits[i],
 			CRYPTO_get_lock_name(i));
 		}
+	/* the dynamic locks stay, for the SSL_CTXs still to be freed */
+	for (l=dyn_locks; l != NULL; l=l->next)
+		fprintf(stderr,"%8ld %8ld:dynamic\n",l->count,l->waits);
 	OPENSSL_free(lock_cs);
 	OPENSSL_free(lock_count);
+	OPENSSL_free(lock_waits);
 
 	fprintf(stderr,"done cleanup\n");
 	}
@@ -1077,7 +1203,11 @@ void pthreads_locking_callback(int mode, int type, char *file,
 */
 	if (mode & CRYPTO_LOCK)
 		{
-		pthread_mutex_lock(&(lock_cs[type]));
+		if (pthread_mutex_trylock(&(lock_cs[type])) != 0)
+			{
+			pthread_mutex_lock(&(lock_cs[type]));
+			lock_waits[type]++;
+			}
 		lock_count[type]++;
 		}
 	else
@@ -1088,13 +1218,17 @@ void pthreads_locking_callback(int mode, int type, char *file,
 
 void do_threads(SSL_CTX *s_ctx, SSL_CTX *c_ctx)
 	{
+	double ret;
 	SSL_CTX *ssl_ctx[2];
 	pthread_t thread_ctx[MAX_THREAD_NUMBER];
 	int i;
+	struct timeval start,end;
 
 	ssl_ctx[0]=s_ctx;
 	ssl_ctx[1]=c_ctx;
 
+	gettimeofday(&start,NULL);
+
 	/*
 	thr_setconcurrency(thread_number);
 	*/
@@ -1109,9 +1243,18 @@ void do_threads(SSL_CTX *s_ctx, SSL_CTX *c_ctx)
 		{
 		pthread_join(thread_ctx[i],NULL);
 		}
+	gettimeofday(&end,NULL);
+
+	ret=(end.tv_sec-start.tv_sec)+(end.tv_usec-start.tv_usec)/1000000.0;
 
 	printf("pthreads threads done (%d,%d)\n",
 		s_ctx->references,c_ctx->references);
+	if (err_bench)
+		printf("pthreads threads done - %.3f seconds, %.0f ERR_clear_error()/sec\n",
+			ret,thread_number*(double)number_of_loops*ERR_BENCH_CALLS/ret);
+	else
+		printf("pthreads threads done - %.3f seconds, %.1f connections/sec\n",
+			ret,thread_number*number_of_loops/ret);
 	}
 
 unsigned long pthreads_thread_id(void)
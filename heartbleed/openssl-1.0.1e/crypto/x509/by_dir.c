@@ -274,38 +274,21 @@ static int get_cert_by_subject(X509_LOOKUP *xl, int type, X509_NAME *name,
 	     X509_OBJECT *ret)
 	{
 	BY_DIR *ctx;
-	union	{
-		struct	{
-			X509 st_x509;
-			X509_CINF st_x509_cinf;
-			} x509;
-		struct	{
-			X509_CRL st_crl;
-			X509_CRL_INFO st_crl_info;
-			} crl;
-		} data;
 	int ok=0;
 	int i,j,k;
 	unsigned long h;
 	BUF_MEM *b=NULL;
-	X509_OBJECT stmp,*tmp;
+	X509_OBJECT *tmp;
 	const char *postfix="";
 
 	if (name == NULL) return(0);
 
-	stmp.type=type;
 	if (type == X509_LU_X509)
 		{
-		data.x509.st_x509.cert_info= &data.x509.st_x509_cinf;
-		data.x509.st_x509_cinf.subject=name;
-		stmp.data.x509= &data.x509.st_x509;
 		postfix="";
 		}
 	else if (type == X509_LU_CRL)
 		{
-		data.crl.st_crl.crl= &data.crl.st_crl_info;
-		data.crl.st_crl_info.issuer=name;
-		stmp.data.crl= &data.crl.st_crl;
 		postfix="r";
 		}
 	else
@@ -421,9 +404,7 @@ static int get_cert_by_subject(X509_LOOKUP *xl, int type, X509_NAME *name,
 		/* we have added it to the cache so now pull
 		 * it out again */
 		CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-		j = sk_X509_OBJECT_find(xl->store_ctx->objs,&stmp);
-		if(j != -1) tmp=sk_X509_OBJECT_value(xl->store_ctx->objs,j);
-		else tmp = NULL;
+		tmp = X509_STORE_retrieve_by_subject(xl->store_ctx,type,name);
 		CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 
 
@@ -455,6 +436,10 @@ static int get_cert_by_subject(X509_LOOKUP *xl, int type, X509_NAME *name,
 					ok = 0;
 					goto finish;
 					}
+				/* Sort now, under the write lock: the lookup
+				 * above only holds a read lock, and finding in
+				 * an unsorted stack sorts it. */
+				sk_BY_DIR_HASH_sort(ent->hashes);
 				}
 			else if (hent->suffix < k)
 				hent->suffix = k;
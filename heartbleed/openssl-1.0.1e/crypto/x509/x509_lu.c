@@ -175,6 +175,159 @@ static int x509_object_cmp(const X509_OBJECT * const *a, const X509_OBJECT * con
 	return ret;
 	}
 
+/* The store keeps every object in |objs|, in the order they were added,
+ * for callers that walk the stack.  Lookups go through |obj_index|
+ * instead: one entry per (type, name), where the name is the subject of
+ * a certificate or the issuer of a CRL, listing every object with that
+ * name.  Adding an object is O(1) and no lookup ever sorts |objs|, which
+ * used to happen on the first lookup after each addition.  Objects are
+ * never removed from a store before it is freed, so an entry can borrow
+ * the name of its first object. */
+struct x509_object_index_st
+	{
+	int type;
+	X509_NAME *name;
+	unsigned long hash;
+	STACK_OF(X509_OBJECT) *objs;
+	};
+
+static X509_NAME *x509_object_name(const X509_OBJECT *a)
+	{
+	switch (a->type)
+		{
+	case X509_LU_X509:
+		return X509_get_subject_name(a->data.x509);
+	case X509_LU_CRL:
+		return X509_CRL_get_issuer(a->data.crl);
+	default:
+		return NULL;
+		}
+	}
+
+/* Hash of the canonical encoding, the same bytes X509_NAME_cmp()
+ * compares, so equal names always land in the same bucket. */
+static unsigned long x509_object_index_key(int type, X509_NAME *name)
+	{
+	unsigned long h = 2166136261UL ^ (unsigned long)type;
+	int i;
+
+	if (!name->canon_enc || name->modified)
+		{
+		if (i2d_X509_NAME(name, NULL) < 0)
+			return 0;
+		}
+	for (i = 0; i < name->canon_enclen; i++)
+		{
+		h ^= name->canon_enc[i];
+		h = (h * 16777619UL) & 0xffffffffUL;
+		}
+	return h;
+	}
+
+static unsigned long x509_object_index_hash(const X509_OBJECT_INDEX *a)
+	{
+	return a->hash;
+	}
+static IMPLEMENT_LHASH_HASH_FN(x509_object_index, X509_OBJECT_INDEX)
+
+static int x509_object_index_cmp(const X509_OBJECT_INDEX *a,
+	     const X509_OBJECT_INDEX *b)
+	{
+	if (a->type != b->type)
+		return a->type - b->type;
+	return X509_NAME_cmp(a->name, b->name);
+	}
+static IMPLEMENT_LHASH_COMP_FN(x509_object_index, X509_OBJECT_INDEX)
+
+static STACK_OF(X509_OBJECT) *x509_object_index_find(X509_STORE *ctx,
+	     int type, X509_NAME *name)
+	{
+	X509_OBJECT_INDEX tmp, *ent;
+
+	if (name == NULL)
+		return NULL;
+	tmp.type = type;
+	tmp.name = name;
+	tmp.hash = x509_object_index_key(type, name);
+	ent = lh_X509_OBJECT_INDEX_retrieve(ctx->obj_index, &tmp);
+	return ent ? ent->objs : NULL;
+	}
+
+static int x509_object_index_add(X509_STORE *ctx, X509_OBJECT *obj)
+	{
+	X509_OBJECT_INDEX tmp, *ent;
+
+	tmp.type = obj->type;
+	tmp.name = x509_object_name(obj);
+	if (tmp.name == NULL)
+		return 0;
+	tmp.hash = x509_object_index_key(tmp.type, tmp.name);
+
+	ent = lh_X509_OBJECT_INDEX_retrieve(ctx->obj_index, &tmp);
+	if (ent == NULL)
+		{
+		ent = OPENSSL_malloc(sizeof(X509_OBJECT_INDEX));
+		if (ent == NULL)
+			return 0;
+		*ent = tmp;
+		ent->objs = sk_X509_OBJECT_new_null();
+		if (ent->objs == NULL)
+			{
+			OPENSSL_free(ent);
+			return 0;
+			}
+		lh_X509_OBJECT_INDEX_insert(ctx->obj_index, ent);
+		if (lh_X509_OBJECT_INDEX_retrieve(ctx->obj_index, ent) == NULL)
+			{
+			sk_X509_OBJECT_free(ent->objs);
+			OPENSSL_free(ent);
+			return 0;
+			}
+		}
+	return sk_X509_OBJECT_push(ent->objs, obj) != 0;
+	}
+
+static void x509_object_index_free_doall(X509_OBJECT_INDEX *ent)
+	{
+	sk_X509_OBJECT_free(ent->objs);
+	OPENSSL_free(ent);
+	}
+static IMPLEMENT_LHASH_DOALL_FN(x509_object_index_free, X509_OBJECT_INDEX)
+
+/* Like X509_OBJECT_retrieve_match() on the store's objects */
+static X509_OBJECT *x509_store_match(X509_STORE *ctx, X509_OBJECT *x)
+	{
+	STACK_OF(X509_OBJECT) *objs;
+	X509_OBJECT *obj;
+	int i;
+
+	objs = x509_object_index_find(ctx, x->type, x509_object_name(x));
+	for (i = 0; i < sk_X509_OBJECT_num(objs); i++)
+		{
+		obj = sk_X509_OBJECT_value(objs, i);
+		if (x->type == X509_LU_X509)
+			{
+			if (!X509_cmp(obj->data.x509, x->data.x509))
+				return obj;
+			}
+		else if (!X509_CRL_match(obj->data.crl, x->data.crl))
+			return obj;
+		}
+	return NULL;
+	}
+
+static int x509_store_add_object(X509_STORE *ctx, X509_OBJECT *obj)
+	{
+	if (!sk_X509_OBJECT_push(ctx->objs, obj))
+		return 0;
+	if (!x509_object_index_add(ctx, obj))
+		{
+		(void)sk_X509_OBJECT_pop(ctx->objs);
+		return 0;
+		}
+	return 1;
+	}
+
 X509_STORE *X509_STORE_new(void)
 	{
 	X509_STORE *ret;
@@ -182,6 +335,7 @@ X509_STORE *X509_STORE_new(void)
 	if ((ret=(X509_STORE *)OPENSSL_malloc(sizeof(X509_STORE))) == NULL)
 		return NULL;
 	ret->objs = sk_X509_OBJECT_new(x509_object_cmp);
+	ret->obj_index = lh_X509_OBJECT_INDEX_new();
 	ret->cache=1;
 	ret->get_cert_methods=sk_X509_LOOKUP_new_null();
 	ret->verify=0;
@@ -200,8 +354,11 @@ X509_STORE *X509_STORE_new(void)
 	ret->lookup_crls = 0;
 	ret->cleanup = 0;
 
-	if (!CRYPTO_new_ex_data(CRYPTO_EX_INDEX_X509_STORE, ret, &ret->ex_data))
+	if (ret->obj_index == NULL ||
+	    !CRYPTO_new_ex_data(CRYPTO_EX_INDEX_X509_STORE, ret, &ret->ex_data))
 		{
+		if (ret->obj_index)
+			lh_X509_OBJECT_INDEX_free(ret->obj_index);
 		sk_X509_OBJECT_free(ret->objs);
 		OPENSSL_free(ret);
 		return NULL;
@@ -246,6 +403,12 @@ void X509_STORE_free(X509_STORE *vfy)
 		X509_LOOKUP_free(lu);
 		}
 	sk_X509_LOOKUP_free(sk);
+	if (vfy->obj_index)
+		{
+		lh_X509_OBJECT_INDEX_doall(vfy->obj_index,
+			LHASH_DOALL_FN(x509_object_index_free));
+		lh_X509_OBJECT_INDEX_free(vfy->obj_index);
+		}
 	sk_X509_OBJECT_pop_free(vfy->objs, cleanup);
 
 	CRYPTO_free_ex_data(CRYPTO_EX_INDEX_X509_STORE, vfy, &vfy->ex_data);
@@ -295,7 +458,7 @@ int X509_STORE_get_by_subject(X509_STORE_CTX *vs, int type, X509_NAME *name,
 	int i,j;
 
 	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-	tmp=X509_OBJECT_retrieve_by_subject(ctx->objs,type,name);
+	tmp=X509_STORE_retrieve_by_subject(ctx,type,name);
 	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 
 	if (tmp == NULL || type == X509_LU_CRL)
@@ -350,14 +513,20 @@ int X509_STORE_add_cert(X509_STORE *ctx, X509 *x)
 
 	X509_OBJECT_up_ref_count(obj);
 
-	if (X509_OBJECT_retrieve_match(ctx->objs, obj))
+	if (x509_store_match(ctx, obj))
 		{
 		X509_OBJECT_free_contents(obj);
 		OPENSSL_free(obj);
 		X509err(X509_F_X509_STORE_ADD_CERT,X509_R_CERT_ALREADY_IN_HASH_TABLE);
 		ret=0;
-		} 
-	else sk_X509_OBJECT_push(ctx->objs, obj);
+		}
+	else if (!x509_store_add_object(ctx, obj))
+		{
+		X509_OBJECT_free_contents(obj);
+		OPENSSL_free(obj);
+		X509err(X509_F_X509_STORE_ADD_CERT,ERR_R_MALLOC_FAILURE);
+		ret=0;
+		}
 
 	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 
@@ -383,14 +552,20 @@ int X509_STORE_add_crl(X509_STORE *ctx, X509_CRL *x)
 
 	X509_OBJECT_up_ref_count(obj);
 
-	if (X509_OBJECT_retrieve_match(ctx->objs, obj))
+	if (x509_store_match(ctx, obj))
 		{
 		X509_OBJECT_free_contents(obj);
 		OPENSSL_free(obj);
 		X509err(X509_F_X509_STORE_ADD_CRL,X509_R_CERT_ALREADY_IN_HASH_TABLE);
 		ret=0;
 		}
-	else sk_X509_OBJECT_push(ctx->objs, obj);
+	else if (!x509_store_add_object(ctx, obj))
+		{
+		X509_OBJECT_free_contents(obj);
+		OPENSSL_free(obj);
+		X509err(X509_F_X509_STORE_ADD_CRL,ERR_R_MALLOC_FAILURE);
+		ret=0;
+		}
 
 	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 
@@ -485,16 +660,30 @@ X509_OBJECT *X509_OBJECT_retrieve_by_subject(STACK_OF(X509_OBJECT) *h, int type,
 	return sk_X509_OBJECT_value(h, idx);
 	}
 
+/* First object of |type| named |name| in the store, or NULL. The caller
+ * holds CRYPTO_LOCK_X509_STORE. */
+X509_OBJECT *X509_STORE_retrieve_by_subject(X509_STORE *ctx, int type,
+	     X509_NAME *name)
+	{
+	STACK_OF(X509_OBJECT) *objs;
+
+	objs = x509_object_index_find(ctx, type, name);
+	if (sk_X509_OBJECT_num(objs) <= 0)
+		return NULL;
+	return sk_X509_OBJECT_value(objs, 0);
+	}
+
 STACK_OF(X509)* X509_STORE_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
 	{
-	int i, idx, cnt;
+	int i, cnt;
 	STACK_OF(X509) *sk;
+	STACK_OF(X509_OBJECT) *objs;
 	X509 *x;
 	X509_OBJECT *obj;
 	sk = sk_X509_new_null();
 	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-	idx = x509_object_idx_cnt(ctx->ctx->objs, X509_LU_X509, nm, &cnt);
-	if (idx < 0)
+	objs = x509_object_index_find(ctx->ctx, X509_LU_X509, nm);
+	if (sk_X509_OBJECT_num(objs) <= 0)
 		{
 		/* Nothing found in cache: do lookup to possibly add new
 		 * objects to cache
@@ -508,17 +697,18 @@ STACK_OF(X509)* X509_STORE_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
 			}
 		X509_OBJECT_free_contents(&xobj);
 		CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-		idx = x509_object_idx_cnt(ctx->ctx->objs,X509_LU_X509,nm, &cnt);
-		if (idx < 0)
+		objs = x509_object_index_find(ctx->ctx, X509_LU_X509, nm);
+		if (sk_X509_OBJECT_num(objs) <= 0)
 			{
 			CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 			sk_X509_free(sk);
 			return NULL;
 			}
 		}
-	for (i = 0; i < cnt; i++, idx++)
+	cnt = sk_X509_OBJECT_num(objs);
+	for (i = 0; i < cnt; i++)
 		{
-		obj = sk_X509_OBJECT_value(ctx->ctx->objs, idx);
+		obj = sk_X509_OBJECT_value(objs, i);
 		x = obj->data.x509;
 		CRYPTO_add(&x->references, 1, CRYPTO_LOCK_X509);
 		if (!sk_X509_push(sk, x))
@@ -536,18 +726,15 @@ STACK_OF(X509)* X509_STORE_get1_certs(X509_STORE_CTX *ctx, X509_NAME *nm)
 
 STACK_OF(X509_CRL)* X509_STORE_get1_crls(X509_STORE_CTX *ctx, X509_NAME *nm)
 	{
-	int i, idx, cnt;
+	int i, cnt;
 	STACK_OF(X509_CRL) *sk;
+	STACK_OF(X509_OBJECT) *objs;
 	X509_CRL *x;
 	X509_OBJECT *obj, xobj;
 	sk = sk_X509_CRL_new_null();
-	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-	/* Check cache first */
-	idx = x509_object_idx_cnt(ctx->ctx->objs, X509_LU_CRL, nm, &cnt);
 
 	/* Always do lookup to possibly add new CRLs to cache
 	 */
-	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 	if (!X509_STORE_get_by_subject(ctx, X509_LU_CRL, nm, &xobj))
 		{
 		sk_X509_CRL_free(sk);
@@ -555,17 +742,18 @@ STACK_OF(X509_CRL)* X509_STORE_get1_crls(X509_STORE_CTX *ctx, X509_NAME *nm)
 		}
 	X509_OBJECT_free_contents(&xobj);
 	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-	idx = x509_object_idx_cnt(ctx->ctx->objs,X509_LU_CRL, nm, &cnt);
-	if (idx < 0)
+	objs = x509_object_index_find(ctx->ctx, X509_LU_CRL, nm);
+	cnt = sk_X509_OBJECT_num(objs);
+	if (cnt <= 0)
 		{
 		CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
 		sk_X509_CRL_free(sk);
 		return NULL;
 		}
 
-	for (i = 0; i < cnt; i++, idx++)
+	for (i = 0; i < cnt; i++)
 		{
-		obj = sk_X509_OBJECT_value(ctx->ctx->objs, idx);
+		obj = sk_X509_OBJECT_value(objs, i);
 		x = obj->data.crl;
 		CRYPTO_add(&x->references, 1, CRYPTO_LOCK_X509_CRL);
 		if (!sk_X509_CRL_push(sk, x))
@@ -625,7 +813,8 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
 	{
 	X509_NAME *xn;
 	X509_OBJECT obj, *pobj;
-	int i, ok, idx, ret;
+	STACK_OF(X509_OBJECT) *objs;
+	int i, ok, ret;
 	xn=X509_get_issuer_name(x);
 	ok=X509_STORE_get_by_subject(ctx,X509_LU_X509,xn,&obj);
 	if (ok != X509_LU_X509)
@@ -655,25 +844,17 @@ int X509_STORE_CTX_get1_issuer(X509 **issuer, X509_STORE_CTX *ctx, X509 *x)
 	/* Else find index of first cert accepted by 'check_issued' */
 	ret = 0;
 	CRYPTO_w_lock(CRYPTO_LOCK_X509_STORE);
-	idx = X509_OBJECT_idx_by_subject(ctx->ctx->objs, X509_LU_X509, xn);
-	if (idx != -1) /* should be true as we've had at least one match */
+	objs = x509_object_index_find(ctx->ctx, X509_LU_X509, xn);
+	/* Look through all matching certs for suitable issuer */
+	for (i = 0; i < sk_X509_OBJECT_num(objs); i++)
 		{
-		/* Look through all matching certs for suitable issuer */
-		for (i = idx; i < sk_X509_OBJECT_num(ctx->ctx->objs); i++)
+		pobj = sk_X509_OBJECT_value(objs, i);
+		if (ctx->check_issued(ctx, x, pobj->data.x509))
 			{
-			pobj = sk_X509_OBJECT_value(ctx->ctx->objs, i);
-			/* See if we've run past the matches */
-			if (pobj->type != X509_LU_X509)
-				break;
-			if (X509_NAME_cmp(xn, X509_get_subject_name(pobj->data.x509)))
-				break;
-			if (ctx->check_issued(ctx, x, pobj->data.x509))
-				{
-				*issuer = pobj->data.x509;
-				X509_OBJECT_up_ref_count(pobj);
-				ret = 1;
-				break;
-				}
+			*issuer = pobj->data.x509;
+			X509_OBJECT_up_ref_count(pobj);
+			ret = 1;
+			break;
 			}
 		}
 	CRYPTO_w_unlock(CRYPTO_LOCK_X509_STORE);
@@ -137,6 +137,10 @@ typedef struct x509_lookup_st X509_LOOKUP;
 DECLARE_STACK_OF(X509_LOOKUP)
 DECLARE_STACK_OF(X509_OBJECT)
 
+/* Hash index over the objects of an X509_STORE, private to x509_lu.c */
+typedef struct x509_object_index_st X509_OBJECT_INDEX;
+DECLARE_LHASH_OF(X509_OBJECT_INDEX);
+
 /* This is a static that defines the function interface */
 typedef struct x509_lookup_method_st
 	{
@@ -206,6 +210,10 @@ struct x509_store_st
 
 	CRYPTO_EX_DATA ex_data;
 	int references;
+
+	/* |objs| by subject (certificates) or issuer (CRLs) name, so that
+	 * lookups never need to sort |objs| */
+	LHASH_OF(X509_OBJECT_INDEX) *obj_index;
 	} /* X509_STORE */;
 
 int X509_STORE_set_depth(X509_STORE *store, int depth);
@@ -407,6 +415,8 @@ int X509_OBJECT_idx_by_subject(STACK_OF(X509_OBJECT) *h, int type,
 	     X509_NAME *name);
 X509_OBJECT *X509_OBJECT_retrieve_by_subject(STACK_OF(X509_OBJECT) *h,int type,X509_NAME *name);
 X509_OBJECT *X509_OBJECT_retrieve_match(STACK_OF(X509_OBJECT) *h, X509_OBJECT *x);
+X509_OBJECT *X509_STORE_retrieve_by_subject(X509_STORE *ctx, int type,
+	     X509_NAME *name);
 void X509_OBJECT_up_ref_count(X509_OBJECT *a);
 void X509_OBJECT_free_contents(X509_OBJECT *a);
 X509_STORE *X509_STORE_new(void );
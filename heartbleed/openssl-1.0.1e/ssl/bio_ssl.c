@@ -206,6 +206,10 @@ static int ssl_read(BIO *b, char *out, int outl)
 		BIO_set_retry_special(b);
 		retry_reason=BIO_RR_SSL_X509_LOOKUP;
 		break;
+	case SSL_ERROR_WANT_ASYNC:
+		BIO_set_retry_special(b);
+		retry_reason=BIO_RR_SSL_ASYNC;
+		break;
 	case SSL_ERROR_WANT_ACCEPT:
 		BIO_set_retry_special(b);
 		retry_reason=BIO_RR_ACCEPT;
@@ -280,6 +284,10 @@ static int ssl_write(BIO *b, const char *out, int outl)
 		BIO_set_retry_special(b);
 		retry_reason=BIO_RR_SSL_X509_LOOKUP;
 		break;
+	case SSL_ERROR_WANT_ASYNC:
+		BIO_set_retry_special(b);
+		retry_reason=BIO_RR_SSL_ASYNC;
+		break;
 	case SSL_ERROR_WANT_CONNECT:
 		BIO_set_retry_special(b);
 		retry_reason=BIO_RR_CONNECT;
@@ -437,6 +445,11 @@ static long ssl_ctrl(BIO *b, int cmd, long num, void *ptr)
 				BIO_FLAGS_IO_SPECIAL|BIO_FLAGS_SHOULD_RETRY);
 			b->retry_reason=b->next_bio->retry_reason;
 			break;
+		case SSL_ERROR_WANT_ASYNC:
+			BIO_set_flags(b,
+				BIO_FLAGS_IO_SPECIAL|BIO_FLAGS_SHOULD_RETRY);
+			b->retry_reason=BIO_RR_SSL_ASYNC;
+			break;
 		default:
 			break;
 			}
@@ -124,11 +124,70 @@
 #include <openssl/evp.h>
 #include <openssl/x509.h>
 
+/* With SSL_MODE_COALESCE_FLIGHT, handshake messages written while the
+ * buffering BIO is pushed are not sent one record each: they are queued
+ * in s->s3->flight and go out together, packed into as few records as
+ * possible, when the state machine reaches its FLUSH state or before a
+ * ChangeCipherSpec. The handshake hash and message callback are updated
+ * as each message is queued, so the Finished computation is unaffected.
+ * Alerts bypass the queue; only fatal ones can be sent mid-flight, at which
+ * point the rest of the flight is of no interest to the peer. */
+static int ssl3_coalesce_flight(SSL *s)
+	{
+	return (s->mode & SSL_MODE_COALESCE_FLIGHT) &&
+		s->bbio != NULL && s->wbio == s->bbio;
+	}
+
+int ssl3_write_flight(SSL *s)
+	{
+	BUF_MEM *f=s->s3->flight;
+	int ret;
+
+	if (f == NULL || f->length == 0)
+		return(1);
+
+	/* ssl3_write_bytes() keeps its progress in s->s3->wnum, so a retry
+	 * must present the same buffer, which stays put until it is done */
+	ret=ssl3_write_bytes(s,SSL3_RT_HANDSHAKE,f->data,(int)f->length);
+	if (ret <= 0) return(ret);
+	f->length=0;
+	return(1);
+	}
+
 /* send s->init_buf in records of type 'type' (SSL3_RT_HANDSHAKE or SSL3_RT_CHANGE_CIPHER_SPEC) */
 int ssl3_do_write(SSL *s, int type)
 	{
 	int ret;
 
+	if (ssl3_coalesce_flight(s))
+		{
+		if (type == SSL3_RT_HANDSHAKE)
+			{
+			BUF_MEM *f=s->s3->flight;
+			size_t len=f ? f->length : 0;
+
+			if (f == NULL && (f=s->s3->flight=BUF_MEM_new()) == NULL)
+				{
+				SSLerr(SSL_F_SSL3_DO_WRITE,ERR_R_MALLOC_FAILURE);
+				return(-1);
+				}
+			if (!BUF_MEM_grow(f,len+s->init_num))
+				{
+				SSLerr(SSL_F_SSL3_DO_WRITE,ERR_R_MALLOC_FAILURE);
+				return(-1);
+				}
+			memcpy(&f->data[len],&s->init_buf->data[s->init_off],
+				s->init_num);
+			ssl3_finish_mac(s,(unsigned char *)&s->init_buf->data[s->init_off],s->init_num);
+			if (s->msg_callback)
+				s->msg_callback(1, s->version, type, s->init_buf->data, (size_t)(s->init_off + s->init_num), s, s->msg_callback_arg);
+			return(1);
+			}
+		/* anything else must not overtake the queued messages */
+		if ((ret=ssl3_write_flight(s)) <= 0)
+			return(-1);
+		}
+
 	ret=ssl3_write_bytes(s,type,&s->init_buf->data[s->init_off],
 	                     s->init_num);
 	if (ret < 0) return(-1);
@@ -340,32 +399,21 @@ static int ssl3_add_cert_to_buf(BUF_MEM *buf, unsigned long *l, X509 *x)
 	return(0);
 	}
 
-unsigned long ssl3_output_cert_chain(SSL *s, X509 *x)
+/* Appends the certificate_list for x to s->init_buf at offset *l: x and
+ * the chain the store builds for it, unless no_chain, then the extra
+ * certificates of the SSL_CTX. */
+static int ssl3_add_cert_chain(SSL *s, X509 *x, int no_chain,
+	unsigned long *l)
 	{
-	unsigned char *p;
+	BUF_MEM *buf=s->init_buf;
 	int i;
-	unsigned long l=7;
-	BUF_MEM *buf;
-	int no_chain;
 
-	if ((s->mode & SSL_MODE_NO_AUTO_CHAIN) || s->ctx->extra_certs)
-		no_chain = 1;
-	else
-		no_chain = 0;
-
-	/* TLSv1 sends a chain with nothing in it, instead of an alert */
-	buf=s->init_buf;
-	if (!BUF_MEM_grow_clean(buf,10))
-		{
-		SSLerr(SSL_F_SSL3_OUTPUT_CERT_CHAIN,ERR_R_BUF_LIB);
-		return(0);
-		}
 	if (x != NULL)
 		{
 		if (no_chain)
 			{
-			if (ssl3_add_cert_to_buf(buf, &l, x))
-				return(0);
+			if (ssl3_add_cert_to_buf(buf, l, x))
+				return(-1);
 			}
 		else
 			{
@@ -374,7 +422,7 @@ unsigned long ssl3_output_cert_chain(SSL *s, X509 *x)
 			if (!X509_STORE_CTX_init(&xs_ctx,s->ctx->cert_store,x,NULL))
 				{
 				SSLerr(SSL_F_SSL3_OUTPUT_CERT_CHAIN,ERR_R_X509_LIB);
-				return(0);
+				return(-1);
 				}
 			X509_verify_cert(&xs_ctx);
 			/* Don't leave errors in the queue */
@@ -383,10 +431,10 @@ unsigned long ssl3_output_cert_chain(SSL *s, X509 *x)
 				{
 				x = sk_X509_value(xs_ctx.chain, i);
 
-				if (ssl3_add_cert_to_buf(buf, &l, x))
+				if (ssl3_add_cert_to_buf(buf, l, x))
 					{
 					X509_STORE_CTX_cleanup(&xs_ctx);
-					return 0;
+					return(-1);
 					}
 				}
 			X509_STORE_CTX_cleanup(&xs_ctx);
@@ -396,8 +444,88 @@ unsigned long ssl3_output_cert_chain(SSL *s, X509 *x)
 	for (i=0; i<sk_X509_num(s->ctx->extra_certs); i++)
 		{
 		x=sk_X509_value(s->ctx->extra_certs,i);
-		if (ssl3_add_cert_to_buf(buf, &l, x))
+		if (ssl3_add_cert_to_buf(buf, l, x))
+			return(-1);
+		}
+	return(0);
+	}
+
+unsigned long ssl3_output_cert_chain(SSL *s, X509 *x)
+	{
+	unsigned char *p,*der;
+	int i,cached=0,gen=0;
+	unsigned long l=7;
+	BUF_MEM *buf;
+	CERT_PKEY *cpk=NULL;
+	int no_chain;
+
+	if ((s->mode & SSL_MODE_NO_AUTO_CHAIN) || s->ctx->extra_certs)
+		no_chain = 1;
+	else
+		no_chain = 0;
+
+	/* TLSv1 sends a chain with nothing in it, instead of an alert */
+	buf=s->init_buf;
+	if (!BUF_MEM_grow_clean(buf,10))
+		{
+		SSLerr(SSL_F_SSL3_OUTPUT_CERT_CHAIN,ERR_R_BUF_LIB);
+		return(0);
+		}
+
+	/* When x is one of the certificates of the SSL_CTX the list only
+	 * depends on the SSL_CTX, so it is encoded once and kept there. */
+	if (x != NULL && s->ctx->cert != NULL)
+		{
+		for (i=0; i<SSL_PKEY_NUM; i++)
+			{
+			if (s->ctx->cert->pkeys[i].x509 == x)
+				{
+				cpk=&s->ctx->cert->pkeys[i];
+				break;
+				}
+			}
+		}
+	if (cpk != NULL)
+		{
+		CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+		gen=s->ctx->cert->chain_gen;
+		if (cpk->chain_der != NULL && cpk->chain_no_auto == no_chain)
+			{
+			if (!BUF_MEM_grow_clean(buf,(int)(l+cpk->chain_der_len)))
+				{
+				CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+				SSLerr(SSL_F_SSL3_OUTPUT_CERT_CHAIN,ERR_R_BUF_LIB);
+				return(0);
+				}
+			memcpy(&buf->data[l],cpk->chain_der,cpk->chain_der_len);
+			l+=cpk->chain_der_len;
+			cached=1;
+			}
+		CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+		}
+
+	if (!cached)
+		{
+		if (ssl3_add_cert_chain(s, x, no_chain, &l))
 			return(0);
+		/* Failing to keep a copy is not an error. The copy is
+		 * dropped if the chains were flushed while it was built. */
+		if (cpk != NULL &&
+			(der=BUF_memdup(&buf->data[7],l-7)) != NULL)
+			{
+			CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+			if (cpk->x509 == x && s->ctx->cert->chain_gen == gen)
+				{
+				p=cpk->chain_der;
+				cpk->chain_der=der;
+				cpk->chain_der_len=l-7;
+				cpk->chain_no_auto=no_chain;
+				der=p;
+				}
+			CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+			if (der != NULL)
+				OPENSSL_free(der);
+			}
 		}
 
 	l-=7;
@@ -829,8 +957,13 @@ int ssl3_release_write_buffer(SSL *s)
 	{
 	if (s->s3->wbuf.buf != NULL)
 		{
-		freelist_insert(s->ctx, 0, s->s3->wbuf.len, s->s3->wbuf.buf);
+		/* The multi-block buffer never goes to the free list */
+		if (s->s3->wbuf_jumbo)
+			OPENSSL_free(s->s3->wbuf.buf);
+		else
+			freelist_insert(s->ctx, 0, s->s3->wbuf.len, s->s3->wbuf.buf);
 		s->s3->wbuf.buf = NULL;
+		s->s3->wbuf_jumbo = 0;
 		}
 	return 1;
 	}
@@ -571,6 +571,8 @@ int ssl3_connect(SSL *s)
 			break;
 
 		case SSL3_ST_CW_FLUSH:
+			ret=ssl3_write_flight(s);
+			if (ret <= 0) goto end;
 			s->rwstate=SSL_WRITING;
 			if (BIO_flush(s->wbio) <= 0)
 				{
@@ -1133,7 +1135,7 @@ int ssl3_get_server_certificate(SSL *s)
 			}
 
 		q=p;
-		x=d2i_X509(NULL,&q,l);
+		x=ssl_d2i_peer_cert(s,&q,l,sk_X509_num(sk));
 		if (x == NULL)
 			{
 			al=SSL_AD_BAD_CERTIFICATE;
@@ -119,7 +119,8 @@
 
 static int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
 			 unsigned int len, int create_empty_fragment);
-static int ssl3_get_record(SSL *s);
+static int ssl3_get_record(SSL *s, unsigned char *dst, unsigned int dst_len,
+	int *in_dst);
 
 int ssl3_read_n(SSL *s, int n, int max, int extend)
 	{
@@ -281,7 +282,79 @@ int ssl3_read_n(SSL *s, int n, int max, int extend)
  * ssl->s3->rrec.length, - number of bytes
  */
 /* used only by ssl3_read_bytes */
-static int ssl3_get_record(SSL *s)
+/* SSL_MODE_ZERO_COPY_READ: read the n byte body of the record whose header
+ * is in s->packet into dst rather than into rbuf. Up to one more record
+ * header is asked for as well and left in rbuf, so that a stream of
+ * records takes one read each. Whatever has arrived goes back to rbuf
+ * if the body is incomplete, since the next call may pass a different
+ * dst. */
+static int ssl3_read_body_into(SSL *s, unsigned char *dst,
+	unsigned int dst_len, unsigned int n)
+	{
+	SSL3_BUFFER *rb= &(s->s3->rbuf);
+	unsigned int got,max;
+	long align=0;
+	int i;
+
+#if defined(SSL3_ALIGN_PAYLOAD) && SSL3_ALIGN_PAYLOAD!=0
+	align = (long)rb->buf + SSL3_RT_HEADER_LENGTH;
+	align = (-align)&(SSL3_ALIGN_PAYLOAD-1);
+#endif
+
+	/* start with what was read ahead, always less than n */
+	got=rb->left;
+	memcpy(dst,rb->buf+rb->offset,got);
+	rb->left=0;
+
+	/* With released buffers nothing may be left behind in rbuf */
+	max=n;
+	if (!(s->mode & SSL_MODE_RELEASE_BUFFERS) &&
+		dst_len-n >= SSL3_RT_HEADER_LENGTH)
+		max+=SSL3_RT_HEADER_LENGTH;
+
+	while (got < n)
+		{
+		clear_sys_error();
+		if (s->rbio != NULL)
+			{
+			s->rwstate=SSL_READING;
+			i=BIO_read(s->rbio,dst+got,max-got);
+			}
+		else
+			{
+			SSLerr(SSL_F_SSL3_READ_N,SSL_R_READ_BIO_NOT_SET);
+			i= -1;
+			}
+
+		if (i <= 0)
+			{
+			if (s->packet != rb->buf+align)
+				{
+				memmove(rb->buf+align,s->packet,
+					SSL3_RT_HEADER_LENGTH);
+				s->packet=rb->buf+align;
+				}
+			rb->offset=align+SSL3_RT_HEADER_LENGTH;
+			memcpy(rb->buf+rb->offset,dst,got);
+			rb->left=got;
+			return(i);
+			}
+		got+=i;
+		}
+
+	/* the rest is the start of the next record */
+	rb->offset=align;
+	rb->left=got-n;
+	memcpy(rb->buf+align,dst+n,rb->left);
+	s->rwstate=SSL_NOTHING;
+	return(n);
+	}
+
+/* Reads and decrypts the next record into s->s3->rrec. If dst is given, an
+ * application data record that fits in its dst_len bytes is received and
+ * decrypted there instead of in rbuf, and *in_dst is set. */
+static int ssl3_get_record(SSL *s, unsigned char *dst, unsigned int dst_len,
+	int *in_dst)
 	{
 	int ssl_major,ssl_minor,al;
 	int enc_err,n,i,ret= -1;
@@ -290,11 +363,12 @@ static int ssl3_get_record(SSL *s)
 	unsigned char *p;
 	unsigned char md[EVP_MAX_MD_SIZE];
 	short version;
-	unsigned mac_size, orig_len;
+	unsigned mac_size, orig_len, body_len=0;
 	size_t extra;
 
 	rr= &(s->s3->rrec);
 	sess=s->session;
+	*in_dst=0;
 
 	if (s->options & SSL_OP_MICROSOFT_BIG_SSLV3_BUFFER)
 		extra=SSL3_RT_MAX_EXTRA;
@@ -361,7 +435,17 @@ fprintf(stderr, "Record type=%d, Length=%d\n", rr->type, rr->length);
 
 	/* s->rstate == SSL_ST_READ_BODY, get and decode the data */
 
-	if (rr->length > s->packet_length-SSL3_RT_HEADER_LENGTH)
+	*in_dst=0;
+	if (dst != NULL && rr->type == SSL3_RT_APPLICATION_DATA &&
+		rr->length <= dst_len && s->expand == NULL &&
+		s->packet_length == SSL3_RT_HEADER_LENGTH &&
+		s->s3->rbuf.left < rr->length)
+		{
+		n=ssl3_read_body_into(s,dst,dst_len,rr->length);
+		if (n <= 0) return(n); /* error or non-blocking io */
+		*in_dst=1;
+		}
+	else if (rr->length > s->packet_length-SSL3_RT_HEADER_LENGTH)
 		{
 		/* now s->packet_length == SSL3_RT_HEADER_LENGTH */
 		i=rr->length;
@@ -376,7 +460,11 @@ fprintf(stderr, "Record type=%d, Length=%d\n", rr->type, rr->length);
 	/* At this point, s->packet_length == SSL3_RT_HEADER_LNGTH + rr->length,
 	 * and we have that many bytes in s->packet
 	 */
-	rr->input= &(s->packet[SSL3_RT_HEADER_LENGTH]);
+	if (*in_dst)
+		rr->input=dst;
+	else
+		rr->input= &(s->packet[SSL3_RT_HEADER_LENGTH]);
+	body_len=rr->length;
 
 	/* ok, we can now read from 's->packet' data into 'rr'
 	 * rr->input points at rr->length bytes, which
@@ -533,6 +621,9 @@ fprintf(stderr, "Ultimate Record type=%d, Length=%d\n", rr->type, rr->length);
 f_err:
 	ssl3_send_alert(s,SSL3_AL_FATAL,al);
 err:
+	/* don't hand back the plaintext of a record that failed */
+	if (*in_dst)
+		OPENSSL_cleanse(dst,body_len);
 	return(ret);
 	}
 
@@ -577,6 +668,124 @@ int ssl3_do_compress(SSL *ssl)
 /* Call this to write data in records of type 'type'
  * It will return <= 0 if not all data has been sent or non-blocking IO.
  */
+#ifndef OPENSSL_NO_MULTIBLOCK
+/* Writes as much of 'buf' as possible in groups of 4 or 8 records.
+ * '*tot' is updated with the bytes consumed; the tail (less than 4
+ * records) is left for the regular code path. Returns 1 on success.
+ * The enlarged write buffer is kept for the following writes (it is
+ * large enough for regular records too) until ssl3_release_write_buffer()
+ * drops it, i.e. on SSL_MODE_RELEASE_BUFFERS or when the SSL is freed.
+ */
+static int ssl3_write_multiblock(SSL *s, const unsigned char *buf, int len,
+				 unsigned int *tot)
+	{
+	SSL3_BUFFER *wb=&(s->s3->wbuf);
+	EVP_CTRL_TLS1_1_MULTIBLOCK_PARAM mb_param;
+	unsigned char aad[13];
+	unsigned int frag, n, nw;
+	int i, j, packlen;
+
+	frag = s->max_send_fragment;
+
+	/* A group of records left pending by a previous call */
+	if (wb->left != 0)
+		{
+		i = ssl3_write_pending(s, SSL3_RT_APPLICATION_DATA,
+				       &buf[*tot], s->s3->wpend_tot);
+		if (i <= 0)
+			{
+			s->s3->wnum = *tot;
+			return i;
+			}
+		*tot += i;
+		}
+
+	for (;;)
+		{
+		n = len - *tot;
+		if (n < 4*frag)
+			break;
+
+		if (s->s3->alert_dispatch)
+			{
+			i = s->method->ssl_dispatch_alert(s);
+			if (i <= 0)
+				{
+				s->s3->wnum = *tot;
+				return i;
+				}
+			}
+
+		mb_param.interleave = (n >= 8*frag) ? 8 : 4;
+		nw = frag * mb_param.interleave;
+
+		memcpy(aad, s->s3->write_sequence, 8);
+		aad[8] = SSL3_RT_APPLICATION_DATA;
+		aad[9] = (unsigned char)(s->version>>8);
+		aad[10] = (unsigned char)(s->version);
+		aad[11] = 0;
+		aad[12] = 0;
+
+		mb_param.out = NULL;
+		mb_param.inp = aad;
+		mb_param.len = nw;
+
+		packlen = EVP_CIPHER_CTX_ctrl(s->enc_write_ctx,
+			EVP_CTRL_TLS1_1_MULTIBLOCK_AAD, sizeof(mb_param), &mb_param);
+		if (packlen <= 0)
+			break;
+
+		if (wb->buf == NULL || wb->len < (size_t)packlen)
+			{
+			ssl3_release_write_buffer(s);
+			if ((wb->buf = OPENSSL_malloc(packlen)) == NULL)
+				{
+				SSLerr(SSL_F_SSL3_WRITE_BYTES, ERR_R_MALLOC_FAILURE);
+				return -1;
+				}
+			wb->len = packlen;
+			s->s3->wbuf_jumbo = 1;
+			}
+
+		mb_param.out = wb->buf;
+		mb_param.inp = &buf[*tot];
+		mb_param.len = nw;
+
+		if (EVP_CIPHER_CTX_ctrl(s->enc_write_ctx,
+			EVP_CTRL_TLS1_1_MULTIBLOCK_ENCRYPT, sizeof(mb_param), &mb_param) != packlen)
+			{
+			SSLerr(SSL_F_SSL3_WRITE_BYTES, ERR_R_INTERNAL_ERROR);
+			return -1;
+			}
+
+		/* write_sequence += interleave */
+		for (i = mb_param.interleave; i > 0; i--)
+			{
+			for (j = 7; j >= 0; j--)
+				if (++s->s3->write_sequence[j]) break;
+			}
+
+		wb->offset = 0;
+		wb->left = packlen;
+
+		s->s3->wpend_tot = nw;
+		s->s3->wpend_buf = &buf[*tot];
+		s->s3->wpend_type = SSL3_RT_APPLICATION_DATA;
+		s->s3->wpend_ret = nw;
+
+		i = ssl3_write_pending(s, SSL3_RT_APPLICATION_DATA, &buf[*tot], nw);
+		if (i <= 0)
+			{
+			s->s3->wnum = *tot;
+			return i;
+			}
+		*tot += i;
+		}
+
+	return 1;
+	}
+#endif
+
 int ssl3_write_bytes(SSL *s, int type, const void *buf_, int len)
 	{
 	const unsigned char *buf=buf_;
@@ -598,6 +807,30 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, int len)
 			}
 		}
 
+#ifndef OPENSSL_NO_MULTIBLOCK
+	/* Bulk application data with a cipher able to encrypt several
+	 * records at once: 4 or 8 full sized records are built in a
+	 * single buffer and written out with one BIO_write() call. The
+	 * records never go through do_ssl3_write(), so not with a message
+	 * callback, which would miss their headers.
+	 */
+	if (type == SSL3_RT_APPLICATION_DATA &&
+	    len >= 4*(int)s->max_send_fragment &&
+	    s->version >= TLS1_1_VERSION &&
+	    s->compress == NULL &&
+	    !(s->mode & SSL_MODE_RELEASE_BUFFERS) &&
+	    s->msg_callback == NULL &&
+	    s->enc_write_ctx != NULL &&
+	    EVP_CIPHER_flags(s->enc_write_ctx->cipher) & EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK)
+		{
+		i = ssl3_write_multiblock(s, buf, len, &tot);
+		if (i <= 0)
+			return i;
+		if (tot == (unsigned int)len)
+			return tot;
+		}
+#endif
+
 	n=(len-tot);
 	for (;;)
 		{
@@ -940,7 +1173,7 @@ int ssl3_write_pending(SSL *s, int type, const unsigned char *buf,
  */
 int ssl3_read_bytes(SSL *s, int type, unsigned char *buf, int len, int peek)
 	{
-	int al,i,j,ret;
+	int al,i,j,ret,in_buf=0;
 	unsigned int n;
 	SSL3_RECORD *rr;
 	void (*cb)(const SSL *ssl,int type2,int val)=NULL;
@@ -1002,7 +1235,11 @@ start:
 	/* get new packet if necessary */
 	if ((rr->length == 0) || (s->rstate == SSL_ST_READ_BODY))
 		{
-		ret=ssl3_get_record(s);
+		if ((s->mode & SSL_MODE_ZERO_COPY_READ) && !peek &&
+			type == SSL3_RT_APPLICATION_DATA && len > 0)
+			ret=ssl3_get_record(s,buf,(unsigned int)len,&in_buf);
+		else
+			ret=ssl3_get_record(s,NULL,0,&in_buf);
 		if (ret <= 0) return(ret);
 		}
 
@@ -1046,7 +1283,15 @@ start:
 		else
 			n = (unsigned int)len;
 
-		memcpy(buf,&(rr->data[rr->off]),n);
+		/* The record may have been decrypted in buf already, with
+		 * an explicit IV in front of the data */
+		if (in_buf)
+			{
+			if (rr->data != buf)
+				memmove(buf,rr->data,n);
+			}
+		else
+			memcpy(buf,&(rr->data[rr->off]),n);
 		if (!peek)
 			{
 			rr->length-=n;
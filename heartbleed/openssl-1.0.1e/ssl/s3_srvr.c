@@ -564,6 +564,8 @@ int ssl3_accept(SSL *s)
 			 * unconditionally.
 			 */
 
+			ret=ssl3_write_flight(s);
+			if (ret <= 0) goto end;
 			s->rwstate=SSL_WRITING;
 			if (BIO_flush(s->wbio) <= 0)
 				{
@@ -1584,6 +1586,7 @@ int ssl3_send_server_key_exchange(SSL *s)
 	int nr[4],kn;
 	BUF_MEM *buf;
 	EVP_MD_CTX md_ctx;
+	size_t siglen;
 
 	EVP_MD_CTX_init(&md_ctx);
 	if (s->state == SSL3_ST_SW_KEY_EXCH_A)
@@ -1593,6 +1596,20 @@ int ssl3_send_server_key_exchange(SSL *s)
 
 		buf=s->init_buf;
 
+		if (s->pkey_op != NULL)
+			{
+			/* The parameters went out to the private key method
+			 * with their signature; they are still in init_buf
+			 * and init_num has their length. */
+			if (type & SSL_kRSA)
+				s->s3->tmp.use_rsa_tmp=1;
+			pkey=ssl_get_sign_pkey(s,s->s3->tmp.new_cipher,&md);
+			n=s->init_num;
+			d=(unsigned char *)s->init_buf->data;
+			p= &(d[4+n]);
+			goto sign;
+			}
+
 		r[0]=r[1]=r[2]=r[3]=NULL;
 		n=0;
 #ifndef OPENSSL_NO_RSA
@@ -1925,6 +1942,7 @@ int ssl3_send_server_key_exchange(SSL *s)
 			}
 #endif
 
+sign:
 		/* not anonymous */
 		if (pkey != NULL)
 			{
@@ -1950,7 +1968,19 @@ int ssl3_send_server_key_exchange(SSL *s)
 					q+=i;
 					j+=i;
 					}
-				if (RSA_sign(NID_md5_sha1, md_buf, j,
+				if (s->ctx->private_key_method != NULL)
+					{
+					siglen=EVP_PKEY_size(pkey);
+					i=ssl_private_key_op(s,SSL_PKEY_OP_SIGN,
+						pkey,NID_md5_sha1,md_buf,j,
+						&(p[2]),&siglen);
+					if (i == 0)
+						goto pending;
+					if (i < 0)
+						goto err;
+					u=(unsigned int)siglen;
+					}
+				else if (RSA_sign(NID_md5_sha1, md_buf, j,
 					&(p[2]), &u, pkey->pkey.rsa) <= 0)
 					{
 					SSLerr(SSL_F_SSL3_SEND_SERVER_KEY_EXCHANGE,ERR_LIB_RSA);
@@ -1984,7 +2014,25 @@ int ssl3_send_server_key_exchange(SSL *s)
 				EVP_SignUpdate(&md_ctx,&(s->s3->client_random[0]),SSL3_RANDOM_SIZE);
 				EVP_SignUpdate(&md_ctx,&(s->s3->server_random[0]),SSL3_RANDOM_SIZE);
 				EVP_SignUpdate(&md_ctx,&(d[4]),n);
-				if (!EVP_SignFinal(&md_ctx,&(p[2]),
+				if (s->ctx->private_key_method != NULL)
+					{
+					unsigned char dgst[EVP_MAX_MD_SIZE];
+					unsigned int dlen;
+
+					/* the method gets the digest, as
+					 * EVP_SignFinal() would sign it */
+					EVP_DigestFinal_ex(&md_ctx,dgst,&dlen);
+					siglen=EVP_PKEY_size(pkey);
+					i=ssl_private_key_op(s,SSL_PKEY_OP_SIGN,
+						pkey,EVP_MD_type(md),dgst,dlen,
+						&(p[2]),&siglen);
+					if (i == 0)
+						goto pending;
+					if (i < 0)
+						goto err;
+					i=(int)siglen;
+					}
+				else if (!EVP_SignFinal(&md_ctx,&(p[2]),
 					(unsigned int *)&i,pkey))
 					{
 					SSLerr(SSL_F_SSL3_SEND_SERVER_KEY_EXCHANGE,ERR_LIB_EVP);
@@ -2016,6 +2064,11 @@ int ssl3_send_server_key_exchange(SSL *s)
 	s->state = SSL3_ST_SW_KEY_EXCH_B;
 	EVP_MD_CTX_cleanup(&md_ctx);
 	return(ssl3_do_write(s,SSL3_RT_HANDSHAKE));
+pending:
+	/* come back to SSL3_ST_SW_KEY_EXCH_A when the signature is done */
+	s->init_num=n;
+	EVP_MD_CTX_cleanup(&md_ctx);
+	return(-1);
 f_err:
 	ssl3_send_alert(s,SSL3_AL_FATAL,al);
 err:
@@ -2211,7 +2264,24 @@ int ssl3_get_client_key_exchange(SSL *s)
 				n=i;
 			}
 
-		i=RSA_private_decrypt((int)n,p,p,rsa,RSA_PKCS1_PADDING);
+		if (pkey != NULL && s->ctx->private_key_method != NULL)
+			{
+			size_t len=n;
+
+			i=ssl_private_key_op(s,SSL_PKEY_OP_DECRYPT,pkey,
+				NID_undef,p,n,p,&len);
+			if (i == 0)
+				{
+				/* read the same message again when the
+				 * method has finished */
+				s->s3->tmp.reuse_message=1;
+				return(-1);
+				}
+			/* a failure is treated as a bad padding below */
+			i=(i > 0) ? (int)len : -1;
+			}
+		else
+			i=RSA_private_decrypt((int)n,p,p,rsa,RSA_PKCS1_PADDING);
 
 		al = -1;
 		
@@ -3237,7 +3307,7 @@ int ssl3_get_client_certificate(SSL *s)
 			}
 
 		q=p;
-		x=d2i_X509(NULL,&p,l);
+		x=ssl_d2i_peer_cert(s,&p,l,sk_X509_num(sk));
 		if (x == NULL)
 			{
 			SSLerr(SSL_F_SSL3_GET_CLIENT_CERTIFICATE,ERR_R_ASN1_LIB);
@@ -288,6 +288,7 @@ extern "C" {
 #define SSL_TXT_AES256		"AES256"
 #define SSL_TXT_AES		"AES"
 #define SSL_TXT_AES_GCM		"AESGCM"
+#define SSL_TXT_CHACHA20	"CHACHA20"
 #define SSL_TXT_CAMELLIA128	"CAMELLIA128"
 #define SSL_TXT_CAMELLIA256	"CAMELLIA256"
 #define SSL_TXT_CAMELLIA	"CAMELLIA"
@@ -641,6 +642,14 @@ struct ssl_session_st
  * TLS only.)  "Released" buffers are put onto a free-list in the context
  * or just freed (depending on the context's setting for freelist_max_len). */
 #define SSL_MODE_RELEASE_BUFFERS 0x00000010L
+/* Queue the handshake messages of a flight and send them packed into as
+ * few records, and a single write to the transport, as possible instead
+ * of one record per message. (SSL3 and TLS only.) */
+#define SSL_MODE_COALESCE_FLIGHT 0x00000020L
+/* Receive and decrypt application data records directly in the buffer
+ * passed to SSL_read() when they fit, and read the header of the next
+ * record along with each record body. (SSL3 and TLS only.) */
+#define SSL_MODE_ZERO_COPY_READ 0x00000040L
 
 /* Note: SSL[_CTX]_set_{options,mode} use |= op on the previous value,
  * they cannot be used to clear bits. */
@@ -750,6 +759,47 @@ typedef int (*GEN_SESSION_CB)(const SSL *ssl, unsigned char *id,
 
 typedef struct ssl_comp_st SSL_COMP;
 
+/* A server's private key operation, handed to an SSL_PRIVATE_KEY_METHOD
+ * so that it can be run outside the handshake. For SSL_PKEY_OP_SIGN, |in|
+ * is a digest of type |md_nid| (NID_md5_sha1 for the MD5+SHA1 hash that
+ * RSA signs below TLS 1.2; ignored for DSA and ECDSA); for
+ * SSL_PKEY_OP_DECRYPT it is a PKCS #1 v1.5 RSA ciphertext. The result goes
+ * to |out|, which has room for EVP_PKEY_size(pkey) bytes, with its length
+ * in |out_len|. */
+typedef struct ssl_pkey_op_st
+	{
+	int type;
+	EVP_PKEY *pkey;
+	int md_nid;
+	unsigned char *in;
+	size_t in_len;
+	unsigned char *out;
+	size_t out_len;
+	int fd;			/* returned by start() */
+	const struct ssl_private_key_method_st *meth;
+	void *meth_arg;
+	void *meth_data;	/* for the method's own use */
+	} SSL_PKEY_OP;
+
+#define SSL_PKEY_OP_SIGN	1
+#define SSL_PKEY_OP_DECRYPT	2
+
+/* start() begins |op| and returns a file descriptor that becomes readable
+ * once it has finished, or -1 on error. complete() returns 1 if |op| has
+ * succeeded, 0 while it is still running and -1 if it failed; once it has
+ * returned non-zero the fd is no longer used. cancel() is called instead
+ * if the SSL goes away first, and hands |op| over to the method, which
+ * must release it with SSL_PKEY_OP_free() when it is done with it. */
+typedef struct ssl_private_key_method_st
+	{
+	const char *name;
+	int (*start)(SSL *s, SSL_PKEY_OP *op, void *arg);
+	int (*complete)(SSL *s, SSL_PKEY_OP *op, void *arg);
+	void (*cancel)(SSL_PKEY_OP *op, void *arg);
+	} SSL_PRIVATE_KEY_METHOD;
+
+typedef struct ssl_pkey_pool_st SSL_PKEY_POOL;
+
 #ifndef OPENSSL_NO_SSL_INTERN
 
 struct ssl_comp_st
@@ -978,6 +1028,18 @@ struct ssl_ctx_st
         /* SRTP profiles we are willing to do from RFC 5764 */
         STACK_OF(SRTP_PROTECTION_PROFILE) *srtp_profiles;  
 #endif
+	/* Runs server private key operations outside the handshake */
+	const SSL_PRIVATE_KEY_METHOD *private_key_method;
+	void *private_key_method_arg;
+
+	/* Decoded certificates from peer chains, shared by all connections */
+	struct ssl_peer_chain_cache_st *peer_chain_cache;
+
+	/* Shards of the internal session cache (see ssl_sess.c). The
+	 * first one is made of sessions, session_cache_head and
+	 * session_cache_tail above; the others are only used with
+	 * SSL_SESS_CACHE_SHARDED. */
+	struct ssl_sess_shard_st *sess_shards;
 	};
 
 #endif
@@ -992,8 +1054,10 @@ struct ssl_ctx_st
 #define SSL_SESS_CACHE_NO_INTERNAL_STORE	0x0200
 #define SSL_SESS_CACHE_NO_INTERNAL \
 	(SSL_SESS_CACHE_NO_INTERNAL_LOOKUP|SSL_SESS_CACHE_NO_INTERNAL_STORE)
+#define SSL_SESS_CACHE_SHARDED			0x0400
 
 LHASH_OF(SSL_SESSION) *SSL_CTX_sessions(SSL_CTX *ctx);
+LHASH_OF(SSL_SESSION) *SSL_CTX_sessions_shard(SSL_CTX *ctx, int shard);
 #define SSL_CTX_sess_number(ctx) \
 	SSL_CTX_ctrl(ctx,SSL_CTRL_SESS_NUMBER,0,NULL)
 #define SSL_CTX_sess_connect(ctx) \
@@ -1090,12 +1154,14 @@ const char *SSL_get_psk_identity(const SSL *s);
 #define SSL_WRITING	2
 #define SSL_READING	3
 #define SSL_X509_LOOKUP	4
+#define SSL_ASYNC_PKEY	5
 
 /* These will only be used when doing non-blocking IO */
 #define SSL_want_nothing(s)	(SSL_want(s) == SSL_NOTHING)
 #define SSL_want_read(s)	(SSL_want(s) == SSL_READING)
 #define SSL_want_write(s)	(SSL_want(s) == SSL_WRITING)
 #define SSL_want_x509_lookup(s)	(SSL_want(s) == SSL_X509_LOOKUP)
+#define SSL_want_async(s)	(SSL_want(s) == SSL_ASYNC_PKEY)
 
 #define SSL_MAC_FLAG_READ_MAC_STREAM 1
 #define SSL_MAC_FLAG_WRITE_MAC_STREAM 2
@@ -1352,6 +1418,9 @@ struct ssl_st
 #ifndef OPENSSL_NO_SRP
 	SRP_CTX srp_ctx; /* ctx for SRP authentication */
 #endif
+
+	/* Private key operation in progress, see SSL_PRIVATE_KEY_METHOD */
+	SSL_PKEY_OP *pkey_op;
 	};
 
 #endif
@@ -1509,6 +1578,7 @@ DECLARE_PEM_rw(SSL_SESSION, SSL_SESSION)
 #define SSL_ERROR_ZERO_RETURN		6
 #define SSL_ERROR_WANT_CONNECT		7
 #define SSL_ERROR_WANT_ACCEPT		8
+#define SSL_ERROR_WANT_ASYNC		9
 
 #define SSL_CTRL_NEED_TMP_RSA			1
 #define SSL_CTRL_SET_TMP_RSA			2
@@ -1609,6 +1679,10 @@ DECLARE_PEM_rw(SSL_SESSION, SSL_SESSION)
 #define SSL_CTRL_GET_EXTRA_CHAIN_CERTS		82
 #define SSL_CTRL_CLEAR_EXTRA_CHAIN_CERTS	83
 
+#define SSL_CTRL_SET_PEER_CHAIN_CACHE_SIZE	88
+#define SSL_CTRL_GET_PEER_CHAIN_CACHE_HITS	89
+#define SSL_CTRL_FLUSH_CERT_CHAINS		90
+
 #define DTLSv1_get_timeout(ssl, arg) \
 	SSL_ctrl(ssl,DTLS_CTRL_GET_TIMEOUT,0, (void *)arg)
 #define DTLSv1_handle_timeout(ssl) \
@@ -1650,6 +1724,14 @@ DECLARE_PEM_rw(SSL_SESSION, SSL_SESSION)
 #define SSL_CTX_clear_extra_chain_certs(ctx) \
 	SSL_CTX_ctrl(ctx,SSL_CTRL_CLEAR_EXTRA_CHAIN_CERTS,0,NULL)
 
+#define SSL_MAX_PEER_CHAIN_CACHE_SIZE	65536
+#define SSL_CTX_set_peer_chain_cache_size(ctx,n) \
+	SSL_CTX_ctrl(ctx,SSL_CTRL_SET_PEER_CHAIN_CACHE_SIZE,n,NULL)
+#define SSL_CTX_peer_chain_cache_hits(ctx) \
+	SSL_CTX_ctrl(ctx,SSL_CTRL_GET_PEER_CHAIN_CACHE_HITS,0,NULL)
+#define SSL_CTX_flush_cert_chains(ctx) \
+	SSL_CTX_ctrl(ctx,SSL_CTRL_FLUSH_CERT_CHAINS,0,NULL)
+
 #ifndef OPENSSL_NO_BIO
 BIO_METHOD *BIO_f_ssl(void);
 BIO *BIO_new_ssl(SSL_CTX *ctx,int client);
@@ -2044,6 +2126,16 @@ int SSL_set_session_secret_cb(SSL *s, tls_session_secret_cb_fn tls_session_secre
 void SSL_set_debug(SSL *s, int debug);
 int SSL_cache_hit(SSL *s);
 
+/* Server private key operations outside the handshake */
+void SSL_CTX_set_private_key_method(SSL_CTX *ctx,
+	const SSL_PRIVATE_KEY_METHOD *meth, void *arg);
+int SSL_get_async_fd(const SSL *s);
+int SSL_PKEY_OP_run(SSL_PKEY_OP *op);
+void SSL_PKEY_OP_free(SSL_PKEY_OP *op);
+SSL_PKEY_POOL *SSL_PKEY_POOL_new(int threads);
+void SSL_PKEY_POOL_free(SSL_PKEY_POOL *pool);
+const SSL_PRIVATE_KEY_METHOD *SSL_PKEY_POOL_method(void);
+
 /* BEGIN ERROR CODES */
 /* The following lines are auto generated by the script mkerr.pl. Any changes
  * made after this point may be overwritten when the script is next run.
@@ -2129,6 +2221,7 @@ void ERR_load_SSL_strings(void);
 #define SSL_F_SSL3_CTX_CTRL				 133
 #define SSL_F_SSL3_DIGEST_CACHED_RECORDS		 293
 #define SSL_F_SSL3_DO_CHANGE_CIPHER_SPEC		 292
+#define SSL_F_SSL3_DO_WRITE				 318
 #define SSL_F_SSL3_ENC					 134
 #define SSL_F_SSL3_GENERATE_KEY_BLOCK			 238
 #define SSL_F_SSL3_GET_CERTIFICATE_REQUEST		 135
@@ -2223,8 +2316,10 @@ void ERR_load_SSL_strings(void);
 #define SSL_F_SSL_PARSE_SERVERHELLO_TLSEXT		 303
 #define SSL_F_SSL_PARSE_SERVERHELLO_USE_SRTP_EXT	 311
 #define SSL_F_SSL_PEEK					 270
+#define SSL_F_SSL_PKEY_POOL_NEW				 319
 #define SSL_F_SSL_PREPARE_CLIENTHELLO_TLSEXT		 281
 #define SSL_F_SSL_PREPARE_SERVERHELLO_TLSEXT		 282
+#define SSL_F_SSL_PRIVATE_KEY_OP			 320
 #define SSL_F_SSL_READ					 223
 #define SSL_F_SSL_RSA_PRIVATE_DECRYPT			 187
 #define SSL_F_SSL_RSA_PUBLIC_ENCRYPT			 188
@@ -2445,6 +2540,7 @@ void ERR_load_SSL_strings(void);
 #define SSL_R_PEER_ERROR_NO_CIPHER			 203
 #define SSL_R_PEER_ERROR_UNSUPPORTED_CERTIFICATE_TYPE	 204
 #define SSL_R_PRE_MAC_LENGTH_TOO_LONG			 205
+#define SSL_R_PRIVATE_KEY_OPERATION_FAILED		 371
 #define SSL_R_PROBLEMS_MAPPING_CIPHER_FUNCTIONS		 206
 #define SSL_R_PROTOCOL_IS_SHUTDOWN			 207
 #define SSL_R_PSK_IDENTITY_NOT_FOUND			 223
@@ -2503,6 +2599,7 @@ void ERR_load_SSL_strings(void);
 #define SSL_R_SSL_SESSION_ID_CONTEXT_TOO_LONG		 273
 #define SSL_R_SSL_SESSION_ID_HAS_BAD_LENGTH		 303
 #define SSL_R_SSL_SESSION_ID_IS_DIFFERENT		 231
+#define SSL_R_THREADS_NOT_SUPPORTED			 372
 #define SSL_R_TLSV1_ALERT_ACCESS_DENIED			 1049
 #define SSL_R_TLSV1_ALERT_DECODE_ERROR			 1050
 #define SSL_R_TLSV1_ALERT_DECRYPTION_FAILED		 1021
@@ -539,6 +539,12 @@ typedef struct ssl3_state_st
 	/* Set if we saw the Next Protocol Negotiation extension from our peer. */
 	int next_proto_neg_seen;
 #endif
+
+	/* Handshake messages queued by SSL_MODE_COALESCE_FLIGHT */
+	BUF_MEM *flight;
+
+	/* Set while wbuf is the enlarged multi-block write buffer */
+	int wbuf_jumbo;
 	} SSL3_STATE;
 
 #endif
@@ -387,8 +387,11 @@ void ssl_cert_free(CERT *c)
 	if (c->ecdh_tmp) EC_KEY_free(c->ecdh_tmp);
 #endif
 
+	/* No one else can see c any more, so no need to lock */
 	for (i=0; i<SSL_PKEY_NUM; i++)
 		{
+		if (c->pkeys[i].chain_der != NULL)
+			OPENSSL_free(c->pkeys[i].chain_der);
 		if (c->pkeys[i].x509 != NULL)
 			X509_free(c->pkeys[i].x509);
 		if (c->pkeys[i].privatekey != NULL)
@@ -401,6 +404,29 @@ void ssl_cert_free(CERT *c)
 	OPENSSL_free(c);
 	}
 
+/* Drops the encoded certificate lists kept by ssl3_output_cert_chain().
+ * Called whenever something they were built from changes. Takes
+ * CRYPTO_LOCK_SSL_CTX, which the caller must not hold. */
+void ssl_cert_flush_chains(CERT *c)
+	{
+	int i;
+
+	if (c == NULL)
+		return;
+	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+	c->chain_gen++;
+	for (i=0; i<SSL_PKEY_NUM; i++)
+		{
+		if (c->pkeys[i].chain_der != NULL)
+			{
+			OPENSSL_free(c->pkeys[i].chain_der);
+			c->pkeys[i].chain_der=NULL;
+			c->pkeys[i].chain_der_len=0;
+			}
+		}
+	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+	}
+
 int ssl_cert_inst(CERT **o)
 	{
 	/* Create a CERT if there isn't already one
@@ -506,6 +532,148 @@ int ssl_set_peer_cert_type(SESS_CERT *sc,int type)
 	return(1);
 	}
 
+/* The signature at the end of a certificate makes its last bytes
+ * distinctive enough to index on; matches are confirmed on the whole
+ * encoding. */
+#define SSL_PEER_CHAIN_HASH_BYTES	64
+
+static unsigned long ssl_peer_chain_hash(const unsigned char *p, long len)
+	{
+	unsigned long h=(unsigned long)len;
+	long i;
+
+	i = len > SSL_PEER_CHAIN_HASH_BYTES ? len-SSL_PEER_CHAIN_HASH_BYTES : 0;
+	for (; i<len; i++)
+		h=((h<<5)+h+p[i])&0xffffffffL;
+	return(h);
+	}
+
+void ssl_peer_chain_cache_flush(struct ssl_peer_chain_cache_st *c)
+	{
+	SSL_PEER_CHAIN_ENTRY *e;
+	int i;
+
+	if (c == NULL)
+		return;
+	for (i=0; i<c->size; i++)
+		{
+		e=&c->entries[i];
+		if (e->x509 != NULL)
+			X509_free(e->x509);
+		if (e->der != NULL)
+			OPENSSL_free(e->der);
+		}
+	memset(c->entries,0,c->size*sizeof(SSL_PEER_CHAIN_ENTRY));
+	}
+
+void ssl_peer_chain_cache_free(struct ssl_peer_chain_cache_st *c)
+	{
+	if (c == NULL)
+		return;
+	ssl_peer_chain_cache_flush(c);
+	OPENSSL_free(c->entries);
+	OPENSSL_free(c);
+	}
+
+int ssl_peer_chain_cache_set_size(SSL_CTX *ctx, long size)
+	{
+	struct ssl_peer_chain_cache_st *c=NULL,*old;
+
+	if (size < 0 || size > SSL_MAX_PEER_CHAIN_CACHE_SIZE)
+		return(0);
+	if (size > 0)
+		{
+		c=OPENSSL_malloc(sizeof *c);
+		if (c == NULL)
+			return(0);
+		c->entries=OPENSSL_malloc(size*sizeof(SSL_PEER_CHAIN_ENTRY));
+		if (c->entries == NULL)
+			{
+			OPENSSL_free(c);
+			return(0);
+			}
+		memset(c->entries,0,size*sizeof(SSL_PEER_CHAIN_ENTRY));
+		c->size=(int)size;
+		c->hits=c->misses=0;
+		}
+
+	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+	old=ctx->peer_chain_cache;
+	ctx->peer_chain_cache=c;
+	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+	ssl_peer_chain_cache_free(old);
+	return(1);
+	}
+
+/* Decodes the certificate at depth 'depth' of a peer's Certificate
+ * message like d2i_X509(). Certificates above the leaf are the same for
+ * many peers, so with a cache on the SSL_CTX they are decoded once and
+ * shared. */
+X509 *ssl_d2i_peer_cert(SSL *s, const unsigned char **pp, long length,
+	int depth)
+	{
+	struct ssl_peer_chain_cache_st *c;
+	SSL_PEER_CHAIN_ENTRY *e;
+	const unsigned char *p= *pp;
+	unsigned char *der,*old_der=NULL;
+	X509 *x,*old_x=NULL;
+	unsigned long h;
+
+	if (depth == 0 || s->ctx->peer_chain_cache == NULL || length <= 0)
+		return(d2i_X509(NULL,pp,length));
+
+	h=ssl_peer_chain_hash(p,length);
+	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+	c=s->ctx->peer_chain_cache;
+	if (c != NULL)
+		{
+		e=&c->entries[h%c->size];
+		if (e->x509 != NULL && e->hash == h && e->length == length &&
+			memcmp(e->der,p,length) == 0)
+			{
+			x=e->x509;
+			CRYPTO_add(&x->references,1,CRYPTO_LOCK_X509);
+			c->hits++;
+			CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+			*pp=p+length;
+			return(x);
+			}
+		c->misses++;
+		}
+	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+	x=d2i_X509(NULL,pp,length);
+	/* Only whole encodings are kept; the caller rejects the rest */
+	if (x == NULL || *pp != p+length)
+		return(x);
+	if ((der=BUF_memdup(p,length)) == NULL)
+		return(x);
+
+	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+	c=s->ctx->peer_chain_cache;
+	if (c != NULL)
+		{
+		e=&c->entries[h%c->size];
+		old_der=e->der;
+		old_x=e->x509;
+		e->hash=h;
+		e->length=length;
+		e->der=der;
+		e->x509=x;
+		CRYPTO_add(&x->references,1,CRYPTO_LOCK_X509);
+		}
+	else
+		old_der=der;
+	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+
+	if (old_x != NULL)
+		X509_free(old_x);
+	if (old_der != NULL)
+		OPENSSL_free(old_der);
+	return(x);
+	}
+
 int ssl_verify_cert_chain(SSL *s,STACK_OF(X509) *sk)
 	{
 	X509 *x;
@@ -197,6 +197,8 @@ int SSL_clear(SSL *s)
 		s->session=NULL;
 		}
 
+	ssl_private_key_cancel(s);
+
 	s->error=0;
 	s->hit=0;
 	s->shutdown=0;
@@ -447,6 +449,7 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
 	 * any new session built out of this id/id_len and the ssl_version in
 	 * use by this SSL. */
 	SSL_SESSION r, *p;
+	SSL_SESS_SHARD *sh;
 
 	if(id_len > sizeof r.session_id)
 		return 0;
@@ -466,9 +469,10 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
 		r.session_id_length = SSL2_SSL_SESSION_ID_LENGTH;
 		}
 
-	CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
-	p = lh_SSL_SESSION_retrieve(ssl->ctx->sessions, &r);
-	CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+	sh = ssl_sess_shard(ssl->ctx, &r);
+	ssl_sess_shard_r_lock(sh);
+	p = lh_SSL_SESSION_retrieve(sh->sessions, &r);
+	ssl_sess_shard_r_unlock(sh);
 	return (p != NULL);
 	}
 
@@ -522,6 +526,8 @@ void SSL_free(SSL *s)
 		}
 #endif
 
+	ssl_private_key_cancel(s);
+
 	if (s->param)
 		X509_VERIFY_PARAM_free(s->param);
 
@@ -1125,9 +1131,17 @@ LHASH_OF(SSL_SESSION) *SSL_CTX_sessions(SSL_CTX *ctx)
 	return ctx->sessions;
 	}
 
+LHASH_OF(SSL_SESSION) *SSL_CTX_sessions_shard(SSL_CTX *ctx, int shard)
+	{
+	if (shard < 0 || shard >= SSL_SESS_SHARDS_NUM(ctx))
+		return NULL;
+	return ctx->sess_shards[shard].sessions;
+	}
+
 long SSL_CTX_ctrl(SSL_CTX *ctx,int cmd,long larg,void *parg)
 	{
 	long l;
+	int i;
 
 	switch (cmd)
 		{
@@ -1157,13 +1171,20 @@ long SSL_CTX_ctrl(SSL_CTX *ctx,int cmd,long larg,void *parg)
 		return(ctx->session_cache_size);
 	case SSL_CTRL_SET_SESS_CACHE_MODE:
 		l=ctx->session_cache_mode;
-		ctx->session_cache_mode=larg;
+		/* ssl_sess_set_sharded() flips SSL_SESS_CACHE_SHARDED once
+		 * the sessions are in place */
+		if ((l^larg)&SSL_SESS_CACHE_SHARDED)
+			ssl_sess_set_sharded(ctx,larg&SSL_SESS_CACHE_SHARDED);
+		ctx->session_cache_mode=(larg&~SSL_SESS_CACHE_SHARDED)|
+			(ctx->session_cache_mode&SSL_SESS_CACHE_SHARDED);
 		return(l);
 	case SSL_CTRL_GET_SESS_CACHE_MODE:
 		return(ctx->session_cache_mode);
 
 	case SSL_CTRL_SESS_NUMBER:
-		return(lh_SSL_SESSION_num_items(ctx->sessions));
+		for (l=0, i=0; i<SSL_SESS_SHARDS_NUM(ctx); i++)
+			l+=lh_SSL_SESSION_num_items(ctx->sess_shards[i].sessions);
+		return(l);
 	case SSL_CTRL_SESS_CONNECT:
 		return(ctx->stats.sess_connect);
 	case SSL_CTRL_SESS_CONNECT_GOOD:
@@ -1199,6 +1220,19 @@ long SSL_CTX_ctrl(SSL_CTX *ctx,int cmd,long larg,void *parg)
 			return 0;
 		ctx->max_send_fragment = larg;
 		return 1;
+	case SSL_CTRL_SET_PEER_CHAIN_CACHE_SIZE:
+		return(ssl_peer_chain_cache_set_size(ctx,larg));
+	case SSL_CTRL_GET_PEER_CHAIN_CACHE_HITS:
+		CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
+		l=ctx->peer_chain_cache ? (long)ctx->peer_chain_cache->hits : 0;
+		CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+		return(l);
+	case SSL_CTRL_FLUSH_CERT_CHAINS:
+		ssl_cert_flush_chains(ctx->cert);
+		CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
+		ssl_peer_chain_cache_flush(ctx->peer_chain_cache);
+		CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+		return 1;
 	default:
 		return(ctx->method->ssl_ctx_ctrl(ctx,cmd,larg,parg));
 		}
@@ -1679,6 +1713,8 @@ static IMPLEMENT_LHASH_COMP_FN(ssl_session, SSL_SESSION)
 SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
 	{
 	SSL_CTX *ret=NULL;
+	SSL_SESS_SHARD *sh;
+	int i;
 
 	if (meth == NULL)
 		{
@@ -1758,6 +1794,26 @@ SSL_CTX *SSL_CTX_new(const SSL_METHOD *meth)
 
 	ret->sessions=lh_SSL_SESSION_new();
 	if (ret->sessions == NULL) goto err;
+	/* The first shard is the cache above, the others are only used
+	 * with SSL_SESS_CACHE_SHARDED */
+	ret->sess_shards=OPENSSL_malloc(SSL_SESS_CACHE_SHARDS*
+		sizeof(SSL_SESS_SHARD));
+	if (ret->sess_shards == NULL) goto err;
+	memset(ret->sess_shards,0,SSL_SESS_CACHE_SHARDS*sizeof(SSL_SESS_SHARD));
+	sh=&ret->sess_shards[0];
+	sh->sessions=ret->sessions;
+	sh->head=&ret->session_cache_head;
+	sh->tail=&ret->session_cache_tail;
+	sh->lock=CRYPTO_LOCK_SSL_CTX;
+	for (i=1; i<SSL_SESS_CACHE_SHARDS; i++)
+		{
+		sh=&ret->sess_shards[i];
+		sh->sessions=lh_SSL_SESSION_new();
+		if (sh->sessions == NULL) goto err;
+		sh->head=&sh->session_cache_head;
+		sh->tail=&sh->session_cache_tail;
+		sh->lock=CRYPTO_LOCK_SSL_CTX;
+		}
 	ret->cert_store=X509_STORE_new();
 	if (ret->cert_store == NULL) goto err;
 
@@ -1929,9 +1985,19 @@ void SSL_CTX_free(SSL_CTX *a)
 	 */
 	if (a->sessions != NULL)
 		SSL_CTX_flush_sessions(a,0);
+	/* releases the shard locks */
+	if (a->session_cache_mode & SSL_SESS_CACHE_SHARDED)
+		ssl_sess_set_sharded(a,0);
 
 	CRYPTO_free_ex_data(CRYPTO_EX_INDEX_SSL_CTX, a, &a->ex_data);
 
+	if (a->sess_shards != NULL)
+		{
+		for (i=1; i<SSL_SESS_CACHE_SHARDS; i++)
+			if (a->sess_shards[i].sessions != NULL)
+				lh_SSL_SESSION_free(a->sess_shards[i].sessions);
+		OPENSSL_free(a->sess_shards);
+		}
 	if (a->sessions != NULL)
 		lh_SSL_SESSION_free(a->sessions);
 
@@ -1947,6 +2013,7 @@ void SSL_CTX_free(SSL_CTX *a)
 		sk_X509_NAME_pop_free(a->client_CA,X509_NAME_free);
 	if (a->extra_certs != NULL)
 		sk_X509_pop_free(a->extra_certs,X509_free);
+	ssl_peer_chain_cache_free(a->peer_chain_cache);
 #if 0 /* This should never be done, since it removes a global database */
 	if (a->comp_methods != NULL)
 		sk_SSL_COMP_pop_free(a->comp_methods,SSL_COMP_free);
@@ -2413,17 +2480,9 @@ void ssl_update_cache(SSL *s,int mode)
 			SSL_SESSION_free(s->session);
 		}
 
-	/* auto flush every 255 connections */
-	if ((!(i & SSL_SESS_CACHE_NO_AUTO_CLEAR)) &&
-		((i & mode) == mode))
-		{
-		if (  (((mode & SSL_SESS_CACHE_CLIENT)
-			?s->session_ctx->stats.sess_connect_good
-			:s->session_ctx->stats.sess_accept_good) & 0xff) == 0xff)
-			{
-			SSL_CTX_flush_sessions(s->session_ctx,(unsigned long)time(NULL));
-			}
-		}
+	/* Unless SSL_SESS_CACHE_NO_AUTO_CLEAR is set, SSL_CTX_add_session()
+	 * expires old sessions as it goes, so there is no periodic
+	 * SSL_CTX_flush_sessions() here. */
 	}
 
 const SSL_METHOD *SSL_get_ssl_method(SSL *s)
@@ -2527,6 +2586,10 @@ int SSL_get_error(const SSL *s,int i)
 		{
 		return(SSL_ERROR_WANT_X509_LOOKUP);
 		}
+	if ((i < 0) && SSL_want_async(s))
+		{
+		return(SSL_ERROR_WANT_ASYNC);
+		}
 
 	if (i == 0)
 		{
@@ -2864,6 +2927,14 @@ int ssl_init_wbio_buffer(SSL *s,int push)
 		SSLerr(SSL_F_SSL_INIT_WBIO_BUFFER,ERR_R_BUF_LIB);
 		return(0);
 		}
+	/* a coalesced flight should reach the transport in one write, so
+	 * make room for at least one full record rather than the default */
+	if ((s->mode & SSL_MODE_COALESCE_FLIGHT) &&
+		!BIO_set_write_buffer_size(bbio,SSL3_RT_MAX_PACKET_SIZE))
+		{
+		SSLerr(SSL_F_SSL_INIT_WBIO_BUFFER,ERR_R_BUF_LIB);
+		return(0);
+		}
 	if (push)
 		{
 		if (s->wbio != bbio)
@@ -2954,13 +3025,21 @@ SSL_CTX *SSL_set_SSL_CTX(SSL *ssl, SSL_CTX* ctx)
 #ifndef OPENSSL_NO_STDIO
 int SSL_CTX_set_default_verify_paths(SSL_CTX *ctx)
 	{
-	return(X509_STORE_set_default_paths(ctx->cert_store));
+	int ret;
+
+	ret=X509_STORE_set_default_paths(ctx->cert_store);
+	ssl_cert_flush_chains(ctx->cert);
+	return(ret);
 	}
 
 int SSL_CTX_load_verify_locations(SSL_CTX *ctx, const char *CAfile,
 		const char *CApath)
 	{
-	return(X509_STORE_load_locations(ctx->cert_store,CAfile,CApath));
+	int ret;
+
+	ret=X509_STORE_load_locations(ctx->cert_store,CAfile,CApath);
+	ssl_cert_flush_chains(ctx->cert);
+	return(ret);
 	}
 #endif
 
@@ -3046,6 +3125,7 @@ void SSL_CTX_set_cert_store(SSL_CTX *ctx,X509_STORE *store)
 	if (ctx->cert_store != NULL)
 		X509_STORE_free(ctx->cert_store);
 	ctx->cert_store=store;
+	ssl_cert_flush_chains(ctx->cert);
 	}
 
 int SSL_want(const SSL *s)
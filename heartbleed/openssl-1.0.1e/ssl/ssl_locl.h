@@ -328,6 +328,7 @@
 #define SSL_SEED		0x00000800L
 #define SSL_AES128GCM		0x00001000L
 #define SSL_AES256GCM		0x00002000L
+#define SSL_CHACHA20POLY1305	0x00004000L
 
 #define SSL_AES        		(SSL_AES128|SSL_AES256|SSL_AES128GCM|SSL_AES256GCM)
 #define SSL_CAMELLIA		(SSL_CAMELLIA128|SSL_CAMELLIA256)
@@ -483,8 +484,34 @@ typedef struct cert_pkey_st
 	EVP_PKEY *privatekey;
 	/* Digest to use when signing */
 	const EVP_MD *digest;
+	/* Encoded certificate_list for x509, built by the first
+	 * ssl3_output_cert_chain() that sends it. Only kept in the CERT of an
+	 * SSL_CTX; chain_no_auto records whether it was built without the
+	 * certificate store. */
+	unsigned char *chain_der;
+	unsigned long chain_der_len;
+	int chain_no_auto;
 	} CERT_PKEY;
 
+/* Decoded peer intermediates, see SSL_CTX_set_peer_chain_cache_size().
+ * Direct mapped on a hash of the DER encoding; a slot only matches if the
+ * encoding is identical. */
+typedef struct ssl_peer_chain_entry_st
+	{
+	unsigned long hash;
+	long length;
+	unsigned char *der;
+	X509 *x509;
+	} SSL_PEER_CHAIN_ENTRY;
+
+struct ssl_peer_chain_cache_st
+	{
+	int size;
+	unsigned long hits;
+	unsigned long misses;
+	SSL_PEER_CHAIN_ENTRY *entries;
+	};
+
 typedef struct cert_st
 	{
 	/* Current active set */
@@ -514,6 +541,9 @@ typedef struct cert_st
 #endif
 
 	CERT_PKEY pkeys[SSL_PKEY_NUM];
+	/* Bumped by ssl_cert_flush_chains(), so that a chain built from
+	 * the old certificates is not stored after the flush */
+	int chain_gen;
 
 	int references; /* >1 only if SSL_copy_session_id is used */
 	} CERT;
@@ -544,6 +574,47 @@ typedef struct sess_cert_st
 	int references; /* actually always 1 at the moment */
 	} SESS_CERT;
 
+/* One shard of the internal session cache of an SSL_CTX. By default the
+ * cache is a single shard: the sessions, session_cache_head and
+ * session_cache_tail of the SSL_CTX itself, under CRYPTO_LOCK_SSL_CTX.
+ * With SSL_SESS_CACHE_SHARDED a session lives in the shard picked by
+ * ssl_sess_shard() from its session-id, so that threads working on
+ * different sessions mostly take different locks: one dynamic lock per
+ * shard, or CRYPTO_LOCK_SSL_CTX for all of them when the application
+ * has no dynamic lock callbacks. The list is kept in order of expiry,
+ * the session that expires last at the head, so that expired sessions
+ * can be taken off the tail a few at a time instead of by walking the
+ * whole cache. */
+#define SSL_SESS_CACHE_SHARDS	8	/* a power of two */
+#define SSL_SESS_SHARDS_NUM(ctx) \
+	(((ctx)->session_cache_mode&SSL_SESS_CACHE_SHARDED)? \
+		SSL_SESS_CACHE_SHARDS:1)
+
+typedef struct ssl_sess_shard_st
+	{
+	LHASH_OF(SSL_SESSION) *sessions;
+	/* Ends of the list: in the SSL_CTX for the first shard, below
+	 * for the others */
+	SSL_SESSION **head;
+	SSL_SESSION **tail;
+	SSL_SESSION *session_cache_head;
+	SSL_SESSION *session_cache_tail;
+	/* A static lock id, or a dynamic one and its value, which is
+	 * locked directly rather than through CRYPTO_lock() so that the
+	 * shards do not all go through CRYPTO_LOCK_DYNLOCK */
+	int lock;
+	struct CRYPTO_dynlock_value *dynlock;
+	} SSL_SESS_SHARD;
+
+#define ssl_sess_shard_w_lock(sh) \
+	ssl_sess_shard_lock(sh,CRYPTO_LOCK|CRYPTO_WRITE,__FILE__,__LINE__)
+#define ssl_sess_shard_w_unlock(sh) \
+	ssl_sess_shard_lock(sh,CRYPTO_UNLOCK|CRYPTO_WRITE,__FILE__,__LINE__)
+#define ssl_sess_shard_r_lock(sh) \
+	ssl_sess_shard_lock(sh,CRYPTO_LOCK|CRYPTO_READ,__FILE__,__LINE__)
+#define ssl_sess_shard_r_unlock(sh) \
+	ssl_sess_shard_lock(sh,CRYPTO_UNLOCK|CRYPTO_READ,__FILE__,__LINE__)
+
 
 /*#define MAC_DEBUG	*/
 
@@ -813,11 +884,16 @@ CERT *ssl_cert_new(void);
 CERT *ssl_cert_dup(CERT *cert);
 int ssl_cert_inst(CERT **o);
 void ssl_cert_free(CERT *c);
+void ssl_cert_flush_chains(CERT *c);
 SESS_CERT *ssl_sess_cert_new(void);
 void ssl_sess_cert_free(SESS_CERT *sc);
 int ssl_set_peer_cert_type(SESS_CERT *c, int type);
 int ssl_get_new_session(SSL *s, int session);
 int ssl_get_prev_session(SSL *s, unsigned char *session,int len, const unsigned char *limit);
+void ssl_sess_set_sharded(SSL_CTX *ctx, int sharded);
+SSL_SESS_SHARD *ssl_sess_shard(SSL_CTX *ctx, const SSL_SESSION *s);
+void ssl_sess_shard_lock(SSL_SESS_SHARD *sh, int mode, const char *file,
+	int line);
 int ssl_cipher_id_cmp(const SSL_CIPHER *a,const SSL_CIPHER *b);
 DECLARE_OBJ_BSEARCH_GLOBAL_CMP_FN(SSL_CIPHER, SSL_CIPHER,
 				  ssl_cipher_id);
@@ -836,6 +912,11 @@ int ssl_cipher_get_evp(const SSL_SESSION *s,const EVP_CIPHER **enc,
 		       const EVP_MD **md,int *mac_pkey_type,int *mac_secret_size, SSL_COMP **comp);
 int ssl_get_handshake_digest(int i,long *mask,const EVP_MD **md);			   
 int ssl_verify_cert_chain(SSL *s,STACK_OF(X509) *sk);
+X509 *ssl_d2i_peer_cert(SSL *s, const unsigned char **pp, long length,
+	int depth);
+int ssl_peer_chain_cache_set_size(SSL_CTX *ctx, long size);
+void ssl_peer_chain_cache_flush(struct ssl_peer_chain_cache_st *c);
+void ssl_peer_chain_cache_free(struct ssl_peer_chain_cache_st *c);
 int ssl_undefined_function(SSL *s);
 int ssl_undefined_void_function(void);
 int ssl_undefined_const_function(const SSL *s);
@@ -889,6 +970,7 @@ int ssl3_send_change_cipher_spec(SSL *s,int state_a,int state_b);
 int ssl3_change_cipher_state(SSL *s,int which);
 void ssl3_cleanup_key_block(SSL *s);
 int ssl3_do_write(SSL *s,int type);
+int ssl3_write_flight(SSL *s);
 int ssl3_send_alert(SSL *s,int level, int desc);
 int ssl3_generate_master_secret(SSL *s, unsigned char *out,
 	unsigned char *p, int len);
@@ -1064,6 +1146,11 @@ int dtls1_enc(SSL *s, int snd);
 int ssl_init_wbio_buffer(SSL *s, int push);
 void ssl_free_wbio_buffer(SSL *s);
 
+int ssl_private_key_op(SSL *s, int type, EVP_PKEY *pkey, int md_nid,
+	const unsigned char *in, size_t in_len,
+	unsigned char *out, size_t *out_len);
+void ssl_private_key_cancel(SSL *s);
+
 int tls1_change_cipher_state(SSL *s, int which);
 int tls1_setup_key_block(SSL *s);
 int tls1_enc(SSL *s, int snd);
@@ -0,0 +1,503 @@
+/* ====================================================================
+ * Copyright (c) 2013 The OpenSSL Project.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. All advertising materials mentioning features or use of this
+ *    software must display the following acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit. (http://www.OpenSSL.org/)"
+ *
+ * 4. The names "OpenSSL Toolkit" and "OpenSSL Project" must not be used to
+ *    endorse or promote products derived from this software without
+ *    prior written permission. For written permission, please contact
+ *    licensing@OpenSSL.org.
+ *
+ * 5. Products derived from this software may not be called "OpenSSL"
+ *    nor may "OpenSSL" appear in their names without prior written
+ *    permission of the OpenSSL Project.
+ *
+ * 6. Redistributions of any form whatsoever must retain the following
+ *    acknowledgment:
+ *    "This product includes software developed by the OpenSSL Project
+ *    for use in the OpenSSL Toolkit (http://www.OpenSSL.org/)"
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE OpenSSL PROJECT ``AS IS'' AND ANY
+ * EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE OpenSSL PROJECT OR
+ * ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/*
+ * Server private key operations outside the handshake. When an
+ * SSL_PRIVATE_KEY_METHOD is set on the SSL_CTX, the ServerKeyExchange
+ * signature and the RSA ClientKeyExchange decryption are handed to it
+ * instead of being computed inline. While the operation runs, the
+ * handshake returns -1 with SSL_get_error() == SSL_ERROR_WANT_ASYNC, and
+ * SSL_get_async_fd() gives a descriptor that becomes readable when it is
+ * time to call the handshake function again. An event loop can meanwhile
+ * serve other connections.
+ *
+ * SSL_PKEY_POOL is the reference method: a fixed set of threads that run
+ * the operations with SSL_PKEY_OP_run(), each job reporting completion
+ * through a pipe. The pthread functions are weak references, as for the
+ * default locks in libcrypto, so that linking libssl does not require
+ * libpthread; SSL_PKEY_POOL_new() fails if it is not there.
+ */
+
+#include <stdio.h>
+#include "ssl_locl.h"
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/dsa.h>
+#include <openssl/ecdsa.h>
+
+void SSL_CTX_set_private_key_method(SSL_CTX *ctx,
+	const SSL_PRIVATE_KEY_METHOD *meth, void *arg)
+	{
+	ctx->private_key_method=meth;
+	ctx->private_key_method_arg=arg;
+	}
+
+int SSL_get_async_fd(const SSL *s)
+	{
+	if (s->pkey_op == NULL)
+		return(-1);
+	return(s->pkey_op->fd);
+	}
+
+void SSL_PKEY_OP_free(SSL_PKEY_OP *op)
+	{
+	if (op == NULL)
+		return;
+	if (op->in != NULL)
+		{
+		OPENSSL_cleanse(op->in,op->in_len);
+		OPENSSL_free(op->in);
+		}
+	if (op->out != NULL)
+		{
+		OPENSSL_cleanse(op->out,EVP_PKEY_size(op->pkey));
+		OPENSSL_free(op->out);
+		}
+	if (op->pkey != NULL)
+		EVP_PKEY_free(op->pkey);
+	OPENSSL_free(op);
+	}
+
+/* Performs |op| in the calling thread. Returns 1 on success and 0 on
+ * failure, leaving any errors on the calling thread's queue. */
+int SSL_PKEY_OP_run(SSL_PKEY_OP *op)
+	{
+	EVP_PKEY *pkey=op->pkey;
+	unsigned int len=0;
+	int i=0;
+
+	if (op->type == SSL_PKEY_OP_SIGN)
+		{
+		switch (EVP_PKEY_type(pkey->type))
+			{
+#ifndef OPENSSL_NO_RSA
+		case EVP_PKEY_RSA:
+			i=RSA_sign(op->md_nid,op->in,(unsigned int)op->in_len,
+				op->out,&len,pkey->pkey.rsa);
+			break;
+#endif
+#ifndef OPENSSL_NO_DSA
+		case EVP_PKEY_DSA:
+			i=DSA_sign(0,op->in,(int)op->in_len,op->out,&len,
+				pkey->pkey.dsa);
+			break;
+#endif
+#ifndef OPENSSL_NO_ECDSA
+		case EVP_PKEY_EC:
+			i=ECDSA_sign(0,op->in,(int)op->in_len,op->out,&len,
+				pkey->pkey.ec);
+			break;
+#endif
+		default:
+			break;
+			}
+		}
+#ifndef OPENSSL_NO_RSA
+	else if (op->type == SSL_PKEY_OP_DECRYPT &&
+		EVP_PKEY_type(pkey->type) == EVP_PKEY_RSA)
+		{
+		i=RSA_private_decrypt((int)op->in_len,op->in,op->out,
+			pkey->pkey.rsa,RSA_PKCS1_PADDING);
+		if (i > 0)
+			{
+			len=i;
+			i=1;
+			}
+		}
+#endif
+
+	if (i <= 0)
+		{
+		op->out_len=0;
+		return(0);
+		}
+	op->out_len=len;
+	return(1);
+	}
+
+/* Runs a private key operation through the context's method. The first
+ * call starts it; while it is running 0 is returned with s->rwstate set
+ * to SSL_ASYNC_PKEY, and the caller must arrange to be called again with
+ * the same arguments. Returns 1 with the result in |out| and |*out_len|
+ * once it has finished, or -1 on failure. */
+int ssl_private_key_op(SSL *s, int type, EVP_PKEY *pkey, int md_nid,
+	const unsigned char *in, size_t in_len,
+	unsigned char *out, size_t *out_len)
+	{
+	SSL_PKEY_OP *op=s->pkey_op;
+	int ret;
+
+	if (op == NULL)
+		{
+		if ((op=OPENSSL_malloc(sizeof *op)) == NULL)
+			{
+			SSLerr(SSL_F_SSL_PRIVATE_KEY_OP,ERR_R_MALLOC_FAILURE);
+			return(-1);
+			}
+		memset(op,0,sizeof *op);
+		CRYPTO_add(&pkey->references,1,CRYPTO_LOCK_EVP_PKEY);
+		op->pkey=pkey;
+		op->type=type;
+		op->md_nid=md_nid;
+		op->in=OPENSSL_malloc(in_len);
+		op->out=OPENSSL_malloc(EVP_PKEY_size(pkey));
+		if (op->in == NULL || op->out == NULL)
+			{
+			SSL_PKEY_OP_free(op);
+			SSLerr(SSL_F_SSL_PRIVATE_KEY_OP,ERR_R_MALLOC_FAILURE);
+			return(-1);
+			}
+		memcpy(op->in,in,in_len);
+		op->in_len=in_len;
+		op->meth=s->ctx->private_key_method;
+		op->meth_arg=s->ctx->private_key_method_arg;
+		if ((op->fd=op->meth->start(s,op,op->meth_arg)) < 0)
+			{
+			SSL_PKEY_OP_free(op);
+			SSLerr(SSL_F_SSL_PRIVATE_KEY_OP,SSL_R_PRIVATE_KEY_OPERATION_FAILED);
+			return(-1);
+			}
+		s->pkey_op=op;
+		}
+	else if (op->type != type)
+		{
+		SSLerr(SSL_F_SSL_PRIVATE_KEY_OP,ERR_R_INTERNAL_ERROR);
+		return(-1);
+		}
+
+	ret=op->meth->complete(s,op,op->meth_arg);
+	if (ret == 0)
+		{
+		s->rwstate=SSL_ASYNC_PKEY;
+		return(0);
+		}
+	s->rwstate=SSL_NOTHING;
+	s->pkey_op=NULL;
+	if (ret > 0 && op->out_len <= *out_len)
+		{
+		memcpy(out,op->out,op->out_len);
+		*out_len=op->out_len;
+		}
+	else
+		{
+		SSLerr(SSL_F_SSL_PRIVATE_KEY_OP,SSL_R_PRIVATE_KEY_OPERATION_FAILED);
+		ret= -1;
+		}
+	SSL_PKEY_OP_free(op);
+	return(ret > 0 ? 1 : -1);
+	}
+
+/* Abandons the operation in progress, if any, to its method */
+void ssl_private_key_cancel(SSL *s)
+	{
+	SSL_PKEY_OP *op=s->pkey_op;
+
+	if (op == NULL)
+		return;
+	s->pkey_op=NULL;
+	if (s->rwstate == SSL_ASYNC_PKEY)
+		s->rwstate=SSL_NOTHING;
+	op->meth->cancel(op,op->meth_arg);
+	}
+
+#if defined(OPENSSL_THREADS) && defined(OPENSSL_SYS_UNIX)
+
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && defined(__ELF__)
+#pragma weak pthread_create
+#pragma weak pthread_join
+#pragma weak pthread_mutex_init
+#pragma weak pthread_mutex_destroy
+#pragma weak pthread_mutex_lock
+#pragma weak pthread_mutex_unlock
+#pragma weak pthread_cond_init
+#pragma weak pthread_cond_destroy
+#pragma weak pthread_cond_wait
+#pragma weak pthread_cond_signal
+#pragma weak pthread_cond_broadcast
+#define PKEY_POOL_HAVE_THREADS()	(pthread_create != NULL)
+#else
+#define PKEY_POOL_HAVE_THREADS()	1
+#endif
+
+#define PKEY_JOB_QUEUED		0
+#define PKEY_JOB_RUNNING	1
+#define PKEY_JOB_DONE		2
+
+typedef struct ssl_pkey_job_st
+	{
+	SSL_PKEY_OP *op;
+	int pipefd[2];		/* written to once the job is done */
+	int state;
+	int result;
+	int cancelled;		/* the worker frees it when done */
+	struct ssl_pkey_job_st *next;
+	} SSL_PKEY_JOB;
+
+struct ssl_pkey_pool_st
+	{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	SSL_PKEY_JOB *head,*tail;	/* waiting for a thread */
+	int shutdown;
+	int nthreads;
+	pthread_t *threads;
+	};
+
+static void pkey_job_free(SSL_PKEY_JOB *job)
+	{
+	close(job->pipefd[0]);
+	close(job->pipefd[1]);
+	SSL_PKEY_OP_free(job->op);
+	OPENSSL_free(job);
+	}
+
+static void *pkey_pool_worker(void *arg)
+	{
+	SSL_PKEY_POOL *pool=arg;
+	SSL_PKEY_JOB *job;
+	int result;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;)
+		{
+		while (pool->head == NULL && !pool->shutdown)
+			pthread_cond_wait(&pool->cond,&pool->lock);
+		/* queued jobs are still run on shutdown */
+		if ((job=pool->head) == NULL)
+			break;
+		if ((pool->head=job->next) == NULL)
+			pool->tail=NULL;
+		job->state=PKEY_JOB_RUNNING;
+		pthread_mutex_unlock(&pool->lock);
+
+		result=SSL_PKEY_OP_run(job->op);
+		ERR_clear_error();
+
+		pthread_mutex_lock(&pool->lock);
+		job->result=result;
+		job->state=PKEY_JOB_DONE;
+		if (job->cancelled)
+			pkey_job_free(job);
+		else if (write(job->pipefd[1],"",1) != 1)
+			{
+			/* complete() goes by the state, the byte only
+			 * wakes up the caller's event loop */
+			}
+		}
+	pthread_mutex_unlock(&pool->lock);
+	ERR_remove_thread_state(NULL);
+	return NULL;
+	}
+
+static int pkey_pool_start(SSL *s, SSL_PKEY_OP *op, void *arg)
+	{
+	SSL_PKEY_POOL *pool=arg;
+	SSL_PKEY_JOB *job;
+
+	if ((job=OPENSSL_malloc(sizeof *job)) == NULL)
+		return -1;
+	memset(job,0,sizeof *job);
+	if (pipe(job->pipefd) != 0)
+		{
+		OPENSSL_free(job);
+		return -1;
+		}
+	job->op=op;
+	job->state=PKEY_JOB_QUEUED;
+	op->meth_data=job;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->tail != NULL)
+		pool->tail->next=job;
+	else
+		pool->head=job;
+	pool->tail=job;
+	pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+	return job->pipefd[0];
+	}
+
+static int pkey_pool_complete(SSL *s, SSL_PKEY_OP *op, void *arg)
+	{
+	SSL_PKEY_POOL *pool=arg;
+	SSL_PKEY_JOB *job=op->meth_data;
+	int state;
+
+	pthread_mutex_lock(&pool->lock);
+	state=job->state;
+	pthread_mutex_unlock(&pool->lock);
+	if (state != PKEY_JOB_DONE)
+		return 0;
+
+	close(job->pipefd[0]);
+	close(job->pipefd[1]);
+	op->meth_data=NULL;
+	state=job->result;
+	OPENSSL_free(job);
+	return state ? 1 : -1;
+	}
+
+static void pkey_pool_cancel(SSL_PKEY_OP *op, void *arg)
+	{
+	SSL_PKEY_POOL *pool=arg;
+	SSL_PKEY_JOB *job=op->meth_data,**pp;
+
+	pthread_mutex_lock(&pool->lock);
+	if (job->state == PKEY_JOB_RUNNING)
+		{
+		job->cancelled=1;
+		job=NULL;
+		}
+	else if (job->state == PKEY_JOB_QUEUED)
+		{
+		SSL_PKEY_JOB *t;
+
+		for (pp= &pool->head; *pp != job; pp= &(*pp)->next)
+			;
+		*pp=job->next;
+		for (t=pool->head; t != NULL && t->next != NULL; t=t->next)
+			;
+		pool->tail=t;
+		}
+	pthread_mutex_unlock(&pool->lock);
+	if (job != NULL)
+		pkey_job_free(job);
+	}
+
+static const SSL_PRIVATE_KEY_METHOD pkey_pool_meth=
+	{
+	"thread pool",
+	pkey_pool_start,
+	pkey_pool_complete,
+	pkey_pool_cancel,
+	};
+
+const SSL_PRIVATE_KEY_METHOD *SSL_PKEY_POOL_method(void)
+	{
+	return(&pkey_pool_meth);
+	}
+
+SSL_PKEY_POOL *SSL_PKEY_POOL_new(int threads)
+	{
+	SSL_PKEY_POOL *pool;
+
+	if (!PKEY_POOL_HAVE_THREADS())
+		{
+		SSLerr(SSL_F_SSL_PKEY_POOL_NEW,SSL_R_THREADS_NOT_SUPPORTED);
+		return(NULL);
+		}
+	if (threads < 1)
+		threads=1;
+	if ((pool=OPENSSL_malloc(sizeof *pool)) == NULL)
+		goto err;
+	memset(pool,0,sizeof *pool);
+	if ((pool->threads=OPENSSL_malloc(threads*sizeof(pthread_t))) == NULL)
+		{
+		OPENSSL_free(pool);
+		goto err;
+		}
+	pthread_mutex_init(&pool->lock,NULL);
+	pthread_cond_init(&pool->cond,NULL);
+	for (; pool->nthreads < threads; pool->nthreads++)
+		{
+		if (pthread_create(&pool->threads[pool->nthreads],NULL,
+			pkey_pool_worker,pool) != 0)
+			{
+			SSL_PKEY_POOL_free(pool);
+			SSLerr(SSL_F_SSL_PKEY_POOL_NEW,SSL_R_THREADS_NOT_SUPPORTED);
+			return(NULL);
+			}
+		}
+	return(pool);
+err:
+	SSLerr(SSL_F_SSL_PKEY_POOL_NEW,ERR_R_MALLOC_FAILURE);
+	return(NULL);
+	}
+
+/* Must not be called while any SSL still has an operation with the pool;
+ * jobs already queued are run to completion first. */
+void SSL_PKEY_POOL_free(SSL_PKEY_POOL *pool)
+	{
+	int i;
+
+	if (pool == NULL)
+		return;
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown=1;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+	for (i=0; i < pool->nthreads; i++)
+		pthread_join(pool->threads[i],NULL);
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+	OPENSSL_free(pool->threads);
+	OPENSSL_free(pool);
+	}
+
+#else
+
+const SSL_PRIVATE_KEY_METHOD *SSL_PKEY_POOL_method(void)
+	{
+	return(NULL);
+	}
+
+SSL_PKEY_POOL *SSL_PKEY_POOL_new(int threads)
+	{
+	SSLerr(SSL_F_SSL_PKEY_POOL_NEW,SSL_R_THREADS_NOT_SUPPORTED);
+	return(NULL);
+	}
+
+void SSL_PKEY_POOL_free(SSL_PKEY_POOL *pool)
+	{
+	}
+
+#endif
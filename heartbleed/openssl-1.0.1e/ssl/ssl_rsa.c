@@ -445,6 +445,7 @@ static int ssl_set_cert(CERT *c, X509 *x)
 	CRYPTO_add(&x->references,1,CRYPTO_LOCK_X509);
 	c->pkeys[i].x509=x;
 	c->key= &(c->pkeys[i]);
+	ssl_cert_flush_chains(c);
 
 	c->valid=0;
 	return(1);
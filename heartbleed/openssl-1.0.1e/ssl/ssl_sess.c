@@ -143,9 +143,10 @@
 #endif
 #include "ssl_locl.h"
 
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s);
-static void SSL_SESSION_list_add(SSL_CTX *ctx,SSL_SESSION *s);
+static void SSL_SESSION_list_remove(SSL_SESS_SHARD *sh, SSL_SESSION *s);
+static void SSL_SESSION_list_add(SSL_SESS_SHARD *sh, SSL_SESSION *s);
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck);
+static void expire_sessions(SSL_CTX *ctx, SSL_SESS_SHARD *sh, long t);
 
 SSL_SESSION *SSL_get_session(const SSL *ssl)
 /* aka SSL_get0_session; gets 0 objects, just returns a copy of the pointer */
@@ -468,6 +469,7 @@ int ssl_get_prev_session(SSL *s, unsigned char *session_id, int len,
 	SSL_SESSION *ret=NULL;
 	int fatal = 0;
 	int try_session_cache = 1;
+	SSL_SESS_SHARD *sh;
 #ifndef OPENSSL_NO_TLSEXT
 	int r;
 #endif
@@ -507,14 +509,15 @@ int ssl_get_prev_session(SSL *s, unsigned char *session_id, int len,
 		if (len == 0)
 			return 0;
 		memcpy(data.session_id,session_id,len);
-		CRYPTO_r_lock(CRYPTO_LOCK_SSL_CTX);
-		ret=lh_SSL_SESSION_retrieve(s->session_ctx->sessions,&data);
+		sh=ssl_sess_shard(s->session_ctx,&data);
+		ssl_sess_shard_r_lock(sh);
+		ret=lh_SSL_SESSION_retrieve(sh->sessions,&data);
 		if (ret != NULL)
 			{
 			/* don't allow other threads to steal it: */
 			CRYPTO_add(&ret->references,1,CRYPTO_LOCK_SSL_SESSION);
 			}
-		CRYPTO_r_unlock(CRYPTO_LOCK_SSL_CTX);
+		ssl_sess_shard_r_unlock(sh);
 		if (ret == NULL)
 			s->session_ctx->stats.sess_miss++;
 		}
@@ -630,10 +633,133 @@ int ssl_get_prev_session(SSL *s, unsigned char *session_id, int len,
 		return 0;
 	}
 
+SSL_SESS_SHARD *ssl_sess_shard(SSL_CTX *ctx, const SSL_SESSION *s)
+	{
+	/* ssl_session_hash() is taken from the first four bytes of the
+	 * session-id; use the next one so that the lhash of each shard
+	 * still gets evenly spread keys. */
+	if ((ctx->session_cache_mode & SSL_SESS_CACHE_SHARDED) &&
+		s->session_id_length > 4)
+		return &ctx->sess_shards[s->session_id[4]&
+			(SSL_SESS_CACHE_SHARDS-1)];
+	return &ctx->sess_shards[0];
+	}
+
+void ssl_sess_shard_lock(SSL_SESS_SHARD *sh, int mode, const char *file,
+	int line)
+	{
+	void (*dyn_lock)(int,struct CRYPTO_dynlock_value *,const char *,int);
+
+	if (sh->dynlock != NULL &&
+		(dyn_lock=CRYPTO_get_dynlock_lock_callback()) != NULL)
+		dyn_lock(mode,sh->dynlock,file,line);
+	else
+		CRYPTO_lock(mode,sh->lock,file,line);
+	}
+
+/* One dynamic lock per shard, or CRYPTO_LOCK_SSL_CTX for all of them if
+ * the application has no dynamic lock callbacks. A shard holds two
+ * references to its lock: the lock id and the value it keeps. */
+static void ssl_sess_shard_locks_free(SSL_CTX *ctx)
+	{
+	SSL_SESS_SHARD *sh;
+	int i;
+
+	for (i=0; i<SSL_SESS_CACHE_SHARDS; i++)
+		{
+		sh=&ctx->sess_shards[i];
+		if (sh->dynlock != NULL)
+			{
+			CRYPTO_destroy_dynlockid(sh->lock);
+			CRYPTO_destroy_dynlockid(sh->lock);
+			}
+		sh->lock=CRYPTO_LOCK_SSL_CTX;
+		sh->dynlock=NULL;
+		}
+	}
+
+static void ssl_sess_shard_locks_new(SSL_CTX *ctx)
+	{
+	SSL_SESS_SHARD *sh;
+	int i, id;
+
+	/* CRYPTO_get_new_dynlockid() would leave an error behind */
+	if (CRYPTO_get_dynlock_create_callback() == NULL ||
+		CRYPTO_get_dynlock_lock_callback() == NULL ||
+		CRYPTO_get_dynlock_destroy_callback() == NULL)
+		return;
+
+	for (i=0; i<SSL_SESS_CACHE_SHARDS; i++)
+		{
+		sh=&ctx->sess_shards[i];
+		if ((id=CRYPTO_get_new_dynlockid()) == 0)
+			break;
+		if ((sh->dynlock=CRYPTO_get_dynlock_value(id)) == NULL)
+			{
+			CRYPTO_destroy_dynlockid(id);
+			break;
+			}
+		sh->lock=id;
+		}
+	if (i < SSL_SESS_CACHE_SHARDS)
+		ssl_sess_shard_locks_free(ctx);
+	}
+
+/* ssl_sess_set_sharded switches |ctx| to a sharded session cache, or
+ * back to a single one, moving the cached sessions to their new place.
+ * As with the other settings of the cache, it must happen before the
+ * SSL_CTX is shared by several threads: the locks change too. SSL_CTX_free()
+ * turns sharding off to release the locks. */
+void ssl_sess_set_sharded(SSL_CTX *ctx, int sharded)
+	{
+	SSL_SESS_SHARD *first=&ctx->sess_shards[0], *sh;
+	SSL_SESSION *s, *prev;
+	int i;
+
+	if (sharded)
+		{
+		ctx->session_cache_mode|=SSL_SESS_CACHE_SHARDED;
+		ssl_sess_shard_locks_new(ctx);
+
+		/* From the tail, so that each session goes straight to
+		 * the head of its new list */
+		for (s=*first->tail; s != NULL &&
+			s != (SSL_SESSION *)first->head; s=prev)
+			{
+			prev=s->prev;
+			sh=ssl_sess_shard(ctx,s);
+			if (sh == first) continue;
+			(void)lh_SSL_SESSION_delete(first->sessions,s);
+			SSL_SESSION_list_remove(first,s);
+			(void)lh_SSL_SESSION_insert(sh->sessions,s);
+			SSL_SESSION_list_add(sh,s);
+			}
+		}
+	else
+		{
+		for (i=1; i<SSL_SESS_CACHE_SHARDS; i++)
+			{
+			sh=&ctx->sess_shards[i];
+			while ((s=*sh->tail) != NULL)
+				{
+				(void)lh_SSL_SESSION_delete(sh->sessions,s);
+				SSL_SESSION_list_remove(sh,s);
+				(void)lh_SSL_SESSION_insert(first->sessions,s);
+				SSL_SESSION_list_add(first,s);
+				}
+			}
+
+		ctx->session_cache_mode&= ~SSL_SESS_CACHE_SHARDED;
+		ssl_sess_shard_locks_free(ctx);
+		}
+	}
+
 int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 	{
 	int ret=0;
+	SSL_SESS_SHARD *sh=ssl_sess_shard(ctx,c);
 	SSL_SESSION *s;
+	unsigned long max;
 
 	/* add just 1 reference count for the SSL_CTX's session cache
 	 * even though it has two ways of access: each session is in a
@@ -641,16 +767,16 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 	CRYPTO_add(&c->references,1,CRYPTO_LOCK_SSL_SESSION);
 	/* if session c is in already in cache, we take back the increment later */
 
-	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
-	s=lh_SSL_SESSION_insert(ctx->sessions,c);
+	ssl_sess_shard_w_lock(sh);
+	s=lh_SSL_SESSION_insert(sh->sessions,c);
 	
 	/* s != NULL iff we already had a session with the given PID.
 	 * In this case, s == c should hold (then we did not really modify
-	 * ctx->sessions), or we're in trouble. */
+	 * the cache), or we're in trouble. */
 	if (s != NULL && s != c)
 		{
 		/* We *are* in trouble ... */
-		SSL_SESSION_list_remove(ctx,s);
+		SSL_SESSION_list_remove(sh,s);
 		SSL_SESSION_free(s);
 		/* ... so pretend the other session did not exist in cache
 		 * (we cannot handle two SSL_SESSION structures with identical
@@ -662,7 +788,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 
  	/* Put at the head of the queue unless it is already in the cache */
 	if (s == NULL)
-		SSL_SESSION_list_add(ctx,c);
+		SSL_SESSION_list_add(sh,c);
 
 	if (s != NULL)
 		{
@@ -674,24 +800,31 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 		}
 	else
 		{
-		/* new cache entry -- remove old ones if cache has become too large */
+		/* new cache entry -- drop expired sessions from this
+		 * shard, then old ones if it has become too large. With
+		 * SSL_SESS_CACHE_SHARDED each shard holds its share of the
+		 * cache size. */
 		
 		ret=1;
 
-		if (SSL_CTX_sess_get_cache_size(ctx) > 0)
+		if (!(ctx->session_cache_mode & SSL_SESS_CACHE_NO_AUTO_CLEAR))
+			expire_sessions(ctx,sh,(long)time(NULL));
+
+		max=SSL_CTX_sess_get_cache_size(ctx);
+		if (max > 0)
 			{
-			while (SSL_CTX_sess_number(ctx) >
-				SSL_CTX_sess_get_cache_size(ctx))
+			max=(max+SSL_SESS_SHARDS_NUM(ctx)-1)/
+				SSL_SESS_SHARDS_NUM(ctx);
+			while (lh_SSL_SESSION_num_items(sh->sessions) > max)
 				{
-				if (!remove_session_lock(ctx,
-					ctx->session_cache_tail, 0))
+				if (!remove_session_lock(ctx,*sh->tail,0))
 					break;
 				else
 					ctx->stats.sess_cache_full++;
 				}
 			}
 		}
-	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+	ssl_sess_shard_w_unlock(sh);
 	return(ret);
 	}
 
@@ -703,19 +836,21 @@ int SSL_CTX_remove_session(SSL_CTX *ctx, SSL_SESSION *c)
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck)
 	{
 	SSL_SESSION *r;
+	SSL_SESS_SHARD *sh;
 	int ret=0;
 
 	if ((c != NULL) && (c->session_id_length != 0))
 		{
-		if(lck) CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
-		if ((r = lh_SSL_SESSION_retrieve(ctx->sessions,c)) == c)
+		sh=ssl_sess_shard(ctx,c);
+		if(lck) ssl_sess_shard_w_lock(sh);
+		if ((r = lh_SSL_SESSION_retrieve(sh->sessions,c)) == c)
 			{
 			ret=1;
-			r=lh_SSL_SESSION_delete(ctx->sessions,c);
-			SSL_SESSION_list_remove(ctx,c);
+			r=lh_SSL_SESSION_delete(sh->sessions,c);
+			SSL_SESSION_list_remove(sh,c);
 			}
 
-		if(lck) CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+		if(lck) ssl_sess_shard_w_unlock(sh);
 
 		if (ret)
 			{
@@ -962,7 +1097,7 @@ typedef struct timeout_param_st
 	{
 	SSL_CTX *ctx;
 	long time;
-	LHASH_OF(SSL_SESSION) *cache;
+	SSL_SESS_SHARD *shard;
 	} TIMEOUT_PARAM;
 
 static void timeout_doall_arg(SSL_SESSION *s, TIMEOUT_PARAM *p)
@@ -971,8 +1106,8 @@ static void timeout_doall_arg(SSL_SESSION *s, TIMEOUT_PARAM *p)
 		{
 		/* The reason we don't call SSL_CTX_remove_session() is to
 		 * save on locking overhead */
-		(void)lh_SSL_SESSION_delete(p->cache,s);
-		SSL_SESSION_list_remove(p->ctx,s);
+		(void)lh_SSL_SESSION_delete(p->shard->sessions,s);
+		SSL_SESSION_list_remove(p->shard,s);
 		s->not_resumable=1;
 		if (p->ctx->remove_session_cb != NULL)
 			p->ctx->remove_session_cb(p->ctx,s);
@@ -982,22 +1117,48 @@ static void timeout_doall_arg(SSL_SESSION *s, TIMEOUT_PARAM *p)
 
 static IMPLEMENT_LHASH_DOALL_ARG_FN(timeout, SSL_SESSION, TIMEOUT_PARAM)
 
+/* SSL_CTX_flush_sessions looks at every session, so that it also catches
+ * those whose time or timeout was changed after they were cached and are
+ * out of order in their list. It takes one shard lock at a time. */
 void SSL_CTX_flush_sessions(SSL_CTX *s, long t)
 	{
 	unsigned long i;
+	int j;
 	TIMEOUT_PARAM tp;
 
+	if (s->sess_shards == NULL) return;
 	tp.ctx=s;
-	tp.cache=s->sessions;
-	if (tp.cache == NULL) return;
 	tp.time=t;
-	CRYPTO_w_lock(CRYPTO_LOCK_SSL_CTX);
-	i=CHECKED_LHASH_OF(SSL_SESSION, tp.cache)->down_load;
-	CHECKED_LHASH_OF(SSL_SESSION, tp.cache)->down_load=0;
-	lh_SSL_SESSION_doall_arg(tp.cache, LHASH_DOALL_ARG_FN(timeout),
-				 TIMEOUT_PARAM, &tp);
-	CHECKED_LHASH_OF(SSL_SESSION, tp.cache)->down_load=i;
-	CRYPTO_w_unlock(CRYPTO_LOCK_SSL_CTX);
+	for (j=0; j<SSL_SESS_SHARDS_NUM(s); j++)
+		{
+		tp.shard=&s->sess_shards[j];
+		ssl_sess_shard_w_lock(tp.shard);
+		i=CHECKED_LHASH_OF(SSL_SESSION, tp.shard->sessions)->down_load;
+		CHECKED_LHASH_OF(SSL_SESSION, tp.shard->sessions)->down_load=0;
+		lh_SSL_SESSION_doall_arg(tp.shard->sessions,
+			LHASH_DOALL_ARG_FN(timeout), TIMEOUT_PARAM, &tp);
+		CHECKED_LHASH_OF(SSL_SESSION, tp.shard->sessions)->down_load=i;
+		ssl_sess_shard_w_unlock(tp.shard);
+		}
+	}
+
+/* expire_sessions removes the sessions at the tail of the list of |sh|
+ * that have expired by time |t|, stopping at the first that has not.
+ * Called with the lock of |sh| held. */
+static void expire_sessions(SSL_CTX *ctx, SSL_SESS_SHARD *sh, long t)
+	{
+	SSL_SESSION *s;
+
+	while ((s=*sh->tail) != NULL &&
+		t > s->time+s->timeout)
+		{
+		(void)lh_SSL_SESSION_delete(sh->sessions,s);
+		SSL_SESSION_list_remove(sh,s);
+		s->not_resumable=1;
+		if (ctx->remove_session_cb != NULL)
+			ctx->remove_session_cb(ctx,s);
+		SSL_SESSION_free(s);
+		}
 	}
 
 int ssl_clear_bad_session(SSL *s)
@@ -1013,30 +1174,30 @@ int ssl_clear_bad_session(SSL *s)
 		return(0);
 	}
 
-/* locked by SSL_CTX in the calling function */
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
+/* locked by the shard lock in the calling function */
+static void SSL_SESSION_list_remove(SSL_SESS_SHARD *sh, SSL_SESSION *s)
 	{
 	if ((s->next == NULL) || (s->prev == NULL)) return;
 
-	if (s->next == (SSL_SESSION *)&(ctx->session_cache_tail))
+	if (s->next == (SSL_SESSION *)sh->tail)
 		{ /* last element in list */
-		if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head))
+		if (s->prev == (SSL_SESSION *)sh->head)
 			{ /* only one element in list */
-			ctx->session_cache_head=NULL;
-			ctx->session_cache_tail=NULL;
+			*sh->head=NULL;
+			*sh->tail=NULL;
 			}
 		else
 			{
-			ctx->session_cache_tail=s->prev;
-			s->prev->next=(SSL_SESSION *)&(ctx->session_cache_tail);
+			*sh->tail=s->prev;
+			s->prev->next=(SSL_SESSION *)sh->tail;
 			}
 		}
 	else
 		{
-		if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head))
+		if (s->prev == (SSL_SESSION *)sh->head)
 			{ /* first element in list */
-			ctx->session_cache_head=s->next;
-			s->next->prev=(SSL_SESSION *)&(ctx->session_cache_head);
+			*sh->head=s->next;
+			s->next->prev=(SSL_SESSION *)sh->head;
 			}
 		else
 			{ /* middle of list */
@@ -1047,24 +1208,53 @@ static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
 	s->prev=s->next=NULL;
 	}
 
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s)
+/* SSL_SESSION_list_add puts |s| in the list of |sh| in order of expiry.
+ * With the usual single timeout per SSL_CTX a new session expires last
+ * and goes straight to the head; otherwise the list is walked from the
+ * head to its place. */
+static void SSL_SESSION_list_add(SSL_SESS_SHARD *sh, SSL_SESSION *s)
 	{
+	SSL_SESSION *next;
+	long expires;
+
 	if ((s->next != NULL) && (s->prev != NULL))
-		SSL_SESSION_list_remove(ctx,s);
+		SSL_SESSION_list_remove(sh,s);
 
-	if (ctx->session_cache_head == NULL)
+	if (*sh->head == NULL)
 		{
-		ctx->session_cache_head=s;
-		ctx->session_cache_tail=s;
-		s->prev=(SSL_SESSION *)&(ctx->session_cache_head);
-		s->next=(SSL_SESSION *)&(ctx->session_cache_tail);
+		*sh->head=s;
+		*sh->tail=s;
+		s->prev=(SSL_SESSION *)sh->head;
+		s->next=(SSL_SESSION *)sh->tail;
+		return;
+		}
+
+	expires=s->time+s->timeout;
+	next=*sh->head;
+	while (next != (SSL_SESSION *)sh->tail &&
+		next->time+next->timeout > expires)
+		next=next->next;
+
+	if (next == *sh->head)
+		{ /* new head */
+		s->next=next;
+		next->prev=s;
+		s->prev=(SSL_SESSION *)sh->head;
+		*sh->head=s;
+		}
+	else if (next == (SSL_SESSION *)sh->tail)
+		{ /* new tail */
+		s->prev=*sh->tail;
+		s->prev->next=s;
+		s->next=(SSL_SESSION *)sh->tail;
+		*sh->tail=s;
 		}
 	else
-		{
-		s->next=ctx->session_cache_head;
-		s->next->prev=s;
-		s->prev=(SSL_SESSION *)&(ctx->session_cache_head);
-		ctx->session_cache_head=s;
+		{ /* before next */
+		s->next=next;
+		s->prev=next->prev;
+		s->prev->next=s;
+		next->prev=s;
 		}
 	}
 
@@ -198,6 +198,11 @@
 #include OPENSSL_UNISTD
 #endif
 
+#ifdef OPENSSL_SYS_UNIX
+#include <sys/time.h>
+#include <sys/types.h>
+#endif
+
 #ifdef OPENSSL_SYS_VMS
 #  define TEST_SERVER_CERT "SYS$DISK:[-.APPS]SERVER.PEM"
 #  define TEST_CLIENT_CERT "SYS$DISK:[-.APPS]CLIENT.PEM"
@@ -298,6 +303,9 @@ static BIO *bio_stdout=NULL;
 static char *cipher=NULL;
 static int verbose=0;
 static int debug=0;
+static long max_hs_records=0;
+static int zero_copy=0;
+static int big_writes=0;
 #if 0
 /* Not used yet. */
 #ifdef FIONBIO
@@ -309,6 +317,30 @@ static const char rnd_seed[] = "string to make the random number generator think
 
 int doit_biopair(SSL *s_ssl,SSL *c_ssl,long bytes,clock_t *s_time,clock_t *c_time);
 int doit(SSL *s_ssl,SSL *c_ssl,long bytes);
+
+/* With -big_writes each SSL_write() is large enough for the multi-block
+ * ciphers to encrypt 8 records at once, and the data is a pattern that
+ * the reader checks, starting over for each direction. */
+#define BIG_WRITE_LEN	(8*SSL3_RT_MAX_PLAIN_LENGTH)
+static unsigned char big_write_buf[2][BIG_WRITE_LEN];
+
+static void big_write_fill(unsigned char *buf, long off, int len)
+	{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (unsigned char)((off + i) % 251);
+	}
+
+static int big_write_check(const unsigned char *buf, long off, int len)
+	{
+	int i;
+
+	for (i = 0; i < len; i++)
+		if (buf[i] != (unsigned char)((off + i) % 251))
+			return 0;
+	return 1;
+	}
 static int do_test_cipherlist(void);
 static void sv_usage(void)
 	{
@@ -350,6 +382,7 @@ static void sv_usage(void)
 #endif
 #ifndef OPENSSL_NO_TLS1
 	fprintf(stderr," -tls1         - use TLSv1\n");
+	fprintf(stderr," -tls1_2       - use TLSv1.2\n");
 #endif
 	fprintf(stderr," -CApath arg   - PEM format directory of CA's\n");
 	fprintf(stderr," -CAfile arg   - PEM format file of CA's\n");
@@ -359,6 +392,13 @@ static void sv_usage(void)
 	fprintf(stderr," -c_key arg    - Client key file (default: same as -c_cert)\n");
 	fprintf(stderr," -cipher arg   - The cipher list\n");
 	fprintf(stderr," -bio_pair     - Use BIO pairs\n");
+	fprintf(stderr," -coalesce     - set SSL_MODE_COALESCE_FLIGHT\n");
+	fprintf(stderr," -hs_records <val> - fail if either side sends more handshake records (BIO pair only)\n");
+	fprintf(stderr," -async_pkey <val> - run server private key operations on <val> threads (BIO pair only)\n");
+	fprintf(stderr," -zero_copy    - set SSL_MODE_ZERO_COPY_READ (BIO pair only)\n");
+	fprintf(stderr," -big_writes   - write %d bytes at a time and check them (BIO pair only)\n",BIG_WRITE_LEN);
+	fprintf(stderr," -chain_cache <val> - cache <val> decoded peer chain certificates\n");
+	fprintf(stderr," -chain_cache_hits <val> - fail if the chain caches are hit fewer times\n");
 	fprintf(stderr," -f            - Test even cases that can't work\n");
 	fprintf(stderr," -time         - measure processor time used by client and server\n");
 	fprintf(stderr," -zlib         - use zlib compression\n");
@@ -503,8 +543,12 @@ int main(int argc, char *argv[])
 	char *CApath=NULL,*CAfile=NULL;
 	int badop=0;
 	int bio_pair=0;
+	int coalesce=0;
+	int async_pkey=0;
+	SSL_PKEY_POOL *pkey_pool=NULL;
+	long chain_cache=0,chain_cache_hits=0;
 	int force=0;
-	int tls1=0,ssl2=0,ssl3=0,ret=1;
+	int tls1=0,tls1_2=0,ssl2=0,ssl3=0,ret=1;
 	int client_auth=0;
 	int server_auth=0,i;
 	struct app_verify_arg app_verify_arg =
@@ -661,6 +705,8 @@ int main(int argc, char *argv[])
 			ssl2=1;
 		else if	(strcmp(*argv,"-tls1") == 0)
 			tls1=1;
+		else if	(strcmp(*argv,"-tls1_2") == 0)
+			tls1_2=1;
 		else if	(strcmp(*argv,"-ssl3") == 0)
 			ssl3=1;
 		else if	(strncmp(*argv,"-num",4) == 0)
@@ -727,6 +773,45 @@ int main(int argc, char *argv[])
 			{
 			bio_pair = 1;
 			}
+		else if	(strcmp(*argv,"-coalesce") == 0)
+			{
+			coalesce = 1;
+			}
+		else if	(strcmp(*argv,"-async_pkey") == 0)
+			{
+			if (--argc < 1) goto bad;
+			async_pkey = atoi(*(++argv));
+			if (async_pkey < 1) goto bad;
+			bio_pair = 1;
+			}
+		else if	(strcmp(*argv,"-zero_copy") == 0)
+			{
+			zero_copy = 1;
+			bio_pair = 1;
+			}
+		else if	(strcmp(*argv,"-big_writes") == 0)
+			{
+			big_writes = 1;
+			bio_pair = 1;
+			}
+		else if	(strcmp(*argv,"-chain_cache") == 0)
+			{
+			if (--argc < 1) goto bad;
+			chain_cache = atol(*(++argv));
+			if (chain_cache < 1) goto bad;
+			}
+		else if	(strcmp(*argv,"-chain_cache_hits") == 0)
+			{
+			if (--argc < 1) goto bad;
+			chain_cache_hits = atol(*(++argv));
+			}
+		else if	(strcmp(*argv,"-hs_records") == 0)
+			{
+			if (--argc < 1) goto bad;
+			max_hs_records = atol(*(++argv));
+			if (!bio_pair)
+				bio_pair = 1;
+			}
 		else if	(strcmp(*argv,"-f") == 0)
 			{
 			force = 1;
@@ -790,11 +875,11 @@ bad:
 		goto end;
 		}
 
-	if (!ssl2 && !ssl3 && !tls1 && number > 1 && !reuse && !force)
+	if (!ssl2 && !ssl3 && !tls1 && !tls1_2 && number > 1 && !reuse && !force)
 		{
 		fprintf(stderr, "This case cannot work.  Use -f to perform "
 			"the test anyway (and\n-d to see what happens), "
-			"or add one of -ssl2, -ssl3, -tls1, -reuse\n"
+			"or add one of -ssl2, -ssl3, -tls1, -tls1_2, -reuse\n"
 			"to avoid protocol mismatch.\n");
 		EXIT(1);
 		}
@@ -868,6 +953,11 @@ bad:
 	}
 #endif
 
+#ifndef OPENSSL_NO_TLS1
+	if (tls1_2)
+		meth=TLSv1_2_method();
+	else
+#endif
 #if !defined(OPENSSL_NO_SSL2) && !defined(OPENSSL_NO_SSL3)
 	if (ssl2)
 		meth=SSLv2_method();
@@ -901,6 +991,39 @@ bad:
 		SSL_CTX_set_cipher_list(s_ctx,cipher);
 		}
 
+	if (coalesce)
+		{
+		SSL_CTX_set_mode(c_ctx, SSL_MODE_COALESCE_FLIGHT);
+		SSL_CTX_set_mode(s_ctx, SSL_MODE_COALESCE_FLIGHT);
+		}
+
+	if (zero_copy)
+		{
+		SSL_CTX_set_mode(c_ctx, SSL_MODE_ZERO_COPY_READ);
+		SSL_CTX_set_mode(s_ctx, SSL_MODE_ZERO_COPY_READ);
+		}
+
+	if (chain_cache)
+		{
+		SSL_CTX_set_peer_chain_cache_size(c_ctx, chain_cache);
+		SSL_CTX_set_peer_chain_cache_size(s_ctx, chain_cache);
+		}
+
+	if (async_pkey)
+		{
+		pkey_pool = SSL_PKEY_POOL_new(async_pkey);
+		if (pkey_pool != NULL)
+			SSL_CTX_set_private_key_method(s_ctx,
+				SSL_PKEY_POOL_method(), pkey_pool);
+		else
+			{
+			/* builds without threads cannot offload */
+			ERR_print_errors(bio_err);
+			fprintf(stderr, "Private key pool not available, "
+				"running the test without it\n");
+			}
+		}
+
 #ifndef OPENSSL_NO_DH
 	if (!no_dhe)
 		{
@@ -1101,6 +1224,20 @@ bad:
 		}
 	if ((number > 1) || (bytes > 1L))
 		BIO_printf(bio_stdout, "%d handshakes of %ld bytes done\n",number,bytes);
+	if (chain_cache)
+		{
+		long c_hits = SSL_CTX_peer_chain_cache_hits(c_ctx);
+		long s_hits = SSL_CTX_peer_chain_cache_hits(s_ctx);
+
+		BIO_printf(bio_stdout, "peer chain cache hits: client %ld, "
+			"server %ld\n", c_hits, s_hits);
+		if (c_hits + s_hits < chain_cache_hits)
+			{
+			BIO_printf(bio_err, "expected at least %ld chain cache "
+				"hits\n", chain_cache_hits);
+			ret = 1;
+			}
+		}
 	if (print_time)
 		{
 #ifdef CLOCKS_PER_SEC
@@ -1129,6 +1266,7 @@ bad:
 end:
 	if (s_ctx != NULL) SSL_CTX_free(s_ctx);
 	if (c_ctx != NULL) SSL_CTX_free(c_ctx);
+	SSL_PKEY_POOL_free(pkey_pool);
 
 	if (bio_stdout != NULL) BIO_free(bio_stdout);
 
@@ -1148,12 +1286,78 @@ end:
 	return ret;
 	}
 
+/* Counts the records an SSL object writes to its end of a BIO pair while
+ * it is still in the handshake, by following the record headers through
+ * the written byte stream. */
+typedef struct record_count_st
+	{
+	SSL *ssl;
+	unsigned char hdr[5];
+	int hdr_len;		/* header bytes seen so far */
+	long left;		/* body bytes of the current record still due */
+	long records;
+	} RECORD_COUNT;
+
+static long MS_CALLBACK record_count_cb(BIO *b, int oper, const char *argp,
+	int argi, long argl, long ret)
+	{
+	RECORD_COUNT *rc=(RECORD_COUNT *)BIO_get_callback_arg(b);
+	const unsigned char *p=(const unsigned char *)argp;
+	long n=ret;
+
+	if (oper != (BIO_CB_WRITE|BIO_CB_RETURN) || ret <= 0)
+		return ret;
+	while (n > 0)
+		{
+		if (rc->left > 0)
+			{
+			long l=rc->left < n ? rc->left : n;
+
+			rc->left-=l;
+			p+=l;
+			n-=l;
+			continue;
+			}
+		rc->hdr[rc->hdr_len++]= *(p++);
+		n--;
+		/* an SSLv2 compatible ClientHello has a two byte header */
+		if (rc->hdr_len == 2 && (rc->hdr[0] & 0x80))
+			rc->left=((rc->hdr[0] & 0x7f) << 8) | rc->hdr[1];
+		else if (rc->hdr_len == 5)
+			rc->left=(rc->hdr[3] << 8) | rc->hdr[4];
+		else
+			continue;
+		rc->hdr_len=0;
+		if (SSL_in_init(rc->ssl))
+			rc->records++;
+		}
+	return ret;
+	}
+
+/* Blocks until a private key operation that |s| waits for has finished */
+static void wait_async(SSL *s)
+	{
+#ifdef OPENSSL_SYS_UNIX
+	fd_set fds;
+	int fd = SSL_get_async_fd(s);
+
+	if (fd < 0)
+		return;
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+	select(fd + 1, &fds, NULL, NULL, NULL);
+#endif
+	}
+
 int doit_biopair(SSL *s_ssl, SSL *c_ssl, long count,
 	clock_t *s_time, clock_t *c_time)
 	{
 	long cw_num = count, cr_num = count, sw_num = count, sr_num = count;
 	BIO *s_ssl_bio = NULL, *c_ssl_bio = NULL;
 	BIO *server = NULL, *server_io = NULL, *client = NULL, *client_io = NULL;
+	RECORD_COUNT s_rc, c_rc;
+	long cw_filled = -1, sw_filled = -1; /* -big_writes data offsets */
+	int data_read = 0; /* application data read in this iteration */
 	int ret = 1;
 	
 	size_t bufsiz = 256; /* small buffer for testing */
@@ -1162,6 +1366,15 @@ int doit_biopair(SSL *s_ssl, SSL *c_ssl, long count,
 		goto err;
 	if (!BIO_new_bio_pair(&client, bufsiz, &client_io, bufsiz))
 		goto err;
+
+	memset(&s_rc, 0, sizeof s_rc);
+	s_rc.ssl = s_ssl;
+	BIO_set_callback(server, record_count_cb);
+	BIO_set_callback_arg(server, (char *)&s_rc);
+	memset(&c_rc, 0, sizeof c_rc);
+	c_rc.ssl = c_ssl;
+	BIO_set_callback(client, record_count_cb);
+	BIO_set_callback_arg(client, (char *)&c_rc);
 	
 	s_ssl_bio = BIO_new(BIO_f_ssl());
 	if (!s_ssl_bio)
@@ -1239,11 +1452,25 @@ int doit_biopair(SSL *s_ssl, SSL *c_ssl, long count,
 				{
 				/* Write to server. */
 				
-				if (cw_num > (long)sizeof cbuf)
-					i = sizeof cbuf;
-				else
+				/* with -zero_copy keep records small enough
+				 * to be read in place */
+				i = zero_copy ? sizeof cbuf / 2 : sizeof cbuf;
+				if (big_writes)
+					i = BIG_WRITE_LEN;
+				if (cw_num < (long)i)
 					i = (int)cw_num;
-				r = BIO_write(c_ssl_bio, cbuf, i);
+				if (big_writes)
+					{
+					/* a retry must pass the same data */
+					if (cw_filled != count - cw_num)
+						{
+						cw_filled = count - cw_num;
+						big_write_fill(big_write_buf[0], cw_filled, i);
+						}
+					r = BIO_write(c_ssl_bio, big_write_buf[0], i);
+					}
+				else
+					r = BIO_write(c_ssl_bio, cbuf, i);
 				if (r < 0)
 					{
 					if (!BIO_should_retry(c_ssl_bio))
@@ -1292,7 +1519,14 @@ int doit_biopair(SSL *s_ssl, SSL *c_ssl, long count,
 					{
 					if (debug)
 						printf("client read %d\n", r);
+					if (big_writes && !big_write_check(
+						(unsigned char *)cbuf, count - cr_num, r))
+						{
+						fprintf(stderr,"ERROR in CLIENT: data read does not match\n");
+						goto err;
+						}
 					cr_num -= r;
+					data_read = 1;
 					}
 				}
 
@@ -1325,11 +1559,24 @@ int doit_biopair(SSL *s_ssl, SSL *c_ssl, long count,
 				{
 				/* Write to client. */
 				
-				if (sw_num > (long)sizeof sbuf)
-					i = sizeof sbuf;
-				else
+				/* with -zero_copy keep records small enough
+				 * to be read in place */
+				i = zero_copy ? sizeof sbuf / 2 : sizeof sbuf;
+				if (big_writes)
+					i = BIG_WRITE_LEN;
+				if (sw_num < (long)i)
 					i = (int)sw_num;
-				r = BIO_write(s_ssl_bio, sbuf, i);
+				if (big_writes)
+					{
+					if (sw_filled != count - sw_num)
+						{
+						sw_filled = count - sw_num;
+						big_write_fill(big_write_buf[1], sw_filled, i);
+						}
+					r = BIO_write(s_ssl_bio, big_write_buf[1], i);
+					}
+				else
+					r = BIO_write(s_ssl_bio, sbuf, i);
 				if (r < 0)
 					{
 					if (!BIO_should_retry(s_ssl_bio))
@@ -1375,7 +1622,14 @@ int doit_biopair(SSL *s_ssl, SSL *c_ssl, long count,
 					{
 					if (debug)
 						printf("server read %d\n", r);
+					if (big_writes && !big_write_check(
+						(unsigned char *)sbuf, count - sr_num, r))
+						{
+						fprintf(stderr,"ERROR in SERVER: data read does not match\n");
+						goto err;
+						}
 					sr_num -= r;
+					data_read = 1;
 					}
 				}
 
@@ -1392,7 +1646,11 @@ int doit_biopair(SSL *s_ssl, SSL *c_ssl, long count,
 			 */
 			
 			static int prev_progress = 1;
-			int progress = 0;
+			/* A record larger than the read buffer (-big_writes)
+			 * is read over several iterations without any I/O */
+			int progress = data_read;
+
+			data_read = 0;
 			
 			/* io1 to io2 */
 			do
@@ -1488,6 +1746,14 @@ int doit_biopair(SSL *s_ssl, SSL *c_ssl, long count,
 					}
 			} /* no loop, BIO_ctrl_get_read_request now returns 0 anyway */
 
+			if (!progress && SSL_want_async(s_ssl))
+				{
+				if (debug)
+					printf("server waiting for private key operation\n");
+				wait_async(s_ssl);
+				progress = 1;
+				}
+
 			if (!progress && !prev_progress)
 				if (cw_num > 0 || cr_num > 0 || sw_num > 0 || sr_num > 0)
 					{
@@ -1514,6 +1780,16 @@ int doit_biopair(SSL *s_ssl, SSL *c_ssl, long count,
 
 	if (verbose)
 		print_details(c_ssl, "DONE via BIO pair: ");
+	if (verbose || max_hs_records)
+		printf("Handshake records: client %ld, server %ld\n",
+			c_rc.records, s_rc.records);
+	if (max_hs_records &&
+		(c_rc.records > max_hs_records || s_rc.records > max_hs_records))
+		{
+		fprintf(stderr, "ERROR: more than %ld handshake records\n",
+			max_hs_records);
+		goto err;
+		}
 end:
 	ret = 0;
 
@@ -548,6 +548,14 @@ printf("which = %04X\nmac key=",which);
 		EVP_CipherInit_ex(dd,c,NULL,key,NULL,(which & SSL3_CC_WRITE));
 		EVP_CIPHER_CTX_ctrl(dd, EVP_CTRL_GCM_SET_IV_FIXED, k, iv);
 		}
+	else if ((EVP_CIPHER_flags(c)&EVP_CIPH_FLAG_AEAD_CIPHER) && k &&
+		 EVP_CIPHER_mode(c) == EVP_CIPH_STREAM_CIPHER)
+		{
+		/* ChaCha20-Poly1305: the whole nonce comes from the PRF and
+		 * is XORed with the sequence number for each record. */
+		EVP_CipherInit_ex(dd,c,NULL,key,NULL,(which & SSL3_CC_WRITE));
+		EVP_CIPHER_CTX_ctrl(dd, EVP_CTRL_AEAD_SET_IV_FIXED, k, iv);
+		}
 	else	
 		EVP_CipherInit_ex(dd,c,NULL,key,iv,(which & SSL3_CC_WRITE));
 
@@ -0,0 +1 @@
+../crypto/chacha/chachatest.c
\ No newline at end of file
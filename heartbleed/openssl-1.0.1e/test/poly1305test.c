@@ -0,0 +1 @@
+../crypto/poly1305/poly1305test.c
\ No newline at end of file
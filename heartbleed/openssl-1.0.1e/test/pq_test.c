@@ -0,0 +1 @@
+../crypto/pqueue/pq_test.c
\ No newline at end of file
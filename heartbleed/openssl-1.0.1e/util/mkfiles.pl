@@ -16,6 +16,8 @@ my @dirs = (
 "crypto/mdc2",
 "crypto/hmac",
 "crypto/cmac",
+"crypto/chacha",
+"crypto/poly1305",
 "crypto/ripemd",
 "crypto/des",
 "crypto/rc2",
@@ -58,7 +58,9 @@ VALIDATIONS = [
     ("server!tls!dh_param512",        validations.is_local_file_exists),
     ("server!tls!dh_param1024",       validations.is_local_file_exists),
     ("server!tls!dh_param2048",       validations.is_local_file_exists),
-    ("server!tls!dh_param4096",       validations.is_local_file_exists)
+    ("server!tls!dh_param4096",       validations.is_local_file_exists),
+    ("server!tls!session_cache$",     validations.is_boolean),
+    ("server!tls!session_cache!entries", validations.is_positive_int)
 ]
 
 WARNING = N_("""<p><b>WARNING</b>: This section contains advanced
@@ -92,6 +94,8 @@ NOTE_DH2048       = N_('Path to a Diffie Hellman (DH) parameters PEM file: 2048
 NOTE_DH4096       = N_('Path to a Diffie Hellman (DH) parameters PEM file: 4096 bits.')
 NOTE_TLS_TIMEOUT  = N_('Timeout for the TLS/SSL handshake. Default: 15 seconds.')
 NOTE_TLS_SSLv2    = N_("Allow clients to use SSL version 2 - Beware: it is vulnerable. (Default: No)")
+NOTE_TLS_CACHE    = N_('Share the TLS sessions among worker processes, so they can be resumed after a graceful restart. (Default: Yes)')
+NOTE_TLS_CACHE_SIZE = N_('Maximum number of TLS sessions kept in the shared cache. Default: 2048.')
 
 
 HELPS = [('config_advanced', N_('Advanced'))]
@@ -179,6 +183,8 @@ class TLSWidget (CTK.Container):
         table.Add (_('DH parameters: 1024 bits'), CTK.TextCfg('server!tls!dh_param1024', True), _(NOTE_DH1024))
         table.Add (_('DH parameters: 2048 bits'), CTK.TextCfg('server!tls!dh_param2048', True), _(NOTE_DH2048))
         table.Add (_('DH parameters: 4096 bits'), CTK.TextCfg('server!tls!dh_param4096', True), _(NOTE_DH4096))
+        table.Add (_('Shared Session Cache'),     CTK.CheckCfgText('server!tls!session_cache', True, _("Enabled")), _(NOTE_TLS_CACHE))
+        table.Add (_('Session Cache Entries'),    CTK.TextCfg('server!tls!session_cache!entries', True), _(NOTE_TLS_CACHE_SIZE))
 
         self += CTK.RawHTML ("<h2>%s</h2>" %(_('TLS')))
         self += CTK.Indenter(table)
@@ -35,6 +35,9 @@ NOTE_THEME        = N_("Choose the listing theme.")
 NOTE_ICON_DIR     = N_("Web directory where the icon files are located. Default: <i>/icons</i>.")
 NOTE_NOTICE_FILES = N_("List of notice files to be inserted.")
 NOTE_HIDDEN_FILES = N_("List of files that should not be listed.")
+NOTE_CACHE        = N_("Keep the rendered listings in memory while the directories remain unmodified. Default: <i>Enabled</i>.")
+NOTE_CACHE_SIZE   = N_("Maximum amount of memory used by the cached listings, in bytes. Default: <i>4194304</i>.")
+NOTE_CACHE_LAST   = N_("Maximum time a cached listing is used before it is rendered again, in seconds. Default: <i>60</i>.")
 
 HELPS = [('modules_handlers_dirlist', N_("Only listing"))]
 
@@ -72,10 +75,23 @@ class Plugin_dirlist (Handler.PluginHandler):
         self += CTK.RawHTML ('<h2>%s</h2>' %(_('Theming')))
         self += CTK.Indenter (submit)
 
+        # Caching
+        table = CTK.PropsTable()
+        table.Add (_('Cache listings'), CTK.CheckCfgText("%s!cache"%(key), True, _('Enabled')), _(NOTE_CACHE))
+        table.Add (_('Max. cache size'), CTK.TextCfg("%s!cache!max_size"%(key), True), _(NOTE_CACHE_SIZE))
+        table.Add (_('Max. cache age'),  CTK.TextCfg("%s!cache!lasting"%(key), True), _(NOTE_CACHE_LAST))
+
+        submit = CTK.Submitter (URL_APPLY)
+        submit += table
+        self += CTK.RawHTML ('<h2>%s</h2>' %(_('Caching')))
+        self += CTK.Indenter (submit)
+
         # Publish
         VALS = [("%s!icon_dir"%(key),     validations.is_path),
                 ("%s!notice_files"%(key), validations.is_path_list),
-                ("%s!hidden_files"%(key), validations.is_list)]
+                ("%s!hidden_files"%(key), validations.is_list),
+                ("%s!cache!max_size"%(key), validations.is_positive_int),
+                ("%s!cache!lasting"%(key),  validations.is_positive_int)]
 
         CTK.publish ('^%s$'%(URL_APPLY), CTK.cfg_apply_post, validation=VALS, method="POST")
 
@@ -31,7 +31,10 @@ import Balancer
 from util import *
 from consts import *
 
-HELPS = CgiBase.HELPS + [('modules_handlers_fcgi', "FastCGI")]
+URL_APPLY = '/plugin/fcgi/apply'
+HELPS     = CgiBase.HELPS + [('modules_handlers_fcgi', "FastCGI")]
+
+NOTE_REUSE_MAX = N_("Maximum number of idle connections per server that every thread keeps opened. Each one of them holds a FastCGI worker. (Default: 0, disabled)")
 
 class Plugin_fcgi (CgiBase.PluginHandlerCGI):
     def __init__ (self, key, **kwargs):
@@ -51,3 +54,15 @@ class Plugin_fcgi (CgiBase.PluginHandlerCGI):
         self += CTK.RawHTML ('<h2>%s</h2>' %(_('FastCGI Specific')))
         self += CTK.Indenter (table)
         self += modul
+
+        # Keep-alive
+        table = CTK.PropsTable()
+        table.Add (_("Reuse connections"), CTK.TextCfg ('%s!reuse_max'%(key), True), _(NOTE_REUSE_MAX))
+
+        submit = CTK.Submitter (URL_APPLY)
+        submit += table
+        self += CTK.Indenter (submit)
+
+        # Publish
+        VALS = [('%s!reuse_max'%(key), validations.is_positive_int)]
+        CTK.publish ('^%s'%(URL_APPLY), CTK.cfg_apply_post, validation=VALS, method="POST")
@@ -30,6 +30,7 @@ URL_APPLY = '/plugin/htdigest/apply'
 HELPS     = [('modules_validators_htdigest', "Htdigest")]
 
 NOTE_PASSWD = N_("Full path to the Htdigest formated password file.")
+NOTE_CACHE  = N_("Keep the parsed password file in memory while it remains unmodified. Default: <i>Enabled</i>.")
 
 
 class Plugin_htdigest (Auth.PluginAuth):
@@ -39,6 +40,7 @@ class Plugin_htdigest (Auth.PluginAuth):
 
         table = CTK.PropsTable()
         table.Add (_("Password File"), CTK.TextCfg("%s!passwdfile"%(self.key), False), _(NOTE_PASSWD))
+        table.Add (_("Cache File"), CTK.CheckCfgText("%s!cache"%(self.key), True, _('Enabled')), _(NOTE_CACHE))
 
         submit = CTK.Submitter (URL_APPLY)
         submit += table
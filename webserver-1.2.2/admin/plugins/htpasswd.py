@@ -29,7 +29,9 @@ import validations
 URL_APPLY = '/plugin/htpasswd/apply'
 HELPS     = [('modules_validators_htpasswd', "Htpasswd")]
 
-NOTE_PASSWD = N_("Full path to the Htpasswd formated password file.")
+NOTE_PASSWD   = N_("Full path to the Htpasswd formated password file.")
+NOTE_CACHE    = N_("Keep the parsed password file in memory while it remains unmodified. Default: <i>Enabled</i>.")
+NOTE_VERIFIED = N_("Number of recently verified credentials remembered, so they do not have to be hashed again. Zero disables it. Default: <i>1024</i>.")
 
 class Plugin_htpasswd (Auth.PluginAuth):
     def __init__ (self, key, **kwargs):
@@ -38,6 +40,8 @@ class Plugin_htpasswd (Auth.PluginAuth):
 
         table = CTK.PropsTable()
         table.Add (_("Password File"), CTK.TextCfg("%s!passwdfile"%(self.key), False), _(NOTE_PASSWD))
+        table.Add (_("Cache File"), CTK.CheckCfgText("%s!cache"%(self.key), True, _('Enabled')), _(NOTE_CACHE))
+        table.Add (_("Verified Credentials"), CTK.TextCfg("%s!cache!verified"%(self.key), True), _(NOTE_VERIFIED))
 
         submit = CTK.Submitter (URL_APPLY)
         submit += table
@@ -46,5 +50,6 @@ class Plugin_htpasswd (Auth.PluginAuth):
         self += CTK.Indenter (submit)
 
         # Publish
-        VALS = [("%s!passwdfile"%(self.key), validations.is_local_file_exists)]
+        VALS = [("%s!passwdfile"%(self.key),     validations.is_local_file_exists),
+                ("%s!cache!verified"%(self.key), validations.is_positive_int)]
         CTK.publish ('^%s'%(URL_APPLY), CTK.cfg_apply_post, validation=VALS, method="POST")
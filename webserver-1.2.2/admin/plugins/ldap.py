@@ -37,6 +37,11 @@ NOTE_BASE_DOMAIN = N_('Base domain for the web server authentications.')
 NOTE_FILTER      = N_('Object filter. It can be empty.')
 NOTE_USE_TLS     = N_('Enable to use secure connections between the web and LDAP servers.')
 NOTE_CA_FILE     = N_('CA File for the TLS connections.')
+NOTE_POOL        = N_('Number of threads querying the LDAP server, each one through its own connection. Zero makes the queries from the server threads. Default: <i>2</i>.')
+NOTE_CACHE       = N_('Remember the answers of the LDAP server for a while. Default: <i>Enabled</i>.')
+NOTE_CACHE_LEN   = N_('Maximum number of remembered answers. Default: <i>1024</i>.')
+NOTE_CACHE_OK    = N_('Seconds a successful authentication is remembered. Default: <i>60</i>.')
+NOTE_CACHE_NEG   = N_('Seconds a failed authentication is remembered. Default: <i>10</i>.')
 
 class Plugin_ldap (Auth.PluginAuth):
     def __init__ (self, key, **kwargs):
@@ -52,6 +57,11 @@ class Plugin_ldap (Auth.PluginAuth):
         table.Add (_("Filter"),        CTK.TextCfg("%s!filter"  %(self.key), True),  _(NOTE_FILTER))
         table.Add (_("Use TLS"),       CTK.CheckCfgText("%s!tls"%(self.key), False, _('Enabled')), _(NOTE_USE_TLS))
         table.Add (_("CA File"),       CTK.TextCfg("%s!ca_file" %(self.key), True),  _(NOTE_CA_FILE))
+        table.Add (_("Connections"),   CTK.TextCfg("%s!pool!size"%(self.key), True), _(NOTE_POOL))
+        table.Add (_("Cache"),         CTK.CheckCfgText("%s!cache"%(self.key), True, _('Enabled')), _(NOTE_CACHE))
+        table.Add (_("Cache Entries"), CTK.TextCfg("%s!cache!max_entries"%(self.key), True),      _(NOTE_CACHE_LEN))
+        table.Add (_("Cache Lasting"), CTK.TextCfg("%s!cache!lasting"%(self.key), True),          _(NOTE_CACHE_OK))
+        table.Add (_("Negative Cache Lasting"), CTK.TextCfg("%s!cache!lasting_negative"%(self.key), True), _(NOTE_CACHE_NEG))
 
         submit = CTK.Submitter (URL_APPLY)
         submit += table
@@ -60,7 +70,11 @@ class Plugin_ldap (Auth.PluginAuth):
         self += CTK.Indenter (submit)
 
         # Publish
-        VALS = [("%s!ca_file"%(self.key), validations.is_local_file_exists),
-                ("%s!port"%(self.key),    validations.is_tcp_port)]
+        VALS = [("%s!ca_file"%(self.key),                validations.is_local_file_exists),
+                ("%s!port"%(self.key),                   validations.is_tcp_port),
+                ("%s!pool!size"%(self.key),              validations.is_positive_int),
+                ("%s!cache!max_entries"%(self.key),      validations.is_positive_int),
+                ("%s!cache!lasting"%(self.key),          validations.is_positive_int),
+                ("%s!cache!lasting_negative"%(self.key), validations.is_positive_int)]
 
         CTK.publish ('^%s'%(URL_APPLY), CTK.cfg_apply_post, validation=VALS, method="POST")
@@ -40,6 +40,11 @@ NOTE_PASSWD = N_('Password for connecting to the database.')
 NOTE_DB     = N_('Database name containing the user/password pair list.')
 NOTE_SQL    = N_('SQL command to execute. ${user} is replaced with the user name.')
 NOTE_HASH   = N_('Choose an encryption type for the password. Only suitable for the "Basic" authentication mechanism.')
+NOTE_POOL      = N_('Number of threads querying the database, each one through its own connection. Zero makes the queries from the server threads. Default: <i>2</i>.')
+NOTE_CACHE     = N_('Remember the passwords returned by the database for a while. Default: <i>Enabled</i>.')
+NOTE_CACHE_LEN = N_('Maximum number of remembered users. Default: <i>1024</i>.')
+NOTE_CACHE_OK  = N_('Seconds a password is remembered. Default: <i>60</i>.')
+NOTE_CACHE_NEG = N_('Seconds an unknown user is remembered. Default: <i>10</i>.')
 
 HASHES = [
     ('',     N_('None')),
@@ -80,6 +85,11 @@ class Plugin_mysql (Auth.PluginAuth):
         table.Add (_('Database'),      CTK.TextCfg("%s!database"%(self.key), False),   _(NOTE_DB))
         table.Add (_('SQL Query'),     CTK.TextCfg("%s!query"%(self.key), False),      _(NOTE_SQL))
         table.Add (_('Password Hash'), CTK.ComboCfg("%s!hash"%(self.key), trans_options(HASHES), {'id': 'mysql_hash'}), _(NOTE_HASH))
+        table.Add (_('Connections'),   CTK.TextCfg("%s!pool!size"%(self.key), True),   _(NOTE_POOL))
+        table.Add (_('Cache'),         CTK.CheckCfgText("%s!cache"%(self.key), True, _('Enabled')), _(NOTE_CACHE))
+        table.Add (_('Cache Entries'), CTK.TextCfg("%s!cache!max_entries"%(self.key), True), _(NOTE_CACHE_LEN))
+        table.Add (_('Cache Lasting'), CTK.TextCfg("%s!cache!lasting"%(self.key), True),     _(NOTE_CACHE_OK))
+        table.Add (_('Negative Cache Lasting'), CTK.TextCfg("%s!cache!lasting_negative"%(self.key), True), _(NOTE_CACHE_NEG))
 
         submit = CTK.Submitter (URL_APPLY)
         submit += table
@@ -89,5 +99,9 @@ class Plugin_mysql (Auth.PluginAuth):
         self += CTK.RawHTML (js=BASIC_HASH_HACK)
 
         # Publish
-        VALS = [("%s!passwdfile"%(self.key), validations.is_local_file_exists)]
+        VALS = [("%s!passwdfile"%(self.key),             validations.is_local_file_exists),
+                ("%s!pool!size"%(self.key),              validations.is_positive_int),
+                ("%s!cache!max_entries"%(self.key),      validations.is_positive_int),
+                ("%s!cache!lasting"%(self.key),          validations.is_positive_int),
+                ("%s!cache!lasting_negative"%(self.key), validations.is_positive_int)]
         CTK.publish ('^%s'%(URL_APPLY), CTK.cfg_apply_post, validation=VALS, method="POST")
@@ -82,25 +82,6 @@ typedef struct {
 #define SUBNET_NODE(x) ((subnet_item_t *)(x))
 
 
-static ip_item_t *
-new_ip (void)
-{
-	ip_item_t *n = (ip_item_t *) malloc (sizeof(ip_item_t));
-	if (n == NULL) return NULL;
-
-	INIT_LIST_HEAD (LIST(n));
-	memset (&n->ip, 0, sizeof(ip_t));
-
-	return n;
-}
-
-static ret_t
-free_ip (ip_item_t *ip)
-{
-	free (ip);
-	return ret_ok;
-}
-
 static subnet_item_t *
 new_subnet (void)
 {
@@ -118,7 +99,8 @@ new_subnet (void)
 ret_t
 cherokee_access_init (cherokee_access_t *entry)
 {
-	INIT_LIST_HEAD(&entry->list_ips);
+	cherokee_ip_tree_init (&entry->tree_ipv4, 4);
+	cherokee_ip_tree_init (&entry->tree_ipv6, 16);
 	INIT_LIST_HEAD(&entry->list_subnets);
 	return ret_ok;
 }
@@ -128,12 +110,10 @@ cherokee_access_mrproper (cherokee_access_t *entry)
 {
 	cherokee_list_t *i, *tmp;
 
-	/* Free the IP list items
+	/* Free the IP and prefix trees
 	 */
-	list_for_each_safe (i, tmp, LIST(&entry->list_ips)) {
-		cherokee_list_del (i);
-		free (i);
-	}
+	cherokee_ip_tree_mrproper (&entry->tree_ipv4);
+	cherokee_ip_tree_mrproper (&entry->tree_ipv6);
 
 	/* Free the Subnet list items
 	 */
@@ -297,27 +277,75 @@ parse_netmask (char *netmask, subnet_item_t *n)
 }
 
 
+/* Length of a netmask, or -1 if its bits are not contiguous
+ */
+static int
+netmask_bits (ip_type_t type, ip_t *mask)
+{
+	cuint_t        i;
+	cuint_t        len;
+	int            bits  = 0;
+	unsigned char  c;
+	unsigned char *bytes = (unsigned char *) mask;
+
+	len = (type == ipv6) ? 16 : 4;
+
+	for (i = 0; i < len; i++) {
+		c = bytes[i];
+		if (c == 0xFF) {
+			bits += 8;
+			continue;
+		}
+
+		while (c & 0x80) {
+			c = (c << 1) & 0xFF;
+			bits++;
+		}
+
+		if (c != 0)
+			return -1;
+
+		for (i++; i < len; i++) {
+			if (bytes[i] != 0)
+				return -1;
+		}
+	}
+
+	return bits;
+}
+
+
+static ret_t
+tree_add (cherokee_access_t *entry, ip_type_t type, ip_t *ip, cuint_t bits)
+{
+	if (type == ipv6) {
+		return cherokee_ip_tree_add (&entry->tree_ipv6, ip, bits);
+	}
+
+	return cherokee_ip_tree_add (&entry->tree_ipv4, ip, bits);
+}
+
+
 static ret_t
 cherokee_access_add_ip (cherokee_access_t *entry, char *ip)
 {
-	ret_t      ret;
-	ip_item_t *n;
+	ret_t     ret;
+	ip_item_t n;
 
-	n = new_ip();
-	if (n == NULL) return ret_error;
+	memset (&n.ip, 0, sizeof(ip_t));
 
-	ret = parse_ip (ip, n);
+	ret = parse_ip (ip, &n);
 	if (ret < ret_ok) {
 		LOG_ERROR (CHEROKEE_ERROR_ACCESS_INVALID_IP, ip);
-
-		free_ip(n);
 		return ret;
 	}
 
-	cherokee_list_add (LIST(n), &entry->list_ips);
-	TRACE (ENTRIES, "Access: adding IP '%s'\n", ip);
+	ret = tree_add (entry, n.type, &n.ip, (n.type == ipv6) ? 128 : 32);
+	if (unlikely (ret != ret_ok))
+		return ret;
 
-	return ret;
+	TRACE (ENTRIES, "Access: adding IP '%s'\n", ip);
+	return ret_ok;
 }
 
 
@@ -346,6 +374,7 @@ static ret_t
 cherokee_access_add_subnet (cherokee_access_t *entry, char *subnet)
 {
 	ret_t              ret;
+	int                bits;
 	char              *slash;
 	char              *mask;
 	subnet_item_t     *n;
@@ -359,13 +388,11 @@ cherokee_access_add_subnet (cherokee_access_t *entry, char *subnet)
 	mask = slash +1;
 	cherokee_buffer_add (&ip, subnet, mask-subnet-1);
 
-	/* Create the new list object
+	/* Create the new subnet object
 	 */
 	n = new_subnet();
 	if (n == NULL) return ret_error;
 
-	cherokee_list_add (LIST(n), &entry->list_subnets);
-
 	/* Parse the IP
 	 */
 	ret = parse_ip (ip.buf, IP_NODE(n));
@@ -384,10 +411,23 @@ cherokee_access_add_subnet (cherokee_access_t *entry, char *subnet)
 
 	TRACE (ENTRIES, "Access: subnet IP '%s', mask '%s'\n", ip.buf, mask);
 
+	/* Prefixes go to the tree. Masks with non contiguous bits,
+	 * such as 255.0.255.0, can only be checked one by one.
+	 */
+	bits = netmask_bits (IP_NODE(n)->type, &n->mask);
+	if (bits >= 0) {
+		ret = tree_add (entry, IP_NODE(n)->type, &IP_NODE(n)->ip, bits);
+		free (n);
+	} else {
+		cherokee_list_add (LIST(n), &entry->list_subnets);
+		ret = ret_ok;
+	}
+
 	cherokee_buffer_mrproper (&ip);
-	return ret_ok;
+	return ret;
 
 error:
+	free (n);
 	cherokee_buffer_mrproper (&ip);
 	return ret_error;
 }
@@ -453,16 +493,26 @@ cherokee_access_add (cherokee_access_t *entry, char *ip_or_subnet)
 }
 
 
+static void
+print_prefix (unsigned char *addr, cuint_t bits, void *param)
+{
+	ip_t ip;
+
+	memset (&ip, 0, sizeof(ip_t));
+	memcpy (&ip, addr, (POINTER_TO_INT(param) == ipv6) ? 16 : 4);
+
+	print_ip (POINTER_TO_INT(param), &ip);
+	printf ("/%d ", bits);
+}
+
 ret_t
 cherokee_access_print_debug (cherokee_access_t *entry)
 {
 	cherokee_list_t *i;
 
-	printf ("IPs: ");
-	list_for_each (i, LIST(&entry->list_ips)) {
-		print_ip (IP_NODE(i)->type, &IP_NODE(i)->ip);
-		printf(" ");
-	}
+	printf ("Prefixes: ");
+	cherokee_ip_tree_while (&entry->tree_ipv4, print_prefix, INT_TO_POINTER(ipv4));
+	cherokee_ip_tree_while (&entry->tree_ipv6, print_prefix, INT_TO_POINTER(ipv6));
 	printf("\n");
 
 	printf ("Subnets: ");
@@ -481,70 +531,44 @@ cherokee_access_print_debug (cherokee_access_t *entry)
 ret_t
 cherokee_access_ip_match (cherokee_access_t *entry, cherokee_socket_t *sock)
 {
-	int              re;
+	ret_t            ret;
 	cherokee_list_t *i;
 
 	TRACE (ENTRIES, "Matching ip(%x)\n", SOCKET_ADDR_IPv4(sock)->sin_addr);
 
-	/* Check in the IP list
+	/* Look the address up in the prefix tree of its family
 	 */
-	list_for_each (i, LIST(&entry->list_ips)) {
-
+	switch (SOCKET_AF(sock)) {
+	case ipv4:
+		ret = cherokee_ip_tree_match (&entry->tree_ipv4, &SOCKET_ADDR_IPv4(sock)->sin_addr);
+		break;
 #ifdef HAVE_IPV6
+	case ipv6:
 		/* This is a special case:
 		 * The socket is IPv6 with a mapped IPv4 address
 		 */
-		if ((SOCKET_AF(sock) == ipv6) &&
-		    (IP_NODE(i)->type == ipv4) &&
-		    (IN6_IS_ADDR_V4MAPPED (&SOCKET_ADDR_IPv6(sock)->sin6_addr)) &&
-		    (!memcmp (&SOCKET_ADDR_IPv6(sock)->sin6_addr.s6_addr[12], &IP_NODE(i)->ip, 4)))
-		{
-			TRACE (ENTRIES, "IPv4 mapped in IPv6 address: %s\n", "matched");
-			return ret_ok;
-		}
-#endif
-
-		if (SOCKET_AF(sock) == IP_NODE(i)->type) {
-			switch (IP_NODE(i)->type) {
-			case ipv4:
-				re = memcmp (&SOCKET_ADDR_IPv4(sock)->sin_addr, &IP_NODE(i)->ip, 4);
-				/*
-				printf ("4 remote "); print_ip(ipv4, &SOCKET_ADDRESS_IPv4(sock)); printf ("\n");
-				printf ("4 list   "); print_ip(ipv4, &IP_NODE(i)->ip); printf ("\n");
-				*/
-				TRACE (ENTRIES, "IPv4 address (%x)%s matched (ip=%x)\n",
-				       IP_NODE(i)->ip.ip4,
-				       re ? " haven't" : "",
-				       SOCKET_ADDR_IPv4(sock)->sin_addr);
-				break;
-#ifdef HAVE_IPV6
-			case ipv6:
-				re = (! IN6_ARE_ADDR_EQUAL (&SOCKET_ADDR_IPv6(sock)->sin6_addr, &IP_NODE(i)->ip.ip6));
-
-				/* re = memcmp (&SOCKET_ADDR_IPv6(sock)->sin6_addr, &IP_NODE(i)->ip, 16); */
-
-				/*
-				printf ("6 family=%d, ipv6=%d\n", SOCKET_ADDR_IPv6(sock)->sin6_family, ipv6);
-				printf ("6 port=%d\n",            SOCKET_ADDR_IPv6(sock)->sin6_port);
-				printf ("6 remote "); print_ip(ipv6, &SOCKET_ADDRESS_IPv6(sock)); printf ("\n");
-				printf ("6 list   "); print_ip(ipv6, &IP_NODE(i)->ip); printf ("\n");
-				printf ("6 re = %d\n", re);
-				*/
-				break;
-#endif
-			default:
-				SHOULDNT_HAPPEN;
-				return ret_error;
-			}
-
-			if (re == 0) {
+		if (IN6_IS_ADDR_V4MAPPED (&SOCKET_ADDR_IPv6(sock)->sin6_addr)) {
+			ret = cherokee_ip_tree_match (&entry->tree_ipv4,
+						      &SOCKET_ADDR_IPv6(sock)->sin6_addr.s6_addr[12]);
+			if (ret == ret_ok) {
+				TRACE (ENTRIES, "IPv4 mapped in IPv6 address: %s\n", "matched");
 				return ret_ok;
 			}
 		}
+
+		ret = cherokee_ip_tree_match (&entry->tree_ipv6, &SOCKET_ADDR_IPv6(sock)->sin6_addr);
+		break;
+#endif
+	default:
+		ret = ret_not_found;
 	}
 
+	if (ret == ret_ok) {
+		TRACE (ENTRIES, "Address %s\n", "matched");
+		return ret_ok;
+	}
 
-	/* Check in the Subnets list
+	/* Check the subnets with non contiguous masks
 	 */
 	list_for_each (i, LIST(&entry->list_subnets)) {
 		int j;
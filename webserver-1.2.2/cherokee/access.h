@@ -28,10 +28,12 @@
 #include "common-internal.h"
 #include "list.h"
 #include "socket.h"
+#include "ip_tree.h"
 
 typedef struct {
-	cherokee_list_t list_ips;
-	cherokee_list_t list_subnets;
+	cherokee_ip_tree_t tree_ipv4;
+	cherokee_ip_tree_t tree_ipv6;
+	cherokee_list_t    list_subnets;
 } cherokee_access_t;
 
 ret_t cherokee_access_init       (cherokee_access_t  *entry);
@@ -74,6 +74,10 @@ cherokee_admin_server_reply_get_traffic (cherokee_handler_t *hdl,
 	cherokee_server_t *srv = HANDLER_SRV(hdl);
 	cherokee_buffer_t *tmp = THREAD_TMP_BUF2 (HANDLER_THREAD(hdl));
 
+	if (srv->collector) {
+		cherokee_collector_sync (srv->collector);
+	}
+
 	cherokee_dwriter_dict_open (dwriter);
 
 	cherokee_dwriter_cstring (dwriter, "tx");
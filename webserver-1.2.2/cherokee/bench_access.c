@@ -0,0 +1,192 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "access.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#define LOOKUPS      1000000
+#define LINEAR_LIMIT 10000
+
+typedef struct {
+	uint32_t net;
+	uint32_t mask;
+} prefix4_t;
+
+static double
+now (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* The per entry comparison access.c used to do for every list item
+ */
+static int
+linear_match (prefix4_t *list, int len, uint32_t addr)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if ((addr & list[i].mask) == list[i].net)
+			return 1;
+	}
+
+	return 0;
+}
+
+static void
+bench (int len, cherokee_boolean_t ipv6)
+{
+	int                i;
+	int                hits;
+	int                rounds;
+	double             start;
+	double             elapsed;
+	unsigned char      addr[16];
+	char               str[INET6_ADDRSTRLEN + 8];
+	prefix4_t         *list;
+	unsigned char     *lookups;
+	cherokee_socket_t  sock;
+	cherokee_access_t  access;
+
+	list    = malloc (len * sizeof(prefix4_t));
+	lookups = malloc (LOOKUPS * 16);
+	if ((list == NULL) || (lookups == NULL))
+		exit (1);
+
+	/* Generate a blocklist
+	 */
+	cherokee_access_init (&access);
+
+	start = now();
+	for (i = 0; i < len; i++) {
+		int bits;
+
+		memset (addr, 0, 16);
+		*(uint32_t *) addr = rand();
+
+		if (ipv6) {
+			addr[0] = 0x20;
+			addr[1] = 0x01;
+			*(uint32_t *) (addr + 4) = rand();
+			bits = 32 + rand() % 33;
+			inet_ntop (AF_INET6, addr, str, INET6_ADDRSTRLEN);
+		} else {
+			bits = 16 + rand() % 17;
+			inet_ntop (AF_INET, addr, str, INET6_ADDRSTRLEN);
+
+			list[i].mask = htonl (0xFFFFFFFFUL << (32 - bits));
+			list[i].net  = *(uint32_t *) addr & list[i].mask;
+		}
+
+		sprintf (str + strlen(str), "/%d", bits);
+		cherokee_access_add (&access, str);
+	}
+	elapsed = now() - start;
+
+	printf ("%s %7d prefixes: built in %6.1f ms\n",
+		ipv6 ? "IPv6" : "IPv4", len, elapsed * 1000);
+
+	/* Random addresses to look up
+	 */
+	for (i = 0; i < LOOKUPS * 16; i++) {
+		lookups[i] = rand() & 0xff;
+	}
+
+	if (ipv6) {
+		for (i = 0; i < LOOKUPS; i++) {
+			lookups[i * 16]     = 0x20;
+			lookups[i * 16 + 1] = 0x01;
+		}
+	}
+
+	memset (&sock.client_addr, 0, sizeof(sock.client_addr));
+	SOCKET_AF(&sock) = ipv6 ? AF_INET6 : AF_INET;
+
+	/* Prefix tree
+	 */
+	hits  = 0;
+	start = now();
+	for (i = 0; i < LOOKUPS; i++) {
+		if (ipv6) {
+			memcpy (&SOCKET_ADDR_IPv6(&sock)->sin6_addr, lookups + i * 16, 16);
+		} else {
+			memcpy (&SOCKET_ADDR_IPv4(&sock)->sin_addr, lookups + i * 16, 4);
+		}
+
+		hits += (cherokee_access_ip_match (&access, &sock) == ret_ok);
+	}
+	elapsed = now() - start;
+
+	printf ("                radix tree: %10.0f lookups/s (%d hits)\n",
+		LOOKUPS / elapsed, hits);
+
+	/* Linear scan, for reference. Fewer rounds on long lists.
+	 */
+	if ((! ipv6) && (len <= LINEAR_LIMIT)) {
+		rounds = LOOKUPS / (1 + len / 100);
+		hits   = 0;
+		start  = now();
+		for (i = 0; i < rounds; i++) {
+			hits += linear_match (list, len, *(uint32_t *) (lookups + i * 16));
+		}
+		elapsed = now() - start;
+
+		printf ("               linear scan: %10.0f lookups/s (%d hits in %d)\n",
+			rounds / elapsed, hits, rounds);
+	}
+
+	cherokee_access_mrproper (&access);
+	free (lookups);
+	free (list);
+}
+
+int
+main (int argc, char *argv[])
+{
+	int i;
+	int sizes[] = {10, 100, 1000, 10000, 100000, 0};
+
+	UNUSED (argc);
+	UNUSED (argv);
+
+	srand (1978);
+
+	for (i = 0; sizes[i] != 0; i++) {
+		bench (sizes[i], false);
+	}
+
+	for (i = 0; sizes[i] != 0; i++) {
+		bench (sizes[i], true);
+	}
+
+	return 0;
+}
@@ -0,0 +1,99 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "crc32.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define TOTAL_BYTES (512 * 1024 * 1024)
+
+typedef crc_t (*crc_func_t) (crc_t, char *, int);
+
+static double
+now (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+bench (const char *name, crc_func_t func, char *buf, int len)
+{
+	long   i;
+	long   rounds = TOTAL_BYTES / len;
+	crc_t  crc    = 0;
+	double start;
+	double elapsed;
+
+	start = now();
+	for (i = 0; i < rounds; i++) {
+		crc = func (crc, buf, len);
+	}
+	elapsed = now() - start;
+
+	printf ("%-18s %8d bytes: %8.1f MB/s (crc %08x)\n", name, len,
+		(rounds * (double)len) / elapsed / (1024 * 1024), crc);
+}
+
+int
+main (int argc, char *argv[])
+{
+	int   i;
+	char *buf;
+	int   sizes[] = {64, 1024, 16 * 1024, 1024 * 1024, 0};
+
+	UNUSED (argc);
+	UNUSED (argv);
+
+	buf = malloc (1024 * 1024);
+	if (buf == NULL) {
+		return 1;
+	}
+
+	for (i = 0; i < 1024 * 1024; i++) {
+		buf[i] = rand() & 0xff;
+	}
+
+	for (i = 0; sizes[i] != 0; i++) {
+		bench ("byte table", crc32_partial_sz_ref, buf, sizes[i]);
+	}
+
+	/* Slicing-by-8 is the default until crc32_init() is called */
+	for (i = 0; sizes[i] != 0; i++) {
+		bench ("slicing-by-8", crc32_partial_sz, buf, sizes[i]);
+	}
+
+	crc32_init();
+	for (i = 0; sizes[i] != 0; i++) {
+		bench ("runtime selected", crc32_partial_sz, buf, sizes[i]);
+	}
+
+	free (buf);
+	return 0;
+}
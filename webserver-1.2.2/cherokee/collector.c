@@ -25,27 +25,81 @@
 #include "common-internal.h"
 #include "collector.h"
 #include "bogotime.h"
+#include "threading.h"
+#include "init.h"
+
+/* Number of per-thread counter slots of each collector. Threads
+ * are given a slot the first time they log something; if there
+ * were more threads than slots, some of them would share one.
+ */
+#define SLOTS_NUM 64
+
+/* Slot counters are only modified by their own thread (unless
+ * they are shared), so atomic additions never contend. They are
+ * merged by whoever reads the collector.
+ */
+#if defined(__GNUC__)
+# define SLOT_ADD(c,var,val)  __sync_fetch_and_add (&(var), (val))
+# define SLOT_READ(var)       __sync_fetch_and_add (&(var), 0)
+#else
+# define SLOT_ADD(c,var,val)  do { LOCK(c); (var) += (val); UNLOCK(c); } while (false)
+# define SLOT_READ(var)       (var)
+#endif
 
 
 /* Priv structure
  */
 
+typedef struct {
+	cullong_t accepts;
+	cullong_t requests;
+	cullong_t timeouts;
+	cullong_t rx;
+	cullong_t tx;
+} slot_t;
+
 typedef struct {
 	CHEROKEE_MUTEX_T (mutex);
-	int               foo;
+	char             *slots_mem;
+	char             *slots;
+	cuint_t           slots_stride;
 } priv_t;
 
+#define PRIV(c)   ((priv_t *)(COLLECTOR_BASE(c)->priv))
+#define LOCK(c)   CHEROKEE_MUTEX_LOCK   (&PRIV(c)->mutex)
+#define UNLOCK(c) CHEROKEE_MUTEX_UNLOCK (&PRIV(c)->mutex)
+#define SLOT(c,n) ((slot_t *)(PRIV(c)->slots + ((n) * PRIV(c)->slots_stride)))
+
 
 static ret_t
 priv_new (priv_t **priv)
 {
-	priv_t *n;
+	priv_t  *n;
+	cuint_t  line;
 
 	n = malloc (sizeof (priv_t));
 	if (n == NULL) {
 		return ret_nomem;
 	}
 
+	/* Each slot takes whole cache lines, so threads never
+	 * write to the same line.
+	 */
+	line = (cherokee_cacheline_size > 0) ? cherokee_cacheline_size : CPU_CACHE_LINE;
+
+	n->slots_stride = line;
+	while (n->slots_stride < sizeof(slot_t)) {
+		n->slots_stride += line;
+	}
+
+	n->slots_mem = calloc (SLOTS_NUM + 1, n->slots_stride);
+	if (n->slots_mem == NULL) {
+		free (n);
+		return ret_nomem;
+	}
+
+	n->slots = (char *) (((uintptr_t)n->slots_mem + line - 1) & ~((uintptr_t)line - 1));
+
 	CHEROKEE_MUTEX_INIT (&n->mutex, CHEROKEE_MUTEX_FAST);
 
 	*priv = n;
@@ -59,11 +113,55 @@ priv_free (priv_t *priv)
 		return;
 
 	CHEROKEE_MUTEX_DESTROY (&priv->mutex);
+	free (priv->slots_mem);
 	free (priv);
 }
 
-#define LOCK(c)   CHEROKEE_MUTEX_LOCK   (&((priv_t *)(COLLECTOR_BASE(c)->priv))->mutex)
-#define UNLOCK(c) CHEROKEE_MUTEX_UNLOCK (&((priv_t *)(COLLECTOR_BASE(c)->priv))->mutex)
+
+/* Thread slots
+ */
+
+static cuint_t
+slot_get_num (void)
+{
+	void           *prop;
+	cuint_t         num;
+	static cuint_t  slots_next = 0;
+
+	prop = CHEROKEE_THREAD_PROP_GET (thread_collector_slot_ptr);
+	if (likely (prop != NULL)) {
+		return (cuint_t) ((uintptr_t)prop - 1);
+	}
+
+#if defined(__GNUC__)
+	num = __sync_fetch_and_add (&slots_next, 1) % SLOTS_NUM;
+#else
+	num = slots_next++ % SLOTS_NUM;
+#endif
+
+	CHEROKEE_THREAD_PROP_SET (thread_collector_slot_ptr, (void *)((uintptr_t)num + 1));
+	return num;
+}
+
+static void
+slots_sum (cherokee_collector_base_t *collector,
+	   slot_t                    *total)
+{
+	cuint_t  i;
+	slot_t  *slot;
+
+	memset (total, 0, sizeof(slot_t));
+
+	for (i = 0; i < SLOTS_NUM; i++) {
+		slot = SLOT(collector, i);
+
+		total->accepts  += SLOT_READ (slot->accepts);
+		total->requests += SLOT_READ (slot->requests);
+		total->timeouts += SLOT_READ (slot->timeouts);
+		total->rx       += SLOT_READ (slot->rx);
+		total->tx       += SLOT_READ (slot->tx);
+	}
+}
 
 
 /* Collection base
@@ -113,17 +211,58 @@ base_free (cherokee_collector_base_t *collector)
 	return ret_ok;
 }
 
-static ret_t
+static void
 base_count (cherokee_collector_base_t *collector,
+	    cuint_t                    num,
 	    off_t                      rx,
 	    off_t                      tx)
 {
-	collector->rx         += rx;
-	collector->rx_partial += rx;
-	collector->tx         += tx;
-	collector->tx_partial += tx;
+	slot_t *slot = SLOT(collector, num);
 
-	return ret_ok;
+	if (rx != 0) {
+		SLOT_ADD (collector, slot->rx, rx);
+	}
+
+	if (tx != 0) {
+		SLOT_ADD (collector, slot->tx, tx);
+	}
+}
+
+static void
+base_sync (cherokee_collector_base_t *collector,
+	   slot_t                    *total)
+{
+	/* collector is LOCKED
+	 */
+	collector->rx_partial += (total->rx - collector->rx);
+	collector->tx_partial += (total->tx - collector->tx);
+
+	collector->rx = total->rx;
+	collector->tx = total->tx;
+}
+
+/* The partial counters are read and consumed under the collector
+ * lock: a sync from another thread may land in between, and it must
+ * not be lost. Only what was read is taken away from them.
+ */
+static void
+base_get_partial (cherokee_collector_base_t    *collector,
+		  cherokee_collector_partial_t *partial)
+{
+	/* collector is LOCKED
+	 */
+	partial->rx = collector->rx_partial;
+	partial->tx = collector->tx_partial;
+}
+
+static void
+base_consume_partial (cherokee_collector_base_t    *collector,
+		      cherokee_collector_partial_t *partial)
+{
+	/* collector is LOCKED
+	 */
+	collector->rx_partial -= partial->rx;
+	collector->tx_partial -= partial->tx;
 }
 
 
@@ -181,34 +320,86 @@ cherokee_collector_init (cherokee_collector_t *collector)
 ret_t
 cherokee_collector_log_accept (cherokee_collector_t *collector)
 {
-	LOCK(collector);
+	slot_t *slot = SLOT(collector, slot_get_num());
 
-	collector->accepts++;
-	collector->accepts_partial++;
+	SLOT_ADD (collector, slot->accepts, 1);
+	return ret_ok;
+}
 
+ret_t
+cherokee_collector_log_request (cherokee_collector_t *collector)
+{
+	slot_t *slot = SLOT(collector, slot_get_num());
+
+	SLOT_ADD (collector, slot->requests, 1);
+	return ret_ok;
+}
+
+ret_t
+cherokee_collector_log_timeout (cherokee_collector_t *collector)
+{
+	slot_t *slot = SLOT(collector, slot_get_num());
+
+	SLOT_ADD (collector, slot->timeouts, 1);
+	return ret_ok;
+}
+
+static void
+srv_sync (cherokee_collector_t *collector)
+{
+	slot_t total;
+
+	/* collector is LOCKED
+	 */
+	slots_sum (COLLECTOR_BASE(collector), &total);
+
+	collector->accepts_partial  += (total.accepts  - collector->accepts);
+	collector->requests_partial += (total.requests - collector->requests);
+	collector->timeouts_partial += (total.timeouts - collector->timeouts);
+
+	collector->accepts  = total.accepts;
+	collector->requests = total.requests;
+	collector->timeouts = total.timeouts;
+
+	base_sync (COLLECTOR_BASE(collector), &total);
+}
+
+ret_t
+cherokee_collector_sync (cherokee_collector_t *collector)
+{
+	LOCK(collector);
+	srv_sync (collector);
 	UNLOCK(collector);
+
 	return ret_ok;
 }
 
 ret_t
-cherokee_collector_log_request (cherokee_collector_t *collector)
+cherokee_collector_sync_partial (cherokee_collector_t         *collector,
+				 cherokee_collector_partial_t *partial)
 {
 	LOCK(collector);
+	srv_sync (collector);
 
-	collector->requests++;
-	collector->requests_partial++;
+	partial->accepts  = collector->accepts_partial;
+	partial->requests = collector->requests_partial;
+	partial->timeouts = collector->timeouts_partial;
+	base_get_partial (COLLECTOR_BASE(collector), partial);
 
 	UNLOCK(collector);
 	return ret_ok;
 }
 
 ret_t
-cherokee_collector_log_timeout (cherokee_collector_t *collector)
+cherokee_collector_consume_partial (cherokee_collector_t         *collector,
+				    cherokee_collector_partial_t *partial)
 {
 	LOCK(collector);
 
-	collector->timeouts++;
-	collector->timeouts_partial++;
+	collector->accepts_partial  -= partial->accepts;
+	collector->requests_partial -= partial->requests;
+	collector->timeouts_partial -= partial->timeouts;
+	base_consume_partial (COLLECTOR_BASE(collector), partial);
 
 	UNLOCK(collector);
 	return ret_ok;
@@ -250,12 +441,6 @@ cherokee_collector_vsrv_init_base (cherokee_collector_vsrv_t  *collector_vsrv,
 	 */
 	base_init (COLLECTOR_BASE(collector_vsrv), NULL, config);
 
-	/* Properties
-	 */
-	collector_vsrv->srv_next_update = 0;
-	collector_vsrv->srv_rx_partial  = 0;
-	collector_vsrv->srv_tx_partial  = 0;
-
 	return ret_ok;
 }
 
@@ -274,31 +459,56 @@ cherokee_collector_vsrv_count (cherokee_collector_vsrv_t  *collector_vsrv,
 			       off_t                       rx,
 			       off_t                       tx)
 {
-	/* Add it to the virtual server collector
+	cuint_t num = slot_get_num();
+
+	/* Add it to both the virtual server and server collectors
 	 */
+	base_count (COLLECTOR_BASE(collector_vsrv), num, rx, tx);
+	base_count (COLLECTOR_BASE(collector_vsrv->srv_collector), num, rx, tx);
+
+	return ret_ok;
+}
+
+ret_t
+cherokee_collector_vsrv_sync (cherokee_collector_vsrv_t *collector_vsrv)
+{
+	slot_t total;
+
 	LOCK(collector_vsrv);
-	base_count (COLLECTOR_BASE(collector_vsrv), rx, tx);
 
-	/* Partial counting (vsrv to srv)
-	 */
-	collector_vsrv->srv_rx_partial += rx;
-	collector_vsrv->srv_tx_partial += tx;
+	slots_sum (COLLECTOR_BASE(collector_vsrv), &total);
+	base_sync (COLLECTOR_BASE(collector_vsrv), &total);
+
+	UNLOCK(collector_vsrv);
+	return ret_ok;
+}
 
-	if (cherokee_bogonow_now >= collector_vsrv->srv_next_update) {
-		LOCK(collector_vsrv->srv_collector);
+ret_t
+cherokee_collector_vsrv_sync_partial (cherokee_collector_vsrv_t    *collector_vsrv,
+				      cherokee_collector_partial_t *partial)
+{
+	slot_t total;
 
-		base_count (COLLECTOR_BASE(collector_vsrv->srv_collector),
-			    collector_vsrv->srv_rx_partial,
-			    collector_vsrv->srv_tx_partial);
+	LOCK(collector_vsrv);
 
-		collector_vsrv->srv_rx_partial  = 0;
-		collector_vsrv->srv_tx_partial  = 0;
-		collector_vsrv->srv_next_update = cherokee_bogonow_now + 10;
+	slots_sum (COLLECTOR_BASE(collector_vsrv), &total);
+	base_sync (COLLECTOR_BASE(collector_vsrv), &total);
 
-		UNLOCK(collector_vsrv->srv_collector);
-	}
+	memset (partial, 0, sizeof(cherokee_collector_partial_t));
+	base_get_partial (COLLECTOR_BASE(collector_vsrv), partial);
+
+	UNLOCK(collector_vsrv);
+	return ret_ok;
+}
 
+ret_t
+cherokee_collector_vsrv_consume_partial (cherokee_collector_vsrv_t    *collector_vsrv,
+					 cherokee_collector_partial_t *partial)
+{
+	LOCK(collector_vsrv);
+	base_consume_partial (COLLECTOR_BASE(collector_vsrv), partial);
 	UNLOCK(collector_vsrv);
+
 	return ret_ok;
 }
 
@@ -60,7 +60,8 @@ typedef struct {
 	 */
 	collector_func_free_t     free;
 
-	/* Properties
+	/* Properties: merged from the per-thread counters
+	 * by cherokee_collector_sync() and _vsrv_sync()
 	 */
 	off_t                     rx;
 	off_t                     rx_partial;
@@ -93,14 +94,18 @@ typedef struct {
 	/* Virtual Methods
 	 */
 	collector_vsrv_func_init_t init;
-
-	/* Properties
-	 */
-	time_t                     srv_next_update;
-	off_t                      srv_rx_partial;
-	off_t                      srv_tx_partial;
 } cherokee_collector_vsrv_t;
 
+/* Partial counters, as handed to the consumers of the collector
+ */
+typedef struct {
+	cullong_t                 accepts;
+	cullong_t                 requests;
+	cullong_t                 timeouts;
+	off_t                     rx;
+	off_t                     tx;
+} cherokee_collector_partial_t;
+
 #define COLLECTOR_BASE(c)       ((cherokee_collector_base_t *)(c))
 #define COLLECTOR(c)            ((cherokee_collector_t *)(c))
 #define COLLECTOR_VSRV(c)       ((cherokee_collector_vsrv_t *)(c))
@@ -140,6 +145,12 @@ ret_t cherokee_collector_free        (cherokee_collector_t      *collector);
 ret_t cherokee_collector_log_accept  (cherokee_collector_t      *collector);
 ret_t cherokee_collector_log_request (cherokee_collector_t      *collector);
 ret_t cherokee_collector_log_timeout (cherokee_collector_t      *collector);
+ret_t cherokee_collector_sync        (cherokee_collector_t      *collector);
+
+ret_t cherokee_collector_sync_partial    (cherokee_collector_t         *collector,
+					  cherokee_collector_partial_t *partial);
+ret_t cherokee_collector_consume_partial (cherokee_collector_t         *collector,
+					  cherokee_collector_partial_t *partial);
 
 /* Collector virtual methods
  */
@@ -153,6 +164,12 @@ ret_t cherokee_collector_vsrv_init   (cherokee_collector_vsrv_t  *collector_vsrv
 ret_t cherokee_collector_vsrv_count  (cherokee_collector_vsrv_t  *collector_vsrv,
 				      off_t                       rx,
 				      off_t                       tx);
+ret_t cherokee_collector_vsrv_sync   (cherokee_collector_vsrv_t  *collector_vsrv);
+
+ret_t cherokee_collector_vsrv_sync_partial    (cherokee_collector_vsrv_t    *collector_vsrv,
+					       cherokee_collector_partial_t *partial);
+ret_t cherokee_collector_vsrv_consume_partial (cherokee_collector_vsrv_t    *collector_vsrv,
+					       cherokee_collector_partial_t *partial);
 
 CHEROKEE_END_DECLS
 
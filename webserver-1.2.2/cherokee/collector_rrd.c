@@ -103,7 +103,12 @@ update_generic (cherokee_buffer_t *params)
 static void
 update_srv_cb (cherokee_collector_rrd_t *rrd)
 {
-	ret_t ret;
+	ret_t                        ret;
+	cherokee_collector_partial_t partial;
+
+	/* Merge the per-thread counters
+	 */
+	cherokee_collector_sync_partial (COLLECTOR(rrd), &partial);
 
 	/* Build the RRDtool string
 	 */
@@ -111,15 +116,15 @@ update_srv_cb (cherokee_collector_rrd_t *rrd)
 	cherokee_buffer_add_str      (&rrd->tmp, "update ");
 	cherokee_buffer_add_buffer   (&rrd->tmp, &rrd->path_database);
 	cherokee_buffer_add_str      (&rrd->tmp, " N:");
-	cherokee_buffer_add_ullong10 (&rrd->tmp, COLLECTOR(rrd)->accepts_partial);
+	cherokee_buffer_add_ullong10 (&rrd->tmp, partial.accepts);
 	cherokee_buffer_add_str      (&rrd->tmp, ":");
-	cherokee_buffer_add_ullong10 (&rrd->tmp, COLLECTOR(rrd)->requests_partial);
+	cherokee_buffer_add_ullong10 (&rrd->tmp, partial.requests);
 	cherokee_buffer_add_str      (&rrd->tmp, ":");
-	cherokee_buffer_add_ullong10 (&rrd->tmp, COLLECTOR(rrd)->timeouts_partial);
+	cherokee_buffer_add_ullong10 (&rrd->tmp, partial.timeouts);
 	cherokee_buffer_add_str      (&rrd->tmp, ":");
-	cherokee_buffer_add_ullong10 (&rrd->tmp, COLLECTOR_BASE(rrd)->rx_partial);
+	cherokee_buffer_add_ullong10 (&rrd->tmp, partial.rx);
 	cherokee_buffer_add_str      (&rrd->tmp, ":");
-	cherokee_buffer_add_ullong10 (&rrd->tmp, COLLECTOR_BASE(rrd)->tx_partial);
+	cherokee_buffer_add_ullong10 (&rrd->tmp, partial.tx);
 	cherokee_buffer_add_str      (&rrd->tmp, "\n");
 
 	/* Update
@@ -129,13 +134,9 @@ update_srv_cb (cherokee_collector_rrd_t *rrd)
 		return;
 	}
 
-	/* Begin partial counting from scratch
+	/* Begin partial counting from what was not reported
 	 */
-	COLLECTOR(rrd)->accepts_partial  = 0;
-	COLLECTOR(rrd)->requests_partial = 0;
-	COLLECTOR(rrd)->timeouts_partial = 0;
-	COLLECTOR_BASE(rrd)->rx_partial  = 0;
-	COLLECTOR_BASE(rrd)->tx_partial  = 0;
+	cherokee_collector_consume_partial (COLLECTOR(rrd), &partial);
 }
 
 
@@ -167,7 +168,12 @@ srv_free (cherokee_collector_rrd_t *rrd)
 static void
 update_vsrv_cb (cherokee_collector_vsrv_rrd_t *rrd)
 {
-	ret_t ret;
+	ret_t                        ret;
+	cherokee_collector_partial_t partial;
+
+	/* Merge the per-thread counters
+	 */
+	cherokee_collector_vsrv_sync_partial (COLLECTOR_VSRV(rrd), &partial);
 
 	/* Build params
 	 */
@@ -175,9 +181,9 @@ update_vsrv_cb (cherokee_collector_vsrv_rrd_t *rrd)
 	cherokee_buffer_add_str      (&rrd->tmp, "update ");
 	cherokee_buffer_add_buffer   (&rrd->tmp, &rrd->path_database);
 	cherokee_buffer_add_str      (&rrd->tmp, " N:");
-	cherokee_buffer_add_ullong10 (&rrd->tmp, COLLECTOR_BASE(rrd)->rx_partial);
+	cherokee_buffer_add_ullong10 (&rrd->tmp, partial.rx);
 	cherokee_buffer_add_str      (&rrd->tmp, ":");
-	cherokee_buffer_add_ullong10 (&rrd->tmp, COLLECTOR_BASE(rrd)->tx_partial);
+	cherokee_buffer_add_ullong10 (&rrd->tmp, partial.tx);
 	cherokee_buffer_add_str      (&rrd->tmp, "\n");
 
 	/* Update
@@ -187,10 +193,9 @@ update_vsrv_cb (cherokee_collector_vsrv_rrd_t *rrd)
 		return;
 	}
 
-	/* Begin partial counting from scratch
+	/* Begin partial counting from what was not reported
 	 */
-	COLLECTOR_BASE(rrd)->rx_partial = 0;
-	COLLECTOR_BASE(rrd)->tx_partial = 0;
+	cherokee_collector_vsrv_consume_partial (COLLECTOR_VSRV(rrd), &partial);
 }
 
 
@@ -125,6 +125,7 @@ struct cherokee_connection {
 	cherokee_buffer_t             incoming_header;  /* -> header               */
 	cherokee_buffer_t             header_buffer;    /* <- header, -> post data */
 	cherokee_buffer_t             buffer;           /* <- data                 */
+	cherokee_buffer_t             pipelined_buffer; /* <- queued responses     */
 
 	/* State
 	 */
@@ -265,6 +266,7 @@ ret_t cherokee_connection_linger_read            (cherokee_connection_t *conn);
 ret_t cherokee_connection_send                   (cherokee_connection_t *conn);
 ret_t cherokee_connection_send_header            (cherokee_connection_t *conn);
 ret_t cherokee_connection_send_header_and_mmaped (cherokee_connection_t *conn);
+ret_t cherokee_connection_send_pipelined         (cherokee_connection_t *conn);
 ret_t cherokee_connection_recv                   (cherokee_connection_t *conn, cherokee_buffer_t *buffer, off_t to_read, off_t *len);
 
 /* Internal
@@ -307,6 +309,7 @@ ret_t cherokee_connection_clean_error_headers    (cherokee_connection_t *conn);
 ret_t cherokee_connection_set_redirect           (cherokee_connection_t *conn, cherokee_buffer_t *address);
 
 ret_t cherokee_connection_clean_for_respin       (cherokee_connection_t *conn);
+ret_t cherokee_connection_clean_for_resetup      (cherokee_connection_t *conn);
 int   cherokee_connection_use_webdir             (cherokee_connection_t *conn);
 
 /* Log
@@ -133,6 +133,7 @@ cherokee_connection_new  (cherokee_connection_t **conn)
 	n->header_ops           = NULL;
 
 	cherokee_buffer_init (&n->buffer);
+	cherokee_buffer_init (&n->pipelined_buffer);
 	cherokee_buffer_init (&n->header_buffer);
 	cherokee_buffer_init (&n->incoming_header);
 	cherokee_buffer_init (&n->encoder_buffer);
@@ -201,6 +202,7 @@ cherokee_connection_free (cherokee_connection_t  *conn)
 
 	cherokee_buffer_mrproper (&conn->pathinfo);
 	cherokee_buffer_mrproper (&conn->buffer);
+	cherokee_buffer_mrproper (&conn->pipelined_buffer);
 	cherokee_buffer_mrproper (&conn->header_buffer);
 	cherokee_buffer_mrproper (&conn->incoming_header);
 	cherokee_buffer_mrproper (&conn->query_string);
@@ -401,6 +403,7 @@ cherokee_connection_clean_close (cherokee_connection_t *conn)
 	 */
 	conn->keepalive = 0;
 	cherokee_buffer_clean (&conn->incoming_header);
+	cherokee_buffer_clean (&conn->pipelined_buffer);
 
 	/* Clean the connection object
 	 */
@@ -889,6 +892,147 @@ cherokee_connection_build_header (cherokee_connection_t *conn)
 }
 
 
+/* HTTP pipelining: when the client has already sent the following
+ * request, the response to the current one is queued instead of
+ * being written. All the queued responses go out in a single
+ * writev() along with the first response that cannot be deferred.
+ */
+static cherokee_boolean_t
+pipeline_can_defer (cherokee_connection_t *conn,
+		    size_t                 len)
+{
+	cuint_t  header_len = 0;
+	char    *next;
+
+	/* The connection has to be kept alive for another request,
+	 * and this response must be sent in a single piece.
+	 */
+	if ((conn->keepalive <= 1) ||
+	    (conn->limit_bps > 0) ||
+	    (conn->chunked_encoding) ||
+	    (http_method_with_input (conn->header.method)) ||
+	    (http_method_with_optional_input (conn->header.method)))
+	{
+		return false;
+	}
+
+	if (conn->pipelined_buffer.len + len > MAX_PIPELINED_LEN) {
+		return false;
+	}
+
+	/* The next request must already be in the incoming buffer
+	 */
+	cherokee_header_get_length (&conn->header, &header_len);
+	if ((header_len == 0) || (header_len >= conn->incoming_header.len)) {
+		return false;
+	}
+
+	next = conn->incoming_header.buf + header_len;
+	while ((*next == CHR_CR) || (*next == CHR_LF)) {
+		next++;
+	}
+
+	/* Only simple requests are waited for. Anything reading a
+	 * body could stall while there are responses queued.
+	 */
+	if ((strncmp (next, "GET ", 4) != 0) &&
+	    (strncmp (next, "HEAD ", 5) != 0))
+	{
+		return false;
+	}
+
+	return (strstr (next, CRLF_CRLF) != NULL);
+}
+
+
+static void
+pipeline_defer (cherokee_connection_t *conn,
+		const char            *buf,
+		size_t                 len)
+{
+	cherokee_buffer_add (&conn->pipelined_buffer, buf, len);
+	cherokee_connection_tx_add (conn, len);
+
+	TRACE (ENTRIES, "conn %p, deferred %d bytes (%d queued)\n",
+	       conn, len, conn->pipelined_buffer.len);
+}
+
+
+/* Writes the queued responses followed by 'vec'. Only the bytes of
+ * 'vec' are reported in 'sent'.
+ */
+static ret_t
+pipeline_writev (cherokee_connection_t *conn,
+		 struct iovec          *vec,
+		 uint16_t               vec_num,
+		 size_t                *sent)
+{
+	ret_t        ret;
+	uint16_t     i;
+	size_t       re     = 0;
+	size_t       queued = conn->pipelined_buffer.len;
+	struct iovec bufs[4];
+
+	if (queued == 0) {
+		return cherokee_socket_writev (&conn->socket, vec, vec_num, sent);
+	}
+
+	bufs[0].iov_base = conn->pipelined_buffer.buf;
+	bufs[0].iov_len  = queued;
+	for (i = 0; i < vec_num; i++) {
+		bufs[i+1] = vec[i];
+	}
+
+	ret = cherokee_socket_writev (&conn->socket, bufs, vec_num + 1, &re);
+	if ((ret != ret_ok) && ((ret != ret_eagain) || (re == 0))) {
+		return ret;
+	}
+
+	/* A partial write may come back as ret_eagain (TLS writes one
+	 * iovec at a time). The written bytes must be consumed anyway,
+	 * or they would be sent again on the next call.
+	 */
+	if (re < queued) {
+		cherokee_buffer_move_to_begin (&conn->pipelined_buffer, re);
+		*sent = 0;
+		return ret_eagain;
+	}
+
+	cherokee_buffer_clean (&conn->pipelined_buffer);
+	*sent = re - queued;
+
+	return ret_ok;
+}
+
+
+ret_t
+cherokee_connection_send_pipelined (cherokee_connection_t *conn)
+{
+	ret_t  ret;
+	size_t sent = 0;
+
+	if (cherokee_buffer_is_empty (&conn->pipelined_buffer)) {
+		return ret_ok;
+	}
+
+	ret = cherokee_socket_bufwrite (&conn->socket, &conn->pipelined_buffer, &sent);
+	if (ret != ret_ok) {
+		return ret;
+	}
+
+	TRACE (ENTRIES, "conn %p, flushed %d of %d queued bytes\n",
+	       conn, sent, conn->pipelined_buffer.len);
+
+	if (sent == conn->pipelined_buffer.len) {
+		cherokee_buffer_clean (&conn->pipelined_buffer);
+		return ret_ok;
+	}
+
+	cherokee_buffer_move_to_begin (&conn->pipelined_buffer, sent);
+	return ret_eagain;
+}
+
+
 ret_t
 cherokee_connection_send_header_and_mmaped (cherokee_connection_t *conn)
 {
@@ -901,7 +1045,10 @@ cherokee_connection_send_header_and_mmaped (cherokee_connection_t *conn)
 	 * because it has been sent by writev() (see below)
 	 */
 	if (cherokee_buffer_is_empty (&conn->buffer)) {
-		ret = cherokee_socket_write (&conn->socket, conn->mmaped, conn->mmaped_len, &re);
+		bufs[0].iov_base = conn->mmaped;
+		bufs[0].iov_len  = conn->mmaped_len;
+
+		ret = pipeline_writev (conn, bufs, 1, &re);
 		if (unlikely (ret != ret_ok) ) {
 			switch (ret) {
 			case ret_eof:
@@ -929,8 +1076,19 @@ cherokee_connection_send_header_and_mmaped (cherokee_connection_t *conn)
 		return (conn->mmaped_len > 0) ? ret_eagain : ret_ok;
 	}
 
-	/* 2.- There are header and mmaped content to send
+	/* 2.- There are header and mmaped content to send. The whole
+	 * response is queued if another request is already waiting.
 	 */
+	if (pipeline_can_defer (conn, conn->buffer.len + conn->mmaped_len)) {
+		pipeline_defer (conn, conn->buffer.buf, conn->buffer.len);
+		pipeline_defer (conn, conn->mmaped, conn->mmaped_len);
+
+		cherokee_buffer_clean (&conn->buffer);
+		conn->mmaped      = (void *) ( ((char *)conn->mmaped) + conn->mmaped_len );
+		conn->mmaped_len  = 0;
+		return ret_ok;
+	}
+
 	bufs[0].iov_base = conn->buffer.buf;
 	bufs[0].iov_len  = conn->buffer.len;
 	if (likely (conn->mmaped_len > 0)) {
@@ -938,7 +1096,7 @@ cherokee_connection_send_header_and_mmaped (cherokee_connection_t *conn)
 		bufs[1].iov_len  = conn->mmaped_len;
 		nvec = 2;
 	}
-	ret = cherokee_socket_writev (&conn->socket, bufs, nvec, &re);
+	ret = pipeline_writev (conn, bufs, nvec, &re);
 	if (unlikely (ret != ret_ok)) {
 		switch (ret) {
 
@@ -1093,15 +1251,27 @@ cherokee_connection_set_cork (cherokee_connection_t *conn,
 ret_t
 cherokee_connection_send_header (cherokee_connection_t *conn)
 {
-	ret_t  ret;
-	size_t sent = 0;
+	ret_t        ret;
+	size_t       sent = 0;
+	struct iovec vec;
 
 	if (cherokee_buffer_is_empty (&conn->buffer))
 		return ret_ok;
 
+	/* Queue it if there is a pipelined request waiting
+	 */
+	if (pipeline_can_defer (conn, conn->buffer.len)) {
+		pipeline_defer (conn, conn->buffer.buf, conn->buffer.len);
+		cherokee_buffer_clean (&conn->buffer);
+		return ret_ok;
+	}
+
 	/* Send the buffer content
 	 */
-	ret = cherokee_socket_bufwrite (&conn->socket, &conn->buffer, &sent);
+	vec.iov_base = conn->buffer.buf;
+	vec.iov_len  = conn->buffer.len;
+
+	ret = pipeline_writev (conn, &vec, 1, &sent);
 	if (unlikely(ret != ret_ok)) return ret;
 
 	/* Add to the connection traffic counter
@@ -1125,9 +1295,10 @@ cherokee_connection_send_header (cherokee_connection_t *conn)
 ret_t
 cherokee_connection_send (cherokee_connection_t *conn)
 {
-	ret_t  ret;
-	size_t to_send;
-	size_t sent     = 0;
+	ret_t        ret;
+	size_t       to_send;
+	size_t       sent     = 0;
+	struct iovec vec;
 
 	/* Use writev to send the chunk-begin mark
 	 */
@@ -1135,6 +1306,12 @@ cherokee_connection_send (cherokee_connection_t *conn)
 	{
 		struct iovec tmp[3];
 
+		/* Previous responses go first */
+		ret = cherokee_connection_send_pipelined (conn);
+		if (ret != ret_ok) {
+			return ret;
+		}
+
 		/* Build the data vector */
 		tmp[0].iov_base = conn->chunked_len.buf;
 		tmp[0].iov_len  = conn->chunked_len.len;
@@ -1196,6 +1373,19 @@ cherokee_connection_send (cherokee_connection_t *conn)
 		goto out;
 	}
 
+	/* Queue it if there is a pipelined request waiting
+	 */
+	if (pipeline_can_defer (conn, conn->buffer.len)) {
+		sent = conn->buffer.len;
+		pipeline_defer (conn, conn->buffer.buf, sent);
+		cherokee_buffer_clean (&conn->buffer);
+
+		if (! HANDLER_SUPPORTS (conn->handler, hsupport_length)) {
+			conn->range_end += sent;
+		}
+		return ret_ok;
+	}
+
 	/* Send the buffer content
 	 */
 	to_send = conn->buffer.len;
@@ -1205,7 +1395,10 @@ cherokee_connection_send (cherokee_connection_t *conn)
 		to_send = conn->limit_bps;
 	}
 
-	ret = cherokee_socket_write (&conn->socket, conn->buffer.buf, to_send, &sent);
+	vec.iov_base = conn->buffer.buf;
+	vec.iov_len  = to_send;
+
+	ret = pipeline_writev (conn, &vec, 1, &sent);
 	if (unlikely(ret != ret_ok))
 		return ret;
 
@@ -2081,6 +2274,18 @@ cherokee_connection_check_authentication (cherokee_connection_t *conn, cherokee_
 		goto unauthorized;
 	}
 
+	/* Resume a validation that was waiting for its back-end. A
+	 * validator from a different rule is replaced.
+	 */
+	if (conn->validator != NULL) {
+		if (MODULE(conn->validator)->props == config_entry->validator_properties) {
+			goto check;
+		}
+
+		cherokee_validator_free (conn->validator);
+		conn->validator = NULL;
+	}
+
 	/* Create the validator object
 	 */
 	ret = config_entry->validator_new_func ((void **) &conn->validator,
@@ -2111,6 +2316,7 @@ cherokee_connection_check_authentication (cherokee_connection_t *conn, cherokee_
 		}
 	}
 
+check:
 	/* Check if the validator is suitable
 	 */
 	if ((conn->validator->support & conn->req_auth_type) == 0) {
@@ -2120,8 +2326,12 @@ cherokee_connection_check_authentication (cherokee_connection_t *conn, cherokee_
 	/* Check the login/password
 	 */
 	ret = cherokee_validator_check (conn->validator, conn);
-
-	if (ret != ret_ok) {
+	switch (ret) {
+	case ret_ok:
+		break;
+	case ret_eagain:
+		return ret_eagain;
+	default:
 		goto unauthorized;
 	}
 
@@ -2467,6 +2677,16 @@ cherokee_connection_clean_for_respin (cherokee_connection_t *conn)
 		return ret_error;
 	}
 
+	return cherokee_connection_clean_for_resetup (conn);
+}
+
+
+ret_t
+cherokee_connection_clean_for_resetup (cherokee_connection_t *conn)
+{
+	/* Undo the request rewrite of the setup phase, so it can be
+	 * run again.
+	 */
 	if (cherokee_connection_use_webdir(conn)) {
 		cherokee_buffer_prepend_buf (&conn->request, &conn->web_directory);
 		cherokee_buffer_clean (&conn->local_directory);
@@ -3,10 +3,16 @@
 
 #include "common.h"
 
+/* Picks the fastest implementation for the CPU */
+void  crc32_init (void);
+
 /* Returns crc32 of data block */
 crc_t crc32_sz(char *buf, int size);
 crc_t crc32_partial_sz (crc_t crc_in, char *buf, int size);
 
+/* Byte-at-a-time implementation, used as reference */
+crc_t crc32_partial_sz_ref (crc_t crc_in, char *buf, int size);
+
 /* Returns crc32 of null-terminated string
 #define crc32(buf) crc32_sz((buf),strlen(buf))
 */
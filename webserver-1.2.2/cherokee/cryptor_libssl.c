@@ -71,6 +71,13 @@ static DH *dh_param_4096 = NULL;
 static ret_t
 _free (cherokee_cryptor_libssl_t *cryp)
 {
+	/* Shared session cache
+	 */
+	if (cryp->session_cache != NULL) {
+		cherokee_cryptor_libssl_cache_free (cryp->session_cache);
+		cryp->session_cache = NULL;
+	}
+
 	/* DH Parameters
 	 */
 	if (dh_param_512  != NULL) {
@@ -161,9 +168,10 @@ _configure (cherokee_cryptor_t     *cryp,
 	    cherokee_config_node_t *conf,
 	    cherokee_server_t      *srv)
 {
-	ret_t ret;
+	ret_t              ret;
+	cherokee_boolean_t session_cache = true;
+	cint_t             entries       = CRYPTOR_LIBSSL_CACHE_ENTRIES;
 
-	UNUSED(cryp);
 	UNUSED(srv);
 
 	ret = try_read_dh_param (conf, &dh_param_512, 512);
@@ -182,6 +190,16 @@ _configure (cherokee_cryptor_t     *cryp,
 	if (ret != ret_ok)
 		return ret;
 
+	/* Session cache shared among workers. If it cannot be set
+	 * up, every worker falls back to its own internal cache.
+	 */
+	cherokee_config_node_read_bool (conf, "session_cache", &session_cache);
+	cherokee_config_node_read_int  (conf, "session_cache!entries", &entries);
+
+	if ((session_cache) && (entries > 0)) {
+		cherokee_cryptor_libssl_cache_new (&CRYPTOR_SSL(cryp)->session_cache, entries);
+	}
+
 	return ret_ok;
 }
 
@@ -351,8 +369,6 @@ _vserver_new (cherokee_cryptor_t          *cryp,
 
 	CHEROKEE_NEW_STRUCT (n, cryptor_vserver_libssl);
 
-	UNUSED(cryp);
-
 	/* Init
 	 */
 	ret = cherokee_cryptor_vserver_init_base (CRYPTOR_VSRV(n));
@@ -488,7 +504,11 @@ _vserver_new (cherokee_cryptor_t          *cryp,
 		LOG_ERROR (CHEROKEE_ERROR_SSL_SESSION_ID, vsrv->name.buf, error);
 	}
 
-	SSL_CTX_set_session_cache_mode (n->context, SSL_SESS_CACHE_SERVER);
+	if (CRYPTOR_SSL(cryp)->session_cache != NULL) {
+		cherokee_cryptor_libssl_cache_set_ctx (CRYPTOR_SSL(cryp)->session_cache, n->context);
+	} else {
+		SSL_CTX_set_session_cache_mode (n->context, SSL_SESS_CACHE_SERVER);
+	}
 
 
 #ifndef OPENSSL_NO_TLSEXT
@@ -581,6 +601,20 @@ socket_initialize (cherokee_cryptor_socket_libssl_t *cryp,
 }
 
 
+/* Sessions are dropped from the shared cache explicitly, since
+ * OpenSSL does not report removals without an internal store.
+ */
+static void
+socket_drop_session (cherokee_cryptor_socket_libssl_t *cryp)
+{
+	if (cryp->session == NULL) {
+		return;
+	}
+
+	cherokee_cryptor_libssl_cache_remove_ssl (cryp->session);
+}
+
+
 static ret_t
 _socket_init_tls (cherokee_cryptor_socket_libssl_t *cryp,
 		  cherokee_socket_t                *sock,
@@ -638,6 +672,8 @@ _socket_init_tls (cherokee_cryptor_socket_libssl_t *cryp,
 			return ret_error;
 
 		case SSL_ERROR_SSL:
+			socket_drop_session (cryp);
+			return ret_error;
 		case SSL_ERROR_ZERO_RETURN:
 			return ret_error;
 		default:
@@ -846,6 +882,7 @@ _socket_write (cherokee_cryptor_socket_libssl_t *cryp,
 
 	case SSL_ERROR_SSL:
 		TRACE (ENTRIES",write", "write len=%d, ERROR: %s\n", buf_len, ERR_error_string(re, NULL));
+		socket_drop_session (cryp);
 		return ret_error;
 	}
 
@@ -891,6 +928,7 @@ _socket_read (cherokee_cryptor_socket_libssl_t *cryp,
 	case SSL_ERROR_ZERO_RETURN:
 		return ret_eof;
 	case SSL_ERROR_SSL:
+		socket_drop_session (cryp);
 		return ret_error;
 	case SSL_ERROR_SYSCALL:
 		switch (error) {
@@ -923,6 +961,16 @@ _socket_clean (cherokee_cryptor_socket_libssl_t *cryp_socket)
 	cherokee_cryptor_socket_clean_base (CRYPTOR_SOCKET(cryp_socket));
 
 	if (cryp_socket->session != NULL) {
+		/* Like OpenSSL does for its internal cache: a session
+		 * that was not shut down properly cannot be resumed.
+		 */
+		if ((! (SSL_get_shutdown (cryp_socket->session) & SSL_SENT_SHUTDOWN)) &&
+		    (! SSL_in_init (cryp_socket->session)) &&
+		    (! SSL_in_before (cryp_socket->session)))
+		{
+			socket_drop_session (cryp_socket);
+		}
+
 		SSL_free (cryp_socket->session);
 		cryp_socket->session = NULL;
 	}
@@ -1129,6 +1177,8 @@ cherokee_cryptor_libssl_new (cherokee_cryptor_libssl_t **cryp)
 	if (ret != ret_ok)
 		return ret;
 
+	n->session_cache = NULL;
+
 	MODULE(n)->free         = (module_func_free_t) _free;
 	CRYPTOR(n)->configure   = (cryptor_func_configure_t) _configure;
 	CRYPTOR(n)->vserver_new = (cryptor_func_vserver_new_t) _vserver_new;
@@ -1143,8 +1193,8 @@ cherokee_cryptor_libssl_new (cherokee_cryptor_libssl_t **cryp)
 
 /* Private low-level functions for OpenSSL
  */
-static pthread_mutex_t *locks;
-static size_t           locks_num;
+static pthread_rwlock_t *locks;
+static size_t            locks_num;
 
 static unsigned long
 __get_thread_id (void)
@@ -1159,10 +1209,15 @@ __lock_thread (int mode, int n, const char *file, int line)
 	UNUSED (file);
 	UNUSED (line);
 
-	if (mode & CRYPTO_LOCK) {
-		CHEROKEE_MUTEX_LOCK (&locks[n]);
+	/* Readers of the session cache, X509 stores, etc. do not
+	 * need to exclude each other.
+	 */
+	if (! (mode & CRYPTO_LOCK)) {
+		CHEROKEE_RWLOCK_UNLOCK (&locks[n]);
+	} else if (mode & CRYPTO_READ) {
+		CHEROKEE_RWLOCK_READER (&locks[n]);
 	} else {
-		CHEROKEE_MUTEX_UNLOCK (&locks[n]);
+		CHEROKEE_RWLOCK_WRITER (&locks[n]);
 	}
 }
 
@@ -1211,7 +1266,7 @@ PLUGIN_INIT_NAME(libssl) (cherokee_plugin_loader_t *loader)
 		locks     = malloc (locks_num * sizeof(*locks));
 
 		for (n = 0; n < locks_num; n++) {
-			CHEROKEE_MUTEX_INIT (&locks[n], NULL);
+			CHEROKEE_RWLOCK_INIT (&locks[n], NULL);
 		}
 	}
 
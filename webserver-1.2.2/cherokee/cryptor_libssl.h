@@ -46,6 +46,7 @@
 #include "avl_r.h"
 #include "module.h"
 #include "cryptor.h"
+#include "cryptor_libssl_cache.h"
 
 #include <openssl/lhash.h>
 #include <openssl/ssl.h>
@@ -66,8 +67,8 @@
 /* Data types
  */
 typedef struct {
-	cherokee_cryptor_t          base;
-	int                         foo;
+	cherokee_cryptor_t               base;
+	cherokee_cryptor_libssl_cache_t *session_cache;
 } cherokee_cryptor_libssl_t;
 
 typedef struct {
@@ -0,0 +1,752 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/* IN CASE THIS PLUG-IN IS COMPILED WITH OPENSSL:
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than OpenSSL.  If you modify file(s)
+ * with this exception, you may extend this exception to your version
+ * of the file(s), but you are not obligated to do so.  If you do not
+ * wish to do so, delete this exception statement from your version.
+ * If you delete this exception statement from all source files in the
+ * program, then also delete it here.
+ */
+
+#include "common-internal.h"
+#include "cryptor_libssl_cache.h"
+#include "bogotime.h"
+#include "util.h"
+
+#include <unistd.h>
+
+#define ENTRIES "crypto,ssl,cache"
+
+#define CACHE_MAGIC    0x43484b53   /* 'CHKS' */
+#define CACHE_VERSION  1
+#define CACHE_SHARDS   16
+#define CACHE_DER_MAX  CRYPTOR_LIBSSL_CACHE_DER_MAX
+#define CACHE_ID_MAX   SSL_MAX_SSL_SESSION_ID_LENGTH
+#define CACHE_ALIGN(n) (((n) + 63) & ~((size_t)63))
+#define NIL            -1
+
+/* PTHREAD_MUTEX_ROBUST is an enum value rather than a macro, so
+ * it cannot be checked for. glibc has robust mutexes since 2.12.
+ */
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 12)))
+# define HAVE_ROBUST_MUTEX 1
+#endif
+
+/* Everything inside of the mapping is addressed by index, since
+ * every process might have mapped the file at a different address.
+ */
+typedef struct {
+	cint_t         hash_next;
+	cint_t         lru_prev;
+	cint_t         lru_next;
+	cuint_t        hash;
+	time_t         expire;
+	cuint_t        id_len;
+	cuint_t        der_len;
+	unsigned char  id  [CACHE_ID_MAX];
+	unsigned char  der [CACHE_DER_MAX];
+} cache_entry_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+	cint_t          lru_head;
+	cint_t          lru_tail;
+	cint_t          free_head;
+	cuint_t         used;
+	cullong_t       hits;
+	cullong_t       misses;
+	cullong_t       stores;
+	cullong_t       evictions;
+} cache_shard_t;
+
+typedef struct {
+	cuint_t  magic;
+	cuint_t  version;
+	cuint_t  shards;
+	cuint_t  entries;
+	cuint_t  buckets;
+	size_t   shard_len;
+} cache_header_t;
+
+#define CACHE_HEADER(c)    ((cache_header_t *)((c)->shm.mem))
+#define CACHE_SHARD(c,n)   ((cache_shard_t *)((char *)(c)->shm.mem + CACHE_ALIGN(sizeof(cache_header_t)) + (n) * (c)->shard_len))
+#define SHARD_BUCKETS(s)   ((cint_t *)((char *)(s) + sizeof(cache_shard_t)))
+#define SHARD_ENTRY(c,s,n) (((cache_entry_t *)((char *)(s) + CACHE_ALIGN(sizeof(cache_shard_t) + (c)->buckets * sizeof(cint_t)))) + (n))
+
+
+static cuint_t
+hash_id (const unsigned char *id, cuint_t len)
+{
+	cuint_t i;
+	cuint_t h = 2166136261U;
+
+	for (i = 0; i < len; i++) {
+		h ^= id[i];
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+static void
+shard_reset (cherokee_cryptor_libssl_cache_t *cache,
+	     cache_shard_t                   *shard)
+{
+	cuint_t  i;
+	cint_t  *buckets = SHARD_BUCKETS(shard);
+
+	for (i = 0; i < cache->buckets; i++) {
+		buckets[i] = NIL;
+	}
+
+	for (i = 0; i < cache->entries; i++) {
+		SHARD_ENTRY(cache, shard, i)->hash_next = (i + 1 < cache->entries) ? (cint_t)(i + 1) : NIL;
+	}
+
+	shard->lru_head  = NIL;
+	shard->lru_tail  = NIL;
+	shard->free_head = 0;
+	shard->used      = 0;
+}
+
+static void
+shard_lock (cherokee_cryptor_libssl_cache_t *cache,
+	    cache_shard_t                   *shard)
+{
+	int re;
+
+	re = pthread_mutex_lock (&shard->lock);
+#ifdef HAVE_ROBUST_MUTEX
+	if (unlikely (re == EOWNERDEAD)) {
+		/* A worker died while holding the lock. Its changes
+		 * might be half way done, so the shard is emptied.
+		 */
+		TRACE (ENTRIES, "Recovering shard %p from a dead owner\n", shard);
+		shard_reset (cache, shard);
+		pthread_mutex_consistent (&shard->lock);
+	}
+#else
+	UNUSED (cache);
+	UNUSED (re);
+#endif
+}
+
+static void
+shard_unlock (cache_shard_t *shard)
+{
+	pthread_mutex_unlock (&shard->lock);
+}
+
+static cache_shard_t *
+shard_for_hash (cherokee_cryptor_libssl_cache_t *cache,
+		cuint_t                          hash)
+{
+	return CACHE_SHARD (cache, hash % cache->shards);
+}
+
+static cint_t *
+bucket_for_hash (cherokee_cryptor_libssl_cache_t *cache,
+		 cache_shard_t                   *shard,
+		 cuint_t                          hash)
+{
+	return &SHARD_BUCKETS(shard)[(hash / cache->shards) % cache->buckets];
+}
+
+
+/* LRU list: head is the most recently used entry
+ */
+static void
+lru_unlink (cherokee_cryptor_libssl_cache_t *cache,
+	    cache_shard_t                   *shard,
+	    cint_t                           n)
+{
+	cache_entry_t *entry = SHARD_ENTRY(cache, shard, n);
+
+	if (entry->lru_prev != NIL) {
+		SHARD_ENTRY(cache, shard, entry->lru_prev)->lru_next = entry->lru_next;
+	} else {
+		shard->lru_head = entry->lru_next;
+	}
+
+	if (entry->lru_next != NIL) {
+		SHARD_ENTRY(cache, shard, entry->lru_next)->lru_prev = entry->lru_prev;
+	} else {
+		shard->lru_tail = entry->lru_prev;
+	}
+
+	entry->lru_prev = NIL;
+	entry->lru_next = NIL;
+}
+
+static void
+lru_push (cherokee_cryptor_libssl_cache_t *cache,
+	  cache_shard_t                   *shard,
+	  cint_t                           n)
+{
+	cache_entry_t *entry = SHARD_ENTRY(cache, shard, n);
+
+	entry->lru_prev = NIL;
+	entry->lru_next = shard->lru_head;
+
+	if (shard->lru_head != NIL) {
+		SHARD_ENTRY(cache, shard, shard->lru_head)->lru_prev = n;
+	}
+
+	shard->lru_head = n;
+
+	if (shard->lru_tail == NIL) {
+		shard->lru_tail = n;
+	}
+}
+
+
+/* Hash chains
+ */
+static cint_t
+entry_lookup (cherokee_cryptor_libssl_cache_t *cache,
+	      cache_shard_t                   *shard,
+	      cuint_t                          hash,
+	      const unsigned char             *id,
+	      cuint_t                          id_len)
+{
+	cint_t         n;
+	cache_entry_t *entry;
+
+	n = *bucket_for_hash (cache, shard, hash);
+	while (n != NIL) {
+		entry = SHARD_ENTRY(cache, shard, n);
+
+		if ((entry->hash == hash) &&
+		    (entry->id_len == id_len) &&
+		    (memcmp (entry->id, id, id_len) == 0))
+		{
+			return n;
+		}
+
+		n = entry->hash_next;
+	}
+
+	return NIL;
+}
+
+static void
+entry_remove (cherokee_cryptor_libssl_cache_t *cache,
+	      cache_shard_t                   *shard,
+	      cint_t                           n)
+{
+	cint_t        *prev;
+	cache_entry_t *entry = SHARD_ENTRY(cache, shard, n);
+
+	/* Hash chain */
+	prev = bucket_for_hash (cache, shard, entry->hash);
+	while (*prev != n) {
+		prev = &SHARD_ENTRY(cache, shard, *prev)->hash_next;
+	}
+	*prev = entry->hash_next;
+
+	/* LRU */
+	lru_unlink (cache, shard, n);
+
+	/* Free list */
+	entry->hash_next = shard->free_head;
+	shard->free_head = n;
+	shard->used     -= 1;
+}
+
+static cint_t
+entry_take (cherokee_cryptor_libssl_cache_t *cache,
+	    cache_shard_t                   *shard)
+{
+	cint_t n;
+
+	/* Evict the least recently used one if needed
+	 */
+	if (shard->free_head == NIL) {
+		entry_remove (cache, shard, shard->lru_tail);
+		shard->evictions += 1;
+	}
+
+	n = shard->free_head;
+	shard->free_head = SHARD_ENTRY(cache, shard, n)->hash_next;
+	shard->used     += 1;
+
+	return n;
+}
+
+
+/* Cache operations
+ */
+ret_t
+cherokee_cryptor_libssl_cache_store (cherokee_cryptor_libssl_cache_t *cache,
+				     const unsigned char             *id,
+				     cuint_t                          id_len,
+				     const unsigned char             *der,
+				     cuint_t                          der_len,
+				     time_t                           expire)
+{
+	cint_t          n;
+	cint_t         *bucket;
+	cache_entry_t  *entry;
+	cuint_t         hash;
+	cache_shard_t  *shard;
+
+	if ((id_len == 0) || (id_len > CACHE_ID_MAX) ||
+	    (der_len > CACHE_DER_MAX))
+	{
+		return ret_error;
+	}
+
+	hash  = hash_id (id, id_len);
+	shard = shard_for_hash (cache, hash);
+
+	shard_lock (cache, shard);
+
+	n = entry_lookup (cache, shard, hash, id, id_len);
+	if (n != NIL) {
+		entry_remove (cache, shard, n);
+	}
+
+	n     = entry_take (cache, shard);
+	entry = SHARD_ENTRY(cache, shard, n);
+
+	entry->hash    = hash;
+	entry->expire  = expire;
+	entry->id_len  = id_len;
+	entry->der_len = der_len;
+	memcpy (entry->id,  id,  id_len);
+	memcpy (entry->der, der, der_len);
+
+	bucket = bucket_for_hash (cache, shard, hash);
+	entry->hash_next = *bucket;
+	*bucket = n;
+
+	lru_push (cache, shard, n);
+	shard->stores += 1;
+
+	TRACE (ENTRIES, "Stored session (der len=%d), shard usage %d/%d\n",
+	       der_len, shard->used, cache->entries);
+
+	shard_unlock (shard);
+	return ret_ok;
+}
+
+ret_t
+cherokee_cryptor_libssl_cache_fetch (cherokee_cryptor_libssl_cache_t *cache,
+				     const unsigned char             *id,
+				     cuint_t                          id_len,
+				     unsigned char                   *der,
+				     cuint_t                         *der_len)
+{
+	cint_t          n;
+	cache_entry_t  *entry;
+	cuint_t         hash;
+	cache_shard_t  *shard;
+
+	if ((id_len == 0) || (id_len > CACHE_ID_MAX)) {
+		return ret_not_found;
+	}
+
+	hash  = hash_id (id, id_len);
+	shard = shard_for_hash (cache, hash);
+
+	shard_lock (cache, shard);
+
+	n = entry_lookup (cache, shard, hash, id, id_len);
+	if (n == NIL) {
+		goto miss;
+	}
+
+	entry = SHARD_ENTRY(cache, shard, n);
+	if (entry->expire < cherokee_bogonow_now) {
+		entry_remove (cache, shard, n);
+		goto miss;
+	}
+
+	memcpy (der, entry->der, entry->der_len);
+	*der_len = entry->der_len;
+
+	lru_unlink (cache, shard, n);
+	lru_push (cache, shard, n);
+
+	shard->hits += 1;
+	TRACE (ENTRIES, "Session hit (hits=%llu, misses=%llu)\n", shard->hits, shard->misses);
+
+	shard_unlock (shard);
+	return ret_ok;
+
+miss:
+	shard->misses += 1;
+	TRACE (ENTRIES, "Session miss (hits=%llu, misses=%llu)\n", shard->hits, shard->misses);
+
+	shard_unlock (shard);
+	return ret_not_found;
+}
+
+ret_t
+cherokee_cryptor_libssl_cache_remove (cherokee_cryptor_libssl_cache_t *cache,
+				      const unsigned char             *id,
+				      cuint_t                          id_len)
+{
+	cint_t          n;
+	cuint_t         hash;
+	cache_shard_t  *shard;
+
+	if ((id_len == 0) || (id_len > CACHE_ID_MAX)) {
+		return ret_not_found;
+	}
+
+	hash  = hash_id (id, id_len);
+	shard = shard_for_hash (cache, hash);
+
+	shard_lock (cache, shard);
+
+	n = entry_lookup (cache, shard, hash, id, id_len);
+	if (n != NIL) {
+		entry_remove (cache, shard, n);
+	}
+
+	shard_unlock (shard);
+	return (n != NIL) ? ret_ok : ret_not_found;
+}
+
+ret_t
+cherokee_cryptor_libssl_cache_get_stats (cherokee_cryptor_libssl_cache_t       *cache,
+					 cherokee_cryptor_libssl_cache_stats_t *stats)
+{
+	cuint_t        i;
+	cache_shard_t *shard;
+
+	memset (stats, 0, sizeof(cherokee_cryptor_libssl_cache_stats_t));
+
+	for (i = 0; i < cache->shards; i++) {
+		shard = CACHE_SHARD (cache, i);
+
+		shard_lock (cache, shard);
+
+		stats->used      += shard->used;
+		stats->hits      += shard->hits;
+		stats->misses    += shard->misses;
+		stats->stores    += shard->stores;
+		stats->evictions += shard->evictions;
+
+		shard_unlock (shard);
+	}
+
+	return ret_ok;
+}
+
+
+/* OpenSSL callbacks
+ */
+static int
+_new_session_cb (SSL *ssl, SSL_SESSION *session)
+{
+	int                              len;
+	unsigned int                     id_len;
+	const unsigned char             *id;
+	unsigned char                   *p;
+	unsigned char                    der[CACHE_DER_MAX];
+	cherokee_cryptor_libssl_cache_t *cache = SSL_CTX_get_app_data (SSL_get_SSL_CTX (ssl));
+
+	if (unlikely (cache == NULL)) {
+		return 0;
+	}
+
+	id = SSL_SESSION_get_id (session, &id_len);
+	if ((id_len == 0) || (id_len > CACHE_ID_MAX)) {
+		return 0;
+	}
+
+	/* Sessions carrying large peer certificates do not fit
+	 * in a slot. They will require a full handshake.
+	 */
+	len = i2d_SSL_SESSION (session, NULL);
+	if ((len <= 0) || (len > CACHE_DER_MAX)) {
+		TRACE (ENTRIES, "Session does not fit in the cache: %d bytes\n", len);
+		return 0;
+	}
+
+	p = der;
+	i2d_SSL_SESSION (session, &p);
+
+	cherokee_cryptor_libssl_cache_store (cache, id, id_len, der, len,
+					     SSL_SESSION_get_time (session) +
+					     SSL_SESSION_get_timeout (session));
+
+	/* The session object is not referenced
+	 */
+	return 0;
+}
+
+static SSL_SESSION *
+_get_session_cb (SSL *ssl, unsigned char *id, int id_len, int *copy)
+{
+	ret_t                            ret;
+	cuint_t                          len;
+	const unsigned char             *p;
+	unsigned char                    der[CACHE_DER_MAX];
+	cherokee_cryptor_libssl_cache_t *cache = SSL_CTX_get_app_data (SSL_get_SSL_CTX (ssl));
+
+	*copy = 0;
+
+	if ((unlikely (cache == NULL)) ||
+	    (id_len <= 0) || (id_len > CACHE_ID_MAX))
+	{
+		return NULL;
+	}
+
+	ret = cherokee_cryptor_libssl_cache_fetch (cache, id, id_len, der, &len);
+	if (ret != ret_ok) {
+		return NULL;
+	}
+
+	p = der;
+	return d2i_SSL_SESSION (NULL, &p, len);
+}
+
+/* OpenSSL only calls the remove_session_cb for the sessions of its
+ * internal store, which is disabled. The sessions OpenSSL would have
+ * dropped (fatal alerts, connections torn down without close_notify)
+ * are removed from the shared cache by the cryptor instead.
+ */
+ret_t
+cherokee_cryptor_libssl_cache_remove_ssl (SSL *ssl)
+{
+	unsigned int                     id_len;
+	const unsigned char             *id;
+	SSL_SESSION                     *session = SSL_get_session (ssl);
+	cherokee_cryptor_libssl_cache_t *cache   = SSL_CTX_get_app_data (SSL_get_SSL_CTX (ssl));
+
+	if ((cache == NULL) || (session == NULL)) {
+		return ret_not_found;
+	}
+
+	id = SSL_SESSION_get_id (session, &id_len);
+
+	TRACE (ENTRIES, "Invalidating session (id len=%d)\n", id_len);
+	return cherokee_cryptor_libssl_cache_remove (cache, id, id_len);
+}
+
+
+/* Shared memory
+ */
+static ret_t
+cache_init_mem (cherokee_cryptor_libssl_cache_t *cache)
+{
+	cuint_t              i;
+	int                  re;
+	cache_shard_t       *shard;
+	cache_header_t      *header = CACHE_HEADER(cache);
+	pthread_mutexattr_t  mattr;
+
+	pthread_mutexattr_init (&mattr);
+
+	re = pthread_mutexattr_setpshared (&mattr, PTHREAD_PROCESS_SHARED);
+	if (re != 0) {
+		goto error;
+	}
+
+	/* Otherwise, a worker dying while holding a shard lock
+	 * would block the rest of them
+	 */
+#ifdef HAVE_ROBUST_MUTEX
+	re = pthread_mutexattr_setrobust (&mattr, PTHREAD_MUTEX_ROBUST);
+	if (re != 0) {
+		goto error;
+	}
+#endif
+
+	for (i = 0; i < cache->shards; i++) {
+		shard = CACHE_SHARD (cache, i);
+
+		re = pthread_mutex_init (&shard->lock, &mattr);
+		if (re != 0) {
+			goto error;
+		}
+
+		shard_reset (cache, shard);
+	}
+
+	pthread_mutexattr_destroy (&mattr);
+
+	header->version   = CACHE_VERSION;
+	header->shards    = cache->shards;
+	header->entries   = cache->entries;
+	header->buckets   = cache->buckets;
+	header->shard_len = cache->shard_len;
+
+	/* The magic number is the last thing to be written, so a
+	 * half initialized file will never be reused.
+	 */
+	header->magic = CACHE_MAGIC;
+	return ret_ok;
+
+error:
+	pthread_mutexattr_destroy (&mattr);
+
+	errno = re;
+	return ret_error;
+}
+
+static cherokee_boolean_t
+cache_mem_is_valid (cherokee_cryptor_libssl_cache_t *cache,
+		    size_t                           len)
+{
+	cache_header_t *header = CACHE_HEADER(cache);
+
+	if (cache->shm.len != len) {
+		return false;
+	}
+
+	return ((header->magic     == CACHE_MAGIC)    &&
+		(header->version   == CACHE_VERSION)  &&
+		(header->shards    == cache->shards)  &&
+		(header->entries   == cache->entries) &&
+		(header->buckets   == cache->buckets) &&
+		(header->shard_len == cache->shard_len));
+}
+
+
+ret_t
+cherokee_cryptor_libssl_cache_new (cherokee_cryptor_libssl_cache_t **cache,
+				   cuint_t                           entries)
+{
+	ret_t  ret;
+	int    fd  = -1;
+	size_t len;
+	char  *env;
+	CHEROKEE_NEW_STRUCT (n, cryptor_libssl_cache);
+
+	/* Layout
+	 */
+	n->shards    = CACHE_SHARDS;
+	n->entries   = MAX (entries / CACHE_SHARDS, 1);
+	n->buckets   = n->entries;
+	n->shard_len = CACHE_ALIGN (CACHE_ALIGN (sizeof(cache_shard_t) + n->buckets * sizeof(cint_t)) +
+				    n->entries * sizeof(cache_entry_t));
+
+	len = CACHE_ALIGN (sizeof(cache_header_t)) + n->shards * n->shard_len;
+
+	cherokee_shm_init (&n->shm);
+
+	/* Map the file inherited from the supervisor
+	 */
+	env = getenv (CHEROKEE_SHM_TLS_CACHE_ENV);
+	if (env != NULL) {
+		fd = atoi (env);
+	}
+
+	if (fd > STDERR_FILENO) {
+		ret = cherokee_shm_map_fd (&n->shm, fd, len);
+		cherokee_fd_close (fd);
+		unsetenv (CHEROKEE_SHM_TLS_CACHE_ENV);
+
+		if (ret == ret_ok) {
+			if (cache_mem_is_valid (n, len)) {
+				TRACE (ENTRIES, "Reusing TLS session cache fd=%d\n", fd);
+				goto out;
+			}
+
+			if (CACHE_HEADER(n)->magic == 0) {
+				goto init;
+			}
+
+			/* Still in use by the previous worker
+			 */
+			TRACE (ENTRIES, "Ignoring incompatible TLS session cache fd=%d\n", fd);
+			cherokee_shm_mrproper (&n->shm);
+			cherokee_shm_init (&n->shm);
+		}
+	}
+
+	/* Otherwise, the cache is only shared by the threads of this
+	 * worker, in a mapping without a name.
+	 */
+	ret = cherokee_shm_create_anonymous (&n->shm, len);
+	if (ret != ret_ok) {
+		LOG_ERRNO_S (errno, cherokee_err_warning, CHEROKEE_ERROR_SSL_SESSION_CACHE);
+		goto error;
+	}
+
+init:
+	ret = cache_init_mem (n);
+	if (ret != ret_ok) {
+		LOG_ERRNO_S (errno, cherokee_err_warning, CHEROKEE_ERROR_SSL_SESSION_CACHE);
+		goto error;
+	}
+
+	TRACE (ENTRIES, "Created TLS session cache: %d shards, %d entries each, %d bytes\n",
+	       n->shards, n->entries, len);
+
+out:
+	*cache = n;
+	return ret_ok;
+
+error:
+	cherokee_cryptor_libssl_cache_free (n);
+	return ret_error;
+}
+
+
+ret_t
+cherokee_cryptor_libssl_cache_free (cherokee_cryptor_libssl_cache_t *cache)
+{
+	/* The supervisor keeps the file open for the next worker
+	 */
+	cherokee_shm_mrproper (&cache->shm);
+
+	free (cache);
+	return ret_ok;
+}
+
+
+ret_t
+cherokee_cryptor_libssl_cache_set_ctx (cherokee_cryptor_libssl_cache_t *cache,
+				       SSL_CTX                         *context)
+{
+	SSL_CTX_set_app_data (context, cache);
+
+	SSL_CTX_sess_set_new_cb (context, _new_session_cb);
+	SSL_CTX_sess_set_get_cb (context, _get_session_cb);
+
+	/* The shared cache is the only one: sessions must be visible
+	 * from every worker. Bad sessions are removed by the cryptor,
+	 * see cherokee_cryptor_libssl_cache_remove_ssl().
+	 */
+	SSL_CTX_set_session_cache_mode (context,
+					SSL_SESS_CACHE_SERVER |
+					SSL_SESS_CACHE_NO_INTERNAL);
+
+	return ret_ok;
+}
@@ -0,0 +1,101 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/* IN CASE THIS PLUG-IN IS COMPILED WITH OPENSSL:
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ *
+ * You must obey the GNU General Public License in all respects for
+ * all of the code used other than OpenSSL.  If you modify file(s)
+ * with this exception, you may extend this exception to your version
+ * of the file(s), but you are not obligated to do so.  If you do not
+ * wish to do so, delete this exception statement from your version.
+ * If you delete this exception statement from all source files in the
+ * program, then also delete it here.
+ */
+
+#ifndef CHEROKEE_CRYPTOR_LIBSSL_CACHE_H
+#define CHEROKEE_CRYPTOR_LIBSSL_CACHE_H
+
+#include "common.h"
+#include "shm.h"
+
+#include <openssl/ssl.h>
+
+/* The TLS session cache lives in a file mapped in shared memory.
+ * The Cherokee supervisor creates and unlinks it, and hands over
+ * its descriptor to every worker process it spawns (including the
+ * ones created by a graceful restart), so all of them map the very
+ * same cache. A worker started on its own uses an anonymous mapping.
+ */
+#define CRYPTOR_LIBSSL_CACHE_ENTRIES  2048
+#define CRYPTOR_LIBSSL_CACHE_DER_MAX  2048
+
+typedef struct {
+	cherokee_shm_t  shm;
+	cuint_t         shards;
+	cuint_t         entries;
+	cuint_t         buckets;
+	size_t          shard_len;
+} cherokee_cryptor_libssl_cache_t;
+
+typedef struct {
+	cuint_t         used;
+	cullong_t       hits;
+	cullong_t       misses;
+	cullong_t       stores;
+	cullong_t       evictions;
+} cherokee_cryptor_libssl_cache_stats_t;
+
+ret_t cherokee_cryptor_libssl_cache_new       (cherokee_cryptor_libssl_cache_t **cache,
+					       cuint_t                           entries);
+ret_t cherokee_cryptor_libssl_cache_free      (cherokee_cryptor_libssl_cache_t  *cache);
+ret_t cherokee_cryptor_libssl_cache_set_ctx   (cherokee_cryptor_libssl_cache_t  *cache,
+					       SSL_CTX                          *context);
+ret_t cherokee_cryptor_libssl_cache_remove_ssl (SSL                             *ssl);
+
+/* Sessions are stored DER encoded, indexed by their id
+ */
+ret_t cherokee_cryptor_libssl_cache_store     (cherokee_cryptor_libssl_cache_t  *cache,
+					       const unsigned char              *id,
+					       cuint_t                           id_len,
+					       const unsigned char              *der,
+					       cuint_t                           der_len,
+					       time_t                            expire);
+ret_t cherokee_cryptor_libssl_cache_fetch     (cherokee_cryptor_libssl_cache_t  *cache,
+					       const unsigned char              *id,
+					       cuint_t                           id_len,
+					       unsigned char                    *der,
+					       cuint_t                          *der_len);
+ret_t cherokee_cryptor_libssl_cache_remove    (cherokee_cryptor_libssl_cache_t  *cache,
+					       const unsigned char              *id,
+					       cuint_t                           id_len);
+ret_t cherokee_cryptor_libssl_cache_get_stats (cherokee_cryptor_libssl_cache_t       *cache,
+					       cherokee_cryptor_libssl_cache_stats_t *stats);
+
+#endif /* CHEROKEE_CRYPTOR_LIBSSL_CACHE_H */
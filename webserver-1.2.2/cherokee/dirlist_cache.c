@@ -0,0 +1,215 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "dirlist_cache.h"
+#include "bogotime.h"
+#include "util.h"
+
+#define ENTRIES "handler,dirlist"
+
+
+/* Listings cache: the rendered entries of a directory are kept,
+ * keyed by its local path and sorting, for as long as neither the
+ * directory mtime changes nor the entry expires. Every listing is
+ * owned by the cache while it is listed, and by each one of the
+ * handlers referencing it. The last owner frees it.
+ */
+ret_t
+cherokee_dirlist_cache_entry_new (cherokee_dirlist_cache_entry_t **listing)
+{
+	CHEROKEE_NEW_STRUCT (n, dirlist_cache_entry);
+
+	INIT_LIST_HEAD (&n->lru);
+	cherokee_buffer_init (&n->key);
+	cherokee_buffer_init (&n->html);
+
+	n->mtime      = 0;
+	n->expiration = 0;
+	n->ref_count  = 0;
+	n->listed     = false;
+
+	*listing = n;
+	return ret_ok;
+}
+
+ret_t
+cherokee_dirlist_cache_entry_free (cherokee_dirlist_cache_entry_t *listing)
+{
+	cherokee_buffer_mrproper (&listing->key);
+	cherokee_buffer_mrproper (&listing->html);
+
+	free (listing);
+	return ret_ok;
+}
+
+
+ret_t
+cherokee_dirlist_cache_init (cherokee_dirlist_cache_t *cache)
+{
+	cherokee_avl_init (&cache->table);
+	INIT_LIST_HEAD (&cache->lru);
+
+	cache->size       = 0;
+	cache->max_size   = DIRLIST_CACHE_MAX_SIZE;
+	cache->lasting    = DIRLIST_CACHE_LASTING;
+	cache->count_hit  = 0;
+	cache->count_miss = 0;
+
+	CHEROKEE_MUTEX_INIT (&cache->mutex, CHEROKEE_MUTEX_FAST);
+	return ret_ok;
+}
+
+ret_t
+cherokee_dirlist_cache_mrproper (cherokee_dirlist_cache_t *cache)
+{
+	cherokee_list_t *i, *tmp;
+
+	list_for_each_safe (i, tmp, &cache->lru) {
+		cherokee_list_del (i);
+		cherokee_dirlist_cache_entry_free (DIRLIST_CACHE_ENTRY(i));
+	}
+
+	cherokee_avl_mrproper (&cache->table, NULL);
+	CHEROKEE_MUTEX_DESTROY (&cache->mutex);
+
+	return ret_ok;
+}
+
+static void
+cache_evict (cherokee_dirlist_cache_t       *cache,
+	     cherokee_dirlist_cache_entry_t *listing)
+{
+	/* cache->mutex is LOCKED
+	 */
+	TRACE(ENTRIES, "Cache evict: '%s' (refs=%d)\n", listing->key.buf, listing->ref_count);
+
+	cherokee_avl_del (&cache->table, &listing->key, NULL);
+	cherokee_list_del (&listing->lru);
+
+	cache->size     -= DIRLIST_CACHE_ENTRY_SIZE(listing);
+	listing->listed  = false;
+
+	if (listing->ref_count == 0) {
+		cherokee_dirlist_cache_entry_free (listing);
+	}
+}
+
+ret_t
+cherokee_dirlist_cache_get (cherokee_dirlist_cache_t        *cache,
+			    cherokee_buffer_t               *key,
+			    struct stat                     *info,
+			    cherokee_dirlist_cache_entry_t **ret_listing)
+{
+	ret_t                           ret;
+	cherokee_dirlist_cache_entry_t *listing = NULL;
+
+	CHEROKEE_MUTEX_LOCK (&cache->mutex);
+
+	ret = cherokee_avl_get (&cache->table, key, (void **)&listing);
+	if (ret == ret_ok) {
+		/* Revalidate it
+		 */
+		if ((listing->mtime == info->st_mtime) &&
+		    (listing->expiration >= cherokee_bogonow_now))
+		{
+			cherokee_list_del (&listing->lru);
+			cherokee_list_add (&listing->lru, &cache->lru);
+
+			listing->ref_count += 1;
+			cache->count_hit   += 1;
+
+			*ret_listing = listing;
+			goto out;
+		}
+
+		cache_evict (cache, listing);
+		ret = ret_not_found;
+	}
+
+	cache->count_miss += 1;
+
+out:
+	TRACE(ENTRIES, "Cache %s: '%s' (hits=%d, misses=%d, size=%d)\n",
+	      (ret == ret_ok) ? "hit" : "miss", key->buf,
+	      cache->count_hit, cache->count_miss, (int) cache->size);
+
+	CHEROKEE_MUTEX_UNLOCK (&cache->mutex);
+	return ret;
+}
+
+ret_t
+cherokee_dirlist_cache_add (cherokee_dirlist_cache_t       *cache,
+			    cherokee_dirlist_cache_entry_t *listing)
+{
+	ret_t                           ret;
+	cherokee_dirlist_cache_entry_t *prev = NULL;
+	size_t                          len  = DIRLIST_CACHE_ENTRY_SIZE(listing);
+
+	if (len > cache->max_size)
+		return ret_deny;
+
+	CHEROKEE_MUTEX_LOCK (&cache->mutex);
+
+	/* Another thread might have rendered it meanwhile
+	 */
+	ret = cherokee_avl_get (&cache->table, &listing->key, (void **)&prev);
+	if (ret == ret_ok) {
+		cache_evict (cache, prev);
+	}
+
+	/* Make room for it
+	 */
+	while ((cache->size + len > cache->max_size) &&
+	       (! cherokee_list_empty (&cache->lru)))
+	{
+		cache_evict (cache, DIRLIST_CACHE_ENTRY(cache->lru.prev));
+	}
+
+	ret = cherokee_avl_add (&cache->table, &listing->key, listing);
+	if (ret == ret_ok) {
+		cherokee_list_add (&listing->lru, &cache->lru);
+
+		cache->size     += len;
+		listing->listed  = true;
+	}
+
+	CHEROKEE_MUTEX_UNLOCK (&cache->mutex);
+	return ret;
+}
+
+ret_t
+cherokee_dirlist_cache_release (cherokee_dirlist_cache_t       *cache,
+				cherokee_dirlist_cache_entry_t *listing)
+{
+	CHEROKEE_MUTEX_LOCK (&cache->mutex);
+
+	listing->ref_count -= 1;
+	if ((listing->ref_count == 0) && (! listing->listed)) {
+		cherokee_dirlist_cache_entry_free (listing);
+	}
+
+	CHEROKEE_MUTEX_UNLOCK (&cache->mutex);
+	return ret_ok;
+}
@@ -0,0 +1,80 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef CHEROKEE_DIRLIST_CACHE_H
+#define CHEROKEE_DIRLIST_CACHE_H
+
+#include "common-internal.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "avl.h"
+#include "list.h"
+#include "buffer.h"
+
+#define DIRLIST_CACHE_MAX_SIZE  (4 * 1024 * 1024)   /* bytes */
+#define DIRLIST_CACHE_LASTING   60                  /* secs  */
+
+typedef struct {
+	cherokee_list_t          lru;
+	cherokee_buffer_t        key;
+	cherokee_buffer_t        html;
+	time_t                   mtime;
+	time_t                   expiration;
+	cuint_t                  ref_count;
+	cherokee_boolean_t       listed;
+} cherokee_dirlist_cache_entry_t;
+
+typedef struct {
+	cherokee_avl_t           table;
+	cherokee_list_t          lru;
+	size_t                   size;
+	size_t                   max_size;
+	cuint_t                  lasting;
+	cuint_t                  count_hit;
+	cuint_t                  count_miss;
+	CHEROKEE_MUTEX_T        (mutex);
+} cherokee_dirlist_cache_t;
+
+#define DIRLIST_CACHE_ENTRY(x)       ((cherokee_dirlist_cache_entry_t *)(x))
+#define DIRLIST_CACHE_ENTRY_SIZE(l)  (sizeof(cherokee_dirlist_cache_entry_t) + (l)->key.size + (l)->html.size)
+
+
+ret_t cherokee_dirlist_cache_entry_new  (cherokee_dirlist_cache_entry_t **listing);
+ret_t cherokee_dirlist_cache_entry_free (cherokee_dirlist_cache_entry_t  *listing);
+
+ret_t cherokee_dirlist_cache_init       (cherokee_dirlist_cache_t        *cache);
+ret_t cherokee_dirlist_cache_mrproper   (cherokee_dirlist_cache_t        *cache);
+
+ret_t cherokee_dirlist_cache_get        (cherokee_dirlist_cache_t        *cache,
+					 cherokee_buffer_t               *key,
+					 struct stat                     *info,
+					 cherokee_dirlist_cache_entry_t **listing);
+ret_t cherokee_dirlist_cache_add        (cherokee_dirlist_cache_t        *cache,
+					 cherokee_dirlist_cache_entry_t  *listing);
+ret_t cherokee_dirlist_cache_release    (cherokee_dirlist_cache_t        *cache,
+					 cherokee_dirlist_cache_entry_t  *listing);
+
+#endif /* CHEROKEE_DIRLIST_CACHE_H */
@@ -180,12 +180,27 @@ e('VALIDATOR_FILE_NO_FILE',
   desc  = "This validation modules reads a local file in order to get the authorizated user list. The configuration specifies. Please try to reconfigure the details and ensure a filename is provided.")
 
 
+# cherokee/validator_backend.c
+#
+e('VALIDATOR_BACKEND_PIPE',
+  title = "Could not create a pipe for a back-end query: '${errno}'",
+  desc  = SYSTEM_ISSUE)
+
+e('VALIDATOR_BACKEND_THREAD',
+  title = "Could not create a back-end pool thread (%d of %d): '${errno}'",
+  desc  = SYSTEM_ISSUE)
+
+
 # cherokee/validator.c
 #
 e('VALIDATOR_METHOD_UNKNOWN',
   title = "Unknown authentication method '%s'",
   desc  = BROKEN_CONFIG)
 
+e('VALIDATOR_SECRET_URANDOM',
+  title = "Could not read /dev/urandom: the credential caches will use a weaker secret",
+  desc  = SYSTEM_ISSUE)
+
 
 # cherokee/handler_*.c
 #
@@ -244,6 +259,10 @@ e('HANDLER_FCGI_BALANCER',
   title = "Found a FastCGI handler without a Load Balancer",
   desc  = BROKEN_CONFIG)
 
+e('HANDLER_FCGI_REUSE_MAX',
+  title = "Invalid number of reused FastCGI connections: '%s'",
+  desc  = "The number of idle connections kept per FastCGI server must be 0 (disabled) or a positive integer.")
+
 
 # cherokee/handler_error_redir.c
 #
@@ -1220,6 +1239,10 @@ e('VALIDATOR_MYSQL_NOCONN',
   title = "Unable to connect to MySQL server: %s:%d %s",
   desc  = "Most probably the MySQL server is down or you've mistyped a connetion parameter")
 
+e('VALIDATOR_MYSQL_THREAD',
+  title = "Could not initialize the MySQL client library for a pool thread",
+  desc  = SYSTEM_ISSUE)
+
 
 # cherokee/error_log.c
 #
@@ -1336,3 +1359,10 @@ e('SSL_PKCS11',
 e('SSL_DEFAULTS',
   title = "Could not set all defaults",
   desc  = SYSTEM_ISSUE)
+
+# cherokee/cryptor_libssl_cache.c
+#
+e('SSL_SESSION_CACHE',
+  title   = "Could not set up the shared TLS session cache: ${errno}",
+  desc    = "The TLS sessions will be cached by each worker process independently, so they will not survive a graceful restart.",
+  show_bt = False)
@@ -51,6 +51,7 @@
 #include "common.h"
 #include "human_strcmp.h"
 #include "match.h"
+#include "bogotime.h"
 
 #define ICON_WEB_DIR_DEFAULT "/icons"
 #define ENTRIES "handler,dirlist"
@@ -74,6 +75,8 @@ struct file_match {
 typedef struct file_match file_match_t;
 
 
+static ret_t build_listing (cherokee_handler_dirlist_t *dhdl);
+
 /* Plug-in initialization
  */
 PLUGIN_INFO_HANDLER_EASIEST_INIT (dirlist, http_get | http_options);
@@ -249,6 +252,8 @@ cherokee_handler_dirlist_props_free  (cherokee_handler_dirlist_props_t *props)
 	cherokee_buffer_mrproper (&props->css);
 	cherokee_buffer_mrproper (&props->icon_web_dir);
 
+	cherokee_dirlist_cache_mrproper (&props->cache);
+
 	return cherokee_handler_props_free_base (HANDLER_PROPS(props));
 }
 
@@ -286,6 +291,7 @@ cherokee_handler_dirlist_configure (cherokee_config_node_t   *conf,
 				    cherokee_module_props_t **_props)
 {
 	ret_t                             ret;
+	int                               val;
 	cherokee_list_t                  *i;
 	cherokee_handler_dirlist_props_t *props;
 	const char                       *theme      = NULL;
@@ -321,6 +327,9 @@ cherokee_handler_dirlist_configure (cherokee_config_node_t   *conf,
 		INIT_LIST_HEAD (&n->notice_files);
 		INIT_LIST_HEAD (&n->hidden_files);
 
+		n->use_cache      = true;
+		cherokee_dirlist_cache_init (&n->cache);
+
 		*_props = MODULE_PROPS(n);
 	}
 
@@ -348,6 +357,17 @@ cherokee_handler_dirlist_configure (cherokee_config_node_t   *conf,
 		} else if (equal_buf_str (&subconf->key, "backup")) {
 			props->show_backup = !! atoi (subconf->val.buf);
 
+		} else if (equal_buf_str (&subconf->key, "cache")) {
+			props->use_cache = !! atoi (subconf->val.buf);
+
+			ret = cherokee_config_node_read_int (subconf, "max_size", &val);
+			if ((ret == ret_ok) && (val >= 0))
+				props->cache.max_size = val;
+
+			ret = cherokee_config_node_read_int (subconf, "lasting", &val);
+			if ((ret == ret_ok) && (val >= 0))
+				props->cache.lasting = val;
+
 		} else if (equal_buf_str (&subconf->key, "theme")) {
 			theme = subconf->val.buf;
 
@@ -596,6 +616,8 @@ cherokee_handler_dirlist_new (cherokee_handler_t **hdl, void *cnt, cherokee_modu
 	n->dir_ptr          = NULL;
 	n->file_ptr         = NULL;
 	n->longest_filename = 0;
+	n->listing          = NULL;
+	n->listing_sent     = 0;
 
 	/* Check if icons can be used
 	 */
@@ -638,22 +660,30 @@ cherokee_handler_dirlist_new (cherokee_handler_t **hdl, void *cnt, cherokee_modu
 }
 
 
-ret_t
-cherokee_handler_dirlist_free (cherokee_handler_dirlist_t *dhdl)
+static void
+file_list_free (cherokee_list_t *list)
 {
 	cherokee_list_t *i, *tmp;
 
-	cherokee_buffer_mrproper (&dhdl->header);
-	cherokee_buffer_mrproper (&dhdl->public_dir);
-
-	list_for_each_safe (i, tmp, &dhdl->dirs) {
+	list_for_each_safe (i, tmp, list) {
 		cherokee_list_del (i);
 		file_entry_free ((file_entry_t *)i);
 	}
+}
 
-	list_for_each_safe (i, tmp, &dhdl->files) {
-		cherokee_list_del (i);
-		file_entry_free ((file_entry_t *)i);
+
+ret_t
+cherokee_handler_dirlist_free (cherokee_handler_dirlist_t *dhdl)
+{
+	cherokee_buffer_mrproper (&dhdl->header);
+	cherokee_buffer_mrproper (&dhdl->public_dir);
+
+	file_list_free (&dhdl->dirs);
+	file_list_free (&dhdl->files);
+
+	if (dhdl->listing != NULL) {
+		cherokee_dirlist_cache_release (&HDL_DIRLIST_PROP(dhdl)->cache, dhdl->listing);
+		dhdl->listing = NULL;
 	}
 
 	return ret_ok;
@@ -919,6 +949,16 @@ cherokee_handler_dirlist_init (cherokee_handler_dirlist_t *dhdl)
 		return ret_ok;
 	}
 
+	/* Build de local request
+	 */
+	if (HDL_DIRLIST_PROP(dhdl)->use_cache) {
+		ret = build_listing (dhdl);
+	} else {
+		ret = build_file_list (dhdl);
+	}
+	if (unlikely(ret < ret_ok))
+		return ret;
+
 	/* Read the Notice file
 	 */
 	if (! cherokee_list_empty (&HDL_DIRLIST_PROP(dhdl)->notice_files)) {
@@ -927,12 +967,6 @@ cherokee_handler_dirlist_init (cherokee_handler_dirlist_t *dhdl)
 			return ret;
 	}
 
-	/* Build de local request
-	 */
-	ret = build_file_list (dhdl);
-	if (unlikely(ret < ret_ok))
-		return ret;
-
 	/* Build public dir string
 	 */
 	ret = build_public_path (dhdl, &dhdl->public_dir);
@@ -1241,6 +1275,107 @@ render_header_footer_vbles (cherokee_handler_dirlist_t *dhdl,
 }
 
 
+static ret_t
+render_listing (cherokee_handler_dirlist_t *dhdl,
+		cherokee_buffer_t          *buffer)
+{
+	ret_t            ret;
+	cherokee_list_t *i;
+
+	ret = render_parent_directory (dhdl, buffer);
+	if (unlikely (ret != ret_ok))
+		return ret;
+
+	list_for_each (i, &dhdl->dirs) {
+		render_file (dhdl, buffer, (file_entry_t *)i);
+	}
+
+	list_for_each (i, &dhdl->files) {
+		render_file (dhdl, buffer, (file_entry_t *)i);
+	}
+
+	return ret_ok;
+}
+
+
+static ret_t
+build_listing (cherokee_handler_dirlist_t *dhdl)
+{
+	int                               re;
+	ret_t                             ret;
+	struct stat                       info;
+	cherokee_dirlist_cache_entry_t   *listing = NULL;
+	cherokee_connection_t            *conn    = HANDLER_CONN(dhdl);
+	cherokee_handler_dirlist_props_t *props   = HDL_DIRLIST_PROP(dhdl);
+	cherokee_buffer_t                 key     = CHEROKEE_BUF_INIT;
+
+	/* A single stat() revalidates the cached listing
+	 */
+	cherokee_buffer_add_buffer (&key, &conn->local_directory);
+	cherokee_buffer_add_buffer (&key, &conn->request);
+
+	re = cherokee_stat (key.buf, &info);
+	if (re < 0) {
+		cherokee_buffer_mrproper (&key);
+		return build_file_list (dhdl);
+	}
+
+	cherokee_buffer_add_va (&key, "?%d", dhdl->sort);
+
+	ret = cherokee_dirlist_cache_get (&props->cache, &key, &info, &listing);
+	if (ret == ret_ok) {
+		dhdl->listing = listing;
+		goto out;
+	}
+
+	/* Read and render the directory
+	 */
+	ret = build_file_list (dhdl);
+	if (unlikely (ret != ret_ok))
+		goto out;
+
+	ret = cherokee_dirlist_cache_entry_new (&listing);
+	if (unlikely (ret != ret_ok))
+		goto out;
+
+	cherokee_buffer_swap_buffers (&listing->key, &key);
+	listing->mtime      = info.st_mtime;
+	listing->expiration = cherokee_bogonow_now + props->cache.lasting;
+	listing->ref_count  = 1;
+
+	ret = render_listing (dhdl, &listing->html);
+	if (unlikely (ret != ret_ok)) {
+		cherokee_dirlist_cache_entry_free (listing);
+		goto out;
+	}
+
+	dhdl->listing = listing;
+
+	/* render_file() uses it as scratch space
+	 */
+	cherokee_buffer_clean (&dhdl->header);
+
+	/* The entries are not needed any longer
+	 */
+	file_list_free (&dhdl->dirs);
+	file_list_free (&dhdl->files);
+
+	dhdl->dir_ptr  = NULL;
+	dhdl->file_ptr = NULL;
+
+	/* Changes within the current second would not update the
+	 * directory mtime: such a listing is not worth caching.
+	 */
+	if (info.st_mtime < cherokee_bogonow_now) {
+		cherokee_dirlist_cache_add (&props->cache, listing);
+	}
+
+out:
+	cherokee_buffer_mrproper (&key);
+	return ret;
+}
+
+
 ret_t
 cherokee_handler_dirlist_step (cherokee_handler_dirlist_t *dhdl,
 			       cherokee_buffer_t          *buffer)
@@ -1267,11 +1402,26 @@ cherokee_handler_dirlist_step (cherokee_handler_dirlist_t *dhdl,
 		dhdl->phase = dirlist_phase_add_parent_dir;
 
 	case dirlist_phase_add_parent_dir:
-		ret = render_parent_directory (dhdl, buffer);
-		if (unlikely (ret != ret_ok)) return ret;
+		if (dhdl->listing == NULL) {
+			ret = render_parent_directory (dhdl, buffer);
+			if (unlikely (ret != ret_ok)) return ret;
+		}
 		dhdl->phase = dirlist_phase_add_entries;
 
 	case dirlist_phase_add_entries:
+		/* Pre-rendered listing
+		 */
+		if (dhdl->listing != NULL) {
+			cherokee_buffer_t *html = &dhdl->listing->html;
+			size_t             len  = MIN (html->len - dhdl->listing_sent, DEFAULT_READ_SIZE);
+
+			cherokee_buffer_add (buffer, html->buf + dhdl->listing_sent, len);
+			dhdl->listing_sent += len;
+
+			if (dhdl->listing_sent < html->len)
+				return ret_ok;
+		}
+
 		/* Print the directories first
 		 */
 		while (dhdl->dir_ptr) {
@@ -30,10 +30,12 @@
 #include <dirent.h>
 #include <unistd.h>
 
+#include "avl.h"
 #include "list.h"
 #include "buffer.h"
 #include "handler.h"
 #include "plugin_loader.h"
+#include "dirlist_cache.h"
 
 
 typedef enum {
@@ -54,6 +56,7 @@ typedef enum {
 } cherokee_dirlist_phase_t;
 
 
+
 typedef struct {
 	cherokee_handler_props_t  props;
 
@@ -82,6 +85,11 @@ typedef struct {
 	 */
 	cherokee_boolean_t       redir_symlinks;
 	cherokee_buffer_t        icon_web_dir;
+
+	/* Rendered listings cache
+	 */
+	cherokee_boolean_t       use_cache;
+	cherokee_dirlist_cache_t cache;
 } cherokee_handler_dirlist_props_t;
 
 
@@ -106,6 +114,11 @@ typedef struct {
  	cherokee_buffer_t        header;
 
 	cherokee_buffer_t        public_dir;
+
+	/* Rendered listing
+	 */
+	cherokee_dirlist_cache_entry_t *listing;
+	size_t                          listing_sent;
 } cherokee_handler_dirlist_t;
 
 #define PROP_DIRLIST(x)      ((cherokee_handler_dirlist_props_t *)(x))
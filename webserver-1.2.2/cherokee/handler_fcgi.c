@@ -38,6 +38,7 @@
 #include "fastcgi.h"
 
 #define POST_PACKAGE_LEN 32600
+#define DEFAULT_REUSE_MAX 0
 #define ENTRIES "fcgi,handler"
 
 
@@ -49,11 +50,257 @@ static void set_env_pair (cherokee_handler_cgi_base_t *cgi_base,
 			  const char *key, int key_len,
 			  const char *val, int val_len);
 
+static ret_t connect_to_server (cherokee_handler_fcgi_t *hdl);
+static ret_t do_send           (cherokee_handler_fcgi_t *hdl,
+				cherokee_buffer_t       *buffer);
+
 /* Plug-in initialization
  */
 CGI_LIB_INIT (fcgi, http_all_methods);
 
 
+/* Keep-alive connections: every thread keeps its own list of idle
+ * back-end connections per source, so there is no locking involved.
+ * The lists are indexed by the source name in the fastcgi_servers
+ * tree of the thread.
+ */
+typedef struct {
+	cherokee_list_t    reuse;
+	cuint_t            reuse_len;
+} fcgi_poll_t;
+
+typedef struct {
+	cherokee_list_t    listed;
+	cherokee_socket_t  socket;
+} fcgi_poll_conn_t;
+
+#define FCGI_POLL_CONN(c) ((fcgi_poll_conn_t *)(c))
+
+
+static void
+poll_conn_free (fcgi_poll_conn_t *pconn)
+{
+	cherokee_list_del (&pconn->listed);
+
+	cherokee_socket_close    (&pconn->socket);
+	cherokee_socket_mrproper (&pconn->socket);
+
+	free (pconn);
+}
+
+static void
+poll_free (void *p)
+{
+	cherokee_list_t *i, *j;
+	fcgi_poll_t     *poll = p;
+
+	list_for_each_safe (i, j, &poll->reuse) {
+		poll_conn_free (FCGI_POLL_CONN(i));
+	}
+
+	free (poll);
+}
+
+static ret_t
+poll_get (cherokee_handler_fcgi_t *hdl)
+{
+	ret_t              ret;
+	int                re;
+	char               c;
+	fcgi_poll_t       *poll = NULL;
+	fcgi_poll_conn_t  *pconn;
+	cherokee_thread_t *thd  = HANDLER_THREAD(hdl);
+
+	if (thd->fastcgi_servers == NULL)
+		return ret_not_found;
+
+	ret = cherokee_avl_get (thd->fastcgi_servers, &hdl->src_ref->original, (void **)&poll);
+	if (ret != ret_ok)
+		return ret_not_found;
+
+	while (! cherokee_list_empty (&poll->reuse)) {
+		/* The most recently used one
+		 */
+		pconn = FCGI_POLL_CONN(poll->reuse.next);
+		poll->reuse_len -= 1;
+
+		/* The back-end might have closed it while it was
+		 * idle. Nothing is expected to be readable either.
+		 */
+		do {
+			re = recv (SOCKET_FD(&pconn->socket), &c, 1, MSG_PEEK);
+		} while ((re < 0) && (errno == EINTR));
+
+		if ((re < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+			TRACE (ENTRIES, "Reusing back-end connection fd=%d\n", SOCKET_FD(&pconn->socket));
+
+			cherokee_list_del (&pconn->listed);
+			memcpy (&hdl->socket, &pconn->socket, sizeof(cherokee_socket_t));
+			hdl->reused = true;
+
+			free (pconn);
+			return ret_ok;
+		}
+
+		TRACE (ENTRIES, "Dropping closed back-end connection fd=%d\n", SOCKET_FD(&pconn->socket));
+		poll_conn_free (pconn);
+	}
+
+	return ret_not_found;
+}
+
+static ret_t
+poll_release (cherokee_handler_fcgi_t *hdl)
+{
+	ret_t                          ret;
+	fcgi_poll_t                   *poll  = NULL;
+	fcgi_poll_conn_t              *pconn;
+	cherokee_thread_t             *thd   = HANDLER_THREAD(hdl);
+	cherokee_handler_fcgi_props_t *props = HANDLER_FCGI_PROPS(hdl);
+
+	if (thd->fastcgi_servers == NULL) {
+		ret = cherokee_avl_new (&thd->fastcgi_servers);
+		if (unlikely (ret != ret_ok))
+			return ret;
+
+		thd->fastcgi_free_func = poll_free;
+	}
+
+	ret = cherokee_avl_get (thd->fastcgi_servers, &hdl->src_ref->original, (void **)&poll);
+	if (ret != ret_ok) {
+		poll = (fcgi_poll_t *) malloc (sizeof(fcgi_poll_t));
+		if (unlikely (poll == NULL))
+			return ret_nomem;
+
+		INIT_LIST_HEAD (&poll->reuse);
+		poll->reuse_len = 0;
+
+		cherokee_avl_add (thd->fastcgi_servers, &hdl->src_ref->original, poll);
+	}
+
+	/* If the list is full, dispose the oldest connection
+	 */
+	if (poll->reuse_len >= props->reuse_max) {
+		poll_conn_free (FCGI_POLL_CONN(poll->reuse.prev));
+		poll->reuse_len -= 1;
+	}
+
+	pconn = (fcgi_poll_conn_t *) malloc (sizeof(fcgi_poll_conn_t));
+	if (unlikely (pconn == NULL))
+		return ret_nomem;
+
+	memcpy (&pconn->socket, &hdl->socket, sizeof(cherokee_socket_t));
+	cherokee_socket_init (&hdl->socket);
+
+	cherokee_list_add (&pconn->listed, &poll->reuse);
+	poll->reuse_len += 1;
+
+	TRACE (ENTRIES, "Keeping back-end connection fd=%d (%d idle)\n",
+	       SOCKET_FD(&pconn->socket), poll->reuse_len);
+
+	return ret_ok;
+}
+
+
+/* The back-end may close an idle connection right when it is taken
+ * from the list. If a reused connection fails before any response
+ * data arrives, the request is sent once more over a new one.
+ */
+static cherokee_boolean_t
+retry_possible (cherokee_handler_fcgi_t *hdl, ret_t ret, int err)
+{
+	if ((! hdl->reused) ||
+	    (hdl->retry != fcgi_retry_none))
+		return false;
+
+	switch (ret) {
+	case ret_eof:
+		return true;
+	case ret_error:
+		return ((err == EPIPE) || (err == ECONNRESET));
+	default:
+		return false;
+	}
+}
+
+static void
+retry_start (cherokee_handler_fcgi_t *hdl)
+{
+	TRACE (ENTRIES, "Reused back-end connection fd=%d failed, reconnecting\n",
+	       SOCKET_FD(&hdl->socket));
+
+	cherokee_socket_close (&hdl->socket);
+
+	/* Send the request headers again
+	 */
+	cherokee_buffer_clean (&hdl->write_buffer);
+	cherokee_buffer_add_buffer (&hdl->write_buffer, &hdl->request);
+	cherokee_buffer_mrproper (&hdl->request);
+
+	hdl->reused    = false;
+	hdl->keepalive = false;
+	hdl->retry     = fcgi_retry_connect;
+
+	/* do_send() took it for a bad gateway
+	 */
+	HANDLER_CONN(hdl)->error_code = http_ok;
+}
+
+static ret_t
+retry_step (cherokee_handler_fcgi_t *hdl)
+{
+	ret_t                  ret;
+	cherokee_connection_t *conn = HANDLER_CONN(hdl);
+
+	switch (hdl->retry) {
+	case fcgi_retry_connect:
+		ret = connect_to_server (hdl);
+		switch (ret) {
+		case ret_ok:
+			break;
+		case ret_eagain:
+			return ret_eagain;
+		case ret_deny:
+			conn->error_code = http_gateway_timeout;
+			return ret_error;
+		default:
+			conn->error_code = http_service_unavailable;
+			return ret_error;
+		}
+
+		hdl->retry = fcgi_retry_send;
+
+	case fcgi_retry_send:
+		ret = do_send (hdl, &hdl->write_buffer);
+		switch (ret) {
+		case ret_ok:
+			break;
+		case ret_eagain:
+			break;
+		default:
+			return ret_error;
+		}
+
+		if (! cherokee_buffer_is_empty (&hdl->write_buffer)) {
+			ret = cherokee_thread_deactive_to_polling (HANDLER_THREAD(hdl), conn,
+								   SOCKET_FD(&hdl->socket),
+								   FDPOLL_MODE_WRITE, false);
+			if (unlikely (ret != ret_ok)) {
+				return ret_error;
+			}
+			return ret_eagain;
+		}
+
+		hdl->retry = fcgi_retry_done;
+
+	default:
+		break;
+	}
+
+	return ret_ok;
+}
+
+
 /* Methods implementation
  */
 static ret_t
@@ -129,6 +376,16 @@ process_package (cherokee_handler_fcgi_t *hdl, cherokee_buffer_t *inbuf, cheroke
 	case FCGI_END_REQUEST:
 /*		printf ("READ:END"); */
 		HDL_CGI_BASE(hdl)->got_eof = true;
+
+		/* The back-end will keep the connection open if it
+		 * completed the request (FCGI_KEEP_CONN was sent)
+		 */
+		if ((HANDLER_FCGI_PROPS(hdl)->reuse_max > 0) &&
+		    (len >= sizeof(FCGI_EndRequestBody)) &&
+		    (((FCGI_EndRequestBody *) data)->protocolStatus == FCGI_REQUEST_COMPLETE))
+		{
+			hdl->keepalive = true;
+		}
 		break;
 
 	default:
@@ -162,10 +419,26 @@ static ret_t
 read_from_fcgi (cherokee_handler_cgi_base_t *cgi, cherokee_buffer_t *buffer)
 {
 	ret_t                    ret;
+	int                      err;
 	size_t                   read = 0;
 	cherokee_handler_fcgi_t *fcgi = HDL_FCGI(cgi);
+	cherokee_connection_t   *conn = HANDLER_CONN(cgi);
+
+	/* Sending the request again
+	 */
+	if ((fcgi->retry == fcgi_retry_connect) ||
+	    (fcgi->retry == fcgi_retry_send))
+	{
+		ret = retry_step (fcgi);
+		if (ret != ret_ok) {
+			if (ret == ret_error)
+				cgi->got_eof = true;
+			return ret;
+		}
+	}
 
 	ret = cherokee_socket_bufread (&fcgi->socket, &fcgi->write_buffer, DEFAULT_READ_SIZE, &read);
+	err = errno;
 
 	switch (ret) {
 	case ret_eagain:
@@ -179,6 +452,11 @@ read_from_fcgi (cherokee_handler_cgi_base_t *cgi, cherokee_buffer_t *buffer)
 		return ret_eagain;
 
 	case ret_ok:
+		if ((fcgi->reused) && (read > 0)) {
+			fcgi->reused = false;
+			cherokee_buffer_mrproper (&fcgi->request);
+		}
+
 		ret = process_buffer (fcgi, &fcgi->write_buffer, buffer);
 		TRACE (ENTRIES, "%d bytes read, buffer.len %d\n", read, buffer->len);
 
@@ -189,6 +467,15 @@ read_from_fcgi (cherokee_handler_cgi_base_t *cgi, cherokee_buffer_t *buffer)
 
 	case ret_eof:
 	case ret_error:
+		/* The request body cannot be sent again
+		 */
+		if ((! conn->post.has_info) &&
+		    (retry_possible (fcgi, ret, err)))
+		{
+			retry_start (fcgi);
+			return read_from_fcgi (cgi, buffer);
+		}
+
 		cgi->got_eof = true;
 		return ret;
 
@@ -217,6 +504,7 @@ cherokee_handler_fcgi_configure (cherokee_config_node_t   *conf,
 				 cherokee_module_props_t **_props)
 {
 	ret_t                          ret;
+	int                            reuse_max;
 	cherokee_list_t               *i;
 	cherokee_handler_fcgi_props_t *props;
 
@@ -229,7 +517,8 @@ cherokee_handler_fcgi_configure (cherokee_config_node_t   *conf,
 							   MODULE_PROPS_FREE(props_free));
 
 		INIT_LIST_HEAD (&n->server_list);
-		n->balancer = NULL;
+		n->balancer  = NULL;
+		n->reuse_max = DEFAULT_REUSE_MAX;
 
 		*_props = MODULE_PROPS(n);
 	}
@@ -244,6 +533,14 @@ cherokee_handler_fcgi_configure (cherokee_config_node_t   *conf,
 		if (equal_buf_str (&subconf->key, "balancer")) {
 			ret = cherokee_balancer_instance (&subconf->val, subconf, srv, &props->balancer);
 			if (ret != ret_ok) return ret;
+
+		} else if (equal_buf_str (&subconf->key, "reuse_max")) {
+			ret = cherokee_atoi (subconf->val.buf, &reuse_max);
+			if ((ret != ret_ok) || (reuse_max < 0)) {
+				LOG_CRITICAL (CHEROKEE_ERROR_HANDLER_FCGI_REUSE_MAX, subconf->val.buf);
+				return ret_error;
+			}
+			props->reuse_max = reuse_max;
 		}
 	}
 
@@ -288,8 +585,12 @@ cherokee_handler_fcgi_new (cherokee_handler_t **hdl, void *cnt, cherokee_module_
 	 */
 	n->post_phase = fcgi_post_phase_read;
 	n->src_ref    = NULL;
+	n->keepalive  = false;
+	n->reused     = false;
+	n->retry      = fcgi_retry_none;
 
 	cherokee_socket_init (&n->socket);
+	cherokee_buffer_init (&n->request);
 	cherokee_buffer_init (&n->write_buffer);
 	cherokee_buffer_ensure_size (&n->write_buffer, 512);
 
@@ -303,11 +604,26 @@ cherokee_handler_fcgi_new (cherokee_handler_t **hdl, void *cnt, cherokee_module_
 ret_t
 cherokee_handler_fcgi_free (cherokee_handler_fcgi_t *hdl)
 {
+	cherokee_connection_t *conn = HANDLER_CONN(hdl);
+
 	TRACE (ENTRIES, "fcgi handler free: %p\n", hdl);
 
+	/* Keep the connection if the whole request was sent and the
+	 * whole response was read
+	 */
+	if ((hdl->keepalive) &&
+	    (SOCKET_FD(&hdl->socket) >= 0) &&
+	    (SOCKET_FD(&hdl->socket) != conn->polling_fd) &&
+	    (cherokee_buffer_is_empty (&hdl->write_buffer)) &&
+	    ((! conn->post.has_info) || (cherokee_post_read_finished (&conn->post))))
+	{
+		poll_release (hdl);
+	}
+
 	cherokee_socket_close (&hdl->socket);
 	cherokee_socket_mrproper (&hdl->socket);
 
+	cherokee_buffer_mrproper (&hdl->request);
 	cherokee_buffer_mrproper (&hdl->write_buffer);
 
 	return cherokee_handler_cgi_base_free (HDL_CGI_BASE(hdl));
@@ -328,11 +644,11 @@ fcgi_build_header (FCGI_Header *hdr, cuchar_t type, cushort_t request_id, cuint_
 }
 
 static void
-fcgi_build_request_body (FCGI_BeginRequestRecord *request)
+fcgi_build_request_body (FCGI_BeginRequestRecord *request, cuchar_t flags)
 {
 	request->body.roleB0      = FCGI_RESPONDER;
 	request->body.roleB1      = 0;
-	request->body.flags       = 0;
+	request->body.flags       = flags;
 	request->body.reserved[0] = 0;
 	request->body.reserved[1] = 0;
 	request->body.reserved[2] = 0;
@@ -480,16 +796,24 @@ add_empty_packet (cherokee_handler_fcgi_t *hdl, cuint_t type)
 static ret_t
 build_header (cherokee_handler_fcgi_t *hdl, cherokee_buffer_t *buffer)
 {
-	FCGI_BeginRequestRecord  request;
-	cuint_t                  last_header_offset;
-	cherokee_connection_t   *conn                = HANDLER_CONN(hdl);
+	FCGI_BeginRequestRecord        request;
+	cuint_t                        last_header_offset;
+	cuchar_t                       flags               = 0;
+	cherokee_connection_t         *conn                = HANDLER_CONN(hdl);
+	cherokee_handler_fcgi_props_t *props               = HANDLER_FCGI_PROPS(hdl);
 
 	cherokee_buffer_clean (buffer);
 
+	/* Ask the back-end not to close the connection
+	 */
+	if (props->reuse_max > 0) {
+		flags |= FCGI_KEEP_CONN;
+	}
+
 	/* FCGI_BEGIN_REQUEST
 	 */
 	fcgi_build_header (&request.header, FCGI_BEGIN_REQUEST, 1, sizeof(request.body), 0);
-	fcgi_build_request_body (&request);
+	fcgi_build_request_body (&request, flags);
 
 	cherokee_buffer_add (buffer, (void *)&request, sizeof(FCGI_BeginRequestRecord));
 	TRACE (ENTRIES, "Added FCGI_BEGIN_REQUEST, len=%d\n", buffer->len);
@@ -532,6 +856,18 @@ connect_to_server (cherokee_handler_fcgi_t *hdl)
 			return ret;
 	}
 
+	/* Reuse an idle connection to the same source, unless a
+	 * reused one has just failed
+	 */
+	if ((props->reuse_max > 0) &&
+	    (hdl->retry == fcgi_retry_none) &&
+	    (SOCKET_FD(&hdl->socket) < 0))
+	{
+		ret = poll_get (hdl);
+		if (ret == ret_ok)
+			return ret_ok;
+	}
+
 	/* Try to connect
 	 */
 	if (hdl->src_ref->type == source_host) {
@@ -725,6 +1061,14 @@ cherokee_handler_fcgi_init (cherokee_handler_fcgi_t *hdl)
 			return ret_error;
 		}
 
+		/* Keep a copy of the headers, in case the reused
+		 * connection turns out to be closed
+		 */
+		if (hdl->reused) {
+			cherokee_buffer_clean (&hdl->request);
+			cherokee_buffer_add_buffer (&hdl->request, &hdl->write_buffer);
+		}
+
 		HDL_CGI_BASE(hdl)->init_phase = hcgi_phase_send_headers;
 
 	case hcgi_phase_send_headers:
@@ -734,6 +1078,13 @@ cherokee_handler_fcgi_init (cherokee_handler_fcgi_t *hdl)
 		 */
 		ret = do_send (hdl, &hdl->write_buffer);
 		if (ret != ret_ok) {
+			if (retry_possible (hdl, ret, errno)) {
+				retry_start (hdl);
+
+				hdl->retry = fcgi_retry_done;
+				HDL_CGI_BASE(hdl)->init_phase = hcgi_phase_connect;
+				return ret_eagain;
+			}
 			return ret;
 		}
 
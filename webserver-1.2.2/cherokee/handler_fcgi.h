@@ -39,6 +39,13 @@ typedef enum {
 	fcgi_post_phase_write
 } cherokee_handler_fcgi_post_t;
 
+typedef enum {
+	fcgi_retry_none,
+	fcgi_retry_connect,
+	fcgi_retry_send,
+	fcgi_retry_done
+} cherokee_handler_fcgi_retry_t;
+
 /* Data structure
  */
 typedef struct {
@@ -47,6 +54,10 @@ typedef struct {
 	cherokee_socket_t             socket;
 	cherokee_handler_fcgi_post_t  post_phase;
 	cherokee_buffer_t             write_buffer;
+	cherokee_boolean_t            keepalive;
+	cherokee_boolean_t            reused;
+	cherokee_buffer_t             request;
+	cherokee_handler_fcgi_retry_t retry;
 } cherokee_handler_fcgi_t;
 
 #define HDL_FCGI(x)  ((cherokee_handler_fcgi_t *)(x))
@@ -58,6 +69,7 @@ typedef struct {
 	cherokee_handler_cgi_base_t  base;
 	cherokee_list_t              server_list;
 	cherokee_balancer_t         *balancer;
+	cuint_t                      reuse_max;
 } cherokee_handler_fcgi_props_t;
 
 #define PROP_FCGI(x)          ((cherokee_handler_fcgi_props_t *)(x))
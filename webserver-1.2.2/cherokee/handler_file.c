@@ -799,6 +799,13 @@ cherokee_handler_file_step (cherokee_handler_file_t *fhdl, cherokee_buffer_t *bu
 		ssize_t sent;
 		off_t   to_send;
 
+		/* Responses to previous pipelined requests go first
+		 */
+		ret = cherokee_connection_send_pipelined (conn);
+		if (ret != ret_ok) {
+			return ret;
+		}
+
 		to_send = conn->range_end - fhdl->offset + 1;
 		if ((conn->limit_bps > 0) &&
 		    (conn->limit_bps < to_send))
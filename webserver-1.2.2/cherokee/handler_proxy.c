@@ -254,9 +254,9 @@ replace_againt_regex_list (cherokee_buffer_t *in_buf,
 	list_for_each (i, regexs) {
 		regex_entry = REGEX_ENTRY(i);
 
-		re = pcre_exec (regex_entry->re, NULL,
-				in_buf->buf, in_buf->len, 0, 0,
-				ovector, OVECTOR_LEN);
+		re = cherokee_regex_exec (regex_entry->re,
+					  in_buf->buf, in_buf->len,
+					  ovector, OVECTOR_LEN);
 		if (re == 0) {
 			LOG_ERROR_S (CHEROKEE_ERROR_HANDLER_REGEX_GROUPS);
 		}
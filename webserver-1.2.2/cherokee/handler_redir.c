@@ -171,14 +171,14 @@ match_and_substitute (cherokee_handler_redir_t *hdl)
 		/* Case 3: Use the rule-subentry regex
 		 */
 		else {
-			rc = pcre_exec (list->re, NULL, subject, subject_len, 0, 0, ovector, OVECTOR_LEN);
+			rc = cherokee_regex_exec (list->re, subject, subject_len, ovector, OVECTOR_LEN);
 			if (rc == 0) {
 				LOG_ERROR_S (CHEROKEE_ERROR_HANDLER_REGEX_GROUPS);
 			}
 
 			TRACE (ENTRIES, "subject = \"%s\" + len(\"%s\")-1=%d\n",
 			       conn->request.buf, conn->web_directory.buf, conn->web_directory.len - 1);
-			TRACE (ENTRIES, "pcre_exec: subject=\"%s\" -> %d\n", subject, rc);
+			TRACE (ENTRIES, "regex_exec: subject=\"%s\" -> %d\n", subject, rc);
 
 			if (rc <= 0) {
 				continue;
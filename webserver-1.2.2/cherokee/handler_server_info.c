@@ -37,6 +37,7 @@
 #include "server-protected.h"
 #include "plugin_loader.h"
 #include "connection_info.h"
+#include "regex.h"
 
 
 #define PAGE_HEADER                                                                                     \
@@ -351,6 +352,12 @@ add_traffic (cherokee_dwriter_t *writer,
 	cherokee_list_t  *i;
 	cherokee_buffer_t tmp = CHEROKEE_BUF_INIT;
 
+	/* Merge the per-thread counters
+	 */
+	if (srv->collector != NULL) {
+		cherokee_collector_sync (srv->collector);
+	}
+
 	/* Global statistics
 	 */
 	cherokee_dwriter_dict_open (writer);
@@ -430,6 +437,8 @@ add_traffic (cherokee_dwriter_t *writer,
 
 		cherokee_dwriter_bstring (writer, &vsrv->name);
 		if (vsrv->collector != NULL) {
+			cherokee_collector_vsrv_sync (vsrv->collector);
+
 			cherokee_dwriter_dict_open (writer);
 			cherokee_dwriter_cstring (writer, "rx");
 			cherokee_dwriter_integer (writer, COLLECTOR_RX(vsrv->collector));
@@ -728,6 +737,36 @@ add_iocache (cherokee_dwriter_t *writer,
 }
 
 
+static ret_t
+regexs_while (cherokee_buffer_t *pattern, void *value, void *param)
+{
+	cherokee_regex_t   *regex  = value;
+	cherokee_dwriter_t *writer = param;
+
+	cherokee_dwriter_dict_open (writer);
+	cherokee_dwriter_cstring (writer, "pattern");
+	cherokee_dwriter_bstring (writer, pattern);
+	cherokee_dwriter_cstring (writer, "matches");
+	cherokee_dwriter_integer (writer, regex->matches);
+	cherokee_dwriter_cstring (writer, "misses");
+	cherokee_dwriter_integer (writer, regex->misses);
+	cherokee_dwriter_cstring (writer, "studied");
+	cherokee_dwriter_bool    (writer, (regex->extra != NULL));
+	cherokee_dwriter_dict_close (writer);
+
+	return ret_ok;
+}
+
+static void
+add_regexs (cherokee_dwriter_t *writer,
+	    cherokee_server_t  *srv)
+{
+	cherokee_dwriter_list_open (writer);
+	cherokee_regex_table_while (srv->regexs, regexs_while, writer);
+	cherokee_dwriter_list_close (writer);
+}
+
+
 static void
 add_detailed_connections (cherokee_dwriter_t *writer,
 			  cherokee_list_t    *infos)
@@ -838,6 +877,9 @@ server_info_build_info (cherokee_handler_server_info_t *hdl)
 	cherokee_dwriter_cstring (writer, "iocache");
 	add_iocache (writer, srv);
 
+	cherokee_dwriter_cstring (writer, "regexs");
+	add_regexs (writer, srv);
+
 	/* Connection details
 	 */
 	if  (HDL_SRV_INFO_PROPS(hdl)->connection_details) {
@@ -31,6 +31,7 @@
 #include "bogotime.h"
 #include "threading.h"
 #include "spawner.h"
+#include "crc32.h"
 
 /* Global variables
  */
@@ -80,6 +81,10 @@ cherokee_init (void)
 	 */
 	cherokee_cacheline_size_get (&cherokee_cacheline_size);
 
+	/* Choose the CRC32 implementation
+	 */
+	crc32_init();
+
 	/* Get the file descriptor number limit
 	 */
 	ret = cherokee_sys_fdlimit_get (&cherokee_fdlimit);
@@ -0,0 +1,261 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "ip_tree.h"
+
+/* Every node holds a prefix, and only branches at the first bit
+ * after it. Nodes whose prefix was not added themselves (set is
+ * false) are just the joints of two sub-trees, so a tree of N
+ * prefixes has less than 2N nodes and its depth is bound by the
+ * address length instead of by N.
+ */
+struct cherokee_ip_tree_node {
+	cherokee_ip_tree_node_t *child[2];
+	cuint_t                  bits;
+	cherokee_boolean_t       set;
+	unsigned char            addr[IP_TREE_MAX_LEN];
+};
+
+#define BIT(addr,n) (((addr)[(n) >> 3] >> (7 - ((n) & 7))) & 1)
+
+
+static cherokee_ip_tree_node_t *
+node_new (const unsigned char *addr, cuint_t bits, cherokee_boolean_t set)
+{
+	cuint_t                  bytes;
+	cherokee_ip_tree_node_t *n;
+
+	n = (cherokee_ip_tree_node_t *) malloc (sizeof(cherokee_ip_tree_node_t));
+	if (unlikely (n == NULL))
+		return NULL;
+
+	n->child[0] = NULL;
+	n->child[1] = NULL;
+	n->bits     = bits;
+	n->set      = set;
+
+	/* Only keep the bits of the prefix
+	 */
+	memset (n->addr, 0, IP_TREE_MAX_LEN);
+
+	bytes = bits >> 3;
+	memcpy (n->addr, addr, bytes);
+
+	if (bits & 7) {
+		n->addr[bytes] = addr[bytes] & (0xFF << (8 - (bits & 7)));
+	}
+
+	return n;
+}
+
+static void
+node_free (cherokee_ip_tree_node_t *node)
+{
+	if (node == NULL)
+		return;
+
+	node_free (node->child[0]);
+	node_free (node->child[1]);
+	free (node);
+}
+
+/* Length of the prefix shared by two addresses, up to 'bits'
+ */
+static cuint_t
+common_bits (const unsigned char *a, const unsigned char *b, cuint_t bits)
+{
+	cuint_t       i;
+	cuint_t       n;
+	unsigned char diff;
+
+	for (i = 0; i * 8 < bits; i++) {
+		diff = a[i] ^ b[i];
+		if (diff == 0)
+			continue;
+
+		n = i * 8;
+		while ((diff & 0x80) == 0) {
+			diff <<= 1;
+			n++;
+		}
+
+		return MIN (n, bits);
+	}
+
+	return bits;
+}
+
+static cherokee_boolean_t
+prefix_match (const unsigned char *prefix, const unsigned char *addr, cuint_t bits)
+{
+	cuint_t bytes = bits >> 3;
+
+	if (memcmp (prefix, addr, bytes) != 0)
+		return false;
+
+	if (bits & 7) {
+		return ((prefix[bytes] ^ addr[bytes]) & (0xFF << (8 - (bits & 7)))) == 0;
+	}
+
+	return true;
+}
+
+
+ret_t
+cherokee_ip_tree_init (cherokee_ip_tree_t *tree, cuint_t addr_len)
+{
+	if (unlikely (addr_len > IP_TREE_MAX_LEN))
+		return ret_error;
+
+	tree->root     = NULL;
+	tree->max_bits = addr_len * 8;
+	tree->len      = 0;
+
+	return ret_ok;
+}
+
+
+ret_t
+cherokee_ip_tree_mrproper (cherokee_ip_tree_t *tree)
+{
+	node_free (tree->root);
+
+	tree->root = NULL;
+	tree->len  = 0;
+
+	return ret_ok;
+}
+
+
+ret_t
+cherokee_ip_tree_add (cherokee_ip_tree_t *tree, const void *address, cuint_t bits)
+{
+	cuint_t                   common;
+	cherokee_ip_tree_node_t  *node;
+	cherokee_ip_tree_node_t  *new_node;
+	cherokee_ip_tree_node_t  *glue;
+	cherokee_ip_tree_node_t **link = &tree->root;
+	const unsigned char      *addr = address;
+
+	if (unlikely (bits > tree->max_bits))
+		return ret_error;
+
+	while (*link != NULL) {
+		node   = *link;
+		common = common_bits (node->addr, addr, MIN (node->bits, bits));
+
+		if (common < node->bits) {
+			new_node = node_new (addr, bits, true);
+			if (unlikely (new_node == NULL))
+				return ret_nomem;
+
+			/* The new prefix contains the node
+			 */
+			if (common == bits) {
+				new_node->child[BIT(node->addr, bits)] = node;
+				*link = new_node;
+				goto added;
+			}
+
+			/* They diverge within the node prefix
+			 */
+			glue = node_new (addr, common, false);
+			if (unlikely (glue == NULL)) {
+				free (new_node);
+				return ret_nomem;
+			}
+
+			glue->child[BIT(node->addr, common)] = node;
+			glue->child[BIT(addr, common)]       = new_node;
+			*link = glue;
+			goto added;
+		}
+
+		/* A shorter prefix covering it is already there
+		 */
+		if (node->set)
+			return ret_ok;
+
+		if (node->bits == bits) {
+			node->set = true;
+			goto added;
+		}
+
+		link = &node->child[BIT(addr, node->bits)];
+	}
+
+	*link = node_new (addr, bits, true);
+	if (unlikely (*link == NULL))
+		return ret_nomem;
+
+added:
+	tree->len += 1;
+	return ret_ok;
+}
+
+
+ret_t
+cherokee_ip_tree_match (cherokee_ip_tree_t *tree, const void *address)
+{
+	cherokee_ip_tree_node_t *node = tree->root;
+	const unsigned char     *addr = address;
+
+	while (node != NULL) {
+		if (! prefix_match (node->addr, addr, node->bits))
+			return ret_not_found;
+
+		if (node->set)
+			return ret_ok;
+
+		if (node->bits >= tree->max_bits)
+			return ret_not_found;
+
+		node = node->child[BIT(addr, node->bits)];
+	}
+
+	return ret_not_found;
+}
+
+
+static void
+node_while (cherokee_ip_tree_node_t *node, cherokee_ip_tree_func_t func, void *param)
+{
+	if (node == NULL)
+		return;
+
+	if (node->set) {
+		func (node->addr, node->bits, param);
+	}
+
+	node_while (node->child[0], func, param);
+	node_while (node->child[1], func, param);
+}
+
+ret_t
+cherokee_ip_tree_while (cherokee_ip_tree_t *tree, cherokee_ip_tree_func_t func, void *param)
+{
+	node_while (tree->root, func, param);
+	return ret_ok;
+}
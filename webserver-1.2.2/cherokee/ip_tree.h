@@ -0,0 +1,54 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef CHEROKEE_IP_TREE_H
+#define CHEROKEE_IP_TREE_H
+
+#include "common-internal.h"
+
+/* Set of network prefixes of a single address family, kept in a
+ * path compressed binary radix (Patricia) tree. Addresses are given
+ * in network byte order: 4 bytes long for IPv4, 16 for IPv6.
+ */
+
+#define IP_TREE_MAX_LEN 16
+
+typedef struct cherokee_ip_tree_node cherokee_ip_tree_node_t;
+
+typedef struct {
+	cherokee_ip_tree_node_t *root;
+	cuint_t                  max_bits;
+	cuint_t                  len;
+} cherokee_ip_tree_t;
+
+typedef void (*cherokee_ip_tree_func_t) (unsigned char *addr, cuint_t bits, void *param);
+
+ret_t cherokee_ip_tree_init     (cherokee_ip_tree_t *tree, cuint_t addr_len);
+ret_t cherokee_ip_tree_mrproper (cherokee_ip_tree_t *tree);
+
+ret_t cherokee_ip_tree_add      (cherokee_ip_tree_t *tree, const void *addr, cuint_t bits);
+ret_t cherokee_ip_tree_match    (cherokee_ip_tree_t *tree, const void *addr);
+ret_t cherokee_ip_tree_while    (cherokee_ip_tree_t *tree, cherokee_ip_tree_func_t func, void *param);
+
+#endif /* CHEROKEE_IP_TREE_H */
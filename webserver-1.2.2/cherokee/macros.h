@@ -90,6 +90,7 @@
 #define DEFAULT_READ_SIZE             8192
 #define MAX_HEADER_LEN                8192
 #define MAX_HEADER_CRLF               8
+#define MAX_PIPELINED_LEN             (64 * 1024)
 #define MAX_KEEPALIVE                 500
 #define MAX_NEW_CONNECTIONS_PER_STEP  50
 #define DEFAULT_CONN_REUSE            20
@@ -40,6 +40,7 @@
 
 #include "server.h"
 #include "spawner.h"
+#include "shm.h"
 
 #ifdef HAVE_GETOPT_LONG
 # include <getopt.h>
@@ -793,6 +794,30 @@ spawn_clean (void)
 }
 #endif /* HAVE_POSIX_SHM */
 
+static void
+tls_cache_init (void)
+{
+	int  fd;
+	char num[16];
+	char name[sizeof(TMPDIR "/cherokee-tls-cache-<PID_number>")];
+
+	/* The workers map this file (cryptor_libssl_cache.c). It is
+	 * unlinked right away: they inherit the descriptor instead.
+	 */
+	snprintf (name, sizeof(name), TMPDIR "/cherokee-tls-cache-%d", getpid());
+
+	fd = open (name, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+	if (fd < 0) {
+		PRINT_MSG ("(warning) Couldn't create '%s': %s\n", name, strerror(errno));
+		return;
+	}
+
+	unlink (name);
+
+	snprintf (num, sizeof(num), "%d", fd);
+	setenv (CHEROKEE_SHM_TLS_CACHE_ENV, num, 1);
+}
+
 static void
 clean_up (void)
 {
@@ -1067,6 +1092,10 @@ main (int argc, char *argv[])
 	}
 #endif
 
+	if (! single_time) {
+		tls_cache_init();
+	}
+
 	while (true) {
 		graceful_restart = false;
 
@@ -33,6 +33,7 @@
 #include "info.h"
 #include "server-protected.h"
 #include "util.h"
+#include "shm.h"
 #include "ab.h"
 
 #ifdef HAVE_SYS_WAIT_H
@@ -174,6 +175,28 @@ test_configuration_file (void)
 }
 
 
+static void
+close_tls_cache_fd (void)
+{
+	int   fd;
+	char *env;
+
+	/* The TLS session cache descriptor handed over by the
+	 * supervisor, if the configuration did not make use of it.
+	 * It must not be inherited by the CGIs.
+	 */
+	env = getenv (CHEROKEE_SHM_TLS_CACHE_ENV);
+	if (env == NULL)
+		return;
+
+	fd = atoi (env);
+	if (fd > STDERR_FILENO) {
+		cherokee_fd_close (fd);
+	}
+
+	unsetenv (CHEROKEE_SHM_TLS_CACHE_ENV);
+}
+
 static ret_t
 common_server_initialization (cherokee_server_t *srv)
 {
@@ -255,6 +278,8 @@ common_server_initialization (cherokee_server_t *srv)
 		}
 	}
 
+	close_tls_cache_fd();
+
 	if (daemon_mode)
 		cherokee_server_daemonize (srv);
 
@@ -29,12 +29,183 @@
 
 #define ENTRIES "regex"
 
+/* JIT compilation needs a system PCRE 8.20 or newer. The bundled
+ * pcre.h is older, so the interface is declared here as weak
+ * symbols: they are NULL when the library does not provide them.
+ */
+#if defined(HAVE_PCRE_STUDY) && defined(__GNUC__) && defined(HAVE_PTHREAD)
+# define HAVE_PCRE_JIT
+
+# define PCRE_STUDY_JIT_COMPILE 0x0001
+# define JIT_STACK_MIN          (32 * 1024)
+# define JIT_STACK_MAX          (512 * 1024)
+
+typedef struct real_pcre_jit_stack pcre_jit_stack;
+typedef pcre_jit_stack *(*pcre_jit_callback)(void *);
+
+extern void            pcre_free_study       (pcre_extra *) __attribute__((weak));
+extern pcre_jit_stack *pcre_jit_stack_alloc  (int, int) __attribute__((weak));
+extern void            pcre_jit_stack_free   (pcre_jit_stack *) __attribute__((weak));
+extern void            pcre_assign_jit_stack (pcre_extra *, pcre_jit_callback, void *) __attribute__((weak));
+
+# define JIT_AVAILABLE ((pcre_assign_jit_stack != NULL) && \
+			(pcre_jit_stack_alloc  != NULL) && \
+			(pcre_jit_stack_free   != NULL) && \
+			(pcre_free_study       != NULL))
+#endif
+
+#if defined(__GNUC__)
+# define COUNT(var) __sync_fetch_and_add (&(var), 1)
+#else
+# define COUNT(var) ((var) += 1)
+#endif
+
 struct cherokee_regex_table {
 	cherokee_avl_t      cache;
 	CHEROKEE_RWLOCK_T  (rwlock);
 };
 
 
+#ifdef HAVE_PCRE_JIT
+/* JIT stacks: the default one is 32K of the machine stack, too
+ * small for some patterns. Every thread allocates a larger one the
+ * first time it needs it, and reuses it for all the patterns.
+ */
+static pthread_key_t  jit_stack_key;
+static pthread_once_t jit_stack_once = PTHREAD_ONCE_INIT;
+
+static void
+jit_stack_free (void *stack)
+{
+	pcre_jit_stack_free (stack);
+}
+
+static void
+jit_stack_key_new (void)
+{
+	pthread_key_create (&jit_stack_key, jit_stack_free);
+}
+
+static pcre_jit_stack *
+jit_stack_get (void *param)
+{
+	pcre_jit_stack *stack;
+
+	UNUSED (param);
+
+	stack = CHEROKEE_THREAD_PROP_GET (jit_stack_key);
+	if (unlikely (stack == NULL)) {
+		stack = pcre_jit_stack_alloc (JIT_STACK_MIN, JIT_STACK_MAX);
+		CHEROKEE_THREAD_PROP_SET (jit_stack_key, stack);
+	}
+
+	/* With no stack, PCRE falls back to 32K of the machine stack
+	 */
+	return stack;
+}
+#endif
+
+
+/* Literal text the subject has to start with in order to match
+ * the pattern, if any. It lets most of the mismatches skip
+ * pcre_exec(). Only simple anchored patterns are considered.
+ */
+static void
+literal_prefix (const char *pattern, cherokee_buffer_t *prefix)
+{
+	const char *p;
+
+	if ((pattern[0] != '^') ||
+	    (strchr (pattern, '|') != NULL))
+		return;
+
+	for (p = pattern + 1; *p != '\0'; p++) {
+		if (strchr ("\\^$.[]()?*+{}", *p) != NULL)
+			break;
+	}
+
+	cherokee_buffer_add (prefix, pattern + 1, p - (pattern + 1));
+
+	/* A quantifier applies to the last literal character
+	 */
+	if ((*p == '?') || (*p == '*') || (*p == '+') || (*p == '{')) {
+		cherokee_buffer_drop_ending (prefix, 1);
+	}
+}
+
+
+static cherokee_regex_t *
+regex_new (char *pattern)
+{
+	const char       *error_msg;
+	int               error_offset;
+	cherokee_regex_t *n;
+
+	n = (cherokee_regex_t *) malloc (sizeof(cherokee_regex_t));
+	if (unlikely (n == NULL))
+		return NULL;
+
+	n->extra   = NULL;
+	n->matches = 0;
+	n->misses  = 0;
+	cherokee_buffer_init (&n->prefix);
+
+	n->re = pcre_compile (pattern, 0, &error_msg, &error_offset, NULL);
+	if (n->re == NULL) {
+		LOG_ERROR (CHEROKEE_ERROR_REGEX_COMPILATION, pattern, error_msg, error_offset);
+		free (n);
+		return NULL;
+	}
+
+#ifdef HAVE_PCRE_STUDY
+	/* Study it, and compile it to machine code if possible
+	 */
+	error_msg = NULL;
+# ifdef HAVE_PCRE_JIT
+	if (JIT_AVAILABLE) {
+		n->extra = pcre_study (n->re, PCRE_STUDY_JIT_COMPILE, &error_msg);
+		if (n->extra != NULL) {
+			pthread_once (&jit_stack_once, jit_stack_key_new);
+			pcre_assign_jit_stack (n->extra, jit_stack_get, NULL);
+		}
+	} else
+# endif
+		n->extra = pcre_study (n->re, 0, &error_msg);
+
+	if (error_msg != NULL) {
+		TRACE (ENTRIES, "Could not study '%s': %s\n", pattern, error_msg);
+	}
+#endif
+
+	literal_prefix (pattern, &n->prefix);
+
+	TRACE (ENTRIES, "Compiled '%s' (studied=%d, prefix='%s')\n",
+	       pattern, (n->extra != NULL), n->prefix.buf ? n->prefix.buf : "");
+
+	return n;
+}
+
+
+static void
+regex_free (void *param)
+{
+	cherokee_regex_t *regex = param;
+
+	if (regex->extra != NULL) {
+#ifdef HAVE_PCRE_JIT
+		if (JIT_AVAILABLE)
+			pcre_free_study (regex->extra);
+		else
+#endif
+			pcre_free (regex->extra);
+	}
+
+	pcre_free (regex->re);
+	cherokee_buffer_mrproper (&regex->prefix);
+	free (regex);
+}
+
+
 ret_t
 cherokee_regex_table_new  (cherokee_regex_table_t **table)
 {
@@ -57,7 +228,7 @@ cherokee_regex_table_free (cherokee_regex_table_t *table)
 {
 	CHEROKEE_RWLOCK_DESTROY (&table->rwlock);
 
-	cherokee_avl_mrproper (&table->cache, free);
+	cherokee_avl_mrproper (&table->cache, regex_free);
 
 	free(table);
 	return ret_ok;
@@ -67,10 +238,8 @@ cherokee_regex_table_free (cherokee_regex_table_t *table)
 static ret_t
 _add (cherokee_regex_table_t *table, char *pattern, void **regex)
 {
-	ret_t      ret;
-	const char *error_msg;
-	int         error_offset;
-	void       *tmp           = NULL;
+	ret_t  ret;
+	void  *tmp = NULL;
 
 	/* It wasn't in the cache. Lets go to compile the pattern..
 	 * First of all, we have to check again the table because another
@@ -87,9 +256,8 @@ _add (cherokee_regex_table_t *table, char *pattern, void **regex)
 		return ret_ok;
 	}
 
-	tmp = pcre_compile (pattern, 0, &error_msg, &error_offset, NULL);
+	tmp = regex_new (pattern);
 	if (tmp == NULL) {
-		LOG_ERROR (CHEROKEE_ERROR_REGEX_COMPILATION, pattern, error_msg, error_offset);
 		CHEROKEE_RWLOCK_UNLOCK (&table->rwlock);
 		return ret_error;
 	}
@@ -130,6 +298,52 @@ cherokee_regex_table_add (cherokee_regex_table_t *table, char *pattern)
 }
 
 
+ret_t
+cherokee_regex_table_while (cherokee_regex_table_t    *table,
+			    cherokee_avl_while_func_t  func,
+			    void                      *param)
+{
+	ret_t ret;
+
+	CHEROKEE_RWLOCK_READER (&table->rwlock);
+	ret = cherokee_avl_while (&table->cache, func, param, NULL, NULL);
+	CHEROKEE_RWLOCK_UNLOCK (&table->rwlock);
+
+	return ret;
+}
+
+
+/* RegEx matching
+ */
+
+cint_t
+cherokee_regex_exec (cherokee_regex_t *regex,
+		     const char       *subject,
+		     cint_t            length,
+		     cint_t           *ovector,
+		     cint_t            ovecsize)
+{
+	cint_t re;
+
+	if ((regex->prefix.len > 0) &&
+	    (((cuint_t) length < regex->prefix.len) ||
+	     (memcmp (subject, regex->prefix.buf, regex->prefix.len) != 0)))
+	{
+		COUNT (regex->misses);
+		return PCRE_ERROR_NOMATCH;
+	}
+
+	re = pcre_exec (regex->re, regex->extra, subject, length, 0, 0, ovector, ovecsize);
+
+	if (re >= 0)
+		COUNT (regex->matches);
+	else
+		COUNT (regex->misses);
+
+	return re;
+}
+
+
 /* RegEx lists
  */
 
@@ -142,7 +356,7 @@ configure_rewrite_entry (cherokee_list_t        *list,
 	cherokee_regex_entry_t *n;
 	cherokee_buffer_t      *substring;
 	cint_t                  hidden     = 1;
-	pcre                   *re         = NULL;
+	cherokee_regex_t       *re         = NULL;
 	cherokee_buffer_t      *regex      = NULL;
 
 	TRACE(ENTRIES, "Converting rewrite rule '%s'\n", conf->key.buf);
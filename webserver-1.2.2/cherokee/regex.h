@@ -33,6 +33,7 @@
 #include <cherokee/list.h>
 #include <cherokee/buffer.h>
 #include <cherokee/config_node.h>
+#include <cherokee/avl.h>
 #include <pcre/pcre.h>
 
 CHEROKEE_BEGIN_DECLS
@@ -43,20 +44,39 @@ CHEROKEE_BEGIN_DECLS
 typedef struct cherokee_regex_table cherokee_regex_table_t;
 #define REGEX(x) ((cherokee_regex_table_t *)(x))
 
+/* Compiled pattern, owned by the table
+ */
+typedef struct {
+	pcre              *re;
+	pcre_extra        *extra;
+	cherokee_buffer_t  prefix;
+	culong_t           matches;
+	culong_t           misses;
+} cherokee_regex_t;
+
 /* RegEx table
  */
 ret_t cherokee_regex_table_new   (cherokee_regex_table_t **table);
 ret_t cherokee_regex_table_free  (cherokee_regex_table_t  *table);
 ret_t cherokee_regex_table_clean (cherokee_regex_table_t  *table);
 
-ret_t cherokee_regex_table_get  (cherokee_regex_table_t *table, char *pattern, void **pcre);
-ret_t cherokee_regex_table_add  (cherokee_regex_table_t *table, char *pattern);
+ret_t cherokee_regex_table_get   (cherokee_regex_table_t *table, char *pattern, void **regex);
+ret_t cherokee_regex_table_add   (cherokee_regex_table_t *table, char *pattern);
+ret_t cherokee_regex_table_while (cherokee_regex_table_t *table, cherokee_avl_while_func_t func, void *param);
+
+/* RegEx matching
+ */
+cint_t cherokee_regex_exec (cherokee_regex_t *regex,
+			    const char       *subject,
+			    cint_t            length,
+			    cint_t           *ovector,
+			    cint_t            ovecsize);
 
 /* RegEx lists
  */
 typedef struct {
 	cherokee_list_t    listed;
-	pcre              *re;
+	cherokee_regex_t  *re;
 	char               hidden;
 	cherokee_buffer_t  subs;
 } cherokee_regex_entry_t;
@@ -67,11 +67,10 @@ match (cherokee_rule_request_t *rule,
 
 	/* Evaluate the pcre
 	 */
-	re = pcre_exec (rule->pcre, NULL,
-			conn->request.buf,
-			conn->request.len,
-			0, 0,
-			conn->regex_ovector, OVECTOR_LEN);
+	re = cherokee_regex_exec (rule->pcre,
+				  conn->request.buf,
+				  conn->request.len,
+				  conn->regex_ovector, OVECTOR_LEN);
 
 	if (re < 0) {
 		TRACE (ENTRIES, "Request \"%s\" didn't match with \"%s\"\n",
@@ -44,9 +44,7 @@ check_argument (cherokee_rule_url_arg_t *rule,
 
 	/* Check whether it matches
 	 */
-	re = pcre_exec (rule->pcre, NULL,
-			value->buf, value->len,
-			0, 0, NULL, 0);
+	re = cherokee_regex_exec (rule->pcre, value->buf, value->len, NULL, 0);
 
 	if (re < 0) {
 		TRACE (ENTRIES, "Parameter value '%s' didn't match with '%s'\n",
@@ -35,6 +35,36 @@
 
 #define ENTRIES "shm"
 
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
+
+/* Only map files owned by this user, and not accessible by anybody
+ * else. Otherwise, their content could be read or forged.
+ */
+static ret_t
+check_file (int fd, struct stat *info)
+{
+	int re;
+
+	re = cherokee_fstat (fd, info);
+	if (re != 0) {
+		return ret_error;
+	}
+
+	if ((! S_ISREG (info->st_mode)) ||
+	    (info->st_uid != geteuid()) ||
+	    ((info->st_mode & (S_IRWXG | S_IRWXO)) != 0))
+	{
+		TRACE (ENTRIES, "Refusing to map fd=%d: uid=%d mode=%o\n",
+		       fd, info->st_uid, info->st_mode);
+		return ret_deny;
+	}
+
+	return ret_ok;
+}
+
 ret_t
 cherokee_shm_init (cherokee_shm_t *shm)
 {
@@ -65,7 +95,7 @@ cherokee_shm_create (cherokee_shm_t *shm, char *name, size_t len)
 	int re;
 	int fd;
 
-	fd = open (name, O_RDWR | O_EXCL | O_CREAT, 0600);
+	fd = open (name, O_RDWR | O_EXCL | O_CREAT | O_NOFOLLOW, 0600);
 	if (fd < 0) {
 		return ret_error;
 	}
@@ -96,17 +126,18 @@ ret_t
 cherokee_shm_map (cherokee_shm_t    *shm,
 		  cherokee_buffer_t *name)
 {
-	int         re;
+	ret_t       ret;
 	int         fd;
 	struct stat info;
 
-	fd = open (name->buf, O_RDWR, 0600);
+	fd = open (name->buf, O_RDWR | O_NOFOLLOW);
 	if (fd < 0) {
 		return ret_error;
 	}
 
-	re = cherokee_fstat (fd, &info);
-	if (re != 0) {
+	ret = check_file (fd, &info);
+	if (ret != ret_ok) {
+		cherokee_fd_close (fd);
 		return ret_error;
 	}
 
@@ -119,9 +150,70 @@ cherokee_shm_map (cherokee_shm_t    *shm,
 
 	cherokee_fd_close (fd);
 
+	shm->len = info.st_size;
+
 	cherokee_buffer_clean      (&shm->name);
 	cherokee_buffer_add_buffer (&shm->name, name);
 
 	TRACE (ENTRIES, "SHM (mmap: '%s', size: %d) opened\n", name->buf, info.st_size);
 	return ret_ok;
 }
+
+
+ret_t
+cherokee_shm_map_fd (cherokee_shm_t *shm, int fd, size_t len)
+{
+	int         re;
+	ret_t       ret;
+	struct stat info;
+
+	ret = check_file (fd, &info);
+	if (ret != ret_ok) {
+		return ret_error;
+	}
+
+	/* An empty file is sized up by its first user
+	 */
+	if (info.st_size == 0) {
+		re = ftruncate (fd, len);
+		if (re < 0) {
+			return ret_error;
+		}
+	} else if ((size_t) info.st_size != len) {
+		TRACE (ENTRIES, "SHM (fd: %d) size %d, expected %d\n", fd, info.st_size, len);
+		return ret_deny;
+	}
+
+	shm->mem = mmap (0, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm->mem == MAP_FAILED) {
+		shm->mem = NULL;
+		return ret_error;
+	}
+
+	shm->len = len;
+
+	TRACE (ENTRIES, "SHM (fd: %d, len: %d) mapped\n", fd, len);
+	return ret_ok;
+}
+
+
+ret_t
+cherokee_shm_create_anonymous (cherokee_shm_t *shm, size_t len)
+{
+#ifdef MAP_ANONYMOUS
+	shm->mem = mmap (0, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shm->mem == MAP_FAILED) {
+		shm->mem = NULL;
+		return ret_error;
+	}
+
+	shm->len = len;
+
+	TRACE (ENTRIES, "SHM (anonymous, len: %d) created\n", len);
+	return ret_ok;
+#else
+	UNUSED (shm);
+	UNUSED (len);
+	return ret_not_found;
+#endif
+}
@@ -36,6 +36,11 @@
 
 CHEROKEE_BEGIN_DECLS
 
+/* Descriptor of the TLS session cache file, passed from the
+ * supervisor to its workers
+ */
+#define CHEROKEE_SHM_TLS_CACHE_ENV "CHEROKEE_TLS_CACHE_FD"
+
 typedef struct {
 	size_t             len;
 	void              *mem;
@@ -52,6 +57,8 @@ ret_t cherokee_shm_init      (cherokee_shm_t *shm);
 ret_t cherokee_shm_mrproper  (cherokee_shm_t *shm);
 ret_t cherokee_shm_create    (cherokee_shm_t *shm, char *name, size_t len);
 ret_t cherokee_shm_map       (cherokee_shm_t *shm, cherokee_buffer_t *name);
+ret_t cherokee_shm_map_fd    (cherokee_shm_t *shm, int fd, size_t len);
+ret_t cherokee_shm_create_anonymous (cherokee_shm_t *shm, size_t len);
 
 CHEROKEE_END_DECLS
 
@@ -980,6 +980,10 @@ cherokee_socket_writev (cherokee_socket_t  *socket,
 		cnt = 0;
 		ret = cherokee_socket_write (socket, vector[i].iov_base, vector[i].iov_len, &cnt);
 		if (ret != ret_ok) {
+			/* Report the previous iovecs as a partial write
+			 */
+			if ((ret == ret_eagain) && (*pcnt_written > 0))
+				return ret_ok;
 			return ret;
 		}
 
@@ -0,0 +1,235 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "access.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <arpa/inet.h>
+
+#define PREFIXES 2000
+#define LOOKUPS  200000
+
+typedef struct {
+	int           family;
+	unsigned char addr[16];
+	int           bits;
+} prefix_t;
+
+static prefix_t prefixes[PREFIXES];
+
+
+static void
+random_addr (unsigned char *addr, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		addr[i] = rand() & 0xff;
+	}
+
+	/* Keep the addresses close to each other, so prefixes nest
+	 */
+	addr[0] = 10;
+	addr[1] &= 0x3;
+}
+
+static int
+prefix_contains (prefix_t *p, int family, unsigned char *addr)
+{
+	int i;
+	int bits = p->bits;
+
+	if (p->family != family)
+		return 0;
+
+	for (i = 0; bits >= 8; i++, bits -= 8) {
+		if (p->addr[i] != addr[i])
+			return 0;
+	}
+
+	if (bits > 0) {
+		unsigned char mask = 0xFF << (8 - bits);
+		return ((p->addr[i] ^ addr[i]) & mask) == 0;
+	}
+
+	return 1;
+}
+
+static int
+reference_match (int family, unsigned char *addr)
+{
+	int i;
+
+	for (i = 0; i < PREFIXES; i++) {
+		if (prefix_contains (&prefixes[i], family, addr))
+			return 1;
+	}
+
+	return 0;
+}
+
+static void
+set_socket (cherokee_socket_t *sock, int family, unsigned char *addr)
+{
+	memset (&sock->client_addr, 0, sizeof(sock->client_addr));
+	SOCKET_AF(sock) = family;
+
+	if (family == AF_INET) {
+		memcpy (&SOCKET_ADDR_IPv4(sock)->sin_addr, addr, 4);
+	} else {
+		memcpy (&SOCKET_ADDR_IPv6(sock)->sin6_addr, addr, 16);
+	}
+}
+
+static int
+check (cherokee_access_t *access, cherokee_socket_t *sock, int family, unsigned char *addr)
+{
+	ret_t ret;
+	int   expected;
+	char  str[INET6_ADDRSTRLEN];
+
+	set_socket (sock, family, addr);
+
+	expected = reference_match (family, addr);
+	ret      = cherokee_access_ip_match (access, sock);
+
+	if ((ret == ret_ok) != expected) {
+		inet_ntop (family, addr, str, sizeof(str));
+		printf ("FAIL: %s: matched=%d expected=%d\n", str, (ret == ret_ok), expected);
+		return 1;
+	}
+
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	int                i;
+	int                re = 0;
+	ret_t              ret;
+	prefix_t          *p;
+	unsigned char      addr[16];
+	char               str[INET6_ADDRSTRLEN + 8];
+	cherokee_socket_t  sock;
+	cherokee_access_t  access;
+
+	UNUSED (argc);
+	UNUSED (argv);
+
+	srand (1978);
+	cherokee_access_init (&access);
+
+	/* Random IPv4 and IPv6 prefixes and hosts
+	 */
+	for (i = 0; i < PREFIXES; i++) {
+		p = &prefixes[i];
+		memset (p->addr, 0, sizeof(p->addr));
+
+		if (i % 2) {
+			p->family = AF_INET;
+			p->bits   = 8 + rand() % 25;
+			random_addr (p->addr, 4);
+		} else {
+			p->family = AF_INET6;
+			p->bits   = 8 + rand() % 121;
+			random_addr (p->addr, 16);
+		}
+
+		inet_ntop (p->family, p->addr, str, INET6_ADDRSTRLEN);
+		sprintf (str + strlen(str), "/%d", p->bits);
+
+		ret = cherokee_access_add (&access, str);
+		if (ret != ret_ok) {
+			printf ("FAIL: could not add %s\n", str);
+			return 1;
+		}
+	}
+
+	/* Addresses in and around the prefixes
+	 */
+	for (i = 0; (i < LOOKUPS) && (re == 0); i++) {
+		p = &prefixes[rand() % PREFIXES];
+
+		memcpy (addr, p->addr, 16);
+		if (i % 3) {
+			addr[rand() % ((p->family == AF_INET) ? 4 : 16)] ^= 1 << (rand() % 8);
+		}
+
+		re |= check (&access, &sock, p->family, addr);
+	}
+
+	if (re == 0) {
+		printf ("%d random lookups OK\n", LOOKUPS);
+	}
+
+	/* IPv4 addresses mapped in IPv6 sockets
+	 */
+	for (i = 0; (i < 1000) && (re == 0); i++) {
+		p = &prefixes[2 * (rand() % (PREFIXES / 2)) + 1];
+
+		memset (addr, 0, 16);
+		addr[10] = 0xFF;
+		addr[11] = 0xFF;
+		memcpy (addr + 12, p->addr, 4);
+
+		set_socket (&sock, AF_INET6, addr);
+		if (cherokee_access_ip_match (&access, &sock) != ret_ok) {
+			printf ("FAIL: IPv4 mapped address did not match\n");
+			re = 1;
+		}
+	}
+
+	cherokee_access_mrproper (&access);
+
+	/* Non contiguous masks and the catch-all prefix
+	 */
+	cherokee_access_init (&access);
+	cherokee_access_add (&access, "192.0.2.0/255.0.255.0");
+
+	memcpy (addr, "\xc0\x07\x02\x09", 4);
+	set_socket (&sock, AF_INET, addr);
+	if (cherokee_access_ip_match (&access, &sock) != ret_ok) {
+		printf ("FAIL: non contiguous mask\n");
+		re = 1;
+	}
+
+	memcpy (addr, "\xc0\x07\x03\x09", 4);
+	set_socket (&sock, AF_INET, addr);
+	if (cherokee_access_ip_match (&access, &sock) != ret_not_found) {
+		printf ("FAIL: non contiguous mask mismatch\n");
+		re = 1;
+	}
+
+	cherokee_access_add (&access, "0.0.0.0/0");
+	if (cherokee_access_ip_match (&access, &sock) != ret_ok) {
+		printf ("FAIL: catch-all prefix\n");
+		re = 1;
+	}
+
+	cherokee_access_mrproper (&access);
+	return re;
+}
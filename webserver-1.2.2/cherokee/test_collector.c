@@ -0,0 +1,216 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "collector.h"
+#include "threading.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#define THREADS  8
+#define ROUNDS   100000
+#define RX       3
+#define TX       5
+
+static cherokee_collector_t      *srv;
+static cherokee_collector_vsrv_t *vsrv;
+static volatile int               running;
+static int                        finished;
+
+
+/* Worker: logs its requests and traffic
+ */
+static void *
+worker (void *arg)
+{
+	int i;
+
+	UNUSED (arg);
+
+	for (i = 0; i < ROUNDS; i++) {
+		cherokee_collector_log_accept  (srv);
+		cherokee_collector_log_request (srv);
+		cherokee_collector_vsrv_count  (vsrv, RX, TX);
+
+		if ((i % 1000) == 0) {
+			cherokee_collector_log_timeout (srv);
+		}
+	}
+
+	__sync_fetch_and_add (&finished, 1);
+	return NULL;
+}
+
+/* Server-info: merges the vserver counters while they are being
+ * reported and reset.
+ */
+static void *
+reader (void *arg)
+{
+	UNUSED (arg);
+
+	while (running) {
+		cherokee_collector_vsrv_sync (vsrv);
+		cherokee_collector_sync (srv);
+	}
+
+	return NULL;
+}
+
+/* rrdtool: reports the partial counters and consumes them
+ */
+static void
+report (cherokee_collector_partial_t *srv_total,
+	cherokee_collector_partial_t *vsrv_total)
+{
+	cherokee_collector_partial_t partial;
+
+	cherokee_collector_sync_partial (srv, &partial);
+	srv_total->accepts  += partial.accepts;
+	srv_total->requests += partial.requests;
+	srv_total->timeouts += partial.timeouts;
+	srv_total->rx       += partial.rx;
+	srv_total->tx       += partial.tx;
+	cherokee_collector_consume_partial (srv, &partial);
+
+	cherokee_collector_vsrv_sync_partial (vsrv, &partial);
+	vsrv_total->rx      += partial.rx;
+	vsrv_total->tx      += partial.tx;
+	cherokee_collector_vsrv_consume_partial (vsrv, &partial);
+}
+
+int
+main (int argc, char *argv[])
+{
+	int                          i;
+	int                          fails = 0;
+	pthread_t                    workers[THREADS];
+	pthread_t                    info;
+	cherokee_collector_partial_t srv_total;
+	cherokee_collector_partial_t vsrv_total;
+	const cullong_t              requests  = (cullong_t) THREADS * ROUNDS;
+	const cullong_t              timeouts  = (cullong_t) THREADS * (ROUNDS / 1000);
+
+	UNUSED (argc);
+	UNUSED (argv);
+
+	cherokee_threading_init();
+
+	srv  = calloc (1, sizeof(cherokee_collector_t));
+	vsrv = calloc (1, sizeof(cherokee_collector_vsrv_t));
+	if ((srv == NULL) || (vsrv == NULL)) {
+		return 1;
+	}
+
+	cherokee_collector_init_base (srv, NULL, NULL);
+	cherokee_collector_vsrv_init_base (vsrv, NULL);
+	vsrv->srv_collector = srv;
+
+	memset (&srv_total,  0, sizeof(srv_total));
+	memset (&vsrv_total, 0, sizeof(vsrv_total));
+
+	/* Log from several threads while the counters are merged,
+	 * reported and reset.
+	 */
+	running = 1;
+	pthread_create (&info, NULL, reader, NULL);
+
+	for (i = 0; i < THREADS; i++) {
+		pthread_create (&workers[i], NULL, worker, NULL);
+	}
+
+	while (__sync_fetch_and_add (&finished, 0) < THREADS) {
+		report (&srv_total, &vsrv_total);
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		pthread_join (workers[i], NULL);
+	}
+
+	running = 0;
+	pthread_join (info, NULL);
+
+	report (&srv_total, &vsrv_total);
+
+	/* Merged totals
+	 */
+	cherokee_collector_sync (srv);
+	cherokee_collector_vsrv_sync (vsrv);
+
+	if ((srv->accepts  != requests) ||
+	    (srv->requests != requests) ||
+	    (srv->timeouts != timeouts))
+	{
+		printf ("FAIL: server counted %llu accepts, %llu requests, %llu timeouts\n",
+			srv->accepts, srv->requests, srv->timeouts);
+		fails++;
+	}
+
+	if ((COLLECTOR_RX(srv)  != (off_t) (requests * RX)) ||
+	    (COLLECTOR_TX(srv)  != (off_t) (requests * TX)) ||
+	    (COLLECTOR_RX(vsrv) != (off_t) (requests * RX)) ||
+	    (COLLECTOR_TX(vsrv) != (off_t) (requests * TX)))
+	{
+		printf ("FAIL: traffic rx=%llu/%llu tx=%llu/%llu\n",
+			(cullong_t) COLLECTOR_RX(srv), (cullong_t) COLLECTOR_RX(vsrv),
+			(cullong_t) COLLECTOR_TX(srv), (cullong_t) COLLECTOR_TX(vsrv));
+		fails++;
+	}
+
+	/* Reported partials: nothing lost, nothing reported twice
+	 */
+	if ((srv_total.accepts  != requests) ||
+	    (srv_total.requests != requests) ||
+	    (srv_total.timeouts != timeouts) ||
+	    (srv_total.rx       != (off_t) (requests * RX)) ||
+	    (srv_total.tx       != (off_t) (requests * TX)))
+	{
+		printf ("FAIL: server reported %llu accepts, %llu requests, %llu timeouts\n",
+			srv_total.accepts, srv_total.requests, srv_total.timeouts);
+		fails++;
+	}
+
+	if ((vsrv_total.rx != (off_t) (requests * RX)) ||
+	    (vsrv_total.tx != (off_t) (requests * TX)))
+	{
+		printf ("FAIL: vserver reported rx=%llu tx=%llu\n",
+			(cullong_t) vsrv_total.rx, (cullong_t) vsrv_total.tx);
+		fails++;
+	}
+
+	if ((COLLECTOR_RX_PARTIAL(vsrv) != 0) ||
+	    (COLLECTOR_TX_PARTIAL(vsrv) != 0))
+	{
+		printf ("FAIL: vserver partials left after the last report\n");
+		fails++;
+	}
+
+	printf ("%d threads x %d requests, %d failed\n", THREADS, ROUNDS, fails);
+
+	cherokee_collector_vsrv_free (vsrv);
+	cherokee_collector_free (srv);
+	return (fails > 0);
+}
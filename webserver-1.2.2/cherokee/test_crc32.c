@@ -0,0 +1,105 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "crc32.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BUF_LEN  (1024 * 1024 + 64)
+#define ROUNDS   2000
+
+static int
+check_random (char *buf, const char *impl)
+{
+	int   i;
+	int   off;
+	int   len;
+	int   split;
+	crc_t crc;
+	crc_t ref;
+
+	for (i = 0; i < ROUNDS; i++) {
+		off = rand() % 16;
+		len = (i < ROUNDS - 10) ? rand() % 4096 : rand() % (BUF_LEN - 16);
+
+		ref = crc32_partial_sz_ref (0, buf + off, len);
+
+		/* One shot */
+		crc = crc32_sz (buf + off, len);
+		if (crc != ref) {
+			printf ("FAIL (%s): off=%d len=%d crc=%08x ref=%08x\n", impl, off, len, crc, ref);
+			return 1;
+		}
+
+		/* Two chunks */
+		split = (len > 0) ? rand() % len : 0;
+		crc = crc32_partial_sz (0,   buf + off,         split);
+		crc = crc32_partial_sz (crc, buf + off + split, len - split);
+		if (crc != ref) {
+			printf ("FAIL (%s): off=%d len=%d split=%d crc=%08x ref=%08x\n", impl, off, len, split, crc, ref);
+			return 1;
+		}
+	}
+
+	printf ("%s: %d random buffers OK\n", impl, ROUNDS);
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	int   i;
+	int   re  = 0;
+	char *buf;
+
+	UNUSED (argc);
+	UNUSED (argv);
+
+	/* Check value of the algorithm */
+	if (crc32_sz ("123456789", 9) != 0xcbf43926) {
+		printf ("FAIL: check value %08x\n", crc32_sz ("123456789", 9));
+		return 1;
+	}
+
+	buf = malloc (BUF_LEN);
+	if (buf == NULL) {
+		return 1;
+	}
+
+	srand (1978);
+	for (i = 0; i < BUF_LEN; i++) {
+		buf[i] = rand() & 0xff;
+	}
+
+	/* Default implementation, and then the one chosen for this CPU */
+	re |= check_random (buf, "slicing-by-8");
+
+	crc32_init();
+	re |= check_random (buf, "runtime selected");
+
+	free (buf);
+	return re;
+}
@@ -0,0 +1,311 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "cryptor_libssl_cache.h"
+#include "bogotime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define SHARDS     16
+#define PER_SHARD  4
+#define BIG        (SHARDS * 64)
+#define ID_LEN     32
+#define DER_LEN    100
+
+static int fails = 0;
+static int tests = 0;
+
+#define CHECK(cond, msg)						\
+	do {								\
+		tests++;						\
+		if (! (cond)) {						\
+			printf ("FAIL: %s (line %d)\n", msg, __LINE__);	\
+			fails++;					\
+		}							\
+	} while (0)
+
+
+static void
+make_id (unsigned char *id, cuint_t n)
+{
+	cuint_t i;
+
+	for (i = 0; i < ID_LEN; i++) {
+		id[i] = (unsigned char) ((n * 31 + i * 7) ^ (n >> 8));
+	}
+}
+
+static void
+make_der (unsigned char *der, cuint_t n)
+{
+	cuint_t i;
+
+	for (i = 0; i < DER_LEN; i++) {
+		der[i] = (unsigned char) (n + i);
+	}
+}
+
+static ret_t
+store (cherokee_cryptor_libssl_cache_t *cache, cuint_t n, time_t expire)
+{
+	unsigned char id[ID_LEN];
+	unsigned char der[DER_LEN];
+
+	make_id  (id, n);
+	make_der (der, n);
+
+	return cherokee_cryptor_libssl_cache_store (cache, id, ID_LEN, der, DER_LEN, expire);
+}
+
+/* ret_ok only if the session is there, with its own content
+ */
+static ret_t
+fetch (cherokee_cryptor_libssl_cache_t *cache, cuint_t n)
+{
+	ret_t         ret;
+	cuint_t       len = 0;
+	unsigned char id[ID_LEN];
+	unsigned char der[DER_LEN];
+	unsigned char got[CRYPTOR_LIBSSL_CACHE_DER_MAX];
+
+	make_id  (id, n);
+	make_der (der, n);
+
+	ret = cherokee_cryptor_libssl_cache_fetch (cache, id, ID_LEN, got, &len);
+	if (ret != ret_ok) {
+		return ret;
+	}
+
+	if ((len != DER_LEN) || (memcmp (got, der, DER_LEN) != 0)) {
+		return ret_error;
+	}
+
+	return ret_ok;
+}
+
+
+static void
+test_store_lookup (cherokee_cryptor_libssl_cache_t *cache)
+{
+	cuint_t                               i;
+	unsigned char                         id[ID_LEN];
+	cherokee_cryptor_libssl_cache_stats_t stats;
+
+	for (i = 0; i < SHARDS; i++) {
+		CHECK (store (cache, i, 2000) == ret_ok, "store");
+	}
+
+	for (i = 0; i < SHARDS; i++) {
+		CHECK (fetch (cache, i) == ret_ok, "lookup of a stored session");
+	}
+
+	CHECK (fetch (cache, 9999) == ret_not_found, "lookup of an unknown session");
+
+	/* Storing it again replaces it
+	 */
+	CHECK (store (cache, 0, 2000) == ret_ok, "store again");
+	CHECK (fetch (cache, 0) == ret_ok, "lookup of a replaced session");
+
+	/* Removal
+	 */
+	make_id (id, 1);
+	CHECK (cherokee_cryptor_libssl_cache_remove (cache, id, ID_LEN) == ret_ok, "remove");
+	CHECK (cherokee_cryptor_libssl_cache_remove (cache, id, ID_LEN) == ret_not_found, "remove twice");
+	CHECK (fetch (cache, 1) == ret_not_found, "lookup of a removed session");
+
+	/* Sessions that do not fit are refused
+	 */
+	CHECK (cherokee_cryptor_libssl_cache_store (cache, id, ID_LEN, id,
+						    CRYPTOR_LIBSSL_CACHE_DER_MAX + 1, 2000) == ret_error,
+	       "oversized session");
+
+	cherokee_cryptor_libssl_cache_get_stats (cache, &stats);
+	CHECK (stats.used   == SHARDS - 1,  "used entries");
+	CHECK (stats.stores == SHARDS + 1,  "store counter");
+	CHECK (stats.hits   == SHARDS + 1,  "hit counter");
+	CHECK (stats.misses == 2,           "miss counter");
+}
+
+static void
+test_expiry (cherokee_cryptor_libssl_cache_t *cache)
+{
+	cherokee_cryptor_libssl_cache_stats_t before;
+	cherokee_cryptor_libssl_cache_stats_t after;
+
+	cherokee_bogonow_now = 1000;
+	CHECK (store (cache, 100, 1010) == ret_ok, "store");
+	CHECK (fetch (cache, 100) == ret_ok, "lookup before the expiration");
+
+	cherokee_cryptor_libssl_cache_get_stats (cache, &before);
+
+	cherokee_bogonow_now = 1011;
+	CHECK (fetch (cache, 100) == ret_not_found, "lookup after the expiration");
+
+	cherokee_cryptor_libssl_cache_get_stats (cache, &after);
+	CHECK (after.used == before.used - 1, "expired entry is freed");
+
+	cherokee_bogonow_now = 1000;
+}
+
+static void
+test_lru (cherokee_cryptor_libssl_cache_t *cache)
+{
+	cuint_t                               i;
+	cuint_t                               stored = 0;
+	cherokee_cryptor_libssl_cache_stats_t stats;
+
+	/* Session 200 is looked up after every store, 201 never
+	 */
+	CHECK (store (cache, 200, 2000) == ret_ok, "store");
+	CHECK (store (cache, 201, 2000) == ret_ok, "store");
+
+	for (i = 1000; i < 1000 + SHARDS * PER_SHARD * 4; i++) {
+		store (cache, i, 2000);
+		stored++;
+
+		if (fetch (cache, 200) != ret_ok) {
+			break;
+		}
+	}
+
+	CHECK (fetch (cache, 200) == ret_ok,        "recently used session survives");
+	CHECK (fetch (cache, 201) == ret_not_found, "least recently used session is evicted");
+
+	/* Shards never grow beyond their size
+	 */
+	cherokee_cryptor_libssl_cache_get_stats (cache, &stats);
+	CHECK (stats.used <= SHARDS * PER_SHARD, "cache size is bounded");
+	CHECK (stats.evictions > 0,              "eviction counter");
+	CHECK (stats.stores - stats.evictions == stats.used, "evictions account for the stores");
+}
+
+/* The supervisor hands the file descriptor over to the workers: all
+ * of them map the same cache.
+ */
+static void
+test_shared (void)
+{
+	ret_t                            ret;
+	int                              fd;
+	int                              status;
+	pid_t                            pid;
+	char                             num[16];
+	char                             name[] = "/tmp/cherokee-test-tls-cache-XXXXXX";
+	cherokee_cryptor_libssl_cache_t *worker1 = NULL;
+	cherokee_cryptor_libssl_cache_t *worker2 = NULL;
+
+	fd = mkstemp (name);
+	CHECK (fd >= 0, "cache file");
+	if (fd < 0) {
+		return;
+	}
+	unlink (name);
+
+	snprintf (num, sizeof(num), "%d", dup (fd));
+	setenv (CHEROKEE_SHM_TLS_CACHE_ENV, num, 1);
+	ret = cherokee_cryptor_libssl_cache_new (&worker1, SHARDS * PER_SHARD);
+	CHECK (ret == ret_ok, "first worker maps the cache");
+
+	snprintf (num, sizeof(num), "%d", dup (fd));
+	setenv (CHEROKEE_SHM_TLS_CACHE_ENV, num, 1);
+	ret = cherokee_cryptor_libssl_cache_new (&worker2, SHARDS * PER_SHARD);
+	CHECK (ret == ret_ok, "second worker maps the cache");
+
+	close (fd);
+	if ((worker1 == NULL) || (worker2 == NULL)) {
+		return;
+	}
+
+	CHECK (worker1->shm.mem != worker2->shm.mem, "two mappings");
+
+	/* Stored by one, resumed by the other
+	 */
+	CHECK (store (worker1, 300, 2000) == ret_ok, "store");
+	CHECK (fetch (worker2, 300) == ret_ok, "lookup from the other worker");
+
+	/* And across processes
+	 */
+	pid = fork();
+	if (pid == 0) {
+		store (worker2, 301, 2000);
+		_exit (0);
+	}
+
+	waitpid (pid, &status, 0);
+	CHECK (fetch (worker1, 301) == ret_ok, "lookup of a session stored by another process");
+
+	cherokee_cryptor_libssl_cache_free (worker1);
+	cherokee_cryptor_libssl_cache_free (worker2);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+	ret_t                            ret;
+	cherokee_cryptor_libssl_cache_t *cache = NULL;
+
+	UNUSED (argc);
+	UNUSED (argv);
+
+	cherokee_bogonow_now = 1000;
+
+	/* Worker started on its own: anonymous mapping
+	 */
+	unsetenv (CHEROKEE_SHM_TLS_CACHE_ENV);
+
+	ret = cherokee_cryptor_libssl_cache_new (&cache, BIG);
+	if (ret != ret_ok) {
+		printf ("FAIL: could not create the cache\n");
+		return 1;
+	}
+
+	CHECK (cache->shards  == SHARDS,       "shards");
+	CHECK (cache->entries == BIG / SHARDS, "entries per shard");
+
+	test_store_lookup (cache);
+	test_expiry (cache);
+	cherokee_cryptor_libssl_cache_free (cache);
+
+	/* Small one, to get the shards full
+	 */
+	cache = NULL;
+	ret = cherokee_cryptor_libssl_cache_new (&cache, SHARDS * PER_SHARD);
+	CHECK (ret == ret_ok, "small cache");
+
+	if (cache != NULL) {
+		CHECK (cache->entries == PER_SHARD, "entries per shard");
+		test_lru (cache);
+		cherokee_cryptor_libssl_cache_free (cache);
+	}
+
+	test_shared();
+
+	printf ("%d checks, %d failed\n", tests, fails);
+	return (fails > 0);
+}
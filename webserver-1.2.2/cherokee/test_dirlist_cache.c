@@ -0,0 +1,277 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "dirlist_cache.h"
+#include "bogotime.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <utime.h>
+
+#define HTML_LEN  1000
+
+static int fails = 0;
+static int tests = 0;
+
+#define CHECK(cond, msg)						\
+	do {								\
+		tests++;						\
+		if (! (cond)) {						\
+			printf ("FAIL: %s (line %d)\n", msg, __LINE__);	\
+			fails++;					\
+		}							\
+	} while (0)
+
+
+/* Same key as the handler: local path and sorting
+ */
+static void
+make_key (cherokee_buffer_t *key, const char *path, int sort)
+{
+	cherokee_buffer_clean (key);
+	cherokee_buffer_add (key, path, strlen(path));
+	cherokee_buffer_add_va (key, "?%d", sort);
+}
+
+/* Renders a listing and hands it over to the cache, as the handler
+ * does when its request is over.
+ */
+static ret_t
+add (cherokee_dirlist_cache_t *cache,
+     const char               *path,
+     int                       sort,
+     struct stat              *info,
+     size_t                    html_len)
+{
+	ret_t                           ret;
+	cherokee_dirlist_cache_entry_t *listing = NULL;
+
+	cherokee_dirlist_cache_entry_new (&listing);
+
+	make_key (&listing->key, path, sort);
+	cherokee_buffer_ensure_size (&listing->html, html_len + 1);
+	memset (listing->html.buf, 'x', html_len);
+	listing->html.buf[html_len] = '\0';
+	listing->html.len = html_len;
+
+	listing->mtime      = info->st_mtime;
+	listing->expiration = cherokee_bogonow_now + cache->lasting;
+	listing->ref_count  = 1;
+
+	ret = cherokee_dirlist_cache_add (cache, listing);
+	cherokee_dirlist_cache_release (cache, listing);
+
+	return ret;
+}
+
+static ret_t
+get (cherokee_dirlist_cache_t *cache,
+     const char               *path,
+     int                       sort,
+     struct stat              *info)
+{
+	ret_t                           ret;
+	cherokee_buffer_t               key     = CHEROKEE_BUF_INIT;
+	cherokee_dirlist_cache_entry_t *listing = NULL;
+
+	make_key (&key, path, sort);
+
+	ret = cherokee_dirlist_cache_get (cache, &key, info, &listing);
+	if (ret == ret_ok) {
+		cherokee_dirlist_cache_release (cache, listing);
+	}
+
+	cherokee_buffer_mrproper (&key);
+	return ret;
+}
+
+
+static void
+test_key (struct stat *info)
+{
+	cherokee_dirlist_cache_t cache;
+	cherokee_dirlist_cache_t other_theme;
+
+	cherokee_dirlist_cache_init (&cache);
+	cherokee_dirlist_cache_init (&other_theme);
+
+	CHECK (get (&cache, "/var/www/a/", 0, info) == ret_not_found, "empty cache");
+	CHECK (add (&cache, "/var/www/a/", 0, info, HTML_LEN) == ret_ok, "add");
+	CHECK (get (&cache, "/var/www/a/", 0, info) == ret_ok, "hit");
+
+	/* Path and sorting are part of the key
+	 */
+	CHECK (get (&cache, "/var/www/b/", 0, info) == ret_not_found, "other path");
+	CHECK (get (&cache, "/var/www/a/", 1, info) == ret_not_found, "other sorting");
+
+	CHECK (add (&cache, "/var/www/a/", 1, info, HTML_LEN) == ret_ok, "add");
+	CHECK (get (&cache, "/var/www/a/", 0, info) == ret_ok, "hit, first sorting");
+	CHECK (get (&cache, "/var/www/a/", 1, info) == ret_ok, "hit, second sorting");
+
+	/* Every rule (and so every theme and set of visible
+	 * properties) has a cache of its own
+	 */
+	CHECK (get (&other_theme, "/var/www/a/", 0, info) == ret_not_found, "other theme");
+
+	/* Counters
+	 */
+	CHECK (cache.count_hit  == 3, "hit counter");
+	CHECK (cache.count_miss == 3, "miss counter");
+	CHECK (other_theme.count_miss == 1, "miss counter, other theme");
+
+	cherokee_dirlist_cache_mrproper (&cache);
+	cherokee_dirlist_cache_mrproper (&other_theme);
+}
+
+static void
+test_revalidation (const char *dir)
+{
+	int                      re;
+	struct stat              info;
+	struct utimbuf           times;
+	cherokee_dirlist_cache_t cache;
+
+	cherokee_dirlist_cache_init (&cache);
+
+	re = cherokee_stat (dir, &info);
+	CHECK (re == 0, "stat");
+
+	CHECK (add (&cache, dir, 0, &info, HTML_LEN) == ret_ok, "add");
+	CHECK (cache.size > 0, "size accounted");
+
+	/* A single stat() of the directory is enough
+	 */
+	re = cherokee_stat (dir, &info);
+	CHECK (get (&cache, dir, 0, &info) == ret_ok, "unchanged directory");
+
+	/* Its mtime changes when an entry is added or removed
+	 */
+	times.actime  = info.st_atime;
+	times.modtime = info.st_mtime + 10;
+	re = utime (dir, &times);
+	CHECK (re == 0, "utime");
+
+	re = cherokee_stat (dir, &info);
+	CHECK (get (&cache, dir, 0, &info) == ret_not_found, "modified directory");
+	CHECK (cache.size == 0, "stale listing is dropped");
+
+	/* Expiration
+	 */
+	CHECK (add (&cache, dir, 0, &info, HTML_LEN) == ret_ok, "add");
+	cherokee_bogonow_now += cache.lasting;
+	CHECK (get (&cache, dir, 0, &info) == ret_ok, "not expired yet");
+	cherokee_bogonow_now += 1;
+	CHECK (get (&cache, dir, 0, &info) == ret_not_found, "expired");
+	CHECK (cache.size == 0, "expired listing is dropped");
+
+	cherokee_dirlist_cache_mrproper (&cache);
+}
+
+static void
+test_size_limit (struct stat *info)
+{
+	size_t                          entry_len;
+	cherokee_dirlist_cache_t        cache;
+	cherokee_buffer_t               key     = CHEROKEE_BUF_INIT;
+	cherokee_dirlist_cache_entry_t *listing = NULL;
+
+	cherokee_dirlist_cache_init (&cache);
+
+	/* Room for three listings
+	 */
+	CHECK (add (&cache, "/d/1/", 0, info, HTML_LEN) == ret_ok, "add");
+	entry_len = cache.size;
+	cache.max_size = 3 * entry_len;
+
+	CHECK (add (&cache, "/d/2/", 0, info, HTML_LEN) == ret_ok, "add");
+	CHECK (add (&cache, "/d/3/", 0, info, HTML_LEN) == ret_ok, "add");
+	CHECK (cache.size == 3 * entry_len, "full");
+
+	/* The least recently used one goes away
+	 */
+	CHECK (get (&cache, "/d/1/", 0, info) == ret_ok, "hit");
+	CHECK (add (&cache, "/d/4/", 0, info, HTML_LEN) == ret_ok, "add");
+	CHECK (cache.size <= cache.max_size, "size limit");
+
+	CHECK (get (&cache, "/d/2/", 0, info) == ret_not_found, "evicted");
+	CHECK (get (&cache, "/d/1/", 0, info) == ret_ok, "recently used survives");
+	CHECK (get (&cache, "/d/3/", 0, info) == ret_ok, "survives");
+	CHECK (get (&cache, "/d/4/", 0, info) == ret_ok, "survives");
+
+	/* Listings that would not fit are not cached
+	 */
+	CHECK (add (&cache, "/d/big/", 0, info, 3 * entry_len) == ret_deny, "too big");
+	CHECK (get (&cache, "/d/big/", 0, info) == ret_not_found, "too big, not cached");
+	CHECK (cache.size == 3 * entry_len, "untouched");
+
+	/* A listing still being sent outlives its eviction
+	 */
+	make_key (&key, "/d/3/", 0);
+	CHECK (cherokee_dirlist_cache_get (&cache, &key, info, &listing) == ret_ok, "hit");
+
+	CHECK (add (&cache, "/d/5/", 0, info, HTML_LEN) == ret_ok, "add");
+	CHECK (add (&cache, "/d/6/", 0, info, HTML_LEN) == ret_ok, "add");
+	CHECK (add (&cache, "/d/7/", 0, info, HTML_LEN) == ret_ok, "add");
+
+	CHECK (listing->listed == false, "evicted while in use");
+	CHECK (listing->html.len == HTML_LEN, "still readable");
+	cherokee_dirlist_cache_release (&cache, listing);
+
+	CHECK (get (&cache, "/d/3/", 0, info) == ret_not_found, "gone");
+	CHECK (cache.size == 3 * entry_len, "size limit");
+
+	cherokee_buffer_mrproper (&key);
+	cherokee_dirlist_cache_mrproper (&cache);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+	struct stat info;
+	char        dir[] = "/tmp/cherokee-test-dirlist-XXXXXX";
+
+	UNUSED (argc);
+	UNUSED (argv);
+
+	if (mkdtemp (dir) == NULL) {
+		printf ("FAIL: could not create a directory\n");
+		return 1;
+	}
+
+	cherokee_bogonow_now = time (NULL);
+	cherokee_stat (dir, &info);
+
+	test_key (&info);
+	test_size_limit (&info);
+	test_revalidation (dir);
+
+	rmdir (dir);
+
+	printf ("%d checks, %d failed\n", tests, fails);
+	return (fails > 0);
+}
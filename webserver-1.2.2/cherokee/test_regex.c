@@ -0,0 +1,128 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "regex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static char *patterns[] = {
+	"^/old/(.*)$",
+	"^/old",
+	"^/olds?/",
+	"^/ol*d",
+	"^/ol+d",
+	"^/o{2}ld",
+	"^/a.b",
+	"^/a\\.b",
+	"^/a|^/b",
+	"^/(?i)ABC",
+	"^(/x)?/y",
+	"^",
+	"^$",
+	"/old/",
+	"\\.php$",
+	"^/[a-z]+/",
+	"^/café/",
+	NULL
+};
+
+static char *subjects[] = {
+	"",
+	"/",
+	"/o",
+	"/old",
+	"/old/",
+	"/old/page.php",
+	"/olds/",
+	"/od",
+	"/oold",
+	"/ollld",
+	"/a.b",
+	"/axb",
+	"/b",
+	"/abc",
+	"/ABC",
+	"/y",
+	"/x/y",
+	"/new/old/",
+	"/café/menu",
+	"/cafe/menu",
+	NULL
+};
+
+int
+main (int argc, char *argv[])
+{
+	int                     i, j;
+	int                     re;
+	int                     ref;
+	int                     tests = 0;
+	int                     fails = 0;
+	cint_t                  ovector[OVECTOR_LEN];
+	cint_t                  ovector_ref[OVECTOR_LEN];
+	cherokee_regex_t       *regex;
+	cherokee_regex_table_t *table;
+
+	UNUSED (argc);
+	UNUSED (argv);
+
+	cherokee_regex_table_new (&table);
+
+	for (i = 0; patterns[i] != NULL; i++) {
+		if (cherokee_regex_table_get (table, patterns[i], (void **)&regex) != ret_ok) {
+			printf ("FAIL: could not compile '%s'\n", patterns[i]);
+			return 1;
+		}
+
+		for (j = 0; subjects[j] != NULL; j++) {
+			re  = cherokee_regex_exec (regex, subjects[j], strlen(subjects[j]),
+						   ovector, OVECTOR_LEN);
+			ref = pcre_exec (regex->re, NULL, subjects[j], strlen(subjects[j]),
+					 0, 0, ovector_ref, OVECTOR_LEN);
+
+			if ((re != ref) ||
+			    ((re > 0) && (memcmp (ovector, ovector_ref, re * 2 * sizeof(cint_t)) != 0)))
+			{
+				printf ("FAIL: '%s' ~ '%s': %d, expected %d\n",
+					subjects[j], patterns[i], re, ref);
+				fails++;
+			}
+
+			tests++;
+		}
+
+		if (regex->matches + regex->misses != (culong_t) j) {
+			printf ("FAIL: '%s': counted %lu matches and %lu misses\n",
+				patterns[i], regex->matches, regex->misses);
+			fails++;
+		}
+	}
+
+	printf ("%d matches, %d failed\n", tests, fails);
+
+	cherokee_regex_table_free (table);
+	return (fails > 0);
+}
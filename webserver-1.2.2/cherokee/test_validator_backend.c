@@ -0,0 +1,513 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "validator_backend.h"
+#include "connection-protected.h"
+#include "thread.h"
+#include "fdpoll.h"
+#include "bogotime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+
+#define GOOD_PASSWD "secret"
+
+static int fails = 0;
+static int tests = 0;
+
+#define CHECK(cond, msg)						\
+	do {								\
+		tests++;						\
+		if (! (cond)) {						\
+			printf ("FAIL: %s (line %d)\n", msg, __LINE__);	\
+			fails++;					\
+		}							\
+	} while (0)
+
+
+/* Stand-in back-end: accepts GOOD_PASSWD, and can be told to
+ * drop its connection once, or to hold its queries until released.
+ */
+typedef struct {
+	CHEROKEE_MUTEX_T (mutex);
+	int              connects;
+	int              closes;
+	int              queries;
+	int              thread_inits;
+	int              thread_ends;
+	cherokee_boolean_t drop_next;
+#ifdef HAVE_PTHREAD
+	cherokee_boolean_t hold;
+	int              held;
+	pthread_cond_t   cond;
+#endif
+} standin_t;
+
+static void
+standin_init (standin_t *st)
+{
+	memset (st, 0, sizeof(standin_t));
+	CHEROKEE_MUTEX_INIT (&st->mutex, CHEROKEE_MUTEX_FAST);
+#ifdef HAVE_PTHREAD
+	pthread_cond_init (&st->cond, NULL);
+#endif
+}
+
+static void
+standin_mrproper (standin_t *st)
+{
+#ifdef HAVE_PTHREAD
+	pthread_cond_destroy (&st->cond);
+#endif
+	CHEROKEE_MUTEX_DESTROY (&st->mutex);
+}
+
+static ret_t
+standin_thread_init (standin_t *st)
+{
+	CHEROKEE_MUTEX_LOCK (&st->mutex);
+	st->thread_inits++;
+	CHEROKEE_MUTEX_UNLOCK (&st->mutex);
+	return ret_ok;
+}
+
+static void
+standin_thread_end (standin_t *st)
+{
+	CHEROKEE_MUTEX_LOCK (&st->mutex);
+	st->thread_ends++;
+	CHEROKEE_MUTEX_UNLOCK (&st->mutex);
+}
+
+static ret_t
+standin_connect (standin_t *st, void **conn)
+{
+	CHEROKEE_MUTEX_LOCK (&st->mutex);
+	st->connects++;
+	CHEROKEE_MUTEX_UNLOCK (&st->mutex);
+
+	*conn = st;
+	return ret_ok;
+}
+
+static void
+standin_close (standin_t *st, void *conn)
+{
+	UNUSED (conn);
+
+	CHEROKEE_MUTEX_LOCK (&st->mutex);
+	st->closes++;
+	CHEROKEE_MUTEX_UNLOCK (&st->mutex);
+}
+
+static ret_t
+standin_query (standin_t         *st,
+	       void              *conn,
+	       cherokee_buffer_t *user,
+	       cherokee_buffer_t *passwd,
+	       cherokee_buffer_t *result)
+{
+	ret_t ret;
+
+	UNUSED (conn);
+
+	CHEROKEE_MUTEX_LOCK (&st->mutex);
+	st->queries++;
+
+#ifdef HAVE_PTHREAD
+	if (st->hold) {
+		st->held++;
+		pthread_cond_broadcast (&st->cond);
+
+		while (st->hold) {
+			pthread_cond_wait (&st->cond, &st->mutex);
+		}
+	}
+#endif
+
+	if (st->drop_next) {
+		st->drop_next = false;
+		ret = ret_error;
+	} else if (equal_buf_str (passwd, GOOD_PASSWD)) {
+		cherokee_buffer_add_str (result, "uid=");
+		cherokee_buffer_add_buffer (result, user);
+		ret = ret_ok;
+	} else {
+		ret = ret_deny;
+	}
+
+	CHEROKEE_MUTEX_UNLOCK (&st->mutex);
+	return ret;
+}
+
+
+static void
+standin_backend_init (standin_t                    *st,
+		      cherokee_validator_backend_t *backend,
+		      cuint_t                       pool_size)
+{
+	cherokee_validator_backend_init (backend, st,
+					 (validator_backend_func_connect_t) standin_connect,
+					 (validator_backend_func_close_t)   standin_close,
+					 (validator_backend_func_query_t)   standin_query);
+	cherokee_validator_backend_set_thread_funcs (backend,
+						     (validator_backend_func_thread_init_t) standin_thread_init,
+						     (validator_backend_func_thread_end_t)  standin_thread_end);
+	backend->pool_size = pool_size;
+}
+
+
+/* What the thread does with a parked connection once its fd is
+ * ready, or once it gives up on it.
+ */
+static void
+unpark (cherokee_connection_t *conn)
+{
+	cherokee_thread_t *thd = CONN_THREAD(conn);
+
+	cherokee_fdpoll_del (thd->fdpoll, conn->polling_fd);
+	cherokee_fdpoll_add (thd->fdpoll, SOCKET_FD(&conn->socket), FDPOLL_MODE_READ);
+	cherokee_list_del (&conn->list_node);
+	cherokee_list_add (&conn->list_node, &thd->active_list);
+	conn->polling_fd = -1;
+}
+
+static ret_t
+start (cherokee_validator_backend_t  *backend,
+       cherokee_connection_t         *conn,
+       cherokee_validator_job_t     **job,
+       const char                    *user,
+       const char                    *passwd,
+       cherokee_buffer_t             *result)
+{
+	ret_t             ret;
+	cherokee_buffer_t u   = CHEROKEE_BUF_INIT;
+	cherokee_buffer_t p   = CHEROKEE_BUF_INIT;
+	cherokee_buffer_t key = CHEROKEE_BUF_INIT;
+
+	cherokee_buffer_add (&u, user, strlen(user));
+	cherokee_buffer_add (&p, passwd, strlen(passwd));
+	cherokee_validator_backend_cache_key (backend, &u, &p, &key);
+
+	ret = cherokee_validator_backend_query (backend, conn, job, &key, &u, &p, result);
+
+	cherokee_buffer_mrproper (&u);
+	cherokee_buffer_mrproper (&p);
+	cherokee_buffer_mrproper (&key);
+	return ret;
+}
+
+/* Runs a query the way a validator does: if it gets parked, wait
+ * for the pool thread to answer and resume it.
+ */
+static ret_t
+query (cherokee_validator_backend_t *backend,
+       cherokee_connection_t        *conn,
+       const char                   *user,
+       const char                   *passwd,
+       cherokee_buffer_t            *result,
+       cherokee_boolean_t           *parked)
+{
+	ret_t                     ret;
+	int                       re;
+	struct pollfd             pfd;
+	cherokee_validator_job_t *job = NULL;
+
+	*parked = false;
+	cherokee_buffer_clean (result);
+
+	while (true) {
+		ret = start (backend, conn, &job, user, passwd, result);
+		if (ret != ret_eagain)
+			break;
+
+		*parked = true;
+
+		pfd.fd     = conn->polling_fd;
+		pfd.events = POLLIN;
+		do {
+			re = poll (&pfd, 1, 5000);
+		} while ((re < 0) && (errno == EINTR));
+
+		if (re <= 0) {
+			cherokee_validator_backend_cancel (backend, &job);
+			unpark (conn);
+			ret = ret_error;
+			break;
+		}
+
+		unpark (conn);
+	}
+
+	return ret;
+}
+
+
+static void
+test_cache_key (cherokee_validator_backend_t *backend)
+{
+	cherokee_buffer_t user = CHEROKEE_BUF_INIT;
+	cherokee_buffer_t pass = CHEROKEE_BUF_INIT;
+	cherokee_buffer_t key1 = CHEROKEE_BUF_INIT;
+	cherokee_buffer_t key2 = CHEROKEE_BUF_INIT;
+
+	cherokee_buffer_add_str (&user, "alice");
+	cherokee_buffer_add_str (&pass, GOOD_PASSWD);
+
+	cherokee_validator_backend_cache_key (backend, &user, &pass, &key1);
+	cherokee_validator_backend_cache_key (backend, &user, &pass, &key2);
+	CHECK (key1.len == 40, "cache key length");
+	CHECK (cherokee_buffer_cmp_buf (&key1, &key2) == 0, "cache key is stable");
+	CHECK (strstr (key1.buf, GOOD_PASSWD) == NULL, "cache key leaks the password");
+
+	cherokee_buffer_clean (&pass);
+	cherokee_buffer_add_str (&pass, "wrong");
+	cherokee_validator_backend_cache_key (backend, &user, &pass, &key2);
+	CHECK (cherokee_buffer_cmp_buf (&key1, &key2) != 0, "cache key depends on the password");
+
+	cherokee_buffer_mrproper (&user);
+	cherokee_buffer_mrproper (&pass);
+	cherokee_buffer_mrproper (&key1);
+	cherokee_buffer_mrproper (&key2);
+}
+
+
+static void
+test_backend (cherokee_connection_t *conn, cuint_t pool_size)
+{
+	ret_t                         ret;
+	int                           closes;
+	cherokee_boolean_t            parked;
+	cherokee_validator_backend_t  backend;
+	cherokee_buffer_t             result  = CHEROKEE_BUF_INIT;
+	cherokee_boolean_t            pooled  = (pool_size > 0);
+	standin_t                     st;
+
+	standin_init (&st);
+	standin_backend_init (&st, &backend, pool_size);
+
+	test_cache_key (&backend);
+
+	/* Success, then cached
+	 */
+	ret = query (&backend, conn, "alice", GOOD_PASSWD, &result, &parked);
+	CHECK (ret == ret_ok, "correct password accepted");
+	CHECK (parked == pooled, "query went through the pool");
+	CHECK (equal_buf_str (&result, "uid=alice"), "query result");
+	CHECK (st.queries == 1, "one back-end query");
+
+	ret = query (&backend, conn, "alice", GOOD_PASSWD, &result, &parked);
+	CHECK (ret == ret_ok, "cached password accepted");
+	CHECK (! parked, "cache hit is not parked");
+	CHECK (equal_buf_str (&result, "uid=alice"), "cached result");
+	CHECK (st.queries == 1, "cache hit does not query the back-end");
+
+	/* Failure, then negatively cached
+	 */
+	ret = query (&backend, conn, "alice", "wrong", &result, &parked);
+	CHECK (ret == ret_deny, "wrong password denied");
+	CHECK (st.queries == 2, "wrong password queried");
+
+	ret = query (&backend, conn, "alice", "wrong", &result, &parked);
+	CHECK (ret == ret_deny, "cached wrong password denied");
+	CHECK (st.queries == 2, "denial is cached");
+	CHECK (backend.count_hit == 2, "cache hits");
+
+	/* A dropped back-end connection is reopened once. Pool
+	 * threads connect lazily, so count the closes instead.
+	 */
+	closes = st.closes;
+	st.drop_next = true;
+
+	ret = query (&backend, conn, "bob", GOOD_PASSWD, &result, &parked);
+	CHECK (ret == ret_ok, "query retried after a dropped connection");
+	CHECK (st.queries == 4, "failed query and its retry");
+	CHECK (st.closes == closes + 1, "dropped connection closed");
+
+	cherokee_validator_backend_mrproper (&backend);
+
+	CHECK (st.connects == st.closes, "back-end connections closed");
+	if (pooled) {
+		CHECK (st.thread_inits >= 1, "pool threads set up");
+		CHECK (st.thread_inits == st.thread_ends, "pool threads torn down");
+	} else {
+		CHECK (st.thread_inits == 0, "no pool threads");
+	}
+
+	standin_mrproper (&st);
+	cherokee_buffer_mrproper (&result);
+}
+
+
+#ifdef HAVE_PTHREAD
+static void
+wait_held (standin_t *st, int held)
+{
+	CHEROKEE_MUTEX_LOCK (&st->mutex);
+	while (st->held < held) {
+		pthread_cond_wait (&st->cond, &st->mutex);
+	}
+	CHEROKEE_MUTEX_UNLOCK (&st->mutex);
+}
+
+static void
+release (standin_t *st)
+{
+	CHEROKEE_MUTEX_LOCK (&st->mutex);
+	st->hold = false;
+	pthread_cond_broadcast (&st->cond);
+	CHEROKEE_MUTEX_UNLOCK (&st->mutex);
+}
+
+/* A single pool thread, so that the jobs can be caught while the
+ * back-end is answering and while they wait in the queue.
+ */
+static void
+test_pool (cherokee_connection_t *conn)
+{
+	ret_t                         ret;
+	cherokee_boolean_t            parked;
+	cherokee_validator_backend_t  backend;
+	cherokee_validator_job_t     *running = NULL;
+	cherokee_validator_job_t     *queued  = NULL;
+	cherokee_buffer_t             result  = CHEROKEE_BUF_INIT;
+	standin_t                     st;
+
+	standin_init (&st);
+	standin_backend_init (&st, &backend, 1);
+
+	/* Hand a job over and give up on it while the back-end is
+	 * still answering: the pool thread frees it.
+	 */
+	st.hold = true;
+
+	ret = start (&backend, conn, &running, "carol", GOOD_PASSWD, &result);
+	CHECK (ret == ret_eagain, "pool query parked");
+	CHECK (running != NULL, "pool query has a job");
+	CHECK (conn->polling_fd >= 0, "connection polls the job");
+	unpark (conn);
+
+	wait_held (&st, 1);
+
+	/* A second job waits in the queue meanwhile; cancelling it
+	 * takes it out before it reaches the back-end.
+	 */
+	ret = start (&backend, conn, &queued, "dave", GOOD_PASSWD, &result);
+	CHECK (ret == ret_eagain, "queued query parked");
+	unpark (conn);
+
+	cherokee_validator_backend_cancel (&backend, &running);
+	CHECK (running == NULL, "in-flight job cancelled");
+
+	cherokee_validator_backend_cancel (&backend, &queued);
+	CHECK (queued == NULL, "queued job cancelled");
+	CHECK (cherokee_list_empty (&backend.queue), "queued job dequeued");
+
+	release (&st);
+
+	/* The pool goes on: the next job is answered once the thread
+	 * is done with the abandoned one. Its answer was not cached.
+	 */
+	ret = query (&backend, conn, "carol", GOOD_PASSWD, &result, &parked);
+	CHECK (ret == ret_ok, "query after an abandoned job");
+	CHECK (parked, "query after an abandoned job went through the pool");
+	CHECK (equal_buf_str (&result, "uid=carol"), "query after an abandoned job result");
+	CHECK (st.queries == 2, "cancelled queued job never queried");
+	CHECK (backend.count_hit == 0, "abandoned answer not cached");
+
+	/* The pool thread reopens a dropped connection and retries
+	 */
+	st.drop_next = true;
+
+	ret = query (&backend, conn, "dave", GOOD_PASSWD, &result, &parked);
+	CHECK (ret == ret_ok, "pool query retried after a dropped connection");
+	CHECK (equal_buf_str (&result, "uid=dave"), "retried pool query result");
+	CHECK (st.queries == 4, "pool failed query and its retry");
+	CHECK (st.connects == 2, "pool thread reconnected");
+	CHECK (st.closes == 1, "pool thread closed the dropped connection");
+
+	cherokee_validator_backend_mrproper (&backend);
+
+	CHECK (st.connects == st.closes, "pool back-end connections closed");
+	CHECK (st.thread_inits == 1, "one pool thread set up");
+	CHECK (st.thread_ends == 1, "one pool thread torn down");
+
+	standin_mrproper (&st);
+	cherokee_buffer_mrproper (&result);
+}
+#endif
+
+
+int
+main (int argc, char *argv[])
+{
+	int                    fds[2];
+	cherokee_thread_t      thd;
+	cherokee_connection_t *conn;
+
+	UNUSED (argc);
+	UNUSED (argv);
+
+	cherokee_bogotime_init();
+	cherokee_bogotime_update();
+
+	/* Just what parking a connection needs of its thread
+	 */
+	memset (&thd, 0, sizeof(thd));
+	INIT_LIST_HEAD (&thd.active_list);
+	INIT_LIST_HEAD (&thd.polling_list);
+	cherokee_fdpoll_best_new (&thd.fdpoll, 64, 64);
+
+	if (pipe (fds) != 0) {
+		printf ("FAIL: pipe\n");
+		return 1;
+	}
+
+	cherokee_connection_new (&conn);
+	conn->thread = &thd;
+	S_SOCKET_FD(conn->socket) = fds[0];
+	cherokee_list_add (&conn->list_node, &thd.active_list);
+	cherokee_fdpoll_add (thd.fdpoll, fds[0], FDPOLL_MODE_READ);
+
+	test_backend (conn, 0);
+#ifdef HAVE_PTHREAD
+	test_backend (conn, 2);
+	test_pool (conn);
+#endif
+
+	cherokee_fdpoll_del (thd.fdpoll, fds[0]);
+	cherokee_list_del (&conn->list_node);
+	S_SOCKET_FD(conn->socket) = -1;
+	cherokee_connection_free (conn);
+	cherokee_fdpoll_free (thd.fdpoll);
+	close (fds[0]);
+	close (fds[1]);
+
+	printf ("%d checks, %d failed\n", tests, fails);
+	return (fails > 0);
+}
@@ -743,7 +743,8 @@ process_active_connections (cherokee_thread_t *thd)
 		if (conn->options & conn_op_was_polling) {
 			BIT_UNSET (conn->options, conn_op_was_polling);
 		}
-		else if (conn->phase == phase_shutdown) {
+		else if ((conn->phase == phase_shutdown) &&
+			 (cherokee_buffer_is_empty (&conn->pipelined_buffer))) {
 			; /* No FD check*/
 		}
 		else if ((conn->phase == phase_reading_header) && (conn->incoming_header.len > 0)) {
@@ -1028,7 +1029,16 @@ process_active_connections (cherokee_thread_t *thd)
 			/* Check for authentication
 			 */
 			ret = cherokee_connection_check_authentication (conn, &entry);
-			if (unlikely (ret != ret_ok)) {
+			switch (ret) {
+			case ret_ok:
+				break;
+			case ret_eagain:
+				/* The validator is waiting for its back-end.
+				 * The setup is run again once it answers.
+				 */
+				cherokee_connection_clean_for_resetup (conn);
+				continue;
+			default:
 				cherokee_connection_setup_error_handler (conn);
 				continue;
 			}
@@ -1352,6 +1362,14 @@ process_active_connections (cherokee_thread_t *thd)
 			conn->phase = phase_shutdown;
 
 		case phase_shutdown:
+			/* Responses to pipelined requests might be queued
+			 */
+			ret = cherokee_connection_send_pipelined (conn);
+			if (ret == ret_eagain) {
+				conn_set_mode (thd, conn, socket_writing);
+				continue;
+			}
+
 			/* Perform a proper SSL/TLS shutdown
 			 */
 			if (conn->socket.is_tls == TLS) {
@@ -2129,6 +2147,25 @@ cherokee_thread_deactive_to_polling (cherokee_thread_t     *thd,
 	TRACE (ENTRIES",polling", "conn=%p(fd=%d) (fd=%d, rw=%d)\n",
 	       conn, SOCKET_FD(socket), fd, rw);
 
+	/* Do not hold the responses to previous pipelined requests
+	 * while waiting for a slow back-end.
+	 */
+	ret = cherokee_connection_send_pipelined (conn);
+	switch (ret) {
+	case ret_ok:
+	case ret_eagain:
+		break;
+	default:
+		/* The client is gone: do not wait for the back-end
+		 */
+		TRACE (ENTRIES",polling", "conn=%p: pipelined flush failed, ret=%d\n", conn, ret);
+
+		cherokee_buffer_clean (&conn->pipelined_buffer);
+		conn->keepalive = 0;
+		conn->phase     = phase_shutdown;
+		return ret_error;
+	}
+
 	/* Check for fds added more than once
 	 */
 	if (multiple)
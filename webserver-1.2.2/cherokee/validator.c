@@ -30,6 +30,12 @@
 #include "header-protected.h"
 #include "config_entry.h"
 #include "util.h"
+#include "sha1.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/time.h>
 
 
 #define ENTRIES "validator"
@@ -485,3 +491,110 @@ cherokee_validator_props_free_base  (cherokee_validator_props_t *props)
 	return cherokee_module_props_free_base (MODULE_PROPS(props));
 }
 
+
+
+/* Keyed digests of credentials: the secret never leaves the process,
+ * so the digests kept in memory by the credential caches cannot be
+ * reversed by brute force.
+ */
+
+ret_t
+cherokee_validator_secret_init (unsigned char *secret, cuint_t len)
+{
+	int            fd;
+	ssize_t        re    = 0;
+	size_t         got   = 0;
+	size_t         n;
+	cuint_t        block;
+	pid_t          pid;
+	struct timeval tv;
+	SHA_INFO       sha1;
+	unsigned char  digest[SHA_DIGESTSIZE];
+
+	fd = open ("/dev/urandom", O_RDONLY);
+	if (fd >= 0) {
+		while (got < len) {
+			re = read (fd, secret + got, len - got);
+			if (re < 0) {
+				if (errno == EINTR)
+					continue;
+				break;
+			} else if (re == 0) {
+				break;
+			}
+			got += re;
+		}
+		cherokee_fd_close (fd);
+	}
+
+	if (got >= len) {
+		return ret_ok;
+	}
+
+	/* Fallback: hash whatever is at hand. It does not touch the
+	 * rand() sequence of the process.
+	 */
+	LOG_WARNING_S (CHEROKEE_ERROR_VALIDATOR_SECRET_URANDOM);
+
+	pid = getpid();
+	for (block = 0; got < len; block++) {
+		gettimeofday (&tv, NULL);
+
+		sha_init   (&sha1);
+		sha_update (&sha1, (unsigned char *) &tv, sizeof(tv));
+		sha_update (&sha1, (unsigned char *) &pid, sizeof(pid));
+		sha_update (&sha1, (unsigned char *) &block, sizeof(block));
+		sha_update (&sha1, (unsigned char *) &secret, sizeof(secret));
+		sha_update (&sha1, secret, len);
+		sha_final  (&sha1, digest);
+
+		n = MIN (SHA_DIGESTSIZE, len - got);
+		memcpy (secret + got, digest, n);
+		got += n;
+	}
+
+	memset (digest, 0, sizeof(digest));
+	return ret_ok;
+}
+
+
+/* HMAC-SHA1 (RFC 2104) of "str1:str2", keyed with a secret of
+ * CHEROKEE_VALIDATOR_SECRET_LEN bytes.
+ */
+ret_t
+cherokee_validator_hmac (const unsigned char *secret,
+			 cherokee_buffer_t   *str1,
+			 cherokee_buffer_t   *str2,
+			 unsigned char       *digest)
+{
+	cuint_t       i;
+	SHA_INFO      sha1;
+	unsigned char pad[SHA_BLOCKSIZE];
+
+	/* Inner hash
+	 */
+	for (i = 0; i < SHA_BLOCKSIZE; i++) {
+		pad[i] = secret[i] ^ 0x36;
+	}
+
+	sha_init   (&sha1);
+	sha_update (&sha1, pad, SHA_BLOCKSIZE);
+	sha_update (&sha1, (unsigned char *) str1->buf, str1->len);
+	sha_update (&sha1, (unsigned char *) ":", 1);
+	sha_update (&sha1, (unsigned char *) str2->buf, str2->len);
+	sha_final  (&sha1, digest);
+
+	/* Outer hash
+	 */
+	for (i = 0; i < SHA_BLOCKSIZE; i++) {
+		pad[i] = secret[i] ^ 0x5c;
+	}
+
+	sha_init   (&sha1);
+	sha_update (&sha1, pad, SHA_BLOCKSIZE);
+	sha_update (&sha1, digest, SHA_DIGESTSIZE);
+	sha_final  (&sha1, digest);
+
+	memset (pad, 0, sizeof(pad));
+	return ret_ok;
+}
@@ -129,6 +129,14 @@ ret_t cherokee_validator_parse_digest    (cherokee_validator_t *validator, char
 ret_t cherokee_validator_digest_response (cherokee_validator_t *validator, char *A1, cherokee_buffer_t *buf, cherokee_connection_t *conn);
 ret_t cherokee_validator_digest_check    (cherokee_validator_t *validator, cherokee_buffer_t *passwd, cherokee_connection_t *conn);
 
+/* Keyed digests of credentials (HMAC-SHA1)
+ */
+#define CHEROKEE_VALIDATOR_SECRET_LEN  64
+#define CHEROKEE_VALIDATOR_DIGEST_LEN  20
+
+ret_t cherokee_validator_secret_init     (unsigned char *secret, cuint_t len);
+ret_t cherokee_validator_hmac            (const unsigned char *secret, cherokee_buffer_t *str1, cherokee_buffer_t *str2, unsigned char *digest);
+
 /* Validator properties methods
  */
 ret_t cherokee_validator_props_init_base  (cherokee_validator_props_t *props, module_func_props_free_t free_func);
@@ -0,0 +1,692 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include "common-internal.h"
+#include "validator_backend.h"
+#include "connection-protected.h"
+#include "thread.h"
+#include "fdpoll.h"
+#include "bogotime.h"
+#include "util.h"
+
+#include <unistd.h>
+#include <errno.h>
+
+#define ENTRIES "validator,backend"
+
+#define POOL_SIZE          2
+#define CACHE_MAX_LEN      1024
+#define CACHE_LASTING      60   /* secs */
+#define CACHE_LASTING_NEG  10   /* secs */
+
+
+/* Private types
+ */
+struct cherokee_validator_job {
+	cherokee_list_t    queue;
+	int                fds[2];
+	cherokee_buffer_t  user;
+	cherokee_buffer_t  passwd;
+	cherokee_buffer_t  result;
+	ret_t              ret;
+	cherokee_boolean_t queued;
+	cherokee_boolean_t done;
+	cherokee_boolean_t abandoned;
+};
+
+typedef struct {
+	cherokee_list_t    lru;
+	cherokee_buffer_t  key;
+	cherokee_buffer_t  result;
+	ret_t              ret;
+	time_t             expiration;
+} backend_entry_t;
+
+#define JOB(x)           ((cherokee_validator_job_t *)(x))
+#define BACKEND_ENTRY(x) ((backend_entry_t *)(x))
+
+
+/* Jobs: the query of a connection waiting for its answer. The
+ * connection polls the read end of the job pipe, and the pool
+ * thread writes into it once the answer is ready.
+ */
+static ret_t
+job_new (cherokee_validator_job_t **job,
+	 cherokee_buffer_t          *user,
+	 cherokee_buffer_t          *passwd)
+{
+	int re;
+	CHEROKEE_NEW_STRUCT (n, validator_job);
+
+	INIT_LIST_HEAD (&n->queue);
+	cherokee_buffer_init (&n->user);
+	cherokee_buffer_init (&n->passwd);
+	cherokee_buffer_init (&n->result);
+
+	n->ret       = ret_error;
+	n->queued    = false;
+	n->done      = false;
+	n->abandoned = false;
+
+	re = pipe (n->fds);
+	if (unlikely (re != 0)) {
+		LOG_ERRNO_S (errno, cherokee_err_error, CHEROKEE_ERROR_VALIDATOR_BACKEND_PIPE);
+		free (n);
+		return ret_error;
+	}
+
+	cherokee_fd_set_nonblocking (n->fds[0], true);
+	cherokee_fd_set_nonblocking (n->fds[1], true);
+	cherokee_fd_set_closexec (n->fds[0]);
+	cherokee_fd_set_closexec (n->fds[1]);
+
+	cherokee_buffer_add_buffer (&n->user, user);
+	if (passwd != NULL) {
+		cherokee_buffer_add_buffer (&n->passwd, passwd);
+	}
+
+	*job = n;
+	return ret_ok;
+}
+
+static void
+job_free (cherokee_validator_job_t *job)
+{
+	cherokee_fd_close (job->fds[0]);
+	cherokee_fd_close (job->fds[1]);
+
+	cherokee_buffer_mrproper (&job->user);
+	cherokee_buffer_mrproper (&job->passwd);
+	cherokee_buffer_mrproper (&job->result);
+
+	free (job);
+}
+
+
+/* Results cache: the answers of the back-end are kept for a while,
+ * positive answers longer than negative ones. Errors are never
+ * cached.
+ */
+static void
+cache_evict (cherokee_validator_backend_t *backend,
+	     backend_entry_t              *entry)
+{
+	/* backend->cache_mutex is LOCKED
+	 */
+	cherokee_avl_del (&backend->cache, &entry->key, NULL);
+	cherokee_list_del (&entry->lru);
+
+	cherokee_buffer_mrproper (&entry->key);
+	cherokee_buffer_mrproper (&entry->result);
+	free (entry);
+
+	backend->cache_len -= 1;
+}
+
+static ret_t
+cache_get (cherokee_validator_backend_t *backend,
+	   cherokee_buffer_t            *key,
+	   cherokee_buffer_t            *result,
+	   ret_t                        *ret_cached)
+{
+	ret_t            ret;
+	backend_entry_t *entry = NULL;
+
+	CHEROKEE_MUTEX_LOCK (&backend->cache_mutex);
+
+	ret = cherokee_avl_get (&backend->cache, key, (void **)&entry);
+	if (ret == ret_ok) {
+		if (entry->expiration >= cherokee_bogonow_now) {
+			cherokee_list_del (&entry->lru);
+			cherokee_list_add (&entry->lru, &backend->cache_lru);
+
+			cherokee_buffer_clean (result);
+			cherokee_buffer_add_buffer (result, &entry->result);
+
+			*ret_cached = entry->ret;
+		} else {
+			cache_evict (backend, entry);
+			ret = ret_not_found;
+		}
+	}
+
+	if (ret == ret_ok)
+		backend->count_hit += 1;
+	else
+		backend->count_miss += 1;
+
+	TRACE (ENTRIES, "Cache %s (hits=%d, misses=%d)\n",
+	       (ret == ret_ok) ? "hit" : "miss",
+	       backend->count_hit, backend->count_miss);
+
+	CHEROKEE_MUTEX_UNLOCK (&backend->cache_mutex);
+	return ret;
+}
+
+static void
+cache_set (cherokee_validator_backend_t *backend,
+	   cherokee_buffer_t            *key,
+	   ret_t                         ret_query,
+	   cherokee_buffer_t            *result)
+{
+	ret_t            ret;
+	cuint_t          lasting;
+	backend_entry_t *entry = NULL;
+
+	switch (ret_query) {
+	case ret_ok:
+		lasting = backend->cache_lasting;
+		break;
+	case ret_not_found:
+	case ret_deny:
+		lasting = backend->cache_lasting_neg;
+		break;
+	default:
+		return;
+	}
+
+	if ((lasting == 0) || (backend->cache_max_len == 0))
+		return;
+
+	CHEROKEE_MUTEX_LOCK (&backend->cache_mutex);
+
+	ret = cherokee_avl_get (&backend->cache, key, (void **)&entry);
+	if (ret != ret_ok) {
+		/* Make room for it
+		 */
+		if (backend->cache_len >= backend->cache_max_len) {
+			cache_evict (backend, BACKEND_ENTRY(backend->cache_lru.prev));
+		}
+
+		entry = (backend_entry_t *) malloc (sizeof(backend_entry_t));
+		if (unlikely (entry == NULL))
+			goto out;
+
+		INIT_LIST_HEAD (&entry->lru);
+		cherokee_buffer_init (&entry->key);
+		cherokee_buffer_init (&entry->result);
+		cherokee_buffer_add_buffer (&entry->key, key);
+
+		ret = cherokee_avl_add (&backend->cache, &entry->key, entry);
+		if (unlikely (ret != ret_ok)) {
+			cherokee_buffer_mrproper (&entry->key);
+			free (entry);
+			goto out;
+		}
+
+		backend->cache_len += 1;
+	} else {
+		cherokee_list_del (&entry->lru);
+	}
+
+	cherokee_list_add (&entry->lru, &backend->cache_lru);
+
+	cherokee_buffer_clean (&entry->result);
+	cherokee_buffer_add_buffer (&entry->result, result);
+
+	entry->ret        = ret_query;
+	entry->expiration = cherokee_bogonow_now + lasting;
+
+out:
+	CHEROKEE_MUTEX_UNLOCK (&backend->cache_mutex);
+}
+
+
+/* Back-end queries
+ */
+static ret_t
+run_query (cherokee_validator_backend_t  *backend,
+	   void                         **conn,
+	   cherokee_buffer_t             *user,
+	   cherokee_buffer_t             *passwd,
+	   cherokee_buffer_t             *result)
+{
+	ret_t   ret   = ret_error;
+	cuint_t tries;
+
+	for (tries = 0; tries < 2; tries++) {
+		if (*conn == NULL) {
+			ret = backend->func_connect (backend->props, conn);
+			if (ret != ret_ok) {
+				*conn = NULL;
+				return ret_error;
+			}
+		}
+
+		cherokee_buffer_clean (result);
+
+		ret = backend->func_query (backend->props, *conn, user, passwd, result);
+		if (ret != ret_error)
+			return ret;
+
+		/* The persistent connection might have been dropped
+		 * by the server: open a new one and try again.
+		 */
+		backend->func_close (backend->props, *conn);
+		*conn = NULL;
+	}
+
+	return ret;
+}
+
+
+#ifdef HAVE_PTHREAD
+static void *
+pool_thread_func (void *param)
+{
+	ret_t                         ret;
+	ssize_t                       re;
+	cherokee_validator_job_t     *job;
+	void                         *conn    = NULL;
+	cherokee_boolean_t            ready   = true;
+	cherokee_validator_backend_t *backend = param;
+
+	/* Per-thread set up of the client library
+	 */
+	if (backend->func_thread_init != NULL) {
+		ret = backend->func_thread_init (backend->props);
+		if (ret != ret_ok) {
+			ready = false;
+		}
+	}
+
+	CHEROKEE_MUTEX_LOCK (&backend->mutex);
+
+	while (true) {
+		while ((! backend->exiting) &&
+		       (cherokee_list_empty (&backend->queue)))
+		{
+			pthread_cond_wait (&backend->cond, &backend->mutex);
+		}
+
+		if (backend->exiting)
+			break;
+
+		job = JOB(backend->queue.next);
+		cherokee_list_del (&job->queue);
+		job->queued = false;
+
+		CHEROKEE_MUTEX_UNLOCK (&backend->mutex);
+
+		if (likely (ready)) {
+			ret = run_query (backend, &conn, &job->user, &job->passwd, &job->result);
+		} else {
+			ret = ret_error;
+		}
+
+		CHEROKEE_MUTEX_LOCK (&backend->mutex);
+
+		job->ret  = ret;
+		job->done = true;
+
+		/* Wake the connection up, unless it is gone
+		 */
+		if (job->abandoned) {
+			job_free (job);
+			continue;
+		}
+
+		do {
+			re = write (job->fds[1], "", 1);
+		} while ((re < 0) && (errno == EINTR));
+	}
+
+	CHEROKEE_MUTEX_UNLOCK (&backend->mutex);
+
+	if (conn != NULL) {
+		backend->func_close (backend->props, conn);
+	}
+
+	if ((ready) && (backend->func_thread_end != NULL)) {
+		backend->func_thread_end (backend->props);
+	}
+
+	return NULL;
+}
+
+static ret_t
+pool_start (cherokee_validator_backend_t *backend)
+{
+	int re;
+
+	/* backend->mutex is LOCKED
+	 */
+	if (backend->threads != NULL) {
+		return (backend->threads_num > 0) ? ret_ok : ret_not_found;
+	}
+
+	backend->threads = (pthread_t *) malloc (backend->pool_size * sizeof(pthread_t));
+	if (unlikely (backend->threads == NULL))
+		return ret_nomem;
+
+	while (backend->threads_num < backend->pool_size) {
+		re = pthread_create (&backend->threads[backend->threads_num], NULL,
+				     pool_thread_func, backend);
+		if (re != 0) {
+			LOG_ERRNO (re, cherokee_err_error, CHEROKEE_ERROR_VALIDATOR_BACKEND_THREAD,
+				   backend->threads_num, backend->pool_size);
+			break;
+		}
+
+		backend->threads_num += 1;
+	}
+
+	TRACE (ENTRIES, "Started %d pool threads\n", backend->threads_num);
+	return (backend->threads_num > 0) ? ret_ok : ret_not_found;
+}
+#endif
+
+
+/* Back-end object
+ */
+ret_t
+cherokee_validator_backend_init (cherokee_validator_backend_t     *backend,
+				 void                             *props,
+				 validator_backend_func_connect_t  func_connect,
+				 validator_backend_func_close_t    func_close,
+				 validator_backend_func_query_t    func_query)
+{
+	backend->props        = props;
+	backend->func_connect = func_connect;
+	backend->func_close   = func_close;
+	backend->func_query   = func_query;
+
+	backend->func_thread_init = NULL;
+	backend->func_thread_end  = NULL;
+
+	backend->pool_size    = POOL_SIZE;
+	backend->exiting      = false;
+	backend->backend      = NULL;
+
+	INIT_LIST_HEAD (&backend->queue);
+	CHEROKEE_MUTEX_INIT (&backend->mutex, CHEROKEE_MUTEX_FAST);
+
+#ifdef HAVE_PTHREAD
+	backend->threads      = NULL;
+	backend->threads_num  = 0;
+	pthread_cond_init (&backend->cond, NULL);
+#endif
+
+	backend->use_cache         = true;
+	backend->cache_len         = 0;
+	backend->cache_max_len     = CACHE_MAX_LEN;
+	backend->cache_lasting     = CACHE_LASTING;
+	backend->cache_lasting_neg = CACHE_LASTING_NEG;
+	backend->count_hit         = 0;
+	backend->count_miss        = 0;
+
+	cherokee_avl_init (&backend->cache);
+	INIT_LIST_HEAD (&backend->cache_lru);
+	CHEROKEE_MUTEX_INIT (&backend->cache_mutex, CHEROKEE_MUTEX_FAST);
+
+	cherokee_validator_secret_init (backend->cache_secret,
+					sizeof(backend->cache_secret));
+
+	return ret_ok;
+}
+
+
+ret_t
+cherokee_validator_backend_mrproper (cherokee_validator_backend_t *backend)
+{
+	cherokee_list_t *i, *tmp;
+
+#ifdef HAVE_PTHREAD
+	cuint_t n;
+
+	/* Stop the pool
+	 */
+	CHEROKEE_MUTEX_LOCK (&backend->mutex);
+	backend->exiting = true;
+	pthread_cond_broadcast (&backend->cond);
+	CHEROKEE_MUTEX_UNLOCK (&backend->mutex);
+
+	for (n = 0; n < backend->threads_num; n++) {
+		CHEROKEE_THREAD_JOIN (backend->threads[n]);
+	}
+
+	if (backend->threads != NULL) {
+		free (backend->threads);
+		backend->threads = NULL;
+	}
+
+	pthread_cond_destroy (&backend->cond);
+#endif
+
+	list_for_each_safe (i, tmp, &backend->queue) {
+		cherokee_list_del (i);
+		job_free (JOB(i));
+	}
+
+	if (backend->backend != NULL) {
+		backend->func_close (backend->props, backend->backend);
+		backend->backend = NULL;
+	}
+
+	CHEROKEE_MUTEX_DESTROY (&backend->mutex);
+
+	/* Results cache
+	 */
+	list_for_each_safe (i, tmp, &backend->cache_lru) {
+		cache_evict (backend, BACKEND_ENTRY(i));
+	}
+
+	cherokee_avl_mrproper (&backend->cache, NULL);
+	CHEROKEE_MUTEX_DESTROY (&backend->cache_mutex);
+
+	return ret_ok;
+}
+
+
+ret_t
+cherokee_validator_backend_set_thread_funcs (cherokee_validator_backend_t         *backend,
+					     validator_backend_func_thread_init_t  func_init,
+					     validator_backend_func_thread_end_t   func_end)
+{
+	backend->func_thread_init = func_init;
+	backend->func_thread_end  = func_end;
+
+	return ret_ok;
+}
+
+
+ret_t
+cherokee_validator_backend_configure (cherokee_validator_backend_t *backend,
+				      cherokee_config_node_t       *conf)
+{
+	ret_t ret;
+	int   val;
+
+	ret = cherokee_config_node_read_int (conf, "pool!size", &val);
+	if ((ret == ret_ok) && (val >= 0))
+		backend->pool_size = val;
+
+	cherokee_config_node_read_bool (conf, "cache", &backend->use_cache);
+
+	ret = cherokee_config_node_read_int (conf, "cache!max_entries", &val);
+	if ((ret == ret_ok) && (val >= 0))
+		backend->cache_max_len = val;
+
+	ret = cherokee_config_node_read_int (conf, "cache!lasting", &val);
+	if ((ret == ret_ok) && (val >= 0))
+		backend->cache_lasting = val;
+
+	ret = cherokee_config_node_read_int (conf, "cache!lasting_negative", &val);
+	if ((ret == ret_ok) && (val >= 0))
+		backend->cache_lasting_neg = val;
+
+	return ret_ok;
+}
+
+
+/* Looks up a user. The answer is taken from the cache, if possible.
+ * Otherwise the query is handed to the pool threads and ret_eagain
+ * is returned: the connection waits in the polling list until the
+ * answer is ready, and then calls this function again with the
+ * same job.
+ */
+ret_t
+cherokee_validator_backend_query (cherokee_validator_backend_t  *backend,
+				  cherokee_connection_t         *conn,
+				  cherokee_validator_job_t     **job,
+				  cherokee_buffer_t             *key,
+				  cherokee_buffer_t             *user,
+				  cherokee_buffer_t             *passwd,
+				  cherokee_buffer_t             *result)
+{
+	ret_t              ret;
+	ret_t              ret_cached = ret_error;
+	cherokee_boolean_t done;
+
+	/* Resume a pending query
+	 */
+	if (*job != NULL) {
+		CHEROKEE_MUTEX_LOCK (&backend->mutex);
+		done = (*job)->done;
+		CHEROKEE_MUTEX_UNLOCK (&backend->mutex);
+
+		if (! done)
+			goto park;
+
+		ret = (*job)->ret;
+
+		cherokee_buffer_clean (result);
+		cherokee_buffer_add_buffer (result, &(*job)->result);
+
+		job_free (*job);
+		*job = NULL;
+
+		goto out;
+	}
+
+	/* Cached answer
+	 */
+	if (backend->use_cache) {
+		ret = cache_get (backend, key, result, &ret_cached);
+		if (ret == ret_ok) {
+			return ret_cached;
+		}
+	}
+
+#ifdef HAVE_PTHREAD
+	/* Hand it over to the pool
+	 */
+	if (backend->pool_size > 0) {
+		CHEROKEE_MUTEX_LOCK (&backend->mutex);
+		ret = pool_start (backend);
+		CHEROKEE_MUTEX_UNLOCK (&backend->mutex);
+
+		if (ret == ret_ok) {
+			ret = job_new (job, user, passwd);
+			if (unlikely (ret != ret_ok))
+				return ret_error;
+
+			CHEROKEE_MUTEX_LOCK (&backend->mutex);
+			cherokee_list_add_tail (&(*job)->queue, &backend->queue);
+			(*job)->queued = true;
+			pthread_cond_signal (&backend->cond);
+			CHEROKEE_MUTEX_UNLOCK (&backend->mutex);
+
+			goto park;
+		}
+	}
+#endif
+
+	/* No pool: query it from the server thread
+	 */
+	CHEROKEE_MUTEX_LOCK (&backend->mutex);
+	ret = run_query (backend, &backend->backend, user, passwd, result);
+	CHEROKEE_MUTEX_UNLOCK (&backend->mutex);
+
+out:
+	if (backend->use_cache) {
+		cache_set (backend, key, ret, result);
+	}
+
+	return ret;
+
+park:
+	ret = cherokee_thread_deactive_to_polling (CONN_THREAD(conn), conn,
+						   (*job)->fds[0], FDPOLL_MODE_READ, false);
+	if (unlikely (ret != ret_ok)) {
+		cherokee_validator_backend_cancel (backend, job);
+		return ret_error;
+	}
+
+	return ret_eagain;
+}
+
+
+ret_t
+cherokee_validator_backend_cancel (cherokee_validator_backend_t  *backend,
+				   cherokee_validator_job_t     **job)
+{
+	if (*job == NULL)
+		return ret_ok;
+
+	CHEROKEE_MUTEX_LOCK (&backend->mutex);
+
+	if ((*job)->queued) {
+		cherokee_list_del (&(*job)->queue);
+		job_free (*job);
+
+	} else if ((*job)->done) {
+		job_free (*job);
+
+	} else {
+		/* The pool thread will free it
+		 */
+		(*job)->abandoned = true;
+	}
+
+	CHEROKEE_MUTEX_UNLOCK (&backend->mutex);
+
+	*job = NULL;
+	return ret_ok;
+}
+
+
+/* Cache key of a user and its password: HMAC-SHA1 (RFC 2104) of
+ * both, keyed with the secret of the back-end.
+ */
+ret_t
+cherokee_validator_backend_cache_key (cherokee_validator_backend_t *backend,
+				      cherokee_buffer_t            *user,
+				      cherokee_buffer_t            *passwd,
+				      cherokee_buffer_t            *key)
+{
+	cuint_t       i;
+	const char   *hex = "0123456789abcdef";
+	unsigned char digest[CHEROKEE_VALIDATOR_DIGEST_LEN];
+
+	cherokee_validator_hmac (backend->cache_secret, user, passwd, digest);
+
+	cherokee_buffer_clean (key);
+	for (i = 0; i < CHEROKEE_VALIDATOR_DIGEST_LEN; i++) {
+		cherokee_buffer_add_char (key, hex[digest[i] >> 4]);
+		cherokee_buffer_add_char (key, hex[digest[i] & 0xf]);
+	}
+
+	return ret_ok;
+}
@@ -0,0 +1,118 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+
+/* Cherokee
+ *
+ * Authors:
+ *      Alvaro Lopez Ortega <alvaro@alobbs.com>
+ *
+ * Copyright (C) 2001-2011 Alvaro Lopez Ortega
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef CHEROKEE_VALIDATOR_BACKEND_H
+#define CHEROKEE_VALIDATOR_BACKEND_H
+
+#include "common-internal.h"
+#include "avl.h"
+#include "list.h"
+#include "buffer.h"
+#include "connection.h"
+#include "config_node.h"
+#include "validator.h"
+
+/* Back-end functions. They are called from the pool threads, each
+ * one of which owns a persistent back-end connection. The optional
+ * thread functions run when a pool thread starts and before it exits.
+ */
+typedef ret_t (* validator_backend_func_thread_init_t) (void *props);
+typedef void  (* validator_backend_func_thread_end_t)  (void *props);
+typedef ret_t (* validator_backend_func_connect_t) (void *props, void **backend);
+typedef void  (* validator_backend_func_close_t)   (void *props, void  *backend);
+typedef ret_t (* validator_backend_func_query_t)   (void *props, void  *backend,
+						    cherokee_buffer_t *user,
+						    cherokee_buffer_t *passwd,
+						    cherokee_buffer_t *result);
+
+typedef struct cherokee_validator_job cherokee_validator_job_t;
+
+typedef struct {
+	/* Back-end */
+	void                             *props;
+	validator_backend_func_connect_t  func_connect;
+	validator_backend_func_close_t    func_close;
+	validator_backend_func_query_t    func_query;
+	validator_backend_func_thread_init_t func_thread_init;
+	validator_backend_func_thread_end_t  func_thread_end;
+
+	/* Pool */
+	cuint_t                           pool_size;
+	cherokee_list_t                   queue;
+	cherokee_boolean_t                exiting;
+	void                             *backend;
+#ifdef HAVE_PTHREAD
+	pthread_t                        *threads;
+	cuint_t                           threads_num;
+	pthread_cond_t                    cond;
+#endif
+	CHEROKEE_MUTEX_T                 (mutex);
+
+	/* Results cache */
+	cherokee_boolean_t                use_cache;
+	cherokee_avl_t                    cache;
+	cherokee_list_t                   cache_lru;
+	cuint_t                           cache_len;
+	cuint_t                           cache_max_len;
+	cuint_t                           cache_lasting;
+	cuint_t                           cache_lasting_neg;
+	cuint_t                           count_hit;
+	cuint_t                           count_miss;
+	unsigned char                     cache_secret[CHEROKEE_VALIDATOR_SECRET_LEN];
+	CHEROKEE_MUTEX_T                 (cache_mutex);
+} cherokee_validator_backend_t;
+
+
+ret_t cherokee_validator_backend_init      (cherokee_validator_backend_t     *backend,
+					    void                             *props,
+					    validator_backend_func_connect_t  func_connect,
+					    validator_backend_func_close_t    func_close,
+					    validator_backend_func_query_t    func_query);
+
+ret_t cherokee_validator_backend_mrproper  (cherokee_validator_backend_t     *backend);
+
+ret_t cherokee_validator_backend_set_thread_funcs (cherokee_validator_backend_t         *backend,
+						   validator_backend_func_thread_init_t  func_init,
+						   validator_backend_func_thread_end_t   func_end);
+
+ret_t cherokee_validator_backend_configure (cherokee_validator_backend_t     *backend,
+					    cherokee_config_node_t           *conf);
+
+ret_t cherokee_validator_backend_query     (cherokee_validator_backend_t     *backend,
+					    cherokee_connection_t            *conn,
+					    cherokee_validator_job_t        **job,
+					    cherokee_buffer_t                *key,
+					    cherokee_buffer_t                *user,
+					    cherokee_buffer_t                *passwd,
+					    cherokee_buffer_t                *result);
+
+ret_t cherokee_validator_backend_cancel    (cherokee_validator_backend_t     *backend,
+					    cherokee_validator_job_t        **job);
+
+ret_t cherokee_validator_backend_cache_key (cherokee_validator_backend_t     *backend,
+					    cherokee_buffer_t                *user,
+					    cherokee_buffer_t                *passwd,
+					    cherokee_buffer_t                *key);
+
+#endif /* CHEROKEE_VALIDATOR_BACKEND_H */
@@ -25,6 +25,138 @@
 #include "common-internal.h"
 #include "validator_file.h"
 #include "connection-protected.h"
+#include "bogotime.h"
+#include "util.h"
+
+#define ENTRIES "validator,file"
+
+
+/* Private type: parsed password file
+ */
+struct cherokee_password_file {
+	cherokee_buffer_t  content;
+	cherokee_avl_t     users;
+	time_t             mtime;
+	off_t              size;
+	ino_t              ino;
+	time_t             checked;
+};
+typedef struct cherokee_password_file cherokee_password_file_t;
+
+#define PFILE(x) ((cherokee_password_file_t *)(x))
+
+
+/* Splits the next "user:entry" line of a password file, in place.
+ * Empty lines, comments and lines with no user are skipped.
+ */
+static ret_t
+parse_line (char **pos, char *end, char **user, char **entry)
+{
+	char *line;
+	char *eol;
+	char *sep;
+
+	while (*pos < end) {
+		line = *pos;
+
+		eol = memchr (line, CHR_LF, end - line);
+		if (eol == NULL) {
+			eol  = end;
+			*pos = end;
+		} else {
+			*pos = eol + 1;
+		}
+
+		*eol = '\0';
+		if ((eol > line) && (eol[-1] == CHR_CR))
+			eol[-1] = '\0';
+
+		if ((*line == '\0') || (*line == '#'))
+			continue;
+
+		sep = strchr (line, ':');
+		if ((sep == NULL) || (sep == line))
+			continue;
+
+		*sep   = '\0';
+		*user  = line;
+		*entry = sep + 1;
+		return ret_ok;
+	}
+
+	return ret_eof;
+}
+
+static ret_t
+password_file_new (cherokee_password_file_t **file)
+{
+	CHEROKEE_NEW_STRUCT (n, password_file);
+
+	cherokee_buffer_init (&n->content);
+	cherokee_avl_init (&n->users);
+
+	n->mtime   = 0;
+	n->size    = -1;
+	n->ino     = 0;
+	n->checked = 0;
+
+	*file = n;
+	return ret_ok;
+}
+
+static void
+password_file_free (void *file)
+{
+	cherokee_avl_mrproper (&PFILE(file)->users, NULL);
+	cherokee_buffer_mrproper (&PFILE(file)->content);
+	free (file);
+}
+
+static ret_t
+password_file_load (cherokee_password_file_t *file,
+		    cherokee_buffer_t        *path,
+		    struct stat              *info)
+{
+	ret_t  ret;
+	char  *pos;
+	char  *end;
+	char  *user;
+	char  *entry;
+
+	cherokee_avl_mrproper (&file->users, NULL);
+	cherokee_avl_init (&file->users);
+	cherokee_buffer_clean (&file->content);
+
+	ret = cherokee_buffer_read_file (&file->content, path->buf);
+	if (ret != ret_ok)
+		return ret_error;
+
+	/* The first entry of a user wins, as it did when the
+	 * file was scanned on every request: the following
+	 * ones are never looked at.
+	 */
+	pos = file->content.buf;
+	end = file->content.buf + file->content.len;
+
+	while (parse_line (&pos, end, &user, &entry) == ret_ok) {
+		cherokee_avl_add_ptr (&file->users, user, entry);
+	}
+
+	file->mtime = info->st_mtime;
+	file->size  = file->content.len;
+	file->ino   = info->st_ino;
+
+	/* A file modified within the current second could be
+	 * modified again without its mtime changing: force the
+	 * next lookup to read it again.
+	 */
+	if (info->st_mtime >= cherokee_bogonow_now) {
+		file->size = -1;
+	}
+
+	return ret_ok;
+}
+
 
 /* Properties
  */
@@ -36,6 +168,12 @@ cherokee_validator_file_props_init_base (cherokee_validator_file_props_t *props,
 	props->password_path_type = val_path_full;
 	cherokee_buffer_init (&props->password_file);
 
+	props->use_cache        = true;
+	props->cache.count_hit  = 0;
+	props->cache.count_miss = 0;
+	cherokee_avl_init (&props->cache.files);
+	CHEROKEE_MUTEX_INIT (&props->cache.mutex, CHEROKEE_MUTEX_FAST);
+
 	return cherokee_validator_props_init_base (VALIDATOR_PROPS(props), free_func);
 }
 
@@ -44,6 +182,9 @@ cherokee_validator_file_props_free_base (cherokee_validator_file_props_t *props)
 {
 	cherokee_buffer_mrproper (&props->password_file);
 
+	cherokee_avl_mrproper (&props->cache.files, password_file_free);
+	CHEROKEE_MUTEX_DESTROY (&props->cache.mutex);
+
 	return cherokee_validator_props_free_base (VALIDATOR_PROPS(props));
 }
 
@@ -79,6 +220,10 @@ cherokee_validator_file_configure (cherokee_config_node_t     *conf,
 		}
 	}
 
+	/* Keep the parsed file in memory
+	 */
+	cherokee_config_node_read_bool (conf, "cache", &props->use_cache);
+
 	/* Final checks
 	 */
 	if (cherokee_buffer_is_empty (&props->password_file)) {
@@ -140,3 +285,139 @@ cherokee_validator_file_get_full_path (cherokee_validator_file_t  *validator,
 
 	return ret_error;
 }
+
+
+static ret_t
+get_entry_uncached (cherokee_buffer_t *full_path,
+		    cherokee_buffer_t *user,
+		    cherokee_buffer_t *ret_entry)
+{
+	ret_t              ret;
+	char              *pos;
+	char              *end;
+	char              *file_user;
+	char              *entry;
+	cherokee_buffer_t  content   = CHEROKEE_BUF_INIT;
+
+	ret = cherokee_buffer_read_file (&content, full_path->buf);
+	if (ret != ret_ok) {
+		ret = ret_error;
+		goto out;
+	}
+
+	pos = content.buf;
+	end = content.buf + content.len;
+	ret = ret_not_found;
+
+	while (parse_line (&pos, end, &file_user, &entry) == ret_ok) {
+		if (strcmp (file_user, user->buf) == 0) {
+			cherokee_buffer_add (ret_entry, entry, strlen(entry));
+			ret = ret_ok;
+			break;
+		}
+	}
+
+out:
+	cherokee_buffer_mrproper (&content);
+	return ret;
+}
+
+
+/* Password files are parsed once, and indexed by user. The file is
+ * stat()ed at most once per second and read again whenever its
+ * mtime, size or inode change.
+ */
+ret_t
+cherokee_validator_file_get_entry (cherokee_validator_file_t *validator,
+				   cherokee_buffer_t         *full_path,
+				   cherokee_buffer_t         *user,
+				   cherokee_buffer_t         *ret_entry)
+{
+	int                              re;
+	ret_t                            ret;
+	struct stat                      info;
+	char                            *entry = NULL;
+	cherokee_password_file_t        *file  = NULL;
+	cherokee_validator_file_props_t *props = VAL_VFILE_PROP(validator);
+	cherokee_validator_file_cache_t *cache = &props->cache;
+
+	cherokee_buffer_clean (ret_entry);
+
+	if (cherokee_buffer_is_empty (user)) {
+		return ret_not_found;
+	}
+
+	if (! props->use_cache) {
+		return get_entry_uncached (full_path, user, ret_entry);
+	}
+
+	CHEROKEE_MUTEX_LOCK (&cache->mutex);
+
+	ret = cherokee_avl_get (&cache->files, full_path, (void **)&file);
+	if (ret != ret_ok) {
+		file = NULL;
+	}
+
+	/* Revalidate it
+	 */
+	if ((file == NULL) || (file->checked != cherokee_bogonow_now)) {
+		re = cherokee_stat (full_path->buf, &info);
+		if ((re != 0) || (! S_ISREG(info.st_mode))) {
+			ret = ret_error;
+			goto error;
+		}
+
+		if (file == NULL) {
+			password_file_new (&file);
+
+			ret = cherokee_avl_add (&cache->files, full_path, file);
+			if (unlikely (ret != ret_ok)) {
+				password_file_free (file);
+				file = NULL;
+				goto out;
+			}
+		}
+
+		if ((file->mtime != info.st_mtime) ||
+		    (file->size  != info.st_size)  ||
+		    (file->ino   != info.st_ino))
+		{
+			ret = password_file_load (file, full_path, &info);
+			if (ret != ret_ok) {
+				goto error;
+			}
+
+			cache->count_miss += 1;
+			TRACE (ENTRIES, "Loaded '%s' (reads=%d, hits=%d)\n",
+			       full_path->buf, cache->count_miss, cache->count_hit);
+		} else {
+			cache->count_hit += 1;
+		}
+
+		file->checked = (file->size < 0) ? 0 : cherokee_bogonow_now;
+	} else {
+		cache->count_hit += 1;
+	}
+
+	/* Look up the user
+	 */
+	ret = cherokee_avl_get (&file->users, user, (void **)&entry);
+	if (ret != ret_ok) {
+		ret = ret_not_found;
+		goto out;
+	}
+
+	cherokee_buffer_add (ret_entry, entry, strlen(entry));
+	ret = ret_ok;
+	goto out;
+
+error:
+	if (file != NULL) {
+		cherokee_avl_del (&cache->files, full_path, NULL);
+		password_file_free (file);
+	}
+
+out:
+	CHEROKEE_MUTEX_UNLOCK (&cache->mutex);
+	return ret;
+}
@@ -27,16 +27,29 @@
 
 #include "validator.h"
 #include "connection.h"
+#include "avl.h"
 
 typedef enum {
 	val_path_full,
 	val_path_local_dir
 } cherokee_validator_path_t;
 
+typedef struct {
+	cherokee_avl_t            files;
+	cuint_t                   count_hit;
+	cuint_t                   count_miss;
+	CHEROKEE_MUTEX_T         (mutex);
+} cherokee_validator_file_cache_t;
+
 typedef struct {
 	cherokee_module_props_t   base;
 	cherokee_buffer_t         password_file;
 	cherokee_validator_path_t password_path_type;
+
+	/* Parsed password files
+	 */
+	cherokee_boolean_t              use_cache;
+	cherokee_validator_file_cache_t cache;
 } cherokee_validator_file_props_t;
 
 typedef struct {
@@ -78,4 +91,9 @@ ret_t cherokee_validator_file_get_full_path    (cherokee_validator_file_t  *vali
 						cherokee_buffer_t         **ret_buf,
 						cherokee_buffer_t          *tmp);
 
+ret_t cherokee_validator_file_get_entry        (cherokee_validator_file_t  *validator,
+						cherokee_buffer_t          *full_path,
+						cherokee_buffer_t          *user,
+						cherokee_buffer_t          *ret_entry);
+
 #endif /* CHEROKEE_VALIDATOR_FILE_H */
@@ -104,64 +104,29 @@ build_HA1 (cherokee_connection_t *conn, cherokee_buffer_t *buf)
 
 
 static ret_t
-extract_user_entry (cherokee_buffer_t *file, char *user_, char **user, char **realm, char **passwd)
+split_entry (cherokee_buffer_t *entry, char **realm, char **passwd)
 {
-	char *end      = file->buf + file->len;
-	char *pos      = file->buf;
-	int   user_len = strlen (user_);
-
-	while (pos < end) {
-		char *eol;
-
-		/* Limit the line
-		 */
-		eol = strchr (pos, CHR_LF);
-		if (eol != NULL)
-			*eol = '\0';
-
-		/* Check the user
-		 */
-		if ((pos[user_len] == ':') &&
-		    (strncmp (pos, user_, user_len) == 0)) {
-			char *tmp;
-
-			*user = pos;
-
-			tmp = strchr(pos, ':');
-			if (!tmp)
-				return ret_error;
-			*tmp = '\0';
-			*realm = tmp + 1;
-
-			tmp = strchr (*realm, ':');
-			if (!tmp)
-				return ret_error;
-			*tmp = '\0';
-			*passwd = tmp + 1;
-
-			return ret_ok;
-		}
-
-		/* Look for the next line, or exit
-		 */
-		if (eol == NULL)
-			break;
-
-		pos = eol;
-		*eol = CHR_LF;
-		while ((*pos == CHR_CR) || (*pos == CHR_LF)) pos++;
-	}
+	char *tmp;
+
+	/* The entry is the rest of the "user:realm:HA1" line
+	 */
+	*realm = entry->buf;
+
+	tmp = strchr (*realm, ':');
+	if (!tmp)
+		return ret_error;
+	*tmp = '\0';
+	*passwd = tmp + 1;
 
-	return ret_not_found;
+	return ret_ok;
 }
 
 
 static ret_t
-validate_basic (cherokee_validator_htdigest_t *htdigest, cherokee_connection_t *conn, cherokee_buffer_t *file)
+validate_basic (cherokee_validator_htdigest_t *htdigest, cherokee_connection_t *conn, cherokee_buffer_t *entry)
 {
 	ret_t               ret;
 	cherokee_boolean_t  equal;
-	char               *user   = NULL;
 	char               *realm  = NULL;
 	char               *passwd = NULL;
 	cherokee_buffer_t   ha1 = CHEROKEE_BUF_INIT;
@@ -170,7 +135,7 @@ validate_basic (cherokee_validator_htdigest_t *htdigest, cherokee_connection_t *
 
 	/* Extact the right entry information
 	 */
-	ret = extract_user_entry (file, conn->validator->user.buf, &user, &realm, &passwd);
+	ret = split_entry (entry, &realm, &passwd);
 	if (ret != ret_ok)
 		return ret;
 
@@ -188,11 +153,10 @@ validate_basic (cherokee_validator_htdigest_t *htdigest, cherokee_connection_t *
 
 
 static ret_t
-validate_digest (cherokee_validator_htdigest_t *htdigest, cherokee_connection_t *conn, cherokee_buffer_t *file)
+validate_digest (cherokee_validator_htdigest_t *htdigest, cherokee_connection_t *conn, cherokee_buffer_t *entry)
 {
 	int                re;
 	ret_t              ret;
-	char              *user   = NULL;
 	char              *realm  = NULL;
 	char              *passwd = NULL;
 	cherokee_buffer_t  buf    = CHEROKEE_BUF_INIT;
@@ -204,7 +168,7 @@ validate_digest (cherokee_validator_htdigest_t *htdigest, cherokee_connection_t
 
 	/* Extact the right entry information
 	 */
-	ret = extract_user_entry (file, conn->validator->user.buf, &user, &realm, &passwd);
+	ret = split_entry (entry, &realm, &passwd);
 	if (unlikely(ret != ret_ok))
 		return ret;
 
@@ -231,7 +195,7 @@ cherokee_validator_htdigest_check (cherokee_validator_htdigest_t *htdigest,
 {
 	ret_t              ret;
 	cherokee_buffer_t *fpass;
-	cherokee_buffer_t  file = CHEROKEE_BUF_INIT;
+	cherokee_buffer_t  entry = CHEROKEE_BUF_INIT;
 
 	/* Ensure that we have all what we need
 	 */
@@ -248,28 +212,31 @@ cherokee_validator_htdigest_check (cherokee_validator_htdigest_t *htdigest,
 		goto out;
 	}
 
-	/* Read the whole file
+	/* Look up the user entry
 	 */
-	ret = cherokee_buffer_read_file (&file, fpass->buf);
-	if (ret != ret_ok) {
-		ret = ret_error;
+	ret = cherokee_validator_file_get_entry (VFILE(htdigest), fpass,
+						 &conn->validator->user, &entry);
+	if (ret == ret_error) {
+		goto out;
+	} else if (ret != ret_ok) {
+		ret = ret_not_found;
 		goto out;
 	}
 
 	/* Authenticate
 	 */
 	if (conn->req_auth_type & http_auth_basic) {
-		ret = validate_basic (htdigest, conn, &file);
+		ret = validate_basic (htdigest, conn, &entry);
 
 	} else if (conn->req_auth_type & http_auth_digest) {
-		ret = validate_digest (htdigest, conn, &file);
+		ret = validate_digest (htdigest, conn, &entry);
 
 	} else {
 		SHOULDNT_HAPPEN;
 	}
 
 out:
-	cherokee_buffer_mrproper (&file);
+	cherokee_buffer_mrproper (&entry);
 	return ret;
 }
 
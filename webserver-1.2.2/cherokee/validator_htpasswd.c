@@ -37,7 +37,21 @@
 #include "md5crypt.h"
 #include "util.h"
 
+#define ENTRIES           "validator,htpasswd"
 #define CRYPT_SALT_LENGTH 2
+#define VERIFIED_MAX_LEN  1024
+
+
+/* Private type: verified credentials
+ */
+struct verified_entry {
+	cherokee_list_t   lru;
+	cherokee_buffer_t key;
+	unsigned char     digest[CHEROKEE_VALIDATOR_DIGEST_LEN];
+};
+typedef struct verified_entry verified_entry_t;
+
+#define VERIFIED(x) ((verified_entry_t *)(x))
 
 
 /* Plug-in initialization
@@ -45,9 +59,138 @@
 PLUGIN_INFO_VALIDATOR_EASIEST_INIT (htpasswd, http_auth_basic);
 
 
+/* Verified credentials cache: the users whose password has been
+ * checked lately are kept, along with a keyed digest of the stored
+ * hash and the password, so their following requests do not have to
+ * go through crypt() again. A changed password file entry changes
+ * the digest, so stale entries never match.
+ */
+static void
+verified_init (cherokee_htpasswd_verified_t *verified)
+{
+	cherokee_avl_init (&verified->table);
+	INIT_LIST_HEAD (&verified->lru);
+
+	verified->len        = 0;
+	verified->max_len    = VERIFIED_MAX_LEN;
+	verified->count_hit  = 0;
+	verified->count_miss = 0;
+
+	cherokee_validator_secret_init (verified->secret, sizeof(verified->secret));
+	CHEROKEE_MUTEX_INIT (&verified->mutex, CHEROKEE_MUTEX_FAST);
+}
+
+static void
+verified_mrproper (cherokee_htpasswd_verified_t *verified)
+{
+	cherokee_list_t *i, *tmp;
+
+	list_for_each_safe (i, tmp, &verified->lru) {
+		cherokee_list_del (i);
+		cherokee_buffer_mrproper (&VERIFIED(i)->key);
+		free (i);
+	}
+
+	cherokee_avl_mrproper (&verified->table, NULL);
+	CHEROKEE_MUTEX_DESTROY (&verified->mutex);
+
+	memset (verified->secret, 0, sizeof(verified->secret));
+}
+
+static ret_t
+verified_check (cherokee_htpasswd_verified_t *verified,
+		cherokee_buffer_t            *key,
+		unsigned char                 digest[CHEROKEE_VALIDATOR_DIGEST_LEN])
+{
+	ret_t             ret;
+	verified_entry_t *entry = NULL;
+
+	CHEROKEE_MUTEX_LOCK (&verified->mutex);
+
+	ret = cherokee_avl_get (&verified->table, key, (void **)&entry);
+	if ((ret == ret_ok) &&
+	    (memcmp (entry->digest, digest, CHEROKEE_VALIDATOR_DIGEST_LEN) == 0))
+	{
+		cherokee_list_del (&entry->lru);
+		cherokee_list_add (&entry->lru, &verified->lru);
+
+		verified->count_hit += 1;
+		ret = ret_ok;
+	} else {
+		verified->count_miss += 1;
+		ret = ret_not_found;
+	}
+
+	TRACE (ENTRIES, "Verified %s: '%s' (hits=%d, misses=%d)\n",
+	       (ret == ret_ok) ? "hit" : "miss", key->buf,
+	       verified->count_hit, verified->count_miss);
+
+	CHEROKEE_MUTEX_UNLOCK (&verified->mutex);
+	return ret;
+}
+
+static void
+verified_add (cherokee_htpasswd_verified_t *verified,
+	      cherokee_buffer_t            *key,
+	      unsigned char                 digest[CHEROKEE_VALIDATOR_DIGEST_LEN])
+{
+	ret_t             ret;
+	verified_entry_t *entry = NULL;
+
+	CHEROKEE_MUTEX_LOCK (&verified->mutex);
+
+	/* Update the entry of a changed password
+	 */
+	ret = cherokee_avl_get (&verified->table, key, (void **)&entry);
+	if (ret == ret_ok) {
+		memcpy (entry->digest, digest, CHEROKEE_VALIDATOR_DIGEST_LEN);
+
+		cherokee_list_del (&entry->lru);
+		cherokee_list_add (&entry->lru, &verified->lru);
+		goto out;
+	}
+
+	/* Reuse the least recently verified entry if it is full
+	 */
+	if (verified->len >= verified->max_len) {
+		entry = VERIFIED(verified->lru.prev);
+
+		cherokee_list_del (&entry->lru);
+		cherokee_avl_del (&verified->table, &entry->key, NULL);
+		cherokee_buffer_clean (&entry->key);
+
+		verified->len -= 1;
+	} else {
+		entry = (verified_entry_t *) malloc (sizeof(verified_entry_t));
+		if (unlikely (entry == NULL))
+			goto out;
+
+		INIT_LIST_HEAD (&entry->lru);
+		cherokee_buffer_init (&entry->key);
+	}
+
+	cherokee_buffer_add_buffer (&entry->key, key);
+	memcpy (entry->digest, digest, CHEROKEE_VALIDATOR_DIGEST_LEN);
+
+	ret = cherokee_avl_add (&verified->table, &entry->key, entry);
+	if (unlikely (ret != ret_ok)) {
+		cherokee_buffer_mrproper (&entry->key);
+		free (entry);
+		goto out;
+	}
+
+	cherokee_list_add (&entry->lru, &verified->lru);
+	verified->len += 1;
+
+out:
+	CHEROKEE_MUTEX_UNLOCK (&verified->mutex);
+}
+
+
 static ret_t
 props_free (cherokee_validator_htpasswd_props_t *props)
 {
+	verified_mrproper (&props->verified);
 	return cherokee_validator_file_props_free_base (PROP_VFILE(props));
 }
 
@@ -57,6 +200,8 @@ cherokee_validator_htpasswd_configure (cherokee_config_node_t   *conf,
 				       cherokee_server_t        *srv,
 				       cherokee_module_props_t **_props)
 {
+	ret_t                                ret;
+	int                                  val;
 	cherokee_validator_htpasswd_props_t *props;
 
 	UNUSED(srv);
@@ -65,11 +210,19 @@ cherokee_validator_htpasswd_configure (cherokee_config_node_t   *conf,
 		CHEROKEE_NEW_STRUCT (n, validator_htpasswd_props);
 		cherokee_validator_file_props_init_base (PROP_VFILE(n),
 							 MODULE_PROPS_FREE(props_free));
+		verified_init (&n->verified);
 		*_props = MODULE_PROPS(n);
 	}
 
 	props = PROP_HTPASSWD(*_props);
 
+	/* Verified credentials cache
+	 */
+	ret = cherokee_config_node_read_int (conf, "cache!verified", &val);
+	if ((ret == ret_ok) && (val >= 0)) {
+		props->verified.max_len = val;
+	}
+
 	/* Call the file based validator configure
 	 */
 	return cherokee_validator_file_configure (conf, srv, _props);
@@ -265,18 +418,51 @@ request_isnt_passwd_file (cherokee_validator_htpasswd_t *htpasswd,
 }
 
 
+static ret_t
+validate_entry (cherokee_connection_t *conn, char *cryp)
+{
+	ret_t ret_auth;
+
+	/* Check the type of the crypted password:
+	 * It recognizes: Apache MD5, MD5, SHA, old crypt and plain text
+	 */
+	if (strncmp (cryp, "$apr1$", 6) == 0) {
+		const char *magic = "$apr1$";
+		ret_auth = validate_md5 (conn, magic, cryp);
+
+	} else if (strncmp (cryp, "$1$", 3) == 0) {
+		const char *magic = "$1$";
+		ret_auth = validate_md5 (conn, magic, cryp);
+
+	} else if (strncmp (cryp, "{SHA}", 5) == 0) {
+		ret_auth = validate_non_salted_sha (conn, cryp + 5);
+
+	} else if (strlen (cryp) == 13) {
+		ret_auth = validate_crypt (conn, cryp);
+
+		if (ret_auth == ret_deny) {
+			ret_auth = validate_plain (conn, cryp);
+		}
+	} else {
+		ret_auth = validate_plain (conn, cryp);
+	}
+
+	return ret_auth;
+}
+
+
 ret_t
 cherokee_validator_htpasswd_check (cherokee_validator_htpasswd_t *htpasswd,
 				   cherokee_connection_t         *conn)
 {
-	FILE              *f;
-	int                len;
-	char              *cryp;
-	int                cryp_len;
-	ret_t              ret;
-	ret_t              ret_auth;
-	cherokee_buffer_t *fpass;
-	CHEROKEE_TEMP(line, 128);
+	ret_t                                ret;
+	ret_t                                ret_auth;
+	cherokee_buffer_t                   *fpass;
+	cherokee_boolean_t                   use_verified;
+	unsigned char                        digest[CHEROKEE_VALIDATOR_DIGEST_LEN];
+	cherokee_buffer_t                    cryp   = CHEROKEE_BUF_INIT;
+	cherokee_buffer_t                    key    = CHEROKEE_BUF_INIT;
+	cherokee_validator_htpasswd_props_t *props  = VAL_HTPASSWD_PROP(htpasswd);
 
 	/* Sanity checks
 	 */
@@ -297,91 +483,53 @@ cherokee_validator_htpasswd_check (cherokee_validator_htpasswd_t *htpasswd,
 
 	/* 1.- Check the login/passwd
 	 */
-	f = fopen (fpass->buf, "r");
-	if (f == NULL) {
-		return ret_error;
+	ret = cherokee_validator_file_get_entry (VFILE(htpasswd), fpass,
+						 &conn->validator->user, &cryp);
+	if (ret != ret_ok) {
+		ret = ret_error;
+		goto out;
 	}
 
-	cherokee_fd_set_closexec (fileno(f));
-
-	ret      = ret_error;
-	ret_auth = ret_error;
-
-	while (!feof(f)) {
-		if (fgets (line, line_size, f) == NULL)
-			continue;
-
-		len = strlen (line);
-
-		if (len <= 0)
-			continue;
-
-		if (line[0] == '#')
-			continue;
-
-		if (line[len-1] == '\n')
-			line[len-1] = '\0';
-
-		/* Split into user and encrypted password.
-		 */
-		cryp = strchr (line, ':');
-		if (cryp == NULL) continue;
-		*cryp++ = '\0';
-		cryp_len = strlen(cryp);
-
-		/* Is this the right user?
-		 */
-		if (strcmp (conn->validator->user.buf, line) != 0) {
-			continue;
-		}
-
-		/* Check the type of the crypted password:
-		 * It recognizes: Apache MD5, MD5, SHA, old crypt and plain text
-		 */
-		if (strncmp (cryp, "$apr1$", 6) == 0) {
-			const char *magic = "$apr1$";
-			ret_auth = validate_md5 (conn, magic, cryp);
-
-		} else if (strncmp (cryp, "$1$", 3) == 0) {
-			const char *magic = "$1$";
-			ret_auth = validate_md5 (conn, magic, cryp);
-
-		} else if (strncmp (cryp, "{SHA}", 5) == 0) {
-			ret_auth = validate_non_salted_sha (conn, cryp + 5);
+	/* Was it verified lately?
+	 */
+	ret_auth     = ret_error;
+	use_verified = (PROP_VFILE(props)->use_cache &&
+			(props->verified.max_len > 0));
+
+	if (use_verified) {
+		cherokee_buffer_add_buffer (&key, fpass);
+		cherokee_buffer_add_char   (&key, ':');
+		cherokee_buffer_add_buffer (&key, &conn->validator->user);
+
+		cherokee_validator_hmac (props->verified.secret, &cryp,
+					 &conn->validator->passwd, digest);
+		ret_auth = verified_check (&props->verified, &key, digest);
+	}
 
-		} else if (cryp_len == 13) {
-			ret_auth = validate_crypt (conn, cryp);
+	if (ret_auth != ret_ok) {
+		ret_auth = validate_entry (conn, cryp.buf);
 
-			if (ret_auth == ret_deny) {
-				ret_auth = validate_plain (conn, cryp);
-			}
-		} else {
-			ret_auth = validate_plain (conn, cryp);
+		if ((ret_auth == ret_ok) && (use_verified)) {
+			verified_add (&props->verified, &key, digest);
 		}
-
-		if (ret_auth == ret_deny)
-			continue;
-
-		/* ret_ok, or ret_error */
-		break;
 	}
 
-	fclose(f);
-
 	/* Check the authentication returned value
 	 */
 	if (ret_auth < ret_ok) {
-		return ret_auth;
+		ret = ret_auth;
+		goto out;
 	}
 
 	/* 2.- Security check:
 	 * Is the client trying to download the passwd file?
 	 */
 	ret = request_isnt_passwd_file (htpasswd, conn, fpass);
-	if (ret != ret_ok)
-		return ret;
 
-	return ret_ok;
+out:
+	cherokee_buffer_mrproper (&cryp);
+	cherokee_buffer_mrproper (&key);
+	return ret;
 }
 
 
@@ -27,9 +27,23 @@
 
 #include "validator_file.h"
 #include "connection.h"
+#include "avl.h"
+#include "list.h"
+
+typedef struct {
+	cherokee_avl_t                  table;
+	cherokee_list_t                 lru;
+	cuint_t                         len;
+	cuint_t                         max_len;
+	cuint_t                         count_hit;
+	cuint_t                         count_miss;
+	unsigned char                   secret[CHEROKEE_VALIDATOR_SECRET_LEN];
+	CHEROKEE_MUTEX_T               (mutex);
+} cherokee_htpasswd_verified_t;
 
 typedef struct {
 	cherokee_validator_file_props_t base;
+	cherokee_htpasswd_verified_t    verified;
 } cherokee_validator_htpasswd_props_t;
 
 typedef struct {
@@ -45,9 +45,25 @@
 PLUGIN_INFO_VALIDATOR_EASIEST_INIT (ldap, http_auth_basic);
 
 
+/* Back-end connection: the search handle is bound as bind_dn, and
+ * the bind handle is re-bound as every user to be checked.
+ */
+typedef struct {
+	LDAP *search;
+	LDAP *bind;
+} ldap_backend_t;
+
+static ret_t backend_connect (cherokee_validator_ldap_props_t *props, ldap_backend_t **backend);
+static void  backend_close   (cherokee_validator_ldap_props_t *props, ldap_backend_t  *backend);
+static ret_t backend_query   (cherokee_validator_ldap_props_t *props, ldap_backend_t  *backend,
+			      cherokee_buffer_t *user, cherokee_buffer_t *passwd, cherokee_buffer_t *result);
+
+
 static ret_t
 props_free (cherokee_validator_ldap_props_t *props)
 {
+	cherokee_validator_backend_mrproper (&props->backend);
+
 	cherokee_buffer_mrproper (&props->server);
 	cherokee_buffer_mrproper (&props->binddn);
 	cherokee_buffer_mrproper (&props->bindpw);
@@ -82,6 +98,11 @@ cherokee_validator_ldap_configure (cherokee_config_node_t *conf, cherokee_server
 		cherokee_buffer_init (&n->filter);
 		cherokee_buffer_init (&n->ca_file);
 
+		cherokee_validator_backend_init (&n->backend, n,
+						 (validator_backend_func_connect_t) backend_connect,
+						 (validator_backend_func_close_t)   backend_close,
+						 (validator_backend_func_query_t)   backend_query);
+
 		*_props = MODULE_PROPS(n);
 	}
 
@@ -115,7 +136,9 @@ cherokee_validator_ldap_configure (cherokee_config_node_t *conf, cherokee_server
 			cherokee_buffer_add_buffer (&props->ca_file, &subconf->val);
 
 		} else if (equal_buf_str (&subconf->key, "methods") ||
-			   equal_buf_str (&subconf->key, "realm")) {
+			   equal_buf_str (&subconf->key, "realm")   ||
+			   equal_buf_str (&subconf->key, "pool")    ||
+			   equal_buf_str (&subconf->key, "cache")) {
 			/* Not handled here
 			 */
 		} else {
@@ -124,6 +147,10 @@ cherokee_validator_ldap_configure (cherokee_config_node_t *conf, cherokee_server
 		}
 	}
 
+	/* Connection pool and results cache
+	 */
+	cherokee_validator_backend_configure (&props->backend, conf);
+
 	/* Checks
 	 */
 	if (cherokee_buffer_is_empty (&props->basedn)) {
@@ -151,30 +178,26 @@ cherokee_validator_ldap_configure (cherokee_config_node_t *conf, cherokee_server
 
 
 static ret_t
-init_ldap_connection (cherokee_validator_ldap_t *ldap, cherokee_validator_ldap_props_t *props)
+backend_open (cherokee_validator_ldap_props_t *props, LDAP **conn)
 {
 	int re;
 	int val;
 
-	/* Connect
-	 */
-	ldap->conn = ldap_init (props->server.buf, props->port);
-	if (ldap->conn == NULL) {
+	*conn = ldap_init (props->server.buf, props->port);
+	if (*conn == NULL) {
 		LOG_ERRNO (errno, cherokee_err_critical,
 			   CHEROKEE_ERROR_VALIDATOR_LDAP_CONNECT,
 			   props->server.buf, props->port);
 		return ret_error;
 	}
 
-	TRACE (ENTRIES, "Connected to %s:%d\n", props->server.buf, props->port);
-
 	/* Set LDAP protocol version
 	 */
 	val = LDAP_VERSION3;
-	re = ldap_set_option (ldap->conn, LDAP_OPT_PROTOCOL_VERSION, &val);
+	re = ldap_set_option (*conn, LDAP_OPT_PROTOCOL_VERSION, &val);
 	if (re != LDAP_OPT_SUCCESS) {
 		LOG_ERROR (CHEROKEE_ERROR_VALIDATOR_LDAP_V3, ldap_err2string(re));
-		return ret_error;
+		goto error;
 	}
 
 	TRACE (ENTRIES, "LDAP protocol version %d set\n", LDAP_VERSION3);
@@ -182,143 +205,237 @@ init_ldap_connection (cherokee_validator_ldap_t *ldap, cherokee_validator_ldap_p
 	/* Secure connections
 	 */
 	if (props->tls) {
+#ifdef LDAP_HAVE_START_TLS_S
+		re = ldap_start_tls_s (*conn, NULL,  NULL);
+		if (re != LDAP_OPT_SUCCESS) {
+			TRACE (ENTRIES, "Couldn't StartTLS\n");
+			goto error;
+		}
+#else
+		LOG_ERROR_S (CHEROKEE_ERROR_VALIDATOR_LDAP_STARTTLS);
+#endif
+	}
+
+	return ret_ok;
+
+error:
+	ldap_unbind_s (*conn);
+	*conn = NULL;
+	return ret_error;
+}
+
+
+static ret_t
+backend_connect (cherokee_validator_ldap_props_t *props, ldap_backend_t **backend)
+{
+	int             re;
+	ret_t           ret;
+	ldap_backend_t *n;
+
+	n = (ldap_backend_t *) malloc (sizeof(ldap_backend_t));
+	if (unlikely (n == NULL))
+		return ret_nomem;
+
+	n->search = NULL;
+	n->bind   = NULL;
+
+	/* CA file
+	 */
+	if (props->tls) {
 #ifdef LDAP_OPT_X_TLS
 		if (! cherokee_buffer_is_empty (&props->ca_file)) {
 			re = ldap_set_option (NULL, LDAP_OPT_X_TLS_CACERTFILE, props->ca_file.buf);
 			if (re != LDAP_OPT_SUCCESS) {
 				LOG_CRITICAL (CHEROKEE_ERROR_VALIDATOR_LDAP_CA,
 					      props->ca_file.buf, ldap_err2string (re));
-				return ret_error;
+				goto error;
 			}
 		}
-#else
-		LOG_ERROR_S (CHEROKEE_ERROR_VALIDATOR_LDAP_STARTTLS);
 #endif
 	}
 
-	/* Bind
+	/* Search connection
 	 */
+	ret = backend_open (props, &n->search);
+	if (ret != ret_ok)
+		goto error;
+
 	if (cherokee_buffer_is_empty (&props->binddn)) {
 		TRACE (ENTRIES, "anonymous bind %s", "\n");
-		re = ldap_simple_bind_s (ldap->conn, NULL, NULL);
+		re = ldap_simple_bind_s (n->search, NULL, NULL);
 	} else {
 		TRACE (ENTRIES, "bind user=%s password=%s\n",
 		       props->binddn.buf, props->bindpw.buf);
-		re = ldap_simple_bind_s (ldap->conn, props->binddn.buf, props->bindpw.buf);
+		re = ldap_simple_bind_s (n->search, props->binddn.buf, props->bindpw.buf);
 	}
 
 	if (re != LDAP_SUCCESS) {
 		LOG_CRITICAL (CHEROKEE_ERROR_VALIDATOR_LDAP_BIND,
 			      props->server.buf, props->port, props->binddn.buf,
 			      props->bindpw.buf, ldap_err2string(re));
-		return ret_error;
+		goto error;
 	}
 
-	return ret_ok;
-}
+	/* Users connection
+	 */
+	ret = backend_open (props, &n->bind);
+	if (ret != ret_ok)
+		goto error;
 
+	TRACE (ENTRIES, "Connected to %s:%d\n", props->server.buf, props->port);
 
-ret_t
-cherokee_validator_ldap_new (cherokee_validator_ldap_t **ldap, cherokee_module_props_t *props)
-{
-	ret_t ret;
-	CHEROKEE_NEW_STRUCT(n,validator_ldap);
+	*backend = n;
+	return ret_ok;
 
-	/* Init
-	 */
-	cherokee_validator_init_base (VALIDATOR(n), VALIDATOR_PROPS(props), PLUGIN_INFO_VALIDATOR_PTR(ldap));
-	VALIDATOR(n)->support = http_auth_basic;
+error:
+	backend_close (props, n);
+	return ret_error;
+}
 
-	MODULE(n)->free           = (module_func_free_t)           cherokee_validator_ldap_free;
-	VALIDATOR(n)->check       = (validator_func_check_t)       cherokee_validator_ldap_check;
-	VALIDATOR(n)->add_headers = (validator_func_add_headers_t) cherokee_validator_ldap_add_headers;
 
-	/* Init properties
-	 */
-	cherokee_buffer_init (&n->filter);
+static void
+backend_close (cherokee_validator_ldap_props_t *props, ldap_backend_t *backend)
+{
+	UNUSED (props);
 
-	/* Connect to the LDAP server
-	 */
-	ret = init_ldap_connection (n, PROP_LDAP(props));
-	if (ret != ret_ok) {
-		cherokee_validator_ldap_free (n);
-		return ret;
+	if (backend->search != NULL) {
+		ldap_unbind_s (backend->search);
 	}
 
-	*ldap = n;
-	return ret_ok;
-}
+	if (backend->bind != NULL) {
+		ldap_unbind_s (backend->bind);
+	}
 
-ret_t
-cherokee_validator_ldap_free (cherokee_validator_ldap_t *ldap)
-{
-	cherokee_buffer_mrproper (&ldap->filter);
-	return ret_ok;
+	free (backend);
 }
 
 
 static ret_t
-validate_dn (cherokee_validator_ldap_props_t *props, char *dn, char *password)
+backend_query (cherokee_validator_ldap_props_t *props,
+	       ldap_backend_t                  *backend,
+	       cherokee_buffer_t               *user,
+	       cherokee_buffer_t               *passwd,
+	       cherokee_buffer_t               *result)
 {
-	int   re;
-	int   val;
-	LDAP *conn;
+	int                re;
+	ret_t              ret;
+	char              *dn;
+	LDAPMessage       *message = NULL;
+	LDAPMessage       *first;
+	char              *attrs[] = { LDAP_NO_ATTRS, NULL };
+	cherokee_buffer_t  filter  = CHEROKEE_BUF_INIT;
 
-	conn = ldap_init (props->server.buf, props->port);
-	if (conn == NULL) return ret_error;
+	UNUSED (result);
 
-	val = LDAP_VERSION3;
-	re = ldap_set_option (conn, LDAP_OPT_PROTOCOL_VERSION, &val);
-	if (re != LDAP_OPT_SUCCESS)
-		goto error;
+	/* Build filter
+	 */
+	cherokee_buffer_ensure_size (&filter, props->filter.len + user->len);
+	cherokee_buffer_add_buffer (&filter, &props->filter);
+	cherokee_buffer_replace_string (&filter, "${user}", 7, user->buf, user->len);
 
-	if (props->tls) {
-#ifdef LDAP_HAVE_START_TLS_S
-		re = ldap_start_tls_s (conn, NULL,  NULL);
-		if (re != LDAP_OPT_SUCCESS) {
-			TRACE (ENTRIES, "Couldn't StartTLS\n");
-			goto error;
-		}
-#else
-		LOG_ERROR_S (CHEROKEE_ERROR_VALIDATOR_LDAP_STARTTLS);
-#endif
+	TRACE (ENTRIES, "filter %s\n", filter.buf);
+
+	/* Search
+	 */
+	re = ldap_search_s (backend->search, props->basedn.buf, LDAP_SCOPE_SUBTREE, filter.buf, attrs, 0, &message);
+	if (re != LDAP_SUCCESS) {
+		LOG_ERROR (CHEROKEE_ERROR_VALIDATOR_LDAP_SEARCH, props->filter.buf);
+		ret = ret_error;
+		goto out;
 	}
 
-	re = ldap_simple_bind_s (conn, dn, password);
-	if (re != LDAP_SUCCESS)
-		goto error;
+	TRACE (ENTRIES, "subtree search (%s): done\n", filter.buf);
 
-	return ret_ok;
+	/* Check that there a single entry
+	 */
+	re = ldap_count_entries (backend->search, message);
+	if (re != 1) {
+		ret = ret_not_found;
+		goto out;
+	}
 
-error:
-	ldap_unbind_s (conn);
-	return ret_error;
+	/* Pick up the first one
+	 */
+	first = ldap_first_entry (backend->search, message);
+	if (first == NULL) {
+		ret = ret_not_found;
+		goto out;
+	}
+
+	/* Get DN
+	 */
+	dn = ldap_get_dn (backend->search, first);
+	if (dn == NULL) {
+		ret = ret_error;
+		goto out;
+	}
+
+	/* Check that it's right
+	 */
+	re = ldap_simple_bind_s (backend->bind, dn, passwd->buf);
+	ldap_memfree (dn);
+
+	switch (re) {
+	case LDAP_SUCCESS:
+		ret = ret_ok;
+		break;
+	case LDAP_SERVER_DOWN:
+	case LDAP_CONNECT_ERROR:
+	case LDAP_TIMEOUT:
+		ret = ret_error;
+		break;
+	default:
+		ret = ret_deny;
+	}
+
+out:
+	if (message != NULL) {
+		ldap_msgfree (message);
+	}
+
+	cherokee_buffer_mrproper (&filter);
+	return ret;
 }
 
 
-static ret_t
-init_filter (cherokee_validator_ldap_t *ldap, cherokee_validator_ldap_props_t *props, cherokee_connection_t *conn)
+ret_t
+cherokee_validator_ldap_new (cherokee_validator_ldap_t **ldap, cherokee_module_props_t *props)
 {
-	cherokee_buffer_ensure_size (&ldap->filter, props->filter.len + conn->validator->user.len);
-	cherokee_buffer_add_buffer (&ldap->filter, &props->filter);
-	cherokee_buffer_replace_string (&ldap->filter, "${user}", 7, conn->validator->user.buf, conn->validator->user.len);
+	CHEROKEE_NEW_STRUCT(n,validator_ldap);
+
+	/* Init
+	 */
+	cherokee_validator_init_base (VALIDATOR(n), VALIDATOR_PROPS(props), PLUGIN_INFO_VALIDATOR_PTR(ldap));
+	VALIDATOR(n)->support = http_auth_basic;
+
+	MODULE(n)->free           = (module_func_free_t)           cherokee_validator_ldap_free;
+	VALIDATOR(n)->check       = (validator_func_check_t)       cherokee_validator_ldap_check;
+	VALIDATOR(n)->add_headers = (validator_func_add_headers_t) cherokee_validator_ldap_add_headers;
 
-	TRACE (ENTRIES, "filter %s\n", ldap->filter.buf);
+	/* Init properties: the LDAP server is reached through the
+	 * connection pool of the properties.
+	 */
+	n->job = NULL;
 
+	*ldap = n;
 	return ret_ok;
 }
 
+ret_t
+cherokee_validator_ldap_free (cherokee_validator_ldap_t *ldap)
+{
+	cherokee_validator_backend_cancel (&VAL_LDAP_PROP(ldap)->backend, &ldap->job);
+	return cherokee_validator_free_base (VALIDATOR(ldap));
+}
+
 
 ret_t
 cherokee_validator_ldap_check (cherokee_validator_ldap_t *ldap, cherokee_connection_t *conn)
 {
-	int                              re;
 	ret_t                            ret;
 	size_t                           size;
-	char                            *dn;
-	LDAPMessage                     *message;
-	LDAPMessage                     *first;
-	char                            *attrs[] = { LDAP_NO_ATTRS, NULL };
+	cherokee_buffer_t                key     = CHEROKEE_BUF_INIT;
+	cherokee_buffer_t                result  = CHEROKEE_BUF_INIT;
 	cherokee_validator_ldap_props_t *props   = VAL_LDAP_PROP(ldap);
 
 	/* Sanity checks
@@ -331,60 +448,37 @@ cherokee_validator_ldap_check (cherokee_validator_ldap_t *ldap, cherokee_connect
 	if (size != conn->validator->user.len)
 		return ret_error;
 
-	/* Build filter
-	 */
-	ret = init_filter (ldap, props, conn);
-	if (ret != ret_ok)
-		return ret;
-
-	/* Search
+	/* An empty password would be an unauthenticated bind, which
+	 * many servers accept (RFC 4513, section 5.1.2).
 	 */
-	re = ldap_search_s (ldap->conn, props->basedn.buf, LDAP_SCOPE_SUBTREE, ldap->filter.buf, attrs, 0, &message);
-	if (re != LDAP_SUCCESS) {
-		LOG_ERROR (CHEROKEE_ERROR_VALIDATOR_LDAP_SEARCH, props->filter.buf);
+	if (cherokee_buffer_is_empty (&conn->validator->passwd))
 		return ret_error;
-	}
-
-	TRACE (ENTRIES, "subtree search (%s): done\n", ldap->filter.buf);
 
-	/* Check that there a single entry
+	/* Cache key: a keyed digest of the user and its password
 	 */
-	re = ldap_count_entries (ldap->conn, message);
-	if (re != 1) {
-		ldap_msgfree (message);
-		return ret_not_found;
-	}
+	cherokee_validator_backend_cache_key (&props->backend,
+					      &conn->validator->user,
+					      &conn->validator->passwd, &key);
 
-	/* Pick up the first one
-	 */
-	first = ldap_first_entry (ldap->conn, message);
-	if (first == NULL) {
-		ldap_msgfree (message);
-		return ret_not_found;
-	}
-
-	/* Get DN
+	/* Ask the LDAP server, or the cache
 	 */
-	dn = ldap_get_dn (ldap->conn, first);
-	if (dn == NULL) {
-		ldap_msgfree (message);
+	ret = cherokee_validator_backend_query (&props->backend, conn, &ldap->job, &key,
+						&conn->validator->user,
+						&conn->validator->passwd, &result);
+
+	cherokee_buffer_mrproper (&key);
+	cherokee_buffer_mrproper (&result);
+
+	switch (ret) {
+	case ret_ok:
+		break;
+	case ret_eagain:
+		return ret_eagain;
+	default:
+		TRACE (ENTRIES, "User %s did not properly authenticate\n", conn->validator->user.buf);
 		return ret_error;
 	}
 
-	ldap_msgfree (message);
-
-	/* Check that it's right
-	 */
-	ret = validate_dn (props, dn, conn->validator->passwd.buf);
-	if (ret != ret_ok)
-		return ret;
-
-	/* Disconnect from the LDAP server
-	 */
-	re = ldap_unbind_s (ldap->conn);
-	if (re != LDAP_SUCCESS)
-		return ret_error;
-
 	/* Validated!
 	 */
 	TRACE (ENTRIES, "Access to use %s has been granted\n", conn->validator->user.buf);
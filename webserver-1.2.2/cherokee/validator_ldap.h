@@ -34,6 +34,7 @@
 #include "ldap.h"
 
 #include "validator.h"
+#include "validator_backend.h"
 #include "connection.h"
 
 
@@ -50,12 +51,13 @@ typedef struct {
 
 	cherokee_boolean_t         tls;
 	cherokee_buffer_t          ca_file;
+
+	cherokee_validator_backend_t backend;
 } cherokee_validator_ldap_props_t;
 
 typedef struct {
 	cherokee_validator_t       validator;
-	LDAP                      *conn;
-	cherokee_buffer_t          filter;
+	cherokee_validator_job_t  *job;
 } cherokee_validator_ldap_t;
 
 #define LDAP(x)          ((cherokee_validator_ldap_t *)(x))
@@ -38,10 +38,19 @@
  */
 PLUGIN_INFO_VALIDATOR_EASIEST_INIT (mysql, http_auth_basic | http_auth_digest);
 
+static ret_t backend_thread_init (cherokee_validator_mysql_props_t *props);
+static void  backend_thread_end  (cherokee_validator_mysql_props_t *props);
+static ret_t backend_connect (cherokee_validator_mysql_props_t *props, MYSQL **backend);
+static void  backend_close   (cherokee_validator_mysql_props_t *props, MYSQL  *backend);
+static ret_t backend_query   (cherokee_validator_mysql_props_t *props, MYSQL  *backend,
+			      cherokee_buffer_t *user, cherokee_buffer_t *passwd, cherokee_buffer_t *result);
+
 
 static ret_t
 props_free (cherokee_validator_mysql_props_t *props)
 {
+	cherokee_validator_backend_mrproper (&props->backend);
+
 	cherokee_buffer_mrproper (&props->host);
 	cherokee_buffer_mrproper (&props->unix_socket);
 	cherokee_buffer_mrproper (&props->user);
@@ -76,6 +85,15 @@ cherokee_validator_mysql_configure (cherokee_config_node_t *conf, cherokee_serve
 		n->port      = MYSQL_DEFAULT_PORT;
 		n->hash_type = cherokee_mysql_hash_none;
 
+		cherokee_validator_backend_init (&n->backend, n,
+						 (validator_backend_func_connect_t) backend_connect,
+						 (validator_backend_func_close_t)   backend_close,
+						 (validator_backend_func_query_t)   backend_query);
+
+		cherokee_validator_backend_set_thread_funcs (&n->backend,
+							     (validator_backend_func_thread_init_t) backend_thread_init,
+							     (validator_backend_func_thread_end_t)  backend_thread_end);
+
 		*_props = MODULE_PROPS (n);
 	}
 
@@ -118,7 +136,9 @@ cherokee_validator_mysql_configure (cherokee_config_node_t *conf, cherokee_serve
 			}
 
 		} else if ((equal_buf_str (&subconf->key, "methods") ||
-			    equal_buf_str (&subconf->key, "realm")))
+			    equal_buf_str (&subconf->key, "realm")   ||
+			    equal_buf_str (&subconf->key, "pool")    ||
+			    equal_buf_str (&subconf->key, "cache")))
 		{
 			/* not handled here
 			 */
@@ -142,27 +162,60 @@ cherokee_validator_mysql_configure (cherokee_config_node_t *conf, cherokee_serve
 		LOG_ERROR_S (CHEROKEE_ERROR_VALIDATOR_MYSQL_QUERY);
 		return ret_error;
 	}
+	if (unlikely ((props->host.buf == NULL) &&
+		      (props->unix_socket.buf == NULL))) {
+		LOG_ERROR_S (CHEROKEE_ERROR_VALIDATOR_MYSQL_SOURCE);
+		return ret_error;
+	}
+
+	/* Connection pool and results cache
+	 */
+	cherokee_validator_backend_configure (&props->backend, conf);
+
+	/* The client library has to be initialized before the
+	 * pool threads use it.
+	 */
+	mysql_library_init (0, NULL, NULL);
 
 	return ret_ok;
 }
 
 
 static ret_t
-init_mysql_connection (cherokee_validator_mysql_t *mysql, cherokee_validator_mysql_props_t *props)
+backend_thread_init (cherokee_validator_mysql_props_t *props)
 {
-	MYSQL *conn;
+	UNUSED (props);
 
-	if (unlikely ((props->host.buf == NULL) &&
-		      (props->unix_socket.buf == NULL))) {
-		LOG_ERROR_S (CHEROKEE_ERROR_VALIDATOR_MYSQL_SOURCE);
+	/* The pool threads are not created by the client library
+	 */
+	if (mysql_thread_init() != 0) {
+		LOG_ERROR_S (CHEROKEE_ERROR_VALIDATOR_MYSQL_THREAD);
 		return ret_error;
 	}
 
-	mysql->conn = mysql_init (NULL);
-	if (mysql->conn == NULL)
+	return ret_ok;
+}
+
+
+static void
+backend_thread_end (cherokee_validator_mysql_props_t *props)
+{
+	UNUSED (props);
+	mysql_thread_end();
+}
+
+
+static ret_t
+backend_connect (cherokee_validator_mysql_props_t *props, MYSQL **backend)
+{
+	MYSQL *conn;
+	MYSQL *mysql;
+
+	mysql = mysql_init (NULL);
+	if (mysql == NULL)
 		return ret_nomem;
 
-	conn = mysql_real_connect (mysql->conn,
+	conn = mysql_real_connect (mysql,
 				   props->host.buf,
 				   props->user.buf,
 				   props->passwd.buf,
@@ -171,19 +224,98 @@ init_mysql_connection (cherokee_validator_mysql_t *mysql, cherokee_validator_mys
 				   props->unix_socket.buf, 0);
 	if (conn == NULL) {
 		LOG_ERROR (CHEROKEE_ERROR_VALIDATOR_MYSQL_NOCONN,
-			   props->host.buf, props->port, mysql_error (mysql->conn));
+			   props->host.buf, props->port, mysql_error (mysql));
+		mysql_close (mysql);
 		return ret_error;
 	}
 
 	TRACE (ENTRIES, "Connected to (%s:%d)\n", props->host.buf, props->port);
+
+	*backend = mysql;
 	return ret_ok;
 }
 
 
+static void
+backend_close (cherokee_validator_mysql_props_t *props, MYSQL *backend)
+{
+	UNUSED (props);
+	mysql_close (backend);
+}
+
+
+static ret_t
+backend_query (cherokee_validator_mysql_props_t *props,
+	       MYSQL                            *backend,
+	       cherokee_buffer_t                *user,
+	       cherokee_buffer_t                *passwd,
+	       cherokee_buffer_t                *result)
+{
+	int                re;
+	ret_t              ret;
+	MYSQL_ROW          row;
+	MYSQL_RES         *res;
+	unsigned long     *lengths;
+	cherokee_buffer_t  query = CHEROKEE_BUF_INIT;
+
+	UNUSED (passwd);
+
+	/* Build query
+	 */
+	cherokee_buffer_add_buffer (&query, &props->query);
+	cherokee_buffer_replace_string (&query, "${user}", 7, user->buf, user->len);
+
+	TRACE (ENTRIES, "Query: %s\n", query.buf);
+
+	/* Execute query
+	 */
+	re = mysql_query (backend, query.buf);
+	if (re != 0) {
+		TRACE (ENTRIES, "Unable to execute authenication query: %s\n", mysql_error (backend));
+		ret = ret_error;
+		goto out;
+	}
+
+	res = mysql_store_result (backend);
+	if (res == NULL) {
+		ret = ret_error;
+		goto out;
+	}
+
+	re = mysql_num_rows (res);
+	if (re <= 0) {
+		TRACE (ENTRIES, "User %s was not found\n", user->buf);
+		ret = ret_not_found;
+
+	} else if  (re > 1) {
+		TRACE (ENTRIES, "The user %s is not unique in the DB\n", user->buf);
+		ret = ret_deny;
+
+	} else {
+		/* Copy the user information
+		 */
+		row     = mysql_fetch_row (res);
+		lengths = mysql_fetch_lengths (res);
+
+		if ((row == NULL) || (row[0] == NULL)) {
+			ret = ret_not_found;
+		} else {
+			cherokee_buffer_add (result, row[0], (size_t) lengths[0]);
+			ret = ret_ok;
+		}
+	}
+
+	mysql_free_result (res);
+
+out:
+	cherokee_buffer_mrproper (&query);
+	return ret;
+}
+
+
 ret_t
 cherokee_validator_mysql_new (cherokee_validator_mysql_t **mysql, cherokee_module_props_t *props)
 {
-	ret_t ret;
 	CHEROKEE_NEW_STRUCT (n, validator_mysql);
 
 	cherokee_validator_init_base (VALIDATOR(n), VALIDATOR_PROPS(props), PLUGIN_INFO_VALIDATOR_PTR(mysql));
@@ -193,13 +325,10 @@ cherokee_validator_mysql_new (cherokee_validator_mysql_t **mysql, cherokee_modul
 	VALIDATOR(n)->check       = (validator_func_check_t)       cherokee_validator_mysql_check;
 	VALIDATOR(n)->add_headers = (validator_func_add_headers_t) cherokee_validator_mysql_add_headers;
 
-	/* Initialization
+	/* Initialization: the database is reached through the
+	 * connection pool of the properties.
 	 */
-	ret = init_mysql_connection (n, PROP_MYSQL(props));
-	if (ret != ret_ok) {
-		cherokee_validator_mysql_free (n);
-		return ret;
-	}
+	n->job = NULL;
 
 	/* Return obj
 	 */
@@ -211,11 +340,8 @@ cherokee_validator_mysql_new (cherokee_validator_mysql_t **mysql, cherokee_modul
 ret_t
 cherokee_validator_mysql_free (cherokee_validator_mysql_t *mysql)
 {
-	if (mysql->conn != NULL) {
-		mysql_close (mysql->conn);
-	}
-
-	return ret_ok;
+	cherokee_validator_backend_cancel (&VAL_MYSQL_PROP(mysql)->backend, &mysql->job);
+	return cherokee_validator_free_base (VALIDATOR(mysql));
 }
 
 
@@ -224,12 +350,8 @@ cherokee_validator_mysql_check (cherokee_validator_mysql_t *mysql, cherokee_conn
 {
 	int                               re;
 	ret_t                             ret;
-	MYSQL_ROW	                  row;
-	MYSQL_RES	                 *result;
-	unsigned long                    *lengths;
 	cherokee_buffer_t                 db_passwd   = CHEROKEE_BUF_INIT;
 	cherokee_buffer_t                 user_passwd = CHEROKEE_BUF_INIT;
-	cherokee_buffer_t                 query       = CHEROKEE_BUF_INIT;
 	cherokee_validator_mysql_props_t *props	      = VAL_MYSQL_PROP(mysql);
 
 	/* Sanity checks
@@ -251,43 +373,21 @@ cherokee_validator_mysql_check (cherokee_validator_mysql_t *mysql, cherokee_conn
 		return ret_error;
 	}
 
-	/* Build query
+	/* Fetch the password of the user, from the database or
+	 * the cache
 	 */
-	cherokee_buffer_add_buffer (&query, &props->query);
-	cherokee_buffer_replace_string (&query, "${user}", 7, conn->validator->user.buf, conn->validator->user.len);
-
-	TRACE (ENTRIES, "Query: %s\n", query.buf);
-
-	/* Execute query
-	 */
-	re = mysql_query (mysql->conn, query.buf);
-	if (re != 0) {
-		TRACE (ENTRIES, "Unable to execute authenication query: %s\n", mysql_error (mysql->conn));
-		ret = ret_error;
-		goto error;
-	}
-
-	result = mysql_store_result (mysql->conn);
-
-	re = mysql_num_rows (result);
-	if (re <= 0) {
-		TRACE (ENTRIES, "User %s was not found\n", conn->validator->user.buf);
-		ret = ret_not_found;
-		goto error;
-
-	} else if  (re > 1) {
-		TRACE (ENTRIES, "The user %s is not unique in the DB\n", conn->validator->user.buf);
-		ret = ret_deny;
+	ret = cherokee_validator_backend_query (&props->backend, conn, &mysql->job,
+						&conn->validator->user,
+						&conn->validator->user, NULL, &db_passwd);
+	switch (ret) {
+	case ret_ok:
+		break;
+	case ret_eagain:
+		return ret_eagain;
+	default:
 		goto error;
 	}
 
-	/* Copy the user information
-	 */
-	row     = mysql_fetch_row (result);
-	lengths = mysql_fetch_lengths (result);
-
-	cherokee_buffer_add (&db_passwd, row[0], (size_t) lengths[0]);
-
 	/* Check it out
 	 */
 	switch (conn->req_auth_type) {
@@ -326,15 +426,11 @@ cherokee_validator_mysql_check (cherokee_validator_mysql_t *mysql, cherokee_conn
 
 	/* Clean-up
 	 */
-	cherokee_buffer_mrproper (&query);
 	cherokee_buffer_mrproper (&db_passwd);
 	cherokee_buffer_mrproper (&user_passwd);
-
-	mysql_free_result (result);
 	return ret_ok;
 
 error:
-	cherokee_buffer_mrproper (&query);
 	cherokee_buffer_mrproper (&db_passwd);
 	cherokee_buffer_mrproper (&user_passwd);
 	return ret;
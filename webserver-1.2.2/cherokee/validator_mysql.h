@@ -26,13 +26,14 @@
 #define CHEROKEE_VALIDATOR_MYSQL_H
 
 #include "validator.h"
+#include "validator_backend.h"
 #include "connection.h"
 
 #include <mysql.h>
 
 typedef struct {
-	cherokee_validator_t	validator;
-	MYSQL		       *conn;
+	cherokee_validator_t	  validator;
+	cherokee_validator_job_t *job;
 } cherokee_validator_mysql_t;
 
 typedef enum {
@@ -54,6 +55,8 @@ typedef struct {
 	cherokee_buffer_t	query;
 
 	cherokee_mysql_hash_t   hash_type;
+
+	cherokee_validator_backend_t backend;
 } cherokee_validator_mysql_props_t;
 
 #define MYSQL(x)           ((cherokee_validator_mysql_t *)(x))
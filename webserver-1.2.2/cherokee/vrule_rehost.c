@@ -46,13 +46,12 @@ match (cherokee_vrule_rehost_t *vrule,
 	UNUSED(conn);
 
 	list_for_each (i, &vrule->pcre_list) {
-		pcre *regex = LIST_ITEM_INFO(i);
+		cherokee_regex_t *regex = LIST_ITEM_INFO(i);
 
-		re = pcre_exec (regex, NULL,
-				host->buf,
-				host->len,
-				0, 0,
-				conn->regex_host_ovector, OVECTOR_LEN);
+		re = cherokee_regex_exec (regex,
+					  host->buf,
+					  host->len,
+					  conn->regex_host_ovector, OVECTOR_LEN);
 		if (re >= 0) {
 			conn->regex_host_ovecsize = re;
 			TRACE (ENTRIES, "Host \"%s\" matched: %d variables\n", host->buf, re);
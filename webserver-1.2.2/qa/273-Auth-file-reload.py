@@ -0,0 +1,120 @@
+import os
+import time
+import base64
+
+from base import *
+
+try:
+    from hashlib import md5, sha1
+except ImportError:
+    from md5 import md5
+    from sha import sha as sha1
+
+MAGIC   = "Password files are read again when they change"
+REALM   = "realm"
+USER    = "username"
+PASSWD1 = "first_pass"
+PASSWD2 = "other_pass"
+
+CONF = """
+vserver!1!rule!2730!match = directory
+vserver!1!rule!2730!match!directory = /file_reload_htpasswd
+vserver!1!rule!2730!match!final = 0
+vserver!1!rule!2730!auth = htpasswd
+vserver!1!rule!2730!auth!methods = basic
+vserver!1!rule!2730!auth!realm = %(REALM)s
+vserver!1!rule!2730!auth!passwdfile = %(htpasswd_file)s
+
+vserver!1!rule!2731!match = directory
+vserver!1!rule!2731!match!directory = /file_reload_htdigest
+vserver!1!rule!2731!match!final = 0
+vserver!1!rule!2731!auth = htdigest
+vserver!1!rule!2731!auth!methods = basic
+vserver!1!rule!2731!auth!realm = %(REALM)s
+vserver!1!rule!2731!auth!passwdfile = %(htdigest_file)s
+"""
+
+def htpasswd_entry (passwd):
+    return "%s:{SHA}%s\n" % (USER, base64.encodestring (sha1(passwd).digest())[:-1])
+
+def htdigest_entry (passwd):
+    return "%s:%s:%s\n" % (USER, REALM, md5("%s:%s:%s" % (USER, REALM, passwd)).hexdigest())
+
+
+class TestEntry (TestBase):
+    def __init__ (self, dir, passwd, expected, rewrite=None, setup=None):
+        TestBase.__init__ (self, __file__)
+
+        auth = base64.encodestring ("%s:%s" % (USER, passwd))[:-1]
+
+        self.request        = "GET /%s/file HTTP/1.0\r\n" % (dir) + \
+                              "Authorization: Basic %s\r\n" % (auth)
+        self.expected_error = expected
+        self.rewrite        = rewrite
+        self.setup          = setup
+        self.dir            = dir
+
+        if expected == 200:
+            self.expected_content = MAGIC
+
+    def Prepare (self, www):
+        if not self.setup:
+            return
+
+        # Files dated in the past, so they are not read on every
+        # request for being too new
+        #
+        content, mtime = self.setup
+
+        tdir  = self.Mkdir (www, self.dir)
+        passf = self.WriteFile (tdir, "passwd", 0444, content)
+        os.utime (passf, (mtime, mtime))
+        self.WriteFile (tdir, "file", 0444, MAGIC)
+
+    def Run (self, host, port, ssl):
+        # Replace the password file before the request. The new
+        # one has the same size and inode, only its mtime tells
+        # them apart. Files are checked at most once a second.
+        #
+        if self.rewrite:
+            path, content, mtime = self.rewrite
+
+            os.chmod (path, 0644)
+            f = open (path, 'w')
+            f.write (content)
+            f.close()
+            os.chmod (path, 0444)
+            os.utime (path, (mtime, mtime))
+
+            time.sleep (1.1)
+
+        return TestBase.Run (self, host, port, ssl)
+
+
+class Test (TestCollection):
+    def __init__ (self):
+        TestCollection.__init__ (self)
+        self.name           = "Auth: password files read again"
+        self.proxy_suitable = True
+
+    def Prepare (self, www):
+        past = int(time.time()) - 3600
+
+        for validator, entry in (("htpasswd", htpasswd_entry),
+                                 ("htdigest", htdigest_entry)):
+            dir   = "file_reload_%s" % (validator)
+            passf = os.path.join (www, dir, "passwd")
+
+            globals()["%s_file" % (validator)] = passf
+
+            # Right and wrong password, the right one again (cached),
+            # then revoked by a new password file
+            #
+            self.Add (TestEntry (dir, PASSWD1, 200, setup=(entry(PASSWD1), past)))
+            self.Add (TestEntry (dir, PASSWD2, 401))
+            self.Add (TestEntry (dir, PASSWD1, 200))
+            self.Add (TestEntry (dir, PASSWD1, 401, rewrite=(passf, entry(PASSWD2), past + 60)))
+            self.Add (TestEntry (dir, PASSWD2, 200))
+
+        self.conf = CONF % (globals())
+        TestCollection.Prepare (self, www)
@@ -0,0 +1,79 @@
+import os
+from base import *
+
+DIR    = "/FCGI-Keepalive2/"
+PORT   = get_free_port()
+PYTHON = look_for_python()
+
+SCRIPT = """
+import fcgi
+
+accepted = [0]
+connection_init = fcgi.Connection.__init__
+connection_begin_request = fcgi.Connection._do_begin_request
+
+def counting_init (self, *args):
+    accepted[0] += 1
+    self.begun = 0
+    connection_init (self, *args)
+
+def dropping_begin_request (self, inrec):
+    # Drop the kept connection on its second request
+    self.begun += 1
+    if self.begun > 1:
+        self._sock.close()
+        raise EOFError
+    connection_begin_request (self, inrec)
+
+fcgi.Connection.__init__          = counting_init
+fcgi.Connection._do_begin_request = dropping_begin_request
+
+def app (environ, start_response):
+    start_response('200 OK', [("Content-Type", "text/plain")])
+    return ['Back-end connections: %%d\\n' %% (accepted[0])]
+
+fcgi.WSGIServer(app, bindAddress=("localhost",%d)).run()
+""" % (PORT)
+
+source = get_next_source()
+
+CONF = """
+vserver!1!rule!2740!match = directory
+vserver!1!rule!2740!match!directory = %(DIR)s
+vserver!1!rule!2740!handler = fcgi
+vserver!1!rule!2740!handler!check_file = 0
+vserver!1!rule!2740!handler!reuse_max = 2
+vserver!1!rule!2740!handler!balancer = round_robin
+vserver!1!rule!2740!handler!balancer!source!1 = %(source)d
+
+source!%(source)d!type = interpreter
+source!%(source)d!host = localhost:%(PORT)d
+source!%(source)d!interpreter = %(PYTHON)s %(fcgi_file)s
+"""
+
+
+class Test (TestBase):
+    def __init__ (self):
+        TestBase.__init__ (self, __file__)
+        self.name = "FastCGI: Keepalive, dropped connection"
+
+        self.request = "GET %s HTTP/1.1\r\n" %(DIR) + \
+                       "Host: localhost\r\n"        + \
+                       "Connection: Keep-Alive\r\n\r\n"
+        # Second request: sent again over a new connection
+        self.request += self.request
+
+        self.expected_error    = 200
+        self.expected_content  = ['Back-end connections: 1', 'Back-end connections: 2']
+        self.forbidden_content = ['502 Bad Gateway', 'import fcgi']
+
+    def Prepare (self, www):
+        fcgi_file = self.WriteFile (www, "fcgi_test_keepalive2.fcgi", 0444, SCRIPT)
+
+        fcgi = os.path.join (www, 'fcgi.py')
+        if not os.path.exists (fcgi):
+            self.CopyFile ('fcgi.py', fcgi)
+
+        vars = globals()
+        vars['fcgi_file'] = fcgi_file
+        self.conf = CONF % (vars)
@@ -0,0 +1,118 @@
+import time
+import random
+from base import *
+
+DIR     = "pipe3"
+FILES   = 5
+LENGTH  = 12 * 1024
+RCVBUF  = 2048
+CHUNK   = 1024
+
+def content (n):
+    r = random.Random (n)
+    return ''.join ([chr (r.randint (ord('a'), ord('z'))) for i in range(LENGTH)])
+
+
+class Test (TestBase):
+    def __init__ (self):
+        TestBase.__init__ (self, __file__)
+        self.name           = "Pipelining, partial writes"
+        self.proxy_suitable = False
+
+        # The responses to the first requests are queued and go out
+        # in a single write with the last one. The client reads them
+        # slowly through a small receive window, so the server's
+        # writes are cut short.
+        #
+        for n in range(1, FILES+1):
+            if n < FILES:
+                connection = "Keep-alive"
+            else:
+                connection = "Close"
+
+            self.request += "GET /%s/file%d HTTP/1.1\r\n" %(DIR, n) +\
+                            "Host: localhost\r\n"                   +\
+                            "Connection: %s\r\n" %(connection)
+            if n < FILES:
+                self.request += "\r\n"
+
+        self.expected_error = 200
+
+    def Prepare (self, www):
+        self.Mkdir (www, DIR)
+        for n in range(1, FILES+1):
+            self.WriteFile (www, "%s/file%d" %(DIR, n), 0444, content(n))
+
+    def _do_slow_request (self, host, port, ssl):
+        s = None
+        for res in socket.getaddrinfo (host, port, socket.AF_UNSPEC, socket.SOCK_STREAM):
+            af, socktype, proto, canonname, sa = res
+            try:
+                s = socket.socket (af, socktype, proto)
+                s.setsockopt (socket.SOL_SOCKET, socket.SO_RCVBUF, RCVBUF)
+                s.connect (sa)
+            except socket.error, msg:
+                if s: s.close()
+                s = None
+                continue
+            break
+
+        if s is None:
+            raise Exception("Couldn't connect to the server")
+
+        if ssl:
+            self.ssl = socket.ssl (s)
+
+        request = self.request + "\r\n"
+        if self.ssl:
+            self.ssl.write (request)
+        else:
+            s.sendall (request)
+
+        while True:
+            time.sleep (0.01)
+            try:
+                if self.ssl:
+                    d = self.ssl.read (CHUNK)
+                else:
+                    d = s.recv (CHUNK)
+            except Exception, e:
+                d = ''
+
+            if not len(d):
+                break
+            self.reply += d
+
+        s.close()
+
+    def CustomTest (self):
+        # Every response, exactly once and in order
+        reply = self.reply
+        for n in range(1, FILES+1):
+            if not reply.startswith ("HTTP/1.1 200"):
+                return -1
+
+            head, sep, reply = reply.partition ("\r\n\r\n")
+            if not sep:
+                return -1
+
+            length = None
+            for line in head.split ("\r\n"):
+                if line.lower().startswith ("content-length:"):
+                    length = int (line.split(':',1)[1])
+            if length != LENGTH:
+                return -1
+
+            if reply[:length] != content(n):
+                return -1
+            reply = reply[length:]
+
+        if len(reply) > 0:
+            return -1
+
+        return 0
+
+    def Run (self, host, port, ssl):
+        self._do_slow_request (host, port, ssl)
+        self._parse_output()
+        return self._check_result()